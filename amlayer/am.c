@@ -1,14 +1,20 @@
 #include "am.h"
 
-/* splits a leaf node */
-int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength,
-                 int recId, char *value, int status, int index, char *key) {
+/* splits a full leaf node in two, for the insert of value at index to
+be retried; the separator for the parent is returned in key */
+int AM_SplitLeaf(AM_IndexHandle *ih, char *pageBuf, int *pageNum,
+                 char *value, int index, char *key) {
   AM_LEAFHEADER head, temphead; /* local header */
   AM_LEAFHEADER *header, *tempheader;
   char tempPage[PF_PAGE_SIZE]; /* temporary page for manipulation on the page */
   char *tempPageBuf, *tempPageBuf1; /* buffers for new pages to be allocated */
+  char first[AM_MAXATTRLENGTH]; /* first key of a half, the prefix of its layout */
+  char left[AM_MAXATTRLENGTH], right[AM_MAXATTRLENGTH]; /* keys either side of the split */
   int errVal;
   int tempPageNum, tempPageNum1; /* pagenumbers for pages to be allocated */
+  int half;     /* keys in the first half */
+  int prefixLength, keyWidth;
+  int fileDesc = ih->fileDesc;
 
   /* initialise pointers to headers */
   header = &head;
@@ -17,28 +23,32 @@ int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength,
   /* copy header from buffer */
   memcpy(header, pageBuf, AM_sl);
 
-  /* compact half the keys into temporary page */
-  AM_Compact(1, (header->numKeys) / 2, pageBuf, tempPage, header);
+  /* half the keys go either way; a lone key goes to the side value
+  does not, which leaves value an empty leaf */
+  half = (header->numKeys > 1) ? (header->numKeys) / 2 : index - 1;
+
+  /* the keys either side of the split, value standing in for a missing one */
+  AM_CanonKey(&ih->keyType, value, left);
+  memcpy(right, left, header->attrLength);
+  if (half > 0)
+    AM_LeafKey(pageBuf, header, half, left);
+  if (half < header->numKeys)
+    AM_LeafKey(pageBuf, header, half + 1, right);
+  AM_Separator(left, right, header->attrLength, header->packed, key);
+
+  /* compact half the keys into temporary page, in their own layout */
+  AM_RangeLayout(pageBuf, header, 1, half, first, &prefixLength, &keyWidth);
+  AM_CompactAs(1, half, pageBuf, tempPage, header, prefixLength, keyWidth, first);
 
   /* Allocate a new page for the other half of the leaf*/
   errVal = PF_AllocPage(fileDesc, &tempPageNum, &tempPageBuf);
   AM_Check(errVal);
 
   /* compact the other half keys */
-  AM_Compact((header->numKeys) / 2 + 1, header->numKeys, pageBuf, tempPageBuf,
-             header);
-
-  /*check where key has to be inserted */
-  if (index <= ((header->numKeys) / 2)) {
-    /*value to be inserted is in first half */
-    errVal =
-        AM_InsertintoLeaf(tempPage, attrLength, value, recId, index, status);
-  } else {
-    /* value to be inserted in second half */
-    index = index - ((header->numKeys) / 2);
-    errVal = AM_InsertintoLeaf(tempPageBuf, attrLength, value, recId, index,
-                             status);
-  }
+  AM_RangeLayout(pageBuf, header, half + 1, header->numKeys, first, &prefixLength,
+                 &keyWidth);
+  AM_CompactAs(half + 1, header->numKeys, pageBuf, tempPageBuf, header, prefixLength,
+               keyWidth, first);
 
   /* change the next leafpage of first half of leaf to second half */
   memcpy(tempheader, tempPage, AM_sl);
@@ -46,26 +56,20 @@ int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength,
   memcpy(tempPage, tempheader, AM_sl);
   memcpy(pageBuf, tempPage, PF_PAGE_SIZE);
 
-  /* copy the value of key to be written onto the parent */
-  memcpy(key, tempPageBuf + AM_sl, attrLength);
-
   /*check if the split page is root */
-  if ((*pageNum) == AM_RootPageNum) {
+  if ((*pageNum) == ih->rootPageNum) {
     /* the page being split is the root*/
     /* Allocate a new page for another leaf as a new root has
     to be created*/
     errVal = PF_AllocPage(fileDesc, &tempPageNum1, &tempPageBuf1);
     AM_Check(errVal);
 
-    AM_LeftPageNum = tempPageNum1; /* this will remain the
-                             leftmost page hence*/
-
     /* copy the old first half(actually the root) into a new page */
     memcpy(tempPageBuf1, pageBuf, PF_PAGE_SIZE);
     /* Initialise the new root page */
 
     AM_FillRootPage(pageBuf, tempPageNum1, tempPageNum, key, header->attrLength,
-                    header->maxKeys);
+                    header->maxKeys, header->packed);
     errVal = PF_UnfixPage(fileDesc, tempPageNum1, TRUE);
     AM_Check(errVal);
   }
@@ -74,7 +78,7 @@ int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength,
   errVal = PF_UnfixPage(fileDesc, tempPageNum, TRUE);
   AM_Check(errVal);
 
-  if ((*pageNum) == AM_RootPageNum) {
+  if ((*pageNum) == ih->rootPageNum) {
     /* Unfix the original page (which is now the new internal root) */
     errVal = PF_UnfixPage(fileDesc, *pageNum, TRUE);
     AM_Check(errVal);
@@ -91,7 +95,7 @@ int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength,
 }
 
 /* Adds to the parent(on top of the path stack) attribute value and page Number*/
-int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
+int AM_AddtoParent(AM_IndexHandle *ih, AM_STACK *path, int pageNum, char *value) {
   char tempPage[PF_PAGE_SIZE]; /* temporary page for manipulating page */
   int pageNumber; /* pageNumber of parent to which key is to be added-
                                      got from stack*/
@@ -99,6 +103,7 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
                        got from stack*/
   int errVal;
   int pageNum1, pageNum2; /* pagenumbers for new pages to be allocated */
+  int fileDesc = ih->fileDesc;
 
   char *pageBuf, *pageBuf1, *pageBuf2;
   AM_INTHEADER head, *header;
@@ -107,10 +112,15 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
   header = &head;
   /* Get the top of stack values for the page number of the parent
    and offset of the key */
-  AM_topofStack(&pageNumber, &offset);
-  AM_PopStack();
-
-  /* Get the parent node */
+  AM_topofStack(path, &pageNumber, &offset);
+  AM_PopStack(path);
+
+  /* Get the parent node; any cached copy of it is about to be stale, and
+  concurrent readers must see it change */
+  AM_NodeCacheDrop(ih, pageNumber);
+  errVal = AM_OlcLock(ih, pageNumber);
+  if (errVal != AME_OK)
+    return (errVal);
   errVal = PF_GetThisPage(fileDesc, pageNumber, &pageBuf);
   AM_Check(errVal);
 
@@ -118,7 +128,7 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
   memcpy(header, pageBuf, AM_sint);
 
   /* check if there is room in this node for another key */
-  if ((header->numKeys) < (header->maxKeys)) {
+  if (AM_IntPageFits(pageBuf, header, value)) {
     /* add the attribute value to the node */
     AM_AddtoIntPage(pageBuf, value, pageNum, header, offset);
 
@@ -137,7 +147,7 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
     AM_SplitIntNode(pageBuf, tempPage, pageBuf1, header, value, pageNum, offset);
 
     /* check if page being split is root */
-    if (pageNumber == AM_RootPageNum) {
+    if (pageNumber == ih->rootPageNum) {
       /* allocate a new page for a new root */
       errVal = PF_AllocPage(fileDesc, &pageNum2, &pageBuf2);
       AM_Check(errVal);
@@ -148,7 +158,7 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
       /* fill the header of new root page and the
       attribute value */
       AM_FillRootPage(pageBuf, pageNum2, pageNum1, value, header->attrLength,
-                      header->maxKeys);
+                      header->maxKeys, header->packed);
 
       errVal = PF_UnfixPage(fileDesc, pageNumber, TRUE);
       AM_Check(errVal);
@@ -167,10 +177,10 @@ int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength) {
     errVal = PF_UnfixPage(fileDesc, pageNum1, TRUE);
     AM_Check(errVal);
     
-    if (pageNumber != AM_RootPageNum) {
+    if (pageNumber != ih->rootPageNum) {
       /* recursive call to add to the parent of this
       internal node*/
-      errVal = AM_AddtoParent(fileDesc, pageNum1, value, attrLength);
+      errVal = AM_AddtoParent(ih, path, pageNum1, value);
       AM_Check(errVal);
     }
   }
@@ -183,6 +193,10 @@ void AM_AddtoIntPage(char *pageBuf, char *value, int pageNum,
   int recSize;
   int i;
 
+  if (header->packed) {
+    AM_AddtoPackedPage(pageBuf, value, pageNum, header, offset);
+    return;
+  }
   recSize = header->attrLength + AM_si;
 
   /* shift all the keys greater than the one to be added to the right to
@@ -204,19 +218,20 @@ void AM_AddtoIntPage(char *pageBuf, char *value, int pageNum,
 
 /* Fills the header and inserts a key into a new root */
 void AM_FillRootPage(char *pageBuf, int pageNum1, int pageNum2, char *value,
-                     short attrLength, short maxKeys) {
+                     short attrLength, short maxKeys, char packed) {
   AM_INTHEADER temphead, *tempheader;
 
   tempheader = &temphead;
 
   /* fill the header */
   tempheader->pageType = 'i';
+  tempheader->packed = packed;
   tempheader->attrLength = attrLength;
   tempheader->maxKeys = maxKeys;
-  tempheader->numKeys = 1;
+  tempheader->numKeys = 0;
+  tempheader->keyPtr = PF_PAGE_SIZE;
   memcpy(pageBuf + AM_sint, (char *)&pageNum1, AM_si);
-  memcpy(pageBuf + AM_sint + AM_si, value, attrLength);
-  memcpy(pageBuf + AM_sint + AM_si + attrLength, (char *)&pageNum2, AM_si);
+  AM_AddtoIntPage(pageBuf, value, pageNum2, tempheader, 0);
   memcpy(pageBuf, tempheader, AM_sint);
 }
 
@@ -230,12 +245,14 @@ void AM_SplitIntNode(char *pageBuf, char *pbuf1, char *pbuf2,
        AM_MAXATTRLENGTH]; /* temp page for manipulating pageBuf */
   int length1, length2, length3; 
 
+  if (header->packed) {
+    AM_SplitPackedNode(pageBuf, pbuf1, pbuf2, header, value, pageNum, offset);
+    return;
+  }
   tempheader = &temphead;
   recSize = header->attrLength + AM_si;
 
-  tempheader->pageType = header->pageType;
-  tempheader->attrLength = header->attrLength;
-  tempheader->maxKeys = header->maxKeys;
+  memcpy(tempheader, header, AM_sint);
 
   length1 = AM_si + (offset * recSize);
   /* copy the keys to the left of the key to be added */
@@ -19,6 +19,8 @@
 
 typedef struct am_leafheader {
   char pageType;      /* 'l' for leaf */
+  char packed;        /* TRUE for a compressed node (amprefix.c) */
+  char postings;      /* TRUE if recIds are kept in posting lists (amposting.c) */
   int nextLeafPage;   /* Page number of next leaf, or AM_NULL_PAGE */
   short recIdPtr;     /* Offset to start of free space for recIds */
   short keyPtr;       /* Offset to start of free space for keys */
@@ -27,24 +29,131 @@ typedef struct am_leafheader {
   short attrLength;   /* Length of the attribute (key) */
   short numKeys;      /* Number of keys on the page */
   short maxKeys;      /* Max keys this page can hold */
+  short prefixLength; /* Bytes all keys share, kept at the end of the page */
+  short keyWidth;     /* Bytes stored per key, after the prefix */
 } AM_LEAFHEADER;      /* Header for a leaf page */
 
 typedef struct am_intheader {
   char pageType;   /* 'i' for internal */
+  char packed;     /* TRUE for a compressed node (amprefix.c) */
   short numKeys;   /* Number of keys on the page */
   short maxKeys;   /* Max keys this page can hold */
   short attrLength;/* Length of the attribute (key) */
+  short keyPtr;    /* Start of the separator bytes of a compressed node */
 } AM_INTHEADER;    /* Header for an internal node */
 
+typedef struct am_intentry {
+  short keyOff;    /* separator: its bytes on the page */
+  short keyLen;
+  int child;       /* the child to its right */
+} AM_INTENTRY;     /* Key of a compressed internal node */
+
+typedef struct am_postingref {
+  int firstPage;   /* first and last posting page of the list */
+  int lastPage;
+  int count;       /* recIds on them */
+} AM_POSTINGREF;   /* Posting list kept on posting pages, as its leaf holds it */
+
+typedef struct am_postingheader {
+  char pageType;   /* 'p' for a posting page */
+  int nextPage;    /* next page of the list, or AM_NULL_PAGE */
+  short count;     /* recIds on the page, 0 once all are deleted */
+  short size;      /* bytes of varints after the header */
+  short version;   /* changes with the page, for scans reading ahead */
+  int first;       /* smallest and largest recId on the page */
+  int last;
+} AM_POSTINGHEADER; /* Header for a posting page */
+
+/* Misc constants */
+#define AM_NULL 0            /* Null pointer for lists in a page */
+#define AM_MAX_FNAME_LENGTH 80
+#define AM_NULL_PAGE -1
+#define AM_MAXATTRLENGTH 256
+#define AM_MAXSTACK 50       /* deepest root-to-leaf path of a descent */
+
+typedef struct am_nodecache AM_NODECACHE;
+typedef struct am_olc AM_OLC;
+
+/*
+ * AM_KEYTYPE:
+ * How the keys of an index compare, resolved once when it is opened
+ * (AM_ResolveKeyType). The node searches, inserts, splits and scans
+ * call through it and never switch on attrType themselves.
+ */
+typedef struct {
+  char attrType;
+  int attrLength;
+  /* as strncmp: value at valPtr against the key at bufPtr */
+  int (*compare)(char *bufPtr, char *valPtr, int attrLength);
+  /* number of the n keys stride bytes apart below value, *found if the
+     next one equals it; NULL or -1 to search with compare instead */
+  int (*search)(char *keys, int stride, int n, char *value, int *found);
+  int packed; /* nodes are compressed (AM_CREATE_NOCOMPRESSION unset) */
+} AM_KEYTYPE;
+
+/*
+ * AM_IndexHandle:
+ * An open index (AM_OpenIndex). Everything an operation needs to know
+ * about the index is kept here, so any number of indexes can be open
+ * at the same time.
+ */
+typedef struct {
+  int fileDesc;            /* PF file of the index, -1 once closed */
+  char attrType;           /* 'i', 'f', 'c' or 'b' (AM_KEY_BYTES) */
+  int attrLength;          /* key length, read from the root */
+  int rootPageNum;         /* the root: splits keep it in place */
+  AM_NODECACHE *nodeCache; /* cached upper levels (AM_SetNodeCache), or NULL */
+  AM_OLC *olc;             /* version locks (AM_SetConcurrent), or NULL */
+  AM_KEYTYPE keyType;      /* compare and search functions of the keys */
+} AM_IndexHandle;
+
+#define AM_SCANBATCH 64 /* recIds a scan decodes ahead from a posting list */
+
+/*
+ * AM_ScanHandle:
+ * State of one index scan (AM_OpenIndexScan), kept by the caller.
+ * There is no limit on how many scans are open at once.
+ */
+typedef struct {
+  AM_IndexHandle *ih; /* index being scanned */
+  int op;
+  int status;         /* FREE, FIRST, BUSY, LAST or OVER */
+  int pageNum;        /* leaf and index of the scan value */
+  short index;
+  short actindex;     /* index of the key being returned */
+  int nextpageNum;    /* leaf of the next entry */
+  char nextvalue[AM_MAXATTRLENGTH];
+  short nextIndex;
+  short nextRecIdPtr;
+  int lastpageNum;    /* last entry of a < or <= scan */
+  short lastIndex;
+  int batch[AM_SCANBATCH]; /* recIds of the key at nextIndex decoded ahead */
+  short batchLen;     /* 0 unless the leaf holds posting lists */
+  short batchPos;     /* next of them to return */
+  char batchMore;     /* the key has recIds after the batch */
+  int listPage;       /* posting page the batch ended in, or AM_NULL_PAGE */
+  short listOff;      /* its next varint */
+  short listVersion;  /* version of the page then */
+} AM_ScanHandle;
+
+/* Path of internal nodes from the root to a leaf, recorded by a
+descent for an insert to split its way back up. Each operation keeps
+its own. */
+typedef struct {
+  int top; /* -1 when empty */
+  struct {
+    int pageNumber;
+    int offset;
+  } entry[AM_MAXSTACK];
+} AM_STACK;
+
 /*
  * =================================================================
  * Global Variables
  * =================================================================
  */
 
-extern int AM_RootPageNum; /* The page number of the root */
-extern int AM_LeftPageNum; /* The page Number of the leftmost leaf */
-extern int AM_Errno;       /* last error in AM layer */
+extern _Thread_local int AM_Errno; /* last error in AM layer, per thread */
 
 /*
  * =================================================================
@@ -66,18 +175,14 @@ extern int AM_Errno;       /* last error in AM layer */
 #define AM_sint sizeof(AM_INTHEADER)
 #define AM_sc sizeof(char)
 #define AM_sf sizeof(float)
+#define AM_se sizeof(AM_INTENTRY)
+#define AM_sp sizeof(AM_POSTINGHEADER)
 
 /* Search status */
 #define AM_NOT_FOUND 0 /* Key is not in tree */
 #define AM_FOUND 1     /* Key is in tree */
 
-/* Misc constants */
-#define AM_NULL 0            /* Null pointer for lists in a page */
-#define AM_MAX_FNAME_LENGTH 80
-#define AM_NULL_PAGE -1
-#define AM_MAXATTRLENGTH 256
-
-/* Scan Table status */
+/* Scan status */
 #define FREE 0
 #define FIRST 1
 #define BUSY 2
@@ -92,7 +197,17 @@ extern int AM_Errno;       /* last error in AM layer */
 #define LESS_THAN_EQUAL 4
 #define GREATER_THAN_EQUAL 5
 #define NOT_EQUAL 6
-#define MAXSCANS 20
+
+/*
+ * Create flags (AM_CreateIndexFlags)
+ * AM_CREATE_NOCOMPRESSION - plain nodes: 'c' and AM_KEY_BYTES indexes
+ *                           otherwise get compressed nodes (amprefix.c)
+ * AM_CREATE_NOPOSTINGS    - each recId of a key is an entry of a linked
+ *                           list in its leaf, not part of a posting list
+ *                           (amposting.c)
+ */
+#define AM_CREATE_NOCOMPRESSION 0x1
+#define AM_CREATE_NOPOSTINGS 0x2
 
 /*
  * =================================================================
@@ -111,24 +226,86 @@ extern int AM_Errno;       /* last error in AM layer */
 #define AME_INVALIDATTRTYPE -9
 #define AME_FD -10
 #define AME_INVALIDVALUE -11
+#define AME_NOTEMPTY -12
+#define AME_UNSORTED -13
+#define AME_DUPOVERFLOW -14
 
 /*
  * =================================================================
- * Public Function Prototypes (from amfns.c, aminsert.c, amscan.c)
+ * Public Function Prototypes (from amfns.c, ambulk.c, amcache.c, amkey.c, amolc.c, amsearch.c, amscan.c)
  * =================================================================
  */
 
 /* amfns.c */
 int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength);
+int AM_CreateIndexFlags(char *fileName, int indexNo, char attrType,
+                        int attrLength, int flags);
 int AM_DestroyIndex(char *fileName, int indexNo);
-int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value, int recId);
-int AM_InsertEntry(int fileDesc, char attrType, int attrLength, char *value, int recId);
+int AM_OpenIndex(char *fileName, int indexNo, char attrType, AM_IndexHandle *ih);
+int AM_CloseIndex(AM_IndexHandle *ih);
+int AM_DeleteEntry(AM_IndexHandle *ih, char *value, int recId);
+int AM_InsertEntry(AM_IndexHandle *ih, char *value, int recId);
 void AM_PrintError(char *s);
 
+/* ambulk.c */
+/* Returns the next (value, recId) pair of a bulk load in *value and
+   *recId with AME_OK, AME_EOF after the last one, or an error */
+typedef int (*AM_BulkNext)(void *arg, char *value, int *recId);
+int AM_BulkLoad(AM_IndexHandle *ih, AM_BulkNext next, void *arg, float fillFactor);
+
+/* amcache.c */
+typedef struct {
+  long hits;          /* internal nodes read from the cache */
+  long misses;        /* internal nodes read through the PF layer */
+  long invalidations; /* cached nodes dropped because a split changed them */
+  long swizzled;      /* child hops taken through a swizzled pointer */
+  int nodes;          /* nodes held now */
+} AM_NodeCacheStats;
+int AM_SetNodeCache(AM_IndexHandle *ih, int maxNodes);
+int AM_GetNodeCacheStats(AM_IndexHandle *ih, AM_NodeCacheStats *stats);
+
+/* amolc.c */
+typedef struct {
+  long restarts;     /* descents started over because a node changed */
+  long leafInserts;  /* inserts that changed only their leaf */
+  long splitInserts; /* inserts that split, done under the pool latch */
+  long residentHops; /* descent hops to a resident node, without the latch */
+  long latchedPins;  /* descent hops that pinned a node under the latch */
+} AM_ConcurrencyStats;
+int AM_SetConcurrent(AM_IndexHandle *ih, int on);
+int AM_GetConcurrencyStats(AM_IndexHandle *ih, AM_ConcurrencyStats *stats);
+int AM_LookupEntry(AM_IndexHandle *ih, char *value, int *recIds, int maxIds);
+
+/* amkey.c */
+/* Normalized keys: an index of attrType AM_KEY_BYTES compares its keys
+   with memcmp; these encoders build them a column at a time */
+#define AM_KEY_BYTES 'b'
+#define AM_KEY_NULL 0x00  /* first byte of a NULL column: before any value */
+#define AM_KEY_VALUE 0x01 /* first byte of any other column */
+#define AM_KEY_INT_LEN 5
+#define AM_KEY_INT64_LEN 9
+#define AM_KEY_FLOAT_LEN 5
+#define AM_KEY_DOUBLE_LEN 9
+#define AM_KEY_CHAR_LEN(n) ((n) + 1)
+int AM_KeyNull(char *key, int offset, int width);
+int AM_KeyInt(char *key, int offset, int value);
+int AM_KeyInt64(char *key, int offset, long long value);
+int AM_KeyFloat(char *key, int offset, float value);
+int AM_KeyDouble(char *key, int offset, double value);
+int AM_KeyChar(char *key, int offset, char *value, int len);
+
+/* amsearch.c */
+/* How AM_BinSearch and AM_SearchLeaf search a node of 'i' or 'f' keys */
+#define AM_SEARCH_COMPARE 0 /* binary search through the compare function, as for 'c' */
+#define AM_SEARCH_SCALAR 1  /* branchless, typed compares in plain C */
+#define AM_SEARCH_SSE 2     /* ... and the last 16 keys 4 at a time (SSE4.2) */
+#define AM_SEARCH_AVX2 3    /* ... and 8 at a time, gathered (AVX2) */
+int AM_SetSearchLevel(int level);
+
 /* amscan.c */
-int AM_OpenIndexScan(int fileDesc, char attrType, int attrLength, int op, char *value);
-int AM_FindNextEntry(int scanDesc);
-int AM_CloseIndexScan(int scanDesc);
+int AM_OpenIndexScan(AM_IndexHandle *ih, AM_ScanHandle *sh, int op, char *value);
+int AM_FindNextEntry(AM_ScanHandle *sh);
+int AM_CloseIndexScan(AM_ScanHandle *sh);
 
 /*
  * =================================================================
@@ -137,39 +314,95 @@ int AM_CloseIndexScan(int scanDesc);
  */
 
 /* am.c */
-int AM_SplitLeaf(int fileDesc, char *pageBuf, int *pageNum, int attrLength, int recId, char *value, int status, int index, char *key);
-int AM_AddtoParent(int fileDesc, int pageNum, char *value, int attrLength);
+int AM_SplitLeaf(AM_IndexHandle *ih, char *pageBuf, int *pageNum, char *value, int index, char *key);
+int AM_AddtoParent(AM_IndexHandle *ih, AM_STACK *path, int pageNum, char *value);
 void AM_AddtoIntPage(char *pageBuf, char *value, int pageNum, AM_INTHEADER *header, int offset);
-void AM_FillRootPage(char *pageBuf, int pageNum1, int pageNum2, char *value, short attrLength, short maxKeys);
+void AM_FillRootPage(char *pageBuf, int pageNum1, int pageNum2, char *value, short attrLength, short maxKeys, char packed);
 void AM_SplitIntNode(char *pageBuf, char *pbuf1, char *pbuf2, AM_INTHEADER *header, char *value, int pageNum, int offset);
 
+/* amcache.c */
+typedef struct am_cachednode AM_CACHEDNODE;
+AM_CACHEDNODE *AM_NodeCacheRoot(AM_IndexHandle *ih, int *pageNum);
+AM_CACHEDNODE *AM_NodeCacheGet(AM_IndexHandle *ih, int pageNum);
+char *AM_NodeCachePage(AM_CACHEDNODE *node);
+AM_CACHEDNODE *AM_NodeCacheAdd(AM_IndexHandle *ih, int pageNum, int depth, char *pageBuf, AM_CACHEDNODE *parent, int pos);
+int AM_NodeCacheFollow(AM_IndexHandle *ih, AM_CACHEDNODE *parent, int pos, int pageNum, AM_CACHEDNODE **child, char **pageBuf, int *fixed);
+void AM_NodeCacheDrop(AM_IndexHandle *ih, int pageNum);
+void AM_NodeCacheFree(AM_IndexHandle *ih);
+
+/* amglobals.c */
+void AM_LatchPool(void);
+void AM_UnlatchPool(void);
+
+/* amolc.c */
+#define AM_OLC_SPLIT 1 /* AM_OlcInsert: the leaf is full, insert under the latch */
+int AM_OlcInsert(AM_IndexHandle *ih, char *value, int recId);
+int AM_OlcLock(AM_IndexHandle *ih, int pageNum);
+void AM_OlcFree(AM_IndexHandle *ih);
+void AM_OlcUnlockAll(AM_IndexHandle *ih);
+
 /* aminsert.c */
-int AM_InsertintoLeaf(char *pageBuf, int attrLength, char *value, int recId, int index, int status);
+int AM_InsertintoLeaf(AM_IndexHandle *ih, char *pageBuf, char *value, int recId, int index, int status);
 void AM_InsertToLeafFound(char *pageBuf, int recId, int index, AM_LEAFHEADER *header);
 void AM_InsertToLeafNotFound(char *pageBuf, char *value, int recId, int index, AM_LEAFHEADER *header);
 void AM_Compact(int low, int high, char *pageBuf, char *tempPage, AM_LEAFHEADER *header);
+void AM_CompactAs(int low, int high, char *pageBuf, char *tempPage, AM_LEAFHEADER *header, int prefixLength, int keyWidth, char *prefix);
+
+/* amprefix.c */
+#define AM_PACKED_TYPE(t) ((t) == 'c' || (t) == AM_KEY_BYTES)
+/* most separators a compressed internal node holds: its maxKeys */
+#define AM_PACKED_MAXKEYS ((PF_PAGE_SIZE - (int)AM_sint - (int)AM_si) / (int)AM_se)
+int AM_CanonKey(AM_KEYTYPE *kt, char *value, char *canon);
+int AM_KeyLength(char *key, int attrLength);
+void AM_LeafKey(char *pageBuf, AM_LEAFHEADER *header, int index, char *key);
+short AM_LeafList(char *pageBuf, int index);
+int AM_LeafLayout(char *pageBuf, AM_LEAFHEADER *header, char *canon, int *prefixLength, int *keyWidth);
+void AM_RangeLayout(char *pageBuf, AM_LEAFHEADER *header, int low, int high, char *first, int *prefixLength, int *keyWidth);
+void AM_Separator(char *left, char *right, int attrLength, int packed, char *key);
+char *AM_IntKey(char *pageBuf, int attrLength, int i, int *len);
+int AM_IntChild(char *pageBuf, AM_INTHEADER *header, int i);
+int AM_IntPageFits(char *pageBuf, AM_INTHEADER *header, char *value);
+void AM_AddtoPackedPage(char *pageBuf, char *value, int pageNum, AM_INTHEADER *header, int offset);
+void AM_SplitPackedNode(char *pageBuf, char *pbuf1, char *pbuf2, AM_INTHEADER *header, char *value, int pageNum, int offset);
+
+/* amposting.c */
+#define AM_POSTING_PAGES -1   /* size of a list kept on posting pages */
+#define AM_POSTING_INLINE 512 /* most bytes of varints a list keeps in its leaf */
+#define AM_POSTING_LATCH -2   /* AM_PostingLookup: the list must be read latched */
+/* bytes a list on posting pages takes in its leaf */
+#define AM_POSTING_REFBYTES ((int)(AM_ss + sizeof(AM_POSTINGREF)))
+int AM_PostingEncode(int *recIds, int n, char *buf);
+int AM_PostingDecode(char *buf, int size, int *recIds, int maxIds);
+int AM_PostingBytes(char *pageBuf, int off);
+int AM_PostingNewBytes(int recId);
+short AM_PostingNew(char *pageBuf, AM_LEAFHEADER *header, int recId);
+int AM_PostingAdd(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header, int index, int recId, int spill);
+int AM_PostingRemove(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header, int index, int recId);
+int AM_PostingLookup(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header, int index, int *recIds, int maxIds, int latched);
+int AM_PostingFill(AM_ScanHandle *sh, char *pageBuf, int index, int resume);
+void AM_PrintPostings(char *pageBuf, int off);
 
 /* amprint.c */
 void AM_PrintIntNode(char *pageBuf, char attrType);
 void AM_PrintLeafNode(char *pageBuf, char attrType);
-void AM_DumpLeafPages(int fileDesc, int min, char attrType, int attrLength);
+void AM_DumpLeafPages(AM_IndexHandle *ih);
 void AM_PrintLeafKeys(char *pageBuf, char attrType);
 void AM_PrintAttr(char *bufPtr, char attrType, int attrLength);
 void AM_PrintTree(int fileDesc, int pageNum, char attrType);
 
 /* amscan.c */
-int GetLeftPageNum(int fileDesc);
+int GetLeftPageNum(AM_IndexHandle *ih);
 
 /* amsearch.c */
-int AM_Search(int fileDesc, char attrType, int attrLength, char *value, int *pageNum, char **pageBuf, int *indexPtr);
-int AM_BinSearch(char *pageBuf, char attrType, int attrLength, char *value, int *indexPtr, AM_INTHEADER *header);
-int AM_SearchLeaf(char *pageBuf, char attrType, int attrLength, char *value, int *indexPtr, AM_LEAFHEADER *header);
-int AM_Compare(char *bufPtr, char attrType, int attrLength, char *valPtr);
+int AM_Search(AM_IndexHandle *ih, char *value, AM_STACK *path, int *pageNum, char **pageBuf, int *indexPtr);
+int AM_BinSearch(char *pageBuf, AM_KEYTYPE *kt, char *value, int *indexPtr, AM_INTHEADER *header);
+int AM_SearchLeaf(char *pageBuf, AM_KEYTYPE *kt, char *value, int *indexPtr, AM_LEAFHEADER *header);
+int AM_ResolveKeyType(AM_KEYTYPE *kt, char attrType, int attrLength);
 
 /* amstack.c */
-void AM_PushStack(int pageNum, int offset);
-void AM_PopStack(void);
-void AM_topofStack(int *pageNum, int *offset);
-void AM_EmptyStack(void);
+int AM_PushStack(AM_STACK *stack, int pageNum, int offset);
+void AM_PopStack(AM_STACK *stack);
+void AM_topofStack(AM_STACK *stack, int *pageNum, int *offset);
+void AM_EmptyStack(AM_STACK *stack);
 
 #endif /* AM_H */
\ No newline at end of file
@@ -0,0 +1,367 @@
+#include "am.h"
+
+/*
+ * Bottom-up bulk loading. Leaves are filled left to right straight in
+ * the buffer pool (one page pinned at a time) and chained through
+ * nextLeafPage as they are appended. Every finished page hands its
+ * smallest key and page number to the level above, whose node is built
+ * in private memory and written out once it reaches the fill target,
+ * passing its own smallest key further up. The topmost node ends up in
+ * the root page, which is written last: until then the index stays an
+ * empty leaf. Each page is thus written once.
+ *
+ * In a compressed index (amprefix.c) a leaf is rewritten in place
+ * whenever a key changes its layout, leaves hand up truncated
+ * separators, and internal nodes fill to the target by bytes.
+ *
+ * In an index of posting lists (amposting.c) the list of the last key
+ * grows in place; one that outgrows a leaf it shares moves to the next
+ * leaf, and one past AM_POSTING_INLINE bytes to posting pages, which
+ * takes AM_POSTING_REFBYTES of the leaf: that much is kept for each key.
+ */
+
+/* Deepest tree the loader builds (fan-out 2 at the lowest fill) */
+#define AM_BULK_MAXLEVELS 32
+
+/* An internal node being filled */
+typedef struct {
+  char page[PF_PAGE_SIZE];        /* the node */
+  char lowKey[AM_MAXATTRLENGTH];  /* smallest key in its subtree */
+  AM_INTHEADER header;            /* its header (copied in when written) */
+  int numChildren;                /* 0 while the level has no node */
+} AM_BulkLevel;
+
+typedef struct {
+  int fileDesc;
+  int attrLength;
+  char packed;        /* compressed nodes */
+  char postings;      /* recIds in posting lists */
+  short maxKeys;      /* maxKeys of the index, kept in every header */
+  int intKeys;        /* keys per internal node at the fill factor */
+  int intBudget;      /* bytes of a compressed internal node to fill */
+  AM_BulkLevel *levels; /* levels[1] holds leaf separators */
+} AM_BulkState;
+
+static int AM_BulkAddChild(AM_BulkState *st, int lvl, char *key, int child);
+
+/* Writes the node at level lvl to a new page and adds it to the level above */
+static int AM_BulkWriteNode(AM_BulkState *st, int lvl) {
+  AM_BulkLevel *level = &st->levels[lvl];
+  int pageNum;
+  char *pageBuf;
+  int errVal;
+
+  errVal = PF_AppendPage(st->fileDesc, &pageNum, &pageBuf);
+  AM_Check(errVal);
+  memcpy(level->page, &level->header, AM_sint);
+  memcpy(pageBuf, level->page, PF_PAGE_SIZE);
+  errVal = PF_UnfixPage(st->fileDesc, pageNum, TRUE);
+  AM_Check(errVal);
+  level->numChildren = 0;
+  return (AM_BulkAddChild(st, lvl + 1, level->lowKey, pageNum));
+}
+
+/* Appends (key, child) to the node at level lvl, writing it out first if full */
+static int AM_BulkAddChild(AM_BulkState *st, int lvl, char *key, int child) {
+  AM_BulkLevel *level;
+  int full;
+  int errVal;
+
+  if (lvl >= AM_BULK_MAXLEVELS)
+    return (AME_INTERROR);
+  level = &st->levels[lvl];
+
+  if (st->packed)
+    full = level->numChildren > 1 &&
+           AM_sint + AM_si + (level->header.numKeys + 1) * AM_se +
+                   (PF_PAGE_SIZE - level->header.keyPtr) +
+                   AM_KeyLength(key, st->attrLength) > st->intBudget;
+  else
+    full = level->numChildren > st->intKeys;
+  if (full) {
+    errVal = AM_BulkWriteNode(st, lvl);
+    if (errVal < 0)
+      return (errVal);
+  }
+
+  if (level->numChildren == 0) {
+    /* first child of a new node: only its pointer is stored */
+    level->header.pageType = 'i';
+    level->header.packed = st->packed;
+    level->header.numKeys = 0;
+    level->header.maxKeys = st->maxKeys;
+    level->header.attrLength = st->attrLength;
+    level->header.keyPtr = PF_PAGE_SIZE;
+    memcpy(level->page + AM_sint, (char *)&child, AM_si);
+    memcpy(level->lowKey, key, st->attrLength);
+  } else {
+    /* key i sits between pointers i and i + 1 */
+    AM_AddtoIntPage(level->page, key, child, &level->header, level->header.numKeys);
+  }
+  level->numChildren++;
+  return (AME_OK);
+}
+
+/* Initialises an empty leaf in pageBuf */
+static void AM_BulkInitLeaf(char *pageBuf, AM_LEAFHEADER *header, int attrLength,
+                            short maxKeys, char packed, char postings) {
+  header->pageType = 'l';
+  header->nextLeafPage = AM_NULL_PAGE;
+  header->recIdPtr = PF_PAGE_SIZE;
+  header->keyPtr = AM_sl;
+  header->freeListPtr = AM_NULL;
+  header->numinfreeList = 0;
+  header->attrLength = attrLength;
+  header->numKeys = 0;
+  header->maxKeys = maxKeys;
+  header->packed = packed;
+  header->postings = postings;
+  header->prefixLength = 0;
+  header->keyWidth = packed ? 0 : attrLength;
+  memcpy(pageBuf, header, AM_sl);
+}
+
+/*
+ * Builds the index ih, which must be empty, from the (value,
+ * recId) pairs that next() returns in ascending key order. Leaves and
+ * internal nodes are filled to fillFactor (0 < fillFactor <= 1) of their
+ * capacity; recIds of one key stay together in its leaf, in input order,
+ * or in recId order in a posting list. On error the index is left empty.
+ */
+static int AM_Bulk(AM_IndexHandle *ih, AM_BulkNext next, void *arg,
+                   float fillFactor) {
+  AM_BulkState st;
+  AM_LEAFHEADER head, *header;  /* header of the leaf being filled */
+  char firstLeaf[PF_PAGE_SIZE]; /* the first leaf, until it has a page */
+  char tempPage[PF_PAGE_SIZE];  /* a leaf being laid out anew */
+  char value[AM_MAXATTRLENGTH];
+  char canon[AM_MAXATTRLENGTH]; /* value as the leaf stores it */
+  char lastKey[AM_MAXATTRLENGTH];
+  char key[AM_MAXATTRLENGTH];   /* a separator */
+  char *leafBuf;     /* leaf being filled */
+  char *pageBuf;
+  int leafPage;      /* its page, AM_NULL_PAGE while it is firstLeaf */
+  int rootPage;
+  int nextPage;
+  int budget;        /* bytes of a leaf to fill */
+  int need;          /* bytes the leaf takes with the next key */
+  int prefixLength, keyWidth; /* its layout then */
+  int entrySize;     /* recId, next pair in a leaf; a posting list's room */
+  int recId;
+  int lastEntry;     /* last recId entry of the last key */
+  char list[AM_POSTING_REFBYTES + AM_POSTING_INLINE]; /* a posting list on the move */
+  int moved;         /* its bytes, 0 if none */
+  int lvl, errVal, cmp;
+  short end = AM_NULL;
+  short ptr;
+  int fileDesc = ih->fileDesc;
+  int attrLength = ih->attrLength;
+
+  /* check the parameters */
+  if (fileDesc < 0) {
+    AM_Errno = AME_FD;
+    return (AME_FD);
+  }
+  if (next == NULL || !(fillFactor > 0 && fillFactor <= 1)) {
+    AM_Errno = AME_INVALIDVALUE;
+    return (AME_INVALIDVALUE);
+  }
+
+  /* the root must be an empty leaf */
+  header = &head;
+  rootPage = ih->rootPageNum;
+  errVal = PF_GetThisPage(fileDesc, rootPage, &pageBuf);
+  AM_Check(errVal);
+  memcpy(header, pageBuf, AM_sl);
+  errVal = PF_UnfixPage(fileDesc, rootPage, FALSE);
+  AM_Check(errVal);
+  if (header->pageType != 'l' || header->numKeys != 0) {
+    AM_Errno = AME_NOTEMPTY;
+    return (AME_NOTEMPTY);
+  }
+
+  st.fileDesc = fileDesc;
+  st.attrLength = attrLength;
+  st.packed = header->packed;
+  st.postings = header->postings;
+  st.maxKeys = header->maxKeys;
+  st.intBudget = AM_sint + AM_si + (int)(fillFactor * (PF_PAGE_SIZE - AM_sint - AM_si));
+  st.intKeys = (int)(fillFactor * header->maxKeys);
+  if (st.intKeys < 1)
+    st.intKeys = 1;
+  st.levels = calloc(AM_BULK_MAXLEVELS, sizeof(AM_BulkLevel));
+  if (st.levels == NULL) {
+    AM_Errno = AME_INTERROR;
+    return (AME_INTERROR);
+  }
+
+  entrySize = st.postings ? AM_POSTING_REFBYTES : AM_si + AM_ss;
+  budget = AM_sl + (int)(fillFactor * (PF_PAGE_SIZE - AM_sl));
+  leafBuf = firstLeaf;
+  leafPage = AM_NULL_PAGE;
+  lastEntry = 0;
+  AM_BulkInitLeaf(leafBuf, header, attrLength, st.maxKeys, st.packed, st.postings);
+
+  /* invariant: the leaf being filled is pinned once it has a page */
+  while ((errVal = next(arg, value, &recId)) == AME_OK) {
+    /* another recId for the last key: append it to the key's list */
+    cmp = (header->numKeys == 0) ? 1 : ih->keyType.compare(lastKey, value, attrLength);
+    if (cmp < 0) {
+      errVal = AME_UNSORTED;
+      break;
+    }
+    if (cmp == 0 && !st.postings) {
+      if (header->recIdPtr - header->keyPtr < entrySize) {
+        errVal = AME_DUPOVERFLOW;
+        break;
+      }
+      header->recIdPtr -= entrySize;
+      ptr = header->recIdPtr;
+      memcpy(leafBuf + ptr, (char *)&recId, AM_si);
+      memcpy(leafBuf + ptr + AM_si, (char *)&end, AM_ss);
+      memcpy(leafBuf + lastEntry + AM_si, (char *)&ptr, AM_ss);
+      lastEntry = ptr;
+      continue;
+    }
+    moved = 0;
+    if (cmp == 0) {
+      errVal = AM_PostingAdd(ih, leafBuf, header, header->numKeys, recId, FALSE);
+      if (errVal < 0)
+        break;
+      if (errVal == TRUE)
+        continue;
+      if (header->numKeys == 1) {
+        errVal = AME_DUPOVERFLOW;
+        break;
+      }
+      /* a posting list that outgrows a leaf it shares goes on in the
+      next one; being the last list, it is the bottom of the heap */
+      moved = AM_PostingBytes(leafBuf, header->recIdPtr);
+      memcpy(list, leafBuf + header->recIdPtr, moved);
+      header->recIdPtr += moved;
+      header->keyPtr -= header->keyWidth + AM_ss;
+      header->numKeys--;
+      AM_LeafKey(leafBuf, header, header->numKeys, lastKey);
+    }
+
+    /* a new key that would pass the fill target: start the next leaf */
+    AM_CanonKey(&ih->keyType, value, canon);
+    AM_LeafLayout(leafBuf, header, canon, &prefixLength, &keyWidth);
+    need = AM_sl + (header->numKeys + 1) * (keyWidth + AM_ss) + prefixLength +
+           (PF_PAGE_SIZE - header->prefixLength - header->recIdPtr) + entrySize;
+    if (header->numKeys > 0 && (moved > 0 || need > PF_PAGE_SIZE || need > budget)) {
+      if (leafPage == AM_NULL_PAGE) {
+        /* the first leaf is not the root after all: give it a page */
+        if (PF_AppendPage(fileDesc, &nextPage, &pageBuf) != PFE_OK) {
+          errVal = AME_PF;
+          break;
+        }
+        leafPage = nextPage;
+        memcpy(pageBuf, firstLeaf, PF_PAGE_SIZE);
+        leafBuf = pageBuf;
+        AM_LeafKey(leafBuf, header, 1, key);
+        if ((errVal = AM_BulkAddChild(&st, 1, key, leafPage)) < 0)
+          break;
+      }
+      if (PF_AppendPage(fileDesc, &nextPage, &pageBuf) != PFE_OK) {
+        errVal = AME_PF;
+        break;
+      }
+      header->nextLeafPage = nextPage;
+      memcpy(leafBuf, header, AM_sl);
+      errVal = PF_UnfixPage(fileDesc, leafPage, TRUE);
+      leafBuf = pageBuf;
+      leafPage = nextPage;
+      AM_BulkInitLeaf(leafBuf, header, attrLength, st.maxKeys, st.packed, st.postings);
+      if (errVal != PFE_OK) {
+        errVal = AME_PF;
+        break;
+      }
+      AM_Separator(lastKey, canon, attrLength, st.packed, key);
+      if ((errVal = AM_BulkAddChild(&st, 1, key, leafPage)) < 0)
+        break;
+      AM_LeafLayout(leafBuf, header, canon, &prefixLength, &keyWidth);
+    }
+
+    /* a compressed leaf is laid out again for a key that does not fit it */
+    if (prefixLength != header->prefixLength || keyWidth != header->keyWidth) {
+      AM_CompactAs(1, header->numKeys, leafBuf, tempPage, header, prefixLength, keyWidth,
+                   canon);
+      memcpy(leafBuf, tempPage, PF_PAGE_SIZE);
+      memcpy(header, leafBuf, AM_sl);
+    }
+
+    /* the key and its first recId, or the list it brings along */
+    if (moved > 0) {
+      header->recIdPtr -= moved;
+      ptr = header->recIdPtr;
+      memcpy(leafBuf + ptr, list, moved);
+    } else if (st.postings) {
+      ptr = AM_PostingNew(leafBuf, header, recId);
+    } else {
+      header->recIdPtr -= entrySize;
+      ptr = header->recIdPtr;
+      memcpy(leafBuf + ptr, (char *)&recId, AM_si);
+      memcpy(leafBuf + ptr + AM_si, (char *)&end, AM_ss);
+    }
+    memcpy(leafBuf + header->keyPtr, canon + header->prefixLength, header->keyWidth);
+    memcpy(leafBuf + header->keyPtr + header->keyWidth, (char *)&ptr, AM_ss);
+    header->keyPtr += header->keyWidth + AM_ss;
+    header->numKeys++;
+    lastEntry = ptr;
+    memcpy(lastKey, canon, attrLength);
+    if (moved > 0) {
+      errVal = AM_PostingAdd(ih, leafBuf, header, header->numKeys, recId, FALSE);
+      if (errVal < 0)
+        break;
+      if (errVal == FALSE) {
+        errVal = AME_DUPOVERFLOW;
+        break;
+      }
+    }
+  }
+
+  /* write the last leaf, then close every level bottom-up; the top
+  node is the root */
+  if (errVal == AME_EOF) {
+    errVal = AME_OK;
+    memcpy(leafBuf, header, AM_sl);
+    if (leafPage != AM_NULL_PAGE) {
+      errVal = (PF_UnfixPage(fileDesc, leafPage, TRUE) == PFE_OK) ? AME_OK : AME_PF;
+      leafPage = AM_NULL_PAGE;
+      for (lvl = 1; errVal == AME_OK && st.levels[lvl + 1].numChildren > 0; lvl++)
+        errVal = AM_BulkWriteNode(&st, lvl);
+      memcpy(st.levels[lvl].page, &st.levels[lvl].header, AM_sint);
+      leafBuf = st.levels[lvl].page;
+    }
+    if (errVal == AME_OK) {
+      AM_NodeCacheDrop(ih, rootPage);
+      if (AM_OlcLock(ih, rootPage) != AME_OK) {
+        errVal = AME_INTERROR;
+      } else if (PF_GetThisPage(fileDesc, rootPage, &pageBuf) != PFE_OK) {
+        errVal = AME_PF;
+      } else {
+        memcpy(pageBuf, leafBuf, PF_PAGE_SIZE);
+        if (PF_UnfixPage(fileDesc, rootPage, TRUE) != PFE_OK)
+          errVal = AME_PF;
+      }
+    }
+  } else if (leafPage != AM_NULL_PAGE) {
+    PF_UnfixPage(fileDesc, leafPage, TRUE);
+  }
+
+  free(st.levels);
+  AM_Errno = errVal;
+  return (errVal);
+}
+
+int AM_BulkLoad(AM_IndexHandle *ih, AM_BulkNext next, void *arg,
+                float fillFactor) {
+  int errVal;
+
+  AM_LatchPool();
+  errVal = AM_Bulk(ih, next, arg, fillFactor);
+  AM_OlcUnlockAll(ih);
+  AM_UnlatchPool();
+  return (errVal);
+}
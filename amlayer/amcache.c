@@ -0,0 +1,302 @@
+#include "am.h"
+
+/*
+ * Resident copies of the upper levels of an index. Every descent
+ * passes through the root and the first internal levels, so keeping
+ * private copies of those nodes saves a PF_GetThisPage/PF_UnfixPage
+ * pair (hash lookup and LRU update) per level and keeps them from
+ * competing with leaves for buffer frames. Only internal nodes are
+ * cached. When the cache is full a node replaces the deepest cached
+ * node if it sits higher up, so the cache settles on the top levels.
+ * A node is dropped as soon as a split changes it; the next descent
+ * reads it again through the PF layer.
+ *
+ * Child pointers of a cached node are swizzled: next to the page
+ * image, each node keeps one swip per child, pointing straight at the
+ * child's cached node, or at the buffer frame of a resident leaf. A
+ * descent follows swips without looking anything up. A leaf's frame
+ * clears its swip when the PF layer evicts it (PF_SwizzlePage); a
+ * cached child clears its parent's swip when it is dropped, and a
+ * dropped parent lets go of the swips it holds. The page image itself
+ * is never changed, so what is on disk stays as it was.
+ *
+ * Each open index has its own cache, dropped by AM_CloseIndex.
+ */
+
+/* A cached internal node: pageNum is AM_NULL_PAGE for a free slot */
+struct am_cachednode {
+  int pageNum;
+  int depth;                  /* 0 for the root */
+  char page[PF_PAGE_SIZE];    /* the copy */
+  void **swips;               /* child i: its cached node or leaf frame, or NULL */
+  int numSwips;               /* room in swips: maxKeys + 1 */
+  int leafChildren;           /* TRUE if the swips refer to leaf frames */
+  AM_CACHEDNODE *parent;      /* cached node whose swip refers to this one */
+  int parentPos;              /* ... at this position */
+};
+
+/* The node cache of an open index (AM_IndexHandle.nodeCache) */
+struct am_nodecache {
+  int maxNodes;          /* nodes the cache may hold */
+  int numNodes;          /* nodes held now */
+  AM_CACHEDNODE *nodes;  /* maxNodes slots, which never move */
+  AM_CACHEDNODE *root;   /* the cached root, or NULL */
+  AM_NodeCacheStats stats;
+};
+
+/* the cached node of pageNum in cache c, or NULL */
+static AM_CACHEDNODE *AM_FindNode(AM_NODECACHE *c, int pageNum) {
+  int i;
+
+  for (i = 0; i < c->maxNodes; i++)
+    if (c->nodes[i].pageNum == pageNum)
+      return (&c->nodes[i]);
+  return (NULL);
+}
+
+/* empties slot node of cache c, letting go of every swip to or from it */
+static void AM_FreeNode(AM_NODECACHE *c, AM_CACHEDNODE *node) {
+  int i;
+
+  for (i = 0; i < node->numSwips; i++) {
+    if (node->swips[i] == NULL)
+      continue;
+    if (node->leafChildren)
+      PF_UnswizzlePage(node->swips[i]);
+    else
+      ((AM_CACHEDNODE *)node->swips[i])->parent = NULL;
+    node->swips[i] = NULL;
+  }
+  if (node->parent != NULL)
+    node->parent->swips[node->parentPos] = NULL;
+  node->parent = NULL;
+  if (c->root == node)
+    c->root = NULL;
+  node->pageNum = AM_NULL_PAGE;
+  c->numNodes--;
+}
+
+/* makes swip pos of parent refer to its cached child node */
+static void AM_LinkNode(AM_CACHEDNODE *parent, int pos, AM_CACHEDNODE *node) {
+  if (node->parent != NULL)
+    node->parent->swips[node->parentPos] = NULL;
+  parent->swips[pos] = node;
+  node->parent = parent;
+  node->parentPos = pos;
+}
+
+/* Drops the node cache of ih, if it has one; AM_CloseIndex calls it */
+void AM_NodeCacheFree(AM_IndexHandle *ih) {
+  AM_NODECACHE *c = ih->nodeCache;
+  int i;
+
+  if (c == NULL)
+    return;
+  for (i = 0; i < c->maxNodes; i++) {
+    if (c->nodes[i].pageNum != AM_NULL_PAGE)
+      AM_FreeNode(c, &c->nodes[i]);
+    free(c->nodes[i].swips);
+  }
+  free(c->nodes);
+  free(c);
+  ih->nodeCache = NULL;
+}
+
+/* Gives the index a cache of up to maxNodes internal nodes, or drops its
+cache with maxNodes 0. Changing the size starts over with an empty
+cache. */
+int AM_SetNodeCache(AM_IndexHandle *ih, int maxNodes) {
+  AM_NODECACHE *c;
+  int i;
+
+  /* check the parameters */
+  if (ih->fileDesc < 0) {
+    AM_Errno = AME_FD;
+    return (AME_FD);
+  }
+  if (maxNodes < 0) {
+    AM_Errno = AME_INVALIDVALUE;
+    return (AME_INVALIDVALUE);
+  }
+
+  /* drop the old cache, if any */
+  AM_LatchPool();
+  AM_NodeCacheFree(ih);
+  AM_UnlatchPool();
+  if (maxNodes == 0)
+    return (AME_OK);
+
+  c = calloc(1, sizeof(AM_NODECACHE));
+  if (c == NULL || (c->nodes = calloc(maxNodes, sizeof(AM_CACHEDNODE))) == NULL) {
+    free(c);
+    AM_Errno = AME_INTERROR;
+    return (AME_INTERROR);
+  }
+  for (i = 0; i < maxNodes; i++)
+    c->nodes[i].pageNum = AM_NULL_PAGE;
+  c->maxNodes = maxNodes;
+  AM_LatchPool();
+  ih->nodeCache = c;
+  AM_UnlatchPool();
+  return (AME_OK);
+}
+
+/* Copies the counters of the index's node cache into stats (all zero if
+it has none) */
+int AM_GetNodeCacheStats(AM_IndexHandle *ih, AM_NodeCacheStats *stats) {
+  AM_NODECACHE *c;
+
+  AM_LatchPool();
+  c = ih->nodeCache;
+  if (c == NULL) {
+    memset(stats, 0, sizeof(AM_NodeCacheStats));
+  } else {
+    *stats = c->stats;
+    stats->nodes = c->numNodes;
+  }
+  AM_UnlatchPool();
+  return (AME_OK);
+}
+
+/* returns the cached root and its page number in *pageNum, or NULL if
+the root is not cached */
+AM_CACHEDNODE *AM_NodeCacheRoot(AM_IndexHandle *ih, int *pageNum) {
+  AM_NODECACHE *c = ih->nodeCache;
+
+  if (c == NULL || c->root == NULL)
+    return (NULL);
+  c->stats.hits++;
+  *pageNum = c->root->pageNum;
+  return (c->root);
+}
+
+/* returns the page image of a cached node */
+char *AM_NodeCachePage(AM_CACHEDNODE *node) { return (node->page); }
+
+/* returns the cached node of pageNum, or NULL */
+AM_CACHEDNODE *AM_NodeCacheGet(AM_IndexHandle *ih, int pageNum) {
+  AM_NODECACHE *c = ih->nodeCache;
+  AM_CACHEDNODE *node;
+
+  if (c == NULL)
+    return (NULL);
+  node = AM_FindNode(c, pageNum);
+  if (node != NULL)
+    c->stats.hits++;
+  return (node);
+}
+
+/* Offers the cache a copy of internal node pageNum, just read at depth
+through the PF layer from position pos of node parent (NULL for the
+root or an uncached parent). Returns the new cached node, or NULL. */
+AM_CACHEDNODE *AM_NodeCacheAdd(AM_IndexHandle *ih, int pageNum, int depth,
+                               char *pageBuf, AM_CACHEDNODE *parent, int pos) {
+  AM_NODECACHE *c = ih->nodeCache;
+  AM_CACHEDNODE *node, *victim;
+  AM_INTHEADER header;
+  int i;
+
+  if (c == NULL)
+    return (NULL);
+  c->stats.misses++;
+
+  /* a free slot, or the deepest node if it is deeper than this one */
+  victim = NULL;
+  for (i = 0; i < c->maxNodes; i++) {
+    node = &c->nodes[i];
+    if (node->pageNum == AM_NULL_PAGE) {
+      victim = node;
+      break;
+    }
+    if (victim == NULL || node->depth > victim->depth)
+      victim = node;
+  }
+  if (victim->pageNum != AM_NULL_PAGE) {
+    if (victim->depth <= depth)
+      return (NULL);
+    AM_FreeNode(c, victim);
+  }
+
+  /* room for a swip per child */
+  memcpy(&header, pageBuf, AM_sint);
+  if (victim->numSwips < header.maxKeys + 1) {
+    free(victim->swips);
+    victim->swips = calloc(header.maxKeys + 1, sizeof(void *));
+    if (victim->swips == NULL) {
+      victim->numSwips = 0;
+      return (NULL);
+    }
+    victim->numSwips = header.maxKeys + 1;
+  }
+
+  victim->pageNum = pageNum;
+  victim->depth = depth;
+  victim->leafChildren = FALSE;
+  memcpy(victim->page, pageBuf, PF_PAGE_SIZE);
+  c->numNodes++;
+  if (depth == 0)
+    c->root = victim;
+  if (parent != NULL)
+    AM_LinkNode(parent, pos, victim);
+  return (victim);
+}
+
+/*
+ * Gets child pageNum of a descent, reached from position pos of parent
+ * (NULL if the parent is not cached). A cached child is returned in
+ * *child with *fixed FALSE; otherwise the page is fixed (*fixed TRUE,
+ * *child NULL). Either way *pageBuf points at the child. A resident
+ * child is reached through parent's swip when it is set, and the swip
+ * is set when it is not.
+ */
+int AM_NodeCacheFollow(AM_IndexHandle *ih, AM_CACHEDNODE *parent, int pos,
+                       int pageNum, AM_CACHEDNODE **child, char **pageBuf,
+                       int *fixed) {
+  int errVal;
+
+  if (parent != NULL && parent->swips[pos] != NULL) {
+    ih->nodeCache->stats.swizzled++;
+    if (parent->leafChildren) {
+      *child = NULL;
+      *fixed = TRUE;
+      return (PF_GetSwizzledPage(parent->swips[pos], pageBuf));
+    }
+    *child = parent->swips[pos];
+    *fixed = FALSE;
+    *pageBuf = (*child)->page;
+    return (PFE_OK);
+  }
+
+  *child = AM_NodeCacheGet(ih, pageNum);
+  if (*child != NULL) {
+    if (parent != NULL)
+      AM_LinkNode(parent, pos, *child);
+    *fixed = FALSE;
+    *pageBuf = (*child)->page;
+    return (PFE_OK);
+  }
+
+  *fixed = TRUE;
+  errVal = PF_GetThisPage(ih->fileDesc, pageNum, pageBuf);
+  if (errVal != PFE_OK)
+    return (errVal);
+  if (parent != NULL && **pageBuf == 'l') {
+    parent->leafChildren = TRUE;
+    errVal = PF_SwizzlePage(ih->fileDesc, pageNum, &parent->swips[pos]);
+  }
+  return (errVal);
+}
+
+/* Drops the copy of node pageNum, which is about to change */
+void AM_NodeCacheDrop(AM_IndexHandle *ih, int pageNum) {
+  AM_NODECACHE *c = ih->nodeCache;
+  AM_CACHEDNODE *node;
+
+  if (c == NULL)
+    return;
+  node = AM_FindNode(c, pageNum);
+  if (node == NULL)
+    return;
+  AM_FreeNode(c, node);
+  c->stats.invalidations++;
+}
@@ -1,7 +1,9 @@
 #include "am.h"
 
-/* Creates a secondary idex file called fileName.indexNo */
-int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
+/* Creates a secondary idex file called fileName.indexNo, with the
+layout chosen by the AM_CREATE_* flags */
+static int AM_Create(char *fileName, int indexNo, char attrType, int attrLength,
+                     int flags) {
   char *pageBuf; /* buffer for holding a page */
   char indexfName[AM_MAX_FNAME_LENGTH]; /* String to store the indexed
                        files name with extension           */
@@ -12,7 +14,8 @@ int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
   AM_LEAFHEADER head, *header;
 
   /* Check the parameters */
-  if ((attrType != 'c') && (attrType != 'f') && (attrType != 'i')) {
+  if ((attrType != 'c') && (attrType != 'f') && (attrType != 'i') &&
+      (attrType != AM_KEY_BYTES)) {
     AM_Errno = AME_INVALIDATTRTYPE;
     return (AME_INVALIDATTRTYPE);
   }
@@ -23,7 +26,7 @@ int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
   }
 
   if (attrLength != 4)
-    if (attrType != 'c') {
+    if (attrType != 'c' && attrType != AM_KEY_BYTES) {
       AM_Errno = AME_INVALIDATTRLENGTH;
       return (AME_INVALIDATTRLENGTH);
     }
@@ -55,9 +58,16 @@ int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
   header->numinfreeList = 0;
   header->attrLength = attrLength;
   header->numKeys = 0;
-  /* the maximum keys in an internal node- has to be even always*/
+  header->packed = !(flags & AM_CREATE_NOCOMPRESSION) && AM_PACKED_TYPE(attrType);
+  header->postings = !(flags & AM_CREATE_NOPOSTINGS);
+  header->prefixLength = 0;
+  header->keyWidth = header->packed ? 0 : attrLength;
+  /* the maximum keys in an internal node- has to be even always; a
+  compressed one holds as many as fit */
   maxKeys = (PF_PAGE_SIZE - AM_sint - AM_si) / (AM_si + attrLength);
-  if ((maxKeys % 2) != 0)
+  if (header->packed)
+    header->maxKeys = AM_PACKED_MAXKEYS;
+  else if ((maxKeys % 2) != 0)
     header->maxKeys = maxKeys - 1;
   else
     header->maxKeys = maxKeys;
@@ -70,27 +80,130 @@ int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
   /* Close the file */
   errVal = PF_CloseFile(fileDesc);
   AM_Check(errVal);
-
-  /* initialise the root page and the leftmost page numbers */
-  AM_RootPageNum = pageNum;
   return (AME_OK);
 }
 
+int AM_CreateIndex(char *fileName, int indexNo, char attrType, int attrLength) {
+  return (AM_CreateIndexFlags(fileName, indexNo, attrType, attrLength, 0));
+}
+
+/* AM_CreateIndex with AM_CREATE_* flags. The layout they choose is kept
+in the index's node headers, so it lasts as long as the index does. */
+int AM_CreateIndexFlags(char *fileName, int indexNo, char attrType,
+                        int attrLength, int flags) {
+  int errVal;
+
+  AM_LatchPool();
+  errVal = AM_Create(fileName, indexNo, attrType, attrLength, flags);
+  AM_UnlatchPool();
+  return (errVal);
+}
+
 /* Destroys the index fileName.indexNo */
 int AM_DestroyIndex(char *fileName, int indexNo) {
   char indexfName[AM_MAX_FNAME_LENGTH];
   int errVal;
 
   sprintf(indexfName, "%s.%d", fileName, indexNo);
+  AM_LatchPool();
   errVal = PF_DestroyFile(indexfName);
+  AM_UnlatchPool();
+  AM_Check(errVal);
+  return (AME_OK);
+}
+
+/* Opens the index fileName.indexNo, whose keys are of type attrType,
+and fills in *ih; the key length is read from the root */
+static int AM_Open(char *fileName, int indexNo, char attrType,
+                   AM_IndexHandle *ih) {
+  char indexfName[AM_MAX_FNAME_LENGTH];
+  char *pageBuf;
+  int fileDesc;
+  int pageNum;
+  int errVal;
+  AM_LEAFHEADER lhead;
+  AM_INTHEADER ihead;
+
+  /* check the parameters; the key type is resolved here, once */
+  if (AM_ResolveKeyType(&ih->keyType, attrType, 0) != AME_OK) {
+    AM_Errno = AME_INVALIDATTRTYPE;
+    return (AME_INVALIDATTRTYPE);
+  }
+
+  sprintf(indexfName, "%s.%d", fileName, indexNo);
+  fileDesc = PF_OpenFile(indexfName);
+  if (fileDesc < 0) {
+    AM_Errno = AME_PF;
+    return (AME_PF);
+  }
+
+  /* the root is the first page */
+  errVal = PF_GetFirstPage(fileDesc, &pageNum, &pageBuf);
+  if (errVal != PFE_OK) {
+    PF_CloseFile(fileDesc);
+    AM_Errno = AME_PF;
+    return (AME_PF);
+  }
+  if (*pageBuf == 'l') {
+    memcpy(&lhead, pageBuf, AM_sl);
+    ih->attrLength = lhead.attrLength;
+    ih->keyType.packed = lhead.packed;
+  } else {
+    memcpy(&ihead, pageBuf, AM_sint);
+    ih->attrLength = ihead.attrLength;
+    ih->keyType.packed = ihead.packed;
+  }
+  PF_UnfixPage(fileDesc, pageNum, FALSE);
+
+  if ((ih->attrLength != 4 && attrType != 'c' && attrType != AM_KEY_BYTES) ||
+      (ih->keyType.packed && !AM_PACKED_TYPE(attrType))) {
+    PF_CloseFile(fileDesc);
+    AM_Errno = AME_INVALIDATTRLENGTH;
+    return (AME_INVALIDATTRLENGTH);
+  }
+
+  ih->fileDesc = fileDesc;
+  ih->attrType = attrType;
+  ih->keyType.attrLength = ih->attrLength;
+  ih->rootPageNum = pageNum;
+  ih->nodeCache = NULL;
+  ih->olc = NULL;
+  return (AME_OK);
+}
+
+int AM_OpenIndex(char *fileName, int indexNo, char attrType,
+                 AM_IndexHandle *ih) {
+  int errVal;
+
+  AM_LatchPool();
+  errVal = AM_Open(fileName, indexNo, attrType, ih);
+  AM_UnlatchPool();
+  return (errVal);
+}
+
+/* Closes an index opened by AM_OpenIndex, dropping its node cache and
+its version locks */
+int AM_CloseIndex(AM_IndexHandle *ih) {
+  int errVal;
+
+  if (ih->fileDesc < 0) {
+    AM_Errno = AME_FD;
+    return (AME_FD);
+  }
+
+  AM_LatchPool();
+  AM_NodeCacheFree(ih);
+  AM_OlcFree(ih);
+  errVal = PF_CloseFile(ih->fileDesc);
+  ih->fileDesc = -1;
+  AM_UnlatchPool();
   AM_Check(errVal);
   return (AME_OK);
 }
 
 /* Deletes the recId from the list for value and deletes value if list
 becomes empty */
-int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value,
-                   int recId) {
+static int AM_Delete(AM_IndexHandle *ih, char *value, int recId) {
   char *pageBuf;   /* buffer to hold the page */
   int pageNum;     /* page Number of the page in buffer */
   int index;       /* index where key is present */
@@ -103,19 +216,16 @@ int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value,
   int recSize;           /* length of key,ptr pair for a leaf */
   int tempRec;           /* holds the recId of the current record */
   int i;                 /* loop index */
+  int keyWidth;          /* bytes of a key in the leaf */
+  int empty;             /* TRUE once a posting list is emptied */
 
   /* check the parameters */
-  if ((attrType != 'c') && (attrType != 'f') && (attrType != 'i')) {
-    AM_Errno = AME_INVALIDATTRTYPE;
-    return (AME_INVALIDATTRTYPE);
-  }
-
   if (value == NULL) {
     AM_Errno = AME_INVALIDVALUE;
     return (AME_INVALIDVALUE);
   }
 
-  if (fileDesc < 0) {
+  if (ih->fileDesc < 0) {
     AM_Errno = AME_FD;
     return (AME_FD);
   }
@@ -124,9 +234,8 @@ int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value,
   header = &head;
 
   /* find the pagenumber and the index of the key to be deleted if it is
-  there */
-  status = AM_Search(fileDesc, attrType, attrLength, value, &pageNum, &pageBuf,
-                     &index);
+  there; a delete needs no path */
+  status = AM_Search(ih, value, NULL, &pageNum, &pageBuf, &index);
 
   /* check if return value is an error */
   if (status < 0) {
@@ -136,44 +245,63 @@ int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value,
 
   /* The key is not in the tree */
   if (status == AM_NOT_FOUND) {
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
     AM_Errno = AME_NOTFOUND;
     return (AME_NOTFOUND);
   }
 
+  if (AM_OlcLock(ih, pageNum) != AME_OK) {
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    return (AME_INTERROR);
+  }
   memcpy(header, pageBuf, AM_sl);
-  recSize = attrLength + AM_ss;
-  currRecPtr = pageBuf + AM_sl + (index - 1) * recSize + attrLength;
+  keyWidth = header->keyWidth;
+  recSize = keyWidth + AM_ss;
+  currRecPtr = pageBuf + AM_sl + (index - 1) * recSize + keyWidth;
   memcpy(&nextRec, currRecPtr, AM_ss);
 
-  /* search the list for recId */
-  while (nextRec != 0) {
-    memcpy(&tempRec, pageBuf + nextRec, AM_si);
-
-    /* found the recId to be deleted */
-    if (recId == tempRec) {
-      /* Delete recId */
-      memcpy(currRecPtr, pageBuf + nextRec + AM_si, AM_ss);
-      header->numinfreeList++;
-      oldhead = header->freeListPtr;
-      header->freeListPtr = nextRec;
-      memcpy(pageBuf + nextRec + AM_si, &oldhead, AM_ss);
-      break;
-    } else {
-      /* go over to the next item on the list */
-      currRecPtr = pageBuf + nextRec + AM_si;
-      memcpy(&nextRec, currRecPtr, AM_ss);
+  if (header->postings) {
+    /* a posting list is decoded, removed from and encoded again */
+    empty = AM_PostingRemove(ih, pageBuf, header, index, recId);
+    if (empty < 0) {
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      AM_Errno = empty;
+      return (empty);
+    }
+  } else {
+    /* search the list for recId */
+    while (nextRec != 0) {
+      memcpy(&tempRec, pageBuf + nextRec, AM_si);
+
+      /* found the recId to be deleted */
+      if (recId == tempRec) {
+        /* Delete recId */
+        memcpy(currRecPtr, pageBuf + nextRec + AM_si, AM_ss);
+        header->numinfreeList++;
+        oldhead = header->freeListPtr;
+        header->freeListPtr = nextRec;
+        memcpy(pageBuf + nextRec + AM_si, &oldhead, AM_ss);
+        break;
+      } else {
+        /* go over to the next item on the list */
+        currRecPtr = pageBuf + nextRec + AM_si;
+        memcpy(&nextRec, currRecPtr, AM_ss);
+      }
     }
-  }
 
-  /* if end of list reached then key not in tree */
-  if (nextRec == AM_NULL) {
-    AM_Errno = AME_NOTFOUND;
-    return (AME_NOTFOUND);
+    /* if end of list reached then key not in tree */
+    if (nextRec == AM_NULL) {
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      AM_Errno = AME_NOTFOUND;
+      return (AME_NOTFOUND);
+    }
+
+    memcpy(&temp, pageBuf + AM_sl + (index - 1) * recSize + keyWidth, AM_ss);
+    empty = (temp == 0);
   }
 
   /* check if list is empty */
-  memcpy(&temp, pageBuf + AM_sl + (index - 1) * recSize + attrLength, AM_ss);
-  if (temp == 0) {
+  if (empty) {
     /* list is empty , so delete key from the list */
     for (i = index; i < (header->numKeys); i++)
       memcpy(pageBuf + AM_sl + (i - 1) * recSize, pageBuf + AM_sl + i * recSize,
@@ -186,17 +314,23 @@ int AM_DeleteEntry(int fileDesc, char attrType, int attrLength, char *value,
   memcpy(pageBuf, header, AM_sl);
 
   /* Unfix the page, it was modified */
-  PF_UnfixPage(fileDesc, pageNum, TRUE);
-
-  /* empty the stack so that it is set for next amlayer call */
-  AM_EmptyStack();
+  PF_UnfixPage(ih->fileDesc, pageNum, TRUE);
   AM_Errno = AME_OK;
   return (AME_OK);
 }
 
+int AM_DeleteEntry(AM_IndexHandle *ih, char *value, int recId) {
+  int errVal;
+
+  AM_LatchPool();
+  errVal = AM_Delete(ih, value, recId);
+  AM_OlcUnlockAll(ih);
+  AM_UnlatchPool();
+  return (errVal);
+}
+
 /* Inserts a value,recId pair into the tree */
-int AM_InsertEntry(int fileDesc, char attrType, int attrLength, char *value,
-                   int recId) {
+static int AM_Insert(AM_IndexHandle *ih, char *value, int recId) {
   char *pageBuf; /* buffer to hold page */
   int pageNum;   /* page number of the page in buffer */
   int index;     /* index where key can be found or can be inserted */
@@ -207,85 +341,100 @@ int AM_InsertEntry(int fileDesc, char attrType, int attrLength, char *value,
   int errVal;      /* return value of functions within this function */
   char key[AM_MAXATTRLENGTH]; /* holds the attribute to be passed
                                    back to the parent */
+  AM_STACK path;   /* internal nodes from the root to the leaf */
+  AM_LEAFHEADER head; /* header of a leaf that is full */
 
   /* check the parameters */
-  if ((attrType != 'c') && (attrType != 'f') && (attrType != 'i')) {
-    AM_Errno = AME_INVALIDATTRTYPE;
-    return (AME_INVALIDATTRTYPE);
-  }
-
   if (value == NULL) {
     AM_Errno = AME_INVALIDVALUE;
     return (AME_INVALIDVALUE);
   }
 
-  if (fileDesc < 0) {
+  if (ih->fileDesc < 0) {
     AM_Errno = AME_FD;
     return (AME_FD);
   }
 
-  /* Search the leaf for the key */
-  status = AM_Search(fileDesc, attrType, attrLength, value, &pageNum, &pageBuf,
-                     &index);
+  for (;;) {
+    /* Search the leaf for the key */
+    AM_EmptyStack(&path);
+    status = AM_Search(ih, value, &path, &pageNum, &pageBuf, &index);
 
-  /* check if there is an error */
-  if (status < 0) {
-    AM_EmptyStack();
-    AM_Errno = status;
-    return (status);
-  }
+    /* check if there is an error */
+    if (status < 0) {
+      AM_Errno = status;
+      return (status);
+    }
 
-  /* Insert into leaf the key,recId pair */
-  inserted =
-      AM_InsertintoLeaf(pageBuf, attrLength, value, recId, index, status);
-
-  /*
-   * ========================================================
-   * BUG FIX: Empty stack after successful insert.
-   * ========================================================
-   */
-  if (inserted == TRUE) {
-    // fprintf(stderr, "DEBUG AM_InsertEntry -> PF_UnfixPage: fileDesc=%d pageNum=%d (after insert)\n",
-    //         fileDesc, pageNum);
-    errVal = PF_UnfixPage(fileDesc, pageNum, TRUE);
-    AM_Check(errVal);
-    AM_EmptyStack(); /* Clear the stack after successful insert */
-    return (AME_OK);
-  }
+    /* Insert into leaf the key,recId pair */
+    if (AM_OlcLock(ih, pageNum) != AME_OK) {
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      return (AME_INTERROR);
+    }
+    inserted =
+        AM_InsertintoLeaf(ih, pageBuf, value, recId, index, status);
 
+    if (inserted == TRUE) {
+      errVal = PF_UnfixPage(ih->fileDesc, pageNum, TRUE);
+      AM_Check(errVal);
+      return (AME_OK);
+    }
 
-  /* check if there is any error */
-  if (inserted < 0) {
-    AM_EmptyStack();
-    AM_Errno = inserted;
-    return (inserted);
-  }
+    /* check if there is any error */
+    if (inserted < 0) {
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      AM_Errno = inserted;
+      return (inserted);
+    }
+
+    /* a key whose recIds fill a leaf on their own cannot be split off */
+    memcpy(&head, pageBuf, AM_sl);
+    if (status == AM_FOUND && head.numKeys == 1) {
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      AM_Errno = AME_DUPOVERFLOW;
+      return (AME_DUPOVERFLOW);
+    }
 
-  /* if not inserted then have to split */
-  if (inserted == FALSE) {
-    /* Split the leaf page */
-    addtoparent = AM_SplitLeaf(fileDesc, pageBuf, &pageNum, attrLength, recId,
-                             value, status, index, key);
+    /* not inserted: split the leaf page, then insert again into
+    whichever half value now belongs */
+    addtoparent = AM_SplitLeaf(ih, pageBuf, &pageNum, value, index, key);
 
     /* check for errors */
     if (addtoparent < 0) {
-      AM_EmptyStack();
       AM_Errno = addtoparent;
       return (addtoparent);
     }
 
     /* if key has to be added to the parent */
     if (addtoparent == TRUE) {
-      errVal = AM_AddtoParent(fileDesc, pageNum, key, attrLength);
+      errVal = AM_AddtoParent(ih, &path, pageNum, key);
       if (errVal < 0) {
-        AM_EmptyStack();
         AM_Errno = errVal;
         return (errVal);
       }
     }
+
+    /* the split is whole: concurrent readers may have it */
+    AM_OlcUnlockAll(ih);
   }
-  AM_EmptyStack();
-  return (AME_OK);
+}
+
+int AM_InsertEntry(AM_IndexHandle *ih, char *value, int recId) {
+  int errVal;
+
+  /* in concurrent mode, only an insert that splits takes the latch
+  for its whole length */
+  if (ih->olc != NULL) {
+    errVal = AM_OlcInsert(ih, value, recId);
+    if (errVal != AM_OLC_SPLIT)
+      return (errVal);
+  }
+
+  AM_LatchPool();
+  errVal = AM_Insert(ih, value, recId);
+  AM_OlcUnlockAll(ih);
+  AM_UnlatchPool();
+  return (errVal);
 }
 
 /* error messages */
@@ -301,7 +450,10 @@ static char *AMerrormsg[] = {
     "Scan Table is full",
     "Invalid Attribute Type",
     "Invalid file Descriptor",
-    "Invalid value to Delete or Insert Entry"};
+    "Invalid value to Delete or Insert Entry",
+    "Index is not empty",
+    "Bulk load input is not sorted",
+    "Too many duplicates of one key for a leaf page"};
 
 void AM_PrintError(char *s) {
   fprintf(stderr, "%s", s);
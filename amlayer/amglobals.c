@@ -1,5 +1,17 @@
 #include "am.h"
 
-int AM_RootPageNum = 0;
-int AM_LeftPageNum = 0;
-int AM_Errno;
\ No newline at end of file
+_Thread_local int AM_Errno;
+
+/*
+ * The PF buffer pool is shared by every index and is not thread-safe:
+ * a page is either fixed or not, so two threads must not have the same
+ * page fixed at once. AM calls that reach the pool hold the PF pool
+ * latch for the whole call, except in concurrent mode (amolc.c), where
+ * lookups and inserts that fit in their leaf take it only around
+ * pinning pages and changing the leaf. It is the same latch parallel
+ * RM scans use, and it is recursive, so a bulk load may read its input
+ * from another index.
+ */
+void AM_LatchPool(void) { PF_LatchPool(); }
+
+void AM_UnlatchPool(void) { PF_UnlatchPool(); }
@@ -1,17 +1,28 @@
 #include "am.h"
 
 /* Inserts a key into a leaf node */
-int AM_InsertintoLeaf(char *pageBuf, int attrLength, char *value, int recId,
+int AM_InsertintoLeaf(AM_IndexHandle *ih, char *pageBuf, char *value, int recId,
                       int index, int status) {
   int recSize;
   char tempPage[PF_PAGE_SIZE];
+  char canon[AM_MAXATTRLENGTH]; /* value as the leaf stores it */
+  int prefixLength, keyWidth;   /* layout of the leaf with value in it */
+  int heap;                     /* bytes of recIds in the leaf with value's */
+  int inserted;
   AM_LEAFHEADER head, *header;
 
   /* initialise the header */
   header = &head;
   memcpy(header, pageBuf, AM_sl);
 
-  recSize = attrLength + AM_ss;
+  if (status == AM_FOUND && header->postings) {
+    /* add to the key's posting list */
+    inserted = AM_PostingAdd(ih, pageBuf, header, index, recId, FALSE);
+    if (inserted == TRUE)
+      memcpy(pageBuf, header, AM_sl);
+    return (inserted);
+  }
+
   if (status == AM_FOUND)
   /* key is already present */
   {
@@ -26,7 +37,32 @@ int AM_InsertintoLeaf(char *pageBuf, int attrLength, char *value, int recId,
     return (TRUE);
   }
 
-  /* status == AM_NOTFOUND and so key is a new key */
+  /* status == AM_NOTFOUND and so key is a new key; a compressed leaf
+  may need rewriting in a layout that takes it in */
+  AM_CanonKey(&ih->keyType, value, canon);
+  value = canon;
+  if (!AM_LeafLayout(pageBuf, header, canon, &prefixLength, &keyWidth)) {
+    heap = PF_PAGE_SIZE - header->prefixLength - header->recIdPtr -
+           header->numinfreeList * (AM_si + AM_ss) +
+           (header->postings ? AM_PostingNewBytes(recId) : AM_si + AM_ss);
+    if (AM_sl + (header->numKeys + 1) * (keyWidth + AM_ss) + prefixLength + heap > PF_PAGE_SIZE)
+      return (FALSE);
+    AM_CompactAs(1, header->numKeys, pageBuf, tempPage, header, prefixLength, keyWidth,
+                 canon);
+    memcpy(pageBuf, tempPage, PF_PAGE_SIZE);
+    memcpy(header, pageBuf, AM_sl);
+  }
+
+  recSize = header->keyWidth + AM_ss;
+  if (header->postings) {
+    /* a posting leaf has no free list: the new list goes below the others */
+    if ((header->recIdPtr - header->keyPtr) < recSize + AM_PostingNewBytes(recId))
+      return (FALSE);
+    AM_InsertToLeafNotFound(pageBuf, value, recId, index, header);
+    header->numKeys++;
+    memcpy(pageBuf, header, AM_sl);
+    return (TRUE);
+  }
   if ((header->freeListPtr) == 0) {
     /* freelist empty */
     if ((header->recIdPtr - header->keyPtr) < (AM_si + AM_ss + recSize))
@@ -73,7 +109,7 @@ void AM_InsertToLeafFound(char *pageBuf, int recId, int index,
   short tempPtr;
   short oldhead;
 
-  recSize = header->attrLength + AM_ss;
+  recSize = header->keyWidth + AM_ss;
   if ((header->freeListPtr) == 0) {
     header->recIdPtr = header->recIdPtr - AM_si - AM_ss;
     tempPtr = header->recIdPtr;
@@ -84,11 +120,11 @@ void AM_InsertToLeafFound(char *pageBuf, int recId, int index,
   }
 
   /* save  the old head of recId list */
-  memcpy(&oldhead, pageBuf + AM_sl + (index - 1) * recSize + header->attrLength,
+  memcpy(&oldhead, pageBuf + AM_sl + (index - 1) * recSize + header->keyWidth,
          AM_ss);
 
   /* Update the head of recId list to the new recid to be added */
-  memcpy(pageBuf + AM_sl + (index - 1) * recSize + header->attrLength, &tempPtr,
+  memcpy(pageBuf + AM_sl + (index - 1) * recSize + header->keyWidth, &tempPtr,
          AM_ss);
 
   /* Copy the recId*/
@@ -98,14 +134,16 @@ void AM_InsertToLeafFound(char *pageBuf, int recId, int index,
   memcpy(pageBuf + tempPtr + AM_si, (char *)&oldhead, AM_ss);
 }
 
-/* Insert to a leaf given that the key is new */
+/* Insert to a leaf given that the key is new (and, in a compressed
+leaf, canonical and fitting its layout) */
 void AM_InsertToLeafNotFound(char *pageBuf, char *value, int recId, int index,
                              AM_LEAFHEADER *header) {
   int recSize;
   short null = AM_NULL;
+  short list;
   int i;
 
-  recSize = header->attrLength + AM_ss;
+  recSize = header->keyWidth + AM_ss;
   /* create space for the new key by pushing keys greater than that to
                                      the right */
   for (i = header->numKeys; i >= index; i--) {
@@ -115,11 +153,20 @@ void AM_InsertToLeafNotFound(char *pageBuf, char *value, int recId, int index,
   /* Update the header */
   header->keyPtr = header->keyPtr + recSize;
 
-  /* copy the new key */
-  memcpy(pageBuf + AM_sl + (index - 1) * recSize, value, header->attrLength);
+  /* copy the new key, less the prefix it shares */
+  memcpy(pageBuf + AM_sl + (index - 1) * recSize, value + header->prefixLength,
+         header->keyWidth);
+
+  /* a posting list of just recId */
+  if (header->postings) {
+    list = AM_PostingNew(pageBuf, header, recId);
+    memcpy(pageBuf + AM_sl + (index - 1) * recSize + header->keyWidth,
+           (char *)&list, AM_ss);
+    return;
+  }
 
   /* make the head of list NULL*/
-  memcpy(pageBuf + AM_sl + (index - 1) * recSize + header->attrLength,
+  memcpy(pageBuf + AM_sl + (index - 1) * recSize + header->keyWidth,
          (char *)&null, AM_ss);
 
   /* Now insert as if key were old key */
@@ -131,25 +178,48 @@ be space in the middle for a new key. This compacts all the recid's to the right
 so that there is enough space in the middle */
 void AM_Compact(int low, int high, char *pageBuf, char *tempPage,
                 AM_LEAFHEADER *header) {
+  AM_CompactAs(low, high, pageBuf, tempPage, header, header->prefixLength,
+               header->keyWidth, pageBuf + PF_PAGE_SIZE - header->prefixLength);
+}
+
+/* Compacts keys low .. high into tempPage as AM_Compact does, laid out
+with the prefixLength bytes at prefix (not in tempPage) shared and
+keyWidth bytes stored per key; every key must fit the layout */
+void AM_CompactAs(int low, int high, char *pageBuf, char *tempPage,
+                  AM_LEAFHEADER *header, int prefixLength, int keyWidth,
+                  char *prefix) {
   short nextRec;
   AM_LEAFHEADER temphead, *tempheader;
+  char key[AM_MAXATTRLENGTH];
   short recIdPtr;
   int recSize;
   int i, j;
   int offset1, offset2;
+  int bytes;
 
   tempheader = &temphead;
   memcpy(tempheader, header, AM_sl);
 
-  recSize = header->attrLength + AM_ss;
-  recIdPtr = PF_PAGE_SIZE - AM_si - AM_ss;
+  recSize = keyWidth + AM_ss;
+  recIdPtr = PF_PAGE_SIZE - prefixLength - AM_si - AM_ss;
+  if (header->postings)
+    recIdPtr = PF_PAGE_SIZE - prefixLength;
 
   for (i = low, j = 1; i <= high; i++, j++) {
-    offset1 = (i - 1) * recSize + AM_sl;
+    offset1 = (i - 1) * (header->keyWidth + AM_ss) + AM_sl;
     offset2 = (j - 1) * recSize + AM_sl;
-    memcpy(tempPage + offset2, pageBuf + offset1, header->attrLength);
-    memcpy(&nextRec, pageBuf + offset1 + header->attrLength, AM_ss);
-    memcpy(tempPage + offset2 + header->attrLength, (char *)&recIdPtr, AM_ss);
+    AM_LeafKey(pageBuf, header, i, key);
+    memcpy(tempPage + offset2, key + prefixLength, keyWidth);
+    memcpy(&nextRec, pageBuf + offset1 + header->keyWidth, AM_ss);
+    if (header->postings) {
+      /* a posting list is copied whole */
+      bytes = AM_PostingBytes(pageBuf, nextRec);
+      recIdPtr -= bytes;
+      memcpy(tempPage + recIdPtr, pageBuf + nextRec, bytes);
+      memcpy(tempPage + offset2 + keyWidth, (char *)&recIdPtr, AM_ss);
+      continue;
+    }
+    memcpy(tempPage + offset2 + keyWidth, (char *)&recIdPtr, AM_ss);
     while (nextRec != 0) {
       memcpy(tempPage + recIdPtr, pageBuf + nextRec, AM_si);
       recIdPtr = recIdPtr - AM_si - AM_ss;
@@ -158,16 +228,19 @@ void AM_Compact(int low, int high, char *pageBuf, char *tempPage,
     }
     memcpy(tempPage + recIdPtr + 2 * AM_si + AM_ss, (char *)&nextRec, AM_ss);
   }
+  memcpy(tempPage + PF_PAGE_SIZE - prefixLength, prefix, prefixLength);
 
   /* Initialise the header appropriately */
   tempheader->pageType = header->pageType;
   tempheader->nextLeafPage = header->nextLeafPage;
-  tempheader->recIdPtr = recIdPtr + AM_si + AM_ss;
-  tempheader->keyPtr = offset2 + recSize;
+  tempheader->recIdPtr = header->postings ? recIdPtr : recIdPtr + AM_si + AM_ss;
+  tempheader->keyPtr = AM_sl + (high - low + 1) * recSize;
   tempheader->freeListPtr = 0;
   tempheader->numinfreeList = 0;
   tempheader->attrLength = header->attrLength;
   tempheader->numKeys = high - low + 1;
   tempheader->maxKeys = header->maxKeys;
+  tempheader->prefixLength = prefixLength;
+  tempheader->keyWidth = keyWidth;
   memcpy(tempPage, tempheader, AM_sl);
-}
\ No newline at end of file
+}
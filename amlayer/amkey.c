@@ -0,0 +1,92 @@
+#include "am.h"
+
+/*
+ * Normalized keys, for indexes of attrType AM_KEY_BYTES. A key is its
+ * columns encoded one after the other, and the encodings are chosen so
+ * that memcmp of two keys orders them the way their columns do, first
+ * column first. The tree then compares every key, whatever its columns,
+ * with one memcmp.
+ *
+ * Every column starts with a byte, AM_KEY_NULL or AM_KEY_VALUE, so a
+ * NULL sorts before any value of its column. After it come:
+ *   int, long long  big-endian, sign bit flipped: negatives first
+ *   float, double   big-endian IEEE bits, all flipped for negatives and
+ *                   the sign bit alone for the rest; -0 is stored as 0
+ *                   and every NaN as one NaN, after +infinity
+ *   char(n)         the string up to its first NUL, padded with zeros
+ * A NULL column is zeros after its first byte, as wide as a value.
+ *
+ * Each encoder writes its column at key + offset and returns the
+ * offset just past it, so a composite key is built as
+ *   off = AM_KeyInt(key, 0, tenant); AM_KeyInt64(key, off, ts);
+ * in an index created with attrLength AM_KEY_INT_LEN + AM_KEY_INT64_LEN.
+ */
+
+/* stores the n low bytes of bits, most significant first */
+static void AM_KeyPutBits(char *dst, unsigned long long bits, int n) {
+  int i;
+
+  for (i = n - 1; i >= 0; i--) {
+    dst[i] = (char)(bits & 0xff);
+    bits >>= 8;
+  }
+}
+
+int AM_KeyNull(char *key, int offset, int width) {
+  memset(key + offset, 0, width);
+  key[offset] = AM_KEY_NULL;
+  return (offset + width);
+}
+
+int AM_KeyInt(char *key, int offset, int value) {
+  key[offset] = AM_KEY_VALUE;
+  AM_KeyPutBits(key + offset + 1, (unsigned int)value ^ 0x80000000u, 4);
+  return (offset + AM_KEY_INT_LEN);
+}
+
+int AM_KeyInt64(char *key, int offset, long long value) {
+  key[offset] = AM_KEY_VALUE;
+  AM_KeyPutBits(key + offset + 1, (unsigned long long)value ^ 0x8000000000000000ull, 8);
+  return (offset + AM_KEY_INT64_LEN);
+}
+
+int AM_KeyFloat(char *key, int offset, float value) {
+  unsigned int bits;
+
+  if (value != value)
+    bits = 0x7fc00000u;
+  else if (value == 0.0f)
+    bits = 0;
+  else
+    memcpy(&bits, &value, sizeof(bits));
+  bits = (bits & 0x80000000u) ? ~bits : bits ^ 0x80000000u;
+  key[offset] = AM_KEY_VALUE;
+  AM_KeyPutBits(key + offset + 1, bits, 4);
+  return (offset + AM_KEY_FLOAT_LEN);
+}
+
+int AM_KeyDouble(char *key, int offset, double value) {
+  unsigned long long bits;
+
+  if (value != value)
+    bits = 0x7ff8000000000000ull;
+  else if (value == 0.0)
+    bits = 0;
+  else
+    memcpy(&bits, &value, sizeof(bits));
+  bits = (bits & 0x8000000000000000ull) ? ~bits : bits ^ 0x8000000000000000ull;
+  key[offset] = AM_KEY_VALUE;
+  AM_KeyPutBits(key + offset + 1, bits, 8);
+  return (offset + AM_KEY_DOUBLE_LEN);
+}
+
+int AM_KeyChar(char *key, int offset, char *value, int len) {
+  int n = 0;
+
+  while (n < len && value[n] != '\0')
+    n++;
+  key[offset] = AM_KEY_VALUE;
+  memcpy(key + offset + 1, value, n);
+  memset(key + offset + 1 + n, 0, len - n);
+  return (offset + AM_KEY_CHAR_LEN(len));
+}
@@ -0,0 +1,458 @@
+#include "am.h"
+#include <sched.h>
+#include <stdatomic.h>
+
+/*
+ * Concurrent mode (AM_SetConcurrent): optimistic lock coupling. Every
+ * page of the index has a version lock, a counter that is odd while a
+ * writer is changing the page. Lookups and inserts descend without
+ * holding the pool latch: each node is read in place and its version
+ * is checked after the read. The child's version is taken before the
+ * parent is checked, so the hop between them is validated too. If any
+ * version moved the descent starts over from the root.
+ *
+ * The upper levels are resident: the first AM_OLC_MAXRESIDENT internal
+ * nodes a descent reaches keep their pin until concurrent mode ends, so
+ * later descents read them without touching the buffer pool at all.
+ * Since the root never moves and an internal node never becomes
+ * anything else, the set only grows. Any other node is pinned
+ * (PF_PinPage) under the latch for the hop, so a lookup that finds its
+ * leaf below resident nodes latches twice: to pin the leaf and to
+ * unpin it.
+ *
+ * The buffer pool itself stays behind the pool latch, so pages are
+ * only changed by the latch holder, which locks (AM_OlcLock) every
+ * page it changes until the call ends. Calls made under the latch
+ * (scans, deletes, bulk loads) thus still see whole pages. An insert
+ * takes the latch just to add to the leaf its descent found; if the
+ * leaf is full it gives up and runs as an ordinary latched insert,
+ * which locks the leaf and each parent the split changes.
+ *
+ * Versions live in a table of AM_OLC_SLOTS counters indexed by page
+ * number; pages sharing a counter only cost each other restarts.
+ */
+
+#define AM_OLC_SLOTS 4096
+#define AM_OLC_MAXLOCKED (AM_MAXSTACK + 2) /* a split path and its leaf */
+#define AM_OLC_MAXRESIDENT 8 /* internal nodes kept pinned, of PF_MAX_BUFS frames */
+#define AM_OLC_RESTART 2 /* a node changed under a descent */
+
+/* The version locks of an index in concurrent mode (AM_IndexHandle.olc) */
+struct am_olc {
+  atomic_ulong versions[AM_OLC_SLOTS];
+  int locked[AM_OLC_MAXLOCKED]; /* slots the latch holder has locked */
+  int numLocked;
+  int maxIntKeys;               /* most keys a sane internal node holds */
+  int residentPages[AM_OLC_MAXRESIDENT]; /* pinned internal nodes ... */
+  char *residentBufs[AM_OLC_MAXRESIDENT]; /* ... and their buffers */
+  atomic_int numResident;       /* only the latch holder adds to the set */
+  atomic_long restarts;
+  atomic_long leafInserts;
+  atomic_long splitInserts;
+  atomic_long residentHops;
+  atomic_long latchedPins;
+};
+
+#define AM_OlcSlot(olc, pageNum) (&(olc)->versions[(pageNum) % AM_OLC_SLOTS])
+
+/* Locks the version of pageNum, which the pool latch holder is about to
+change, until AM_OlcUnlockAll. No-op outside concurrent mode. A change
+needs at most a split path and its leaf locked, so running out of room
+is an internal error: the caller must not change the page. */
+int AM_OlcLock(AM_IndexHandle *ih, int pageNum) {
+  AM_OLC *olc = ih->olc;
+  atomic_ulong *slot;
+
+  if (olc == NULL)
+    return (AME_OK);
+  slot = AM_OlcSlot(olc, pageNum);
+  /* only the latch holder locks, so an odd slot is already ours */
+  if ((atomic_load_explicit(slot, memory_order_relaxed) & 1) != 0)
+    return (AME_OK);
+  if (olc->numLocked == AM_OLC_MAXLOCKED) {
+    AM_Errno = AME_INTERROR;
+    return (AME_INTERROR);
+  }
+  atomic_fetch_add(slot, 1);
+  atomic_thread_fence(memory_order_release);
+  olc->locked[olc->numLocked++] = (int)(slot - olc->versions);
+  return (AME_OK);
+}
+
+/* Unlocks every version AM_OlcLock locked, each to a new version */
+void AM_OlcUnlockAll(AM_IndexHandle *ih) {
+  AM_OLC *olc = ih->olc;
+  int i;
+
+  if (olc == NULL)
+    return;
+  for (i = 0; i < olc->numLocked; i++)
+    atomic_fetch_add_explicit(&olc->versions[olc->locked[i]], 1, memory_order_release);
+  olc->numLocked = 0;
+}
+
+/* the version of pageNum, once no writer is changing it */
+static unsigned long AM_OlcReadVersion(AM_OLC *olc, int pageNum) {
+  unsigned long v;
+
+  while (((v = atomic_load_explicit(AM_OlcSlot(olc, pageNum), memory_order_acquire)) & 1) != 0) {
+    /* the writer holds the pool latch until it unlocks */
+    AM_LatchPool();
+    AM_UnlatchPool();
+  }
+  return (v);
+}
+
+/* TRUE if pageNum is still at version v, so what was read of it holds */
+static int AM_OlcValid(AM_OLC *olc, int pageNum, unsigned long v) {
+  atomic_thread_fence(memory_order_acquire);
+  return (atomic_load_explicit(AM_OlcSlot(olc, pageNum), memory_order_relaxed) == v);
+}
+
+/* the buffer of pageNum if it is a resident node, or NULL */
+static char *AM_OlcResident(AM_OLC *olc, int pageNum) {
+  int i, n;
+
+  n = atomic_load_explicit(&olc->numResident, memory_order_acquire);
+  for (i = 0; i < n; i++)
+    if (olc->residentPages[i] == pageNum)
+      return (olc->residentBufs[i]);
+  return (NULL);
+}
+
+/* Makes pageNum, just pinned by the pool latch holder, resident if it is
+an internal node and there is room; its pin then belongs to the set and
+TRUE is returned */
+static int AM_OlcKeep(AM_OLC *olc, int pageNum, char *pageBuf) {
+  int n;
+
+  n = atomic_load_explicit(&olc->numResident, memory_order_relaxed);
+  if (n == AM_OLC_MAXRESIDENT || *pageBuf != 'i' || AM_OlcResident(olc, pageNum) != NULL)
+    return (FALSE);
+  olc->residentPages[n] = pageNum;
+  olc->residentBufs[n] = pageBuf;
+  atomic_store_explicit(&olc->numResident, n + 1, memory_order_release);
+  return (TRUE);
+}
+
+/* Moves a descent holding a pin on *pinned (AM_NULL_PAGE for none) to
+newPage, or ends it with newPage AM_NULL_PAGE. A resident node is read
+without the latch; any other is pinned under it, and *pinned is left
+naming the page pinned now. A full buffer pool is waited out as a
+restart. */
+static int AM_OlcMove(AM_IndexHandle *ih, int *pinned, int newPage, char **pageBuf) {
+  AM_OLC *olc = ih->olc;
+  char *buf = NULL;
+  int errVal = PFE_OK;
+
+  if (newPage != AM_NULL_PAGE && (buf = AM_OlcResident(olc, newPage)) != NULL) {
+    atomic_fetch_add_explicit(&olc->residentHops, 1, memory_order_relaxed);
+    *pageBuf = buf;
+    if (*pinned == AM_NULL_PAGE)
+      return (AME_OK);
+  }
+
+  AM_LatchPool();
+  if (*pinned != AM_NULL_PAGE) {
+    errVal = PF_UnpinPage(ih->fileDesc, *pinned, FALSE);
+    *pinned = AM_NULL_PAGE;
+  }
+  if (errVal == PFE_OK && buf == NULL && newPage != AM_NULL_PAGE) {
+    errVal = PF_PinPage(ih->fileDesc, newPage, pageBuf);
+    if (errVal == PFE_OK) {
+      atomic_fetch_add_explicit(&olc->latchedPins, 1, memory_order_relaxed);
+      if (!AM_OlcKeep(olc, newPage, *pageBuf))
+        *pinned = newPage;
+    }
+  }
+  AM_UnlatchPool();
+
+  if (errVal == PFE_NOBUF) {
+    atomic_fetch_add(&olc->restarts, 1);
+    sched_yield();
+    return (AM_OLC_RESTART);
+  }
+  AM_Check(errVal);
+  return (AME_OK);
+}
+
+/* Unpins the resident nodes of ih and drops its version locks; the pool
+latch is held. AM_SetConcurrent and AM_CloseIndex call it. */
+void AM_OlcFree(AM_IndexHandle *ih) {
+  AM_OLC *olc = ih->olc;
+  int i;
+
+  if (olc == NULL)
+    return;
+  for (i = 0; i < atomic_load(&olc->numResident); i++)
+    PF_UnpinPage(ih->fileDesc, olc->residentPages[i], FALSE);
+  free(olc);
+  ih->olc = NULL;
+}
+
+/*
+ * Descends from the root to the leaf where value is or belongs, without
+ * holding the pool latch. Returns AME_OK with the leaf pinned, its page
+ * in *pageNum and *pageBuf and the version it was reached at in
+ * *version; AM_OLC_RESTART (nothing pinned) if a node changed on the
+ * way.
+ */
+static int AM_OlcDescend(AM_IndexHandle *ih, char *value, int *pageNum,
+                         char **pageBuf, unsigned long *version) {
+  AM_OLC *olc = ih->olc;
+  AM_INTHEADER header;
+  unsigned long v, childVersion;
+  int child, index, errVal;
+  int pinned = AM_NULL_PAGE; /* the node pinned for this descent, if any */
+
+  *pageNum = ih->rootPageNum;
+  v = AM_OlcReadVersion(olc, *pageNum);
+  errVal = AM_OlcMove(ih, &pinned, *pageNum, pageBuf);
+  if (errVal != AME_OK)
+    return (errVal);
+
+  for (;;) {
+    /* a node being changed may hold anything: check it before use */
+    memcpy(&header, *pageBuf, AM_sint);
+    if (header.pageType == 'l') {
+      /* resident nodes are internal, so a real leaf is pinned */
+      if (pinned != *pageNum)
+        break;
+      *version = v;
+      return (AME_OK);
+    }
+    if (header.pageType != 'i' || header.numKeys < 0 || header.numKeys > olc->maxIntKeys)
+      break;
+    child = AM_BinSearch(*pageBuf, &ih->keyType, value, &index, &header);
+    if (!AM_OlcValid(olc, *pageNum, v))
+      break;
+
+    /* the parent must still point at the child once its version is known */
+    childVersion = AM_OlcReadVersion(olc, child);
+    if (!AM_OlcValid(olc, *pageNum, v))
+      break;
+    errVal = AM_OlcMove(ih, &pinned, child, pageBuf);
+    if (errVal != AME_OK)
+      return (errVal);
+    *pageNum = child;
+    v = childVersion;
+  }
+
+  atomic_fetch_add(&olc->restarts, 1);
+  AM_OlcMove(ih, &pinned, AM_NULL_PAGE, NULL);
+  return (AM_OLC_RESTART);
+}
+
+/* Copies up to maxIds recIds of value from leaf pageBuf into recIds and
+returns how many the key has (0 if it is not there), or -1 if the page
+is not a sane leaf. Every offset is checked before it is followed: in
+concurrent mode the page may be changing as it is read. Unless latched,
+a posting list on posting pages returns AM_POSTING_LATCH. */
+static int AM_LeafRecIds(AM_IndexHandle *ih, char *pageBuf, char *value,
+                         int *recIds, int maxIds, int latched) {
+  AM_LEAFHEADER header;
+  int recSize;
+  int index, n;
+  short next;
+
+  memcpy(&header, pageBuf, AM_sl);
+  if (header.pageType != 'l' || header.attrLength != ih->attrLength ||
+      header.prefixLength < 0 || header.keyWidth < 0 ||
+      header.prefixLength + header.keyWidth > ih->attrLength)
+    return (-1);
+  recSize = header.keyWidth + AM_ss;
+  if (header.numKeys < 0 || header.numKeys > (PF_PAGE_SIZE - (int)AM_sl) / recSize)
+    return (-1);
+  if (AM_SearchLeaf(pageBuf, &ih->keyType, value, &index, &header) != AM_FOUND)
+    return (0);
+  if (header.postings)
+    return (AM_PostingLookup(ih, pageBuf, &header, index, recIds, maxIds, latched));
+
+  memcpy(&next, pageBuf + AM_sl + (index - 1) * recSize + header.keyWidth, AM_ss);
+  for (n = 0; next != AM_NULL; n++) {
+    if (next < (int)AM_sl || next > PF_PAGE_SIZE - (int)(AM_si + AM_ss) ||
+        n == PF_PAGE_SIZE / (int)(AM_si + AM_ss))
+      return (-1);
+    if (n < maxIds)
+      memcpy(&recIds[n], pageBuf + next, AM_si);
+    memcpy(&next, pageBuf + next + AM_si, AM_ss);
+  }
+  return (n);
+}
+
+/* Puts the index in concurrent mode (on TRUE) or takes it out of it. No
+other call may be running on the index while the mode changes. */
+int AM_SetConcurrent(AM_IndexHandle *ih, int on) {
+  AM_OLC *olc = NULL;
+
+  if (ih->fileDesc < 0) {
+    AM_Errno = AME_FD;
+    return (AME_FD);
+  }
+
+  if (on && ih->olc == NULL) {
+    olc = calloc(1, sizeof(AM_OLC));
+    if (olc == NULL) {
+      AM_Errno = AME_INTERROR;
+      return (AME_INTERROR);
+    }
+    olc->maxIntKeys = ih->keyType.packed ? AM_PACKED_MAXKEYS
+                                         : (PF_PAGE_SIZE - AM_sint - AM_si) / (AM_si + ih->attrLength);
+  }
+
+  AM_LatchPool();
+  if (!on) {
+    AM_OlcFree(ih);
+  } else if (olc != NULL) {
+    ih->olc = olc;
+  }
+  AM_UnlatchPool();
+  return (AME_OK);
+}
+
+/* Copies the counters of the index's concurrent mode into stats (all
+zero if it is not in it) */
+int AM_GetConcurrencyStats(AM_IndexHandle *ih, AM_ConcurrencyStats *stats) {
+  AM_OLC *olc = ih->olc;
+
+  memset(stats, 0, sizeof(AM_ConcurrencyStats));
+  if (olc != NULL) {
+    stats->restarts = atomic_load(&olc->restarts);
+    stats->leafInserts = atomic_load(&olc->leafInserts);
+    stats->splitInserts = atomic_load(&olc->splitInserts);
+    stats->residentHops = atomic_load(&olc->residentHops);
+    stats->latchedPins = atomic_load(&olc->latchedPins);
+  }
+  return (AME_OK);
+}
+
+/*
+ * Point lookup: copies up to maxIds recIds of value into recIds and
+ * returns how many recIds the key has, 0 if it is not in the index. In
+ * concurrent mode the descent and the read of the leaf are optimistic;
+ * otherwise they run under the pool latch.
+ */
+int AM_LookupEntry(AM_IndexHandle *ih, char *value, int *recIds, int maxIds) {
+  char *pageBuf;
+  unsigned long v;
+  int pageNum, index, status, n, valid;
+
+  /* check the parameters */
+  if (value == NULL || maxIds < 0) {
+    AM_Errno = AME_INVALIDVALUE;
+    return (AME_INVALIDVALUE);
+  }
+  if (ih->fileDesc < 0) {
+    AM_Errno = AME_FD;
+    return (AME_FD);
+  }
+
+  if (ih->olc == NULL) {
+    AM_LatchPool();
+    status = AM_Search(ih, value, NULL, &pageNum, &pageBuf, &index);
+    if (status < 0) {
+      AM_UnlatchPool();
+      AM_Errno = status;
+      return (status);
+    }
+    n = AM_LeafRecIds(ih, pageBuf, value, recIds, maxIds, TRUE);
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    AM_UnlatchPool();
+  } else {
+    for (;;) {
+      status = AM_OlcDescend(ih, value, &pageNum, &pageBuf, &v);
+      if (status == AM_OLC_RESTART)
+        continue;
+      if (status < 0)
+        return (status);
+      n = AM_LeafRecIds(ih, pageBuf, value, recIds, maxIds, FALSE);
+      valid = AM_OlcValid(ih->olc, pageNum, v);
+      AM_OlcMove(ih, &pageNum, AM_NULL_PAGE, NULL);
+      if (valid)
+        break;
+      atomic_fetch_add(&ih->olc->restarts, 1);
+    }
+
+    /* a list on posting pages is read under the latch */
+    if (n == AM_POSTING_LATCH) {
+      AM_LatchPool();
+      status = AM_Search(ih, value, NULL, &pageNum, &pageBuf, &index);
+      if (status < 0) {
+        AM_UnlatchPool();
+        AM_Errno = status;
+        return (status);
+      }
+      n = AM_LeafRecIds(ih, pageBuf, value, recIds, maxIds, TRUE);
+      PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+      AM_UnlatchPool();
+    }
+  }
+
+  if (n < 0) {
+    AM_Errno = AME_INTERROR;
+    return (AME_INTERROR);
+  }
+  return (n);
+}
+
+/*
+ * The optimistic part of AM_InsertEntry in concurrent mode: finds the
+ * leaf without the latch, then latches only to add the pair to it if
+ * the leaf has not changed since. Returns AME_OK, an error, or
+ * AM_OLC_SPLIT if the leaf is full and the insert has to be redone
+ * under the latch.
+ */
+int AM_OlcInsert(AM_IndexHandle *ih, char *value, int recId) {
+  AM_OLC *olc = ih->olc;
+  AM_LEAFHEADER header;
+  char *pageBuf;
+  unsigned long v;
+  int pageNum, index, status, inserted, errVal;
+
+  if (value == NULL) {
+    AM_Errno = AME_INVALIDVALUE;
+    return (AME_INVALIDVALUE);
+  }
+
+  for (;;) {
+    errVal = AM_OlcDescend(ih, value, &pageNum, &pageBuf, &v);
+    if (errVal == AM_OLC_RESTART)
+      continue;
+    if (errVal < 0)
+      return (errVal);
+
+    AM_LatchPool();
+    if (atomic_load(AM_OlcSlot(olc, pageNum)) != v) {
+      /* the leaf changed, and may no longer be the one for value */
+      PF_UnpinPage(ih->fileDesc, pageNum, FALSE);
+      AM_UnlatchPool();
+      atomic_fetch_add(&olc->restarts, 1);
+      continue;
+    }
+
+    /* nobody else changes the leaf while the latch is held */
+    memcpy(&header, pageBuf, AM_sl);
+    status = AM_SearchLeaf(pageBuf, &ih->keyType, value, &index, &header);
+    if (AM_OlcLock(ih, pageNum) != AME_OK) {
+      PF_UnpinPage(ih->fileDesc, pageNum, FALSE);
+      AM_UnlatchPool();
+      return (AME_INTERROR);
+    }
+    inserted = AM_InsertintoLeaf(ih, pageBuf, value, recId, index, status);
+    AM_OlcUnlockAll(ih);
+    errVal = PF_UnpinPage(ih->fileDesc, pageNum, inserted == TRUE);
+    AM_UnlatchPool();
+    AM_Check(errVal);
+    if (inserted < 0) {
+      AM_Errno = inserted;
+      return (inserted);
+    }
+
+    if (inserted == TRUE) {
+      atomic_fetch_add(&olc->leafInserts, 1);
+      return (AME_OK);
+    }
+    atomic_fetch_add(&olc->splitInserts, 1);
+    return (AM_OLC_SPLIT);
+  }
+}
@@ -0,0 +1,615 @@
+#include "am.h"
+
+/*
+ * Posting lists, for indexes created without AM_CREATE_NOPOSTINGS. The
+ * recIds of a key are kept sorted, as a varint of the first followed by
+ * varints of the gaps between neighbours (7 bits a byte, the high bit
+ * set on all bytes of a varint but its last), so a key of clustered
+ * rows costs about a byte per recId instead of a 6-byte list entry.
+ *
+ * In a leaf the head of a key's list is the offset of the list in the
+ * recId heap: a short size, then size bytes of varints. The heap stays
+ * packed from recIdPtr to the prefix at the end of the page; a list
+ * that grows or shrinks moves the lists below it (AM_PostingResize),
+ * so these leaves have no free list.
+ *
+ * A list that would pass AM_POSTING_INLINE bytes moves to posting pages
+ * ('p'): its size becomes AM_POSTING_PAGES, followed by an
+ * AM_POSTINGREF. The pages hold consecutive runs of the list in the
+ * same encoding, are chained in recId order and keep their first and
+ * last recIds in their header, so an insert finds its page from the
+ * headers alone; appends go straight to the last page. A page emptied
+ * by deletes stays in the chain until the key goes, when all its pages
+ * are disposed of.
+ *
+ * Scans decode AM_SCANBATCH recIds at a time into their handle
+ * (AM_PostingFill) and hand them out without fixing the page again.
+ */
+
+/* bytes of varints a posting page holds */
+#define AM_PAGE_DATA (PF_PAGE_SIZE - (int)AM_sp)
+
+static int AM_VarintSize(unsigned int v) {
+  int n = 1;
+
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return (n);
+}
+
+/* Writes v at buf and returns its length */
+static int AM_VarintPut(char *buf, unsigned int v) {
+  int n = 0;
+
+  while (v >= 0x80) {
+    buf[n++] = (char)(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = (char)v;
+  return (n);
+}
+
+/* Reads the varint at buf + *pos and moves *pos past it; a varint
+running past end leaves *pos past end */
+static unsigned int AM_VarintGet(char *buf, int *pos, int end) {
+  unsigned int v = 0;
+  unsigned char c;
+  int shift = 0;
+
+  do {
+    if (*pos >= end || shift > 28) {
+      *pos = end + 1;
+      return (0);
+    }
+    c = (unsigned char)buf[(*pos)++];
+    v |= (unsigned int)(c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  return (v);
+}
+
+/* Gap from recId a to the recId b after it */
+#define AM_Gap(a, b) ((unsigned int)(b) - (unsigned int)(a))
+
+/* Encodes the n sorted recIds into buf and returns its length */
+int AM_PostingEncode(int *recIds, int n, char *buf) {
+  int i, len;
+
+  if (n == 0)
+    return (0);
+  len = AM_VarintPut(buf, (unsigned int)recIds[0]);
+  for (i = 1; i < n; i++)
+    len += AM_VarintPut(buf + len, AM_Gap(recIds[i - 1], recIds[i]));
+  return (len);
+}
+
+/* Decodes the size bytes at buf into recIds, at most maxIds of them,
+and returns how many recIds there are, or -1 if the bytes are not a
+list */
+int AM_PostingDecode(char *buf, int size, int *recIds, int maxIds) {
+  unsigned int recId = 0;
+  int pos = 0, n = 0;
+
+  while (pos < size) {
+    recId += AM_VarintGet(buf, &pos, size);
+    if (pos > size)
+      return (-1);
+    if (n < maxIds)
+      recIds[n] = (int)recId;
+    n++;
+  }
+  return (n);
+}
+
+/* Length of the encoding of the n sorted recIds */
+static int AM_PostingLength(int *recIds, int n) {
+  int i, len = 0;
+
+  for (i = 0; i < n; i++)
+    len += AM_VarintSize(i == 0 ? (unsigned int)recIds[0] : AM_Gap(recIds[i - 1], recIds[i]));
+  return (len);
+}
+
+/* How many of the n sorted recIds fit in limit bytes */
+static int AM_PostingRun(int *recIds, int n, int limit) {
+  int m, bytes = 0;
+
+  for (m = 0; m < n; m++) {
+    bytes += AM_VarintSize(m == 0 ? (unsigned int)recIds[0] : AM_Gap(recIds[m - 1], recIds[m]));
+    if (bytes > limit)
+      break;
+  }
+  return (m);
+}
+
+/* Bytes the list at off of a leaf takes, its size included */
+int AM_PostingBytes(char *pageBuf, int off) {
+  short size;
+
+  memcpy(&size, pageBuf + off, AM_ss);
+  return ((size == AM_POSTING_PAGES) ? AM_POSTING_REFBYTES : AM_ss + size);
+}
+
+/* Bytes a new list of recId takes */
+int AM_PostingNewBytes(int recId) {
+  return (AM_ss + AM_VarintSize((unsigned int)recId));
+}
+
+/* Puts a list of just recId at the bottom of the heap of leaf pageBuf,
+which must have room for it, and returns its offset */
+short AM_PostingNew(char *pageBuf, AM_LEAFHEADER *header, int recId) {
+  short size = AM_VarintSize((unsigned int)recId);
+
+  header->recIdPtr -= AM_ss + size;
+  memcpy(pageBuf + header->recIdPtr, &size, AM_ss);
+  AM_VarintPut(pageBuf + header->recIdPtr + AM_ss, (unsigned int)recId);
+  return (header->recIdPtr);
+}
+
+/* Makes room for newBytes of list for the index'th key, in place of
+its list, by moving the lists below it; the caller writes the list */
+static void AM_PostingResize(char *pageBuf, AM_LEAFHEADER *header, int index,
+                             int newBytes) {
+  int recSize = header->keyWidth + AM_ss;
+  short off = AM_LeafList(pageBuf, index);
+  short head;
+  int d = newBytes - AM_PostingBytes(pageBuf, off);
+  int i;
+
+  memmove(pageBuf + header->recIdPtr - d, pageBuf + header->recIdPtr,
+          off - header->recIdPtr);
+  header->recIdPtr -= d;
+  for (i = 1; i <= header->numKeys; i++) {
+    memcpy(&head, pageBuf + AM_sl + (i - 1) * recSize + header->keyWidth, AM_ss);
+    if (head <= off) {
+      head -= d;
+      memcpy(pageBuf + AM_sl + (i - 1) * recSize + header->keyWidth, &head, AM_ss);
+    }
+  }
+}
+
+/* Replaces the list of the index'th key with size and the len bytes at
+bytes; the leaf must have room */
+static void AM_PostingSet(char *pageBuf, AM_LEAFHEADER *header, int index,
+                          short size, char *bytes, int len) {
+  short off;
+
+  AM_PostingResize(pageBuf, header, index, AM_ss + len);
+  off = AM_LeafList(pageBuf, index);
+  memcpy(pageBuf + off, &size, AM_ss);
+  memcpy(pageBuf + off + AM_ss, bytes, len);
+}
+
+/* Writes the n sorted recIds onto posting page pageBuf, ahead of nextPage */
+static void AM_PagePut(char *pageBuf, int *recIds, int n, int nextPage) {
+  AM_POSTINGHEADER ph;
+
+  /* a page being reused may hold anything: only its version is kept */
+  memcpy(&ph, pageBuf, AM_sp);
+  ph.pageType = 'p';
+  ph.nextPage = nextPage;
+  ph.count = n;
+  ph.size = AM_PostingEncode(recIds, n, pageBuf + AM_sp);
+  ph.version++;
+  ph.first = (n > 0) ? recIds[0] : 0;
+  ph.last = (n > 0) ? recIds[n - 1] : 0;
+  memcpy(pageBuf, &ph, AM_sp);
+}
+
+/* Writes the n sorted recIds onto new posting pages, each filled, and
+describes them in *ref */
+static int AM_PagesWrite(AM_IndexHandle *ih, int *recIds, int n, AM_POSTINGREF *ref) {
+  char *pageBuf, *nextBuf;
+  int pageNum, nextPage;
+  int i, m, errVal;
+  int fileDesc = ih->fileDesc;
+
+  errVal = PF_AllocPage(fileDesc, &pageNum, &pageBuf);
+  AM_Check(errVal);
+  ref->firstPage = pageNum;
+  for (i = 0;; i += m) {
+    m = AM_PostingRun(recIds + i, n - i, AM_PAGE_DATA);
+    nextPage = AM_NULL_PAGE;
+    if (i + m < n) {
+      errVal = PF_AllocPage(fileDesc, &nextPage, &nextBuf);
+      AM_Check(errVal);
+    }
+    AM_PagePut(pageBuf, recIds + i, m, nextPage);
+    errVal = PF_UnfixPage(fileDesc, pageNum, TRUE);
+    AM_Check(errVal);
+    if (nextPage == AM_NULL_PAGE)
+      break;
+    pageNum = nextPage;
+    pageBuf = nextBuf;
+  }
+  ref->lastPage = pageNum;
+  ref->count = n;
+  return (AME_OK);
+}
+
+/* Adds recId to the list on the posting pages of *ref */
+static int AM_PagesAdd(AM_IndexHandle *ih, AM_POSTINGREF *ref, int recId) {
+  int recIds[AM_PAGE_DATA + 1];
+  AM_POSTINGHEADER ph;
+  char *pageBuf, *newBuf;
+  int pageNum, target, newPage;
+  int i, n, m, gap, len, errVal;
+  int fileDesc = ih->fileDesc;
+
+  /* an append: onto the last page, or a new page after it */
+  errVal = PF_GetThisPage(fileDesc, ref->lastPage, &pageBuf);
+  AM_Check(errVal);
+  memcpy(&ph, pageBuf, AM_sp);
+  if (ph.count > 0 && recId >= ph.last) {
+    gap = AM_VarintSize(AM_Gap(ph.last, recId));
+    if (ph.size + gap <= AM_PAGE_DATA) {
+      AM_VarintPut(pageBuf + AM_sp + ph.size, AM_Gap(ph.last, recId));
+      ph.size += gap;
+      ph.count++;
+      ph.last = recId;
+    } else {
+      errVal = PF_AllocPage(fileDesc, &newPage, &newBuf);
+      AM_Check(errVal);
+      AM_PagePut(newBuf, &recId, 1, AM_NULL_PAGE);
+      errVal = PF_UnfixPage(fileDesc, newPage, TRUE);
+      AM_Check(errVal);
+      ph.nextPage = newPage;
+    }
+    ph.version++;
+    memcpy(pageBuf, &ph, AM_sp);
+    errVal = PF_UnfixPage(fileDesc, ref->lastPage, TRUE);
+    AM_Check(errVal);
+    if (ph.nextPage != AM_NULL_PAGE)
+      ref->lastPage = ph.nextPage;
+    ref->count++;
+    return (AME_OK);
+  }
+  errVal = PF_UnfixPage(fileDesc, ref->lastPage, FALSE);
+  AM_Check(errVal);
+
+  /* otherwise into the last page starting at or below recId, found
+  from the headers */
+  target = ref->firstPage;
+  for (pageNum = ref->firstPage; pageNum != AM_NULL_PAGE; pageNum = ph.nextPage) {
+    errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
+    AM_Check(errVal);
+    memcpy(&ph, pageBuf, AM_sp);
+    errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
+    AM_Check(errVal);
+    if (ph.count > 0 && ph.first > recId)
+      break;
+    if (ph.count > 0)
+      target = pageNum;
+  }
+
+  errVal = PF_GetThisPage(fileDesc, target, &pageBuf);
+  AM_Check(errVal);
+  memcpy(&ph, pageBuf, AM_sp);
+  n = AM_PostingDecode(pageBuf + AM_sp, ph.size, recIds, AM_PAGE_DATA);
+  for (i = n; i > 0 && recIds[i - 1] > recId; i--)
+    recIds[i] = recIds[i - 1];
+  recIds[i] = recId;
+  n++;
+
+  len = AM_PostingLength(recIds, n);
+  if (len <= AM_PAGE_DATA) {
+    AM_PagePut(pageBuf, recIds, n, ph.nextPage);
+  } else {
+    /* the page is full: the upper half of its bytes go to a new page after it */
+    m = AM_PostingRun(recIds, n, len / 2);
+    if (m == 0)
+      m = 1;
+    errVal = PF_AllocPage(fileDesc, &newPage, &newBuf);
+    AM_Check(errVal);
+    AM_PagePut(newBuf, recIds + m, n - m, ph.nextPage);
+    errVal = PF_UnfixPage(fileDesc, newPage, TRUE);
+    AM_Check(errVal);
+    AM_PagePut(pageBuf, recIds, m, newPage);
+    if (target == ref->lastPage)
+      ref->lastPage = newPage;
+  }
+  errVal = PF_UnfixPage(fileDesc, target, TRUE);
+  AM_Check(errVal);
+  ref->count++;
+  return (AME_OK);
+}
+
+/* Removes recId from the list on the posting pages of *ref */
+static int AM_PagesRemove(AM_IndexHandle *ih, AM_POSTINGREF *ref, int recId) {
+  int recIds[AM_PAGE_DATA];
+  AM_POSTINGHEADER ph;
+  char *pageBuf;
+  int pageNum, i, n, errVal;
+  int fileDesc = ih->fileDesc;
+
+  for (pageNum = ref->firstPage; pageNum != AM_NULL_PAGE; pageNum = ph.nextPage) {
+    errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
+    AM_Check(errVal);
+    memcpy(&ph, pageBuf, AM_sp);
+    if (ph.count > 0 && ph.first <= recId && recId <= ph.last) {
+      n = AM_PostingDecode(pageBuf + AM_sp, ph.size, recIds, AM_PAGE_DATA);
+      for (i = 0; i < n && recIds[i] != recId; i++)
+        ;
+      if (i == n) {
+        PF_UnfixPage(fileDesc, pageNum, FALSE);
+        return (AME_NOTFOUND);
+      }
+      memmove(recIds + i, recIds + i + 1, (n - i - 1) * sizeof(int));
+      AM_PagePut(pageBuf, recIds, n - 1, ph.nextPage);
+      errVal = PF_UnfixPage(fileDesc, pageNum, TRUE);
+      AM_Check(errVal);
+      ref->count--;
+      return (AME_OK);
+    }
+    errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
+    AM_Check(errVal);
+    if (ph.count > 0 && ph.first > recId)
+      break;
+  }
+  return (AME_NOTFOUND);
+}
+
+/* Disposes of the posting pages from pageNum on */
+static int AM_PagesFree(AM_IndexHandle *ih, int pageNum) {
+  AM_POSTINGHEADER ph;
+  char *pageBuf;
+  int errVal;
+
+  while (pageNum != AM_NULL_PAGE) {
+    errVal = PF_GetThisPage(ih->fileDesc, pageNum, &pageBuf);
+    AM_Check(errVal);
+    memcpy(&ph, pageBuf, AM_sp);
+    errVal = PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    AM_Check(errVal);
+    errVal = PF_DisposePage(ih->fileDesc, pageNum);
+    AM_Check(errVal);
+    pageNum = ph.nextPage;
+  }
+  return (AME_OK);
+}
+
+/*
+ * Adds recId to the list of the index'th key of leaf pageBuf, in order.
+ * Returns TRUE, FALSE if the leaf has no room for the longer list, or
+ * an error. A list growing past AM_POSTING_INLINE bytes moves to
+ * posting pages; with spill, so does one the leaf has no room for.
+ */
+int AM_PostingAdd(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header,
+                  int index, int recId, int spill) {
+  int recIds[AM_POSTING_INLINE + 1];
+  char bytes[5 * (AM_POSTING_INLINE + 1)];
+  AM_POSTINGREF ref;
+  short off = AM_LeafList(pageBuf, index);
+  short size;
+  int i, n, len, errVal;
+
+  memcpy(&size, pageBuf + off, AM_ss);
+  if (size == AM_POSTING_PAGES) {
+    memcpy(&ref, pageBuf + off + AM_ss, sizeof(ref));
+    errVal = AM_PagesAdd(ih, &ref, recId);
+    if (errVal < 0)
+      return (errVal);
+    memcpy(pageBuf + off + AM_ss, &ref, sizeof(ref));
+    return (TRUE);
+  }
+
+  /* a list in the leaf is decoded, added to and encoded again */
+  n = AM_PostingDecode(pageBuf + off + AM_ss, size, recIds, AM_POSTING_INLINE);
+  for (i = n; i > 0 && recIds[i - 1] > recId; i--)
+    recIds[i] = recIds[i - 1];
+  recIds[i] = recId;
+  n++;
+  len = AM_PostingEncode(recIds, n, bytes);
+  if (len <= AM_POSTING_INLINE) {
+    if (len - size <= header->recIdPtr - header->keyPtr) {
+      AM_PostingSet(pageBuf, header, index, len, bytes, len);
+      return (TRUE);
+    }
+    if (!spill)
+      return (FALSE);
+  }
+
+  if (AM_POSTING_REFBYTES - AM_PostingBytes(pageBuf, off) > header->recIdPtr - header->keyPtr)
+    return (FALSE);
+  errVal = AM_PagesWrite(ih, recIds, n, &ref);
+  if (errVal < 0)
+    return (errVal);
+  AM_PostingSet(pageBuf, header, index, AM_POSTING_PAGES, (char *)&ref, sizeof(ref));
+  return (TRUE);
+}
+
+/* Removes recId from the list of the index'th key of leaf pageBuf.
+Returns TRUE if that empties the list, which is then gone from the heap
+and its pages disposed of, FALSE if not, or an error. */
+int AM_PostingRemove(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header,
+                     int index, int recId) {
+  int recIds[AM_POSTING_INLINE];
+  char bytes[5 * AM_POSTING_INLINE];
+  AM_POSTINGREF ref;
+  short off = AM_LeafList(pageBuf, index);
+  short size;
+  int i, n, len, errVal;
+
+  memcpy(&size, pageBuf + off, AM_ss);
+  if (size == AM_POSTING_PAGES) {
+    memcpy(&ref, pageBuf + off + AM_ss, sizeof(ref));
+    errVal = AM_PagesRemove(ih, &ref, recId);
+    if (errVal < 0)
+      return (errVal);
+    if (ref.count > 0) {
+      memcpy(pageBuf + off + AM_ss, &ref, sizeof(ref));
+      return (FALSE);
+    }
+    errVal = AM_PagesFree(ih, ref.firstPage);
+    if (errVal < 0)
+      return (errVal);
+    AM_PostingResize(pageBuf, header, index, 0);
+    return (TRUE);
+  }
+
+  n = AM_PostingDecode(pageBuf + off + AM_ss, size, recIds, AM_POSTING_INLINE);
+  for (i = 0; i < n && recIds[i] != recId; i++)
+    ;
+  if (i == n)
+    return (AME_NOTFOUND);
+  if (n == 1) {
+    AM_PostingResize(pageBuf, header, index, 0);
+    return (TRUE);
+  }
+  memmove(recIds + i, recIds + i + 1, (n - i - 1) * sizeof(int));
+  len = AM_PostingEncode(recIds, n - 1, bytes);
+  AM_PostingSet(pageBuf, header, index, len, bytes, len);
+  return (FALSE);
+}
+
+/*
+ * Copies up to maxIds recIds of the index'th key of leaf pageBuf into
+ * recIds and returns how many the key has, or -1 if the list is not
+ * sane: in concurrent mode the leaf may be changing as it is read.
+ * Posting pages are only read latched; otherwise a list on them
+ * returns AM_POSTING_LATCH.
+ */
+int AM_PostingLookup(AM_IndexHandle *ih, char *pageBuf, AM_LEAFHEADER *header,
+                     int index, int *recIds, int maxIds, int latched) {
+  AM_POSTINGREF ref;
+  AM_POSTINGHEADER ph;
+  char *buf;
+  short off = AM_LeafList(pageBuf, index);
+  short size;
+  int pageNum, n = 0, errVal;
+
+  if (off < header->recIdPtr || off > PF_PAGE_SIZE - (int)AM_ss)
+    return (-1);
+  memcpy(&size, pageBuf + off, AM_ss);
+  if (size == AM_POSTING_PAGES && off > PF_PAGE_SIZE - AM_POSTING_REFBYTES)
+    return (-1);
+  if (size != AM_POSTING_PAGES) {
+    if (size < 0 || size > AM_POSTING_INLINE || off + AM_ss + size > PF_PAGE_SIZE)
+      return (-1);
+    return (AM_PostingDecode(pageBuf + off + AM_ss, size, recIds, maxIds));
+  }
+  if (!latched)
+    return (AM_POSTING_LATCH);
+
+  memcpy(&ref, pageBuf + off + AM_ss, sizeof(ref));
+  for (pageNum = ref.firstPage; pageNum != AM_NULL_PAGE && n < maxIds; pageNum = ph.nextPage) {
+    errVal = PF_GetThisPage(ih->fileDesc, pageNum, &buf);
+    AM_Check(errVal);
+    memcpy(&ph, buf, AM_sp);
+    AM_PostingDecode(buf + AM_sp, ph.size, recIds + n, maxIds - n);
+    n += ph.count;
+    errVal = PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    AM_Check(errVal);
+  }
+  return (ref.count);
+}
+
+/*
+ * Fills the batch of scan sh with the first AM_SCANBATCH recIds of the
+ * index'th key of leaf pageBuf, or on resume with the ones after those
+ * the batch holds. A scan of posting pages goes on from the place its
+ * last batch ended if that page is unchanged, and otherwise looks for
+ * the first recId past the batch from the start of the list.
+ */
+int AM_PostingFill(AM_ScanHandle *sh, char *pageBuf, int index, int resume) {
+  int recIds[AM_POSTING_INLINE];
+  AM_POSTINGREF ref;
+  AM_POSTINGHEADER ph;
+  char *buf;
+  short off = AM_LeafList(pageBuf, index);
+  short size;
+  int after = 0;    /* last recId returned */
+  int dups = 0;     /* recIds equal to after among those returned */
+  int skip = resume; /* recIds up to after are still to be skipped */
+  unsigned int recId = 0;
+  int pageNum, nextPage, pos = 0;
+  int i, n, errVal;
+  int fileDesc = sh->ih->fileDesc;
+
+  if (resume) {
+    after = sh->batch[sh->batchLen - 1];
+    for (i = sh->batchLen; i > 0 && sh->batch[i - 1] == after; i--)
+      dups++;
+  }
+  sh->batchLen = 0;
+  sh->batchPos = 0;
+  sh->batchMore = FALSE;
+
+  memcpy(&size, pageBuf + off, AM_ss);
+  if (size != AM_POSTING_PAGES) {
+    n = AM_PostingDecode(pageBuf + off + AM_ss, size, recIds, AM_POSTING_INLINE);
+    for (i = 0; skip && i < n && (recIds[i] < after || (recIds[i] == after && dups-- > 0)); i++)
+      ;
+    for (; i < n && sh->batchLen < AM_SCANBATCH; i++)
+      sh->batch[sh->batchLen++] = recIds[i];
+    sh->batchMore = (i < n);
+    return (AME_OK);
+  }
+
+  memcpy(&ref, pageBuf + off + AM_ss, sizeof(ref));
+  pageNum = ref.firstPage;
+  if (resume && sh->listPage != AM_NULL_PAGE) {
+    errVal = PF_GetThisPage(fileDesc, sh->listPage, &buf);
+    AM_Check(errVal);
+    memcpy(&ph, buf, AM_sp);
+    errVal = PF_UnfixPage(fileDesc, sh->listPage, FALSE);
+    AM_Check(errVal);
+    if (ph.pageType == 'p' && ph.version == sh->listVersion && sh->listOff <= ph.size) {
+      /* the page is as the last batch left it */
+      pageNum = sh->listPage;
+      pos = sh->listOff;
+      recId = (pos > 0) ? (unsigned int)after : 0;
+      skip = FALSE;
+    }
+  }
+
+  for (; pageNum != AM_NULL_PAGE; pageNum = nextPage, pos = 0, recId = 0) {
+    errVal = PF_GetThisPage(fileDesc, pageNum, &buf);
+    AM_Check(errVal);
+    memcpy(&ph, buf, AM_sp);
+    if (skip && (ph.count == 0 || ph.last < after))
+      pos = ph.size;
+    while (pos < ph.size) {
+      if (sh->batchLen == AM_SCANBATCH) {
+        sh->batchMore = TRUE;
+        break;
+      }
+      recId += AM_VarintGet(buf + AM_sp, &pos, ph.size);
+      if (skip && ((int)recId < after || ((int)recId == after && dups-- > 0)))
+        continue;
+      skip = FALSE;
+      sh->batch[sh->batchLen++] = (int)recId;
+    }
+    nextPage = ph.nextPage;
+    errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
+    AM_Check(errVal);
+    if (sh->batchMore) {
+      sh->listPage = pageNum;
+      sh->listOff = pos;
+      sh->listVersion = ph.version;
+      return (AME_OK);
+    }
+  }
+  sh->listPage = AM_NULL_PAGE;
+  return (AME_OK);
+}
+
+/* Prints the list at off of a leaf */
+void AM_PrintPostings(char *pageBuf, int off) {
+  int recIds[AM_POSTING_INLINE];
+  AM_POSTINGREF ref;
+  short size;
+  int i, n;
+
+  memcpy(&size, pageBuf + off, AM_ss);
+  if (size == AM_POSTING_PAGES) {
+    memcpy(&ref, pageBuf + off + AM_ss, sizeof(ref));
+    printf("RECIDS %d on posting pages %d to %d\n", ref.count, ref.firstPage, ref.lastPage);
+    return;
+  }
+  n = AM_PostingDecode(pageBuf + off + AM_ss, size, recIds, AM_POSTING_INLINE);
+  for (i = 0; i < n; i++)
+    printf("RECID is %d\n", recIds[i]);
+}
@@ -0,0 +1,273 @@
+#include "am.h"
+
+/*
+ * Compressed nodes, for indexes of byte string keys ('c' and
+ * AM_KEY_BYTES) created without AM_CREATE_NOCOMPRESSION. Their keys are
+ * stored canonical (AM_CanonKey): a char key is zeroed after its first
+ * NUL, so memcmp orders keys as strncmp does, and the trailing zeros of
+ * a key need not be stored at all.
+ *
+ * Leaves: all keys of a leaf share their first prefixLength bytes, which
+ * are stored once at the end of the page, with the recId lists growing
+ * down below them. Each key slot holds the next keyWidth bytes of its
+ * key; the rest of the key is zeros. A new key that does not fit the
+ * layout, because it has another prefix or a longer tail, has the leaf
+ * rewritten with a shorter prefix or wider slots (AM_LeafLayout,
+ * AM_CompactAs) if that still fits, and splits it otherwise. A split
+ * lays each half out afresh for its own keys (AM_RangeLayout).
+ *
+ * Internal nodes: a separator is the shortest prefix of the first key
+ * of the right leaf that is still above the last key of the left one
+ * (AM_Separator), and is stored at that length. After the first child
+ * pointer come AM_INTENTRYs, each the place and length of a separator
+ * and the child to its right; separator bytes grow down from the end of
+ * the page to meet them (keyPtr). Nodes fill up by bytes, not keys, and
+ * split by bytes (AM_SplitPackedNode).
+ *
+ * Nodes of other indexes have prefixLength 0 and keyWidth attrLength,
+ * which is the fixed layout everything else assumes.
+ */
+
+/* Copies value into canon as it is stored in a compressed node, and
+returns its length without trailing zeros */
+int AM_CanonKey(AM_KEYTYPE *kt, char *value, char *canon) {
+  int n;
+
+  if (kt->attrType != 'c') {
+    memcpy(canon, value, kt->attrLength);
+    return (AM_KeyLength(canon, kt->attrLength));
+  }
+  for (n = 0; n < kt->attrLength && value[n] != '\0'; n++)
+    ;
+  memcpy(canon, value, n);
+  memset(canon + n, 0, kt->attrLength - n);
+  return (n);
+}
+
+/* Length of key without its trailing zeros */
+int AM_KeyLength(char *key, int attrLength) {
+  unsigned long long word;
+
+  /* eight bytes at a time while they are all zeros */
+  while (attrLength >= 8) {
+    memcpy(&word, key + attrLength - 8, sizeof(word));
+    if (word != 0)
+      break;
+    attrLength -= 8;
+  }
+  while (attrLength > 0 && key[attrLength - 1] == 0)
+    attrLength--;
+  return (attrLength);
+}
+
+/* Number of leading bytes a and b share, at most n */
+static int AM_CommonPrefix(char *a, char *b, int n) {
+  int i;
+
+  for (i = 0; i < n && a[i] == b[i]; i++)
+    ;
+  return (i);
+}
+
+/* Copies the full index'th (1-based) key of leaf pageBuf into key */
+void AM_LeafKey(char *pageBuf, AM_LEAFHEADER *header, int index, char *key) {
+  int p = header->prefixLength;
+  int w = header->keyWidth;
+
+  memcpy(key, pageBuf + PF_PAGE_SIZE - p, p);
+  memcpy(key + p, pageBuf + AM_sl + (index - 1) * (w + AM_ss), w);
+  memset(key + p + w, 0, header->attrLength - p - w);
+}
+
+/* Head of the recId list of the index'th key of leaf pageBuf */
+short AM_LeafList(char *pageBuf, int index) {
+  AM_LEAFHEADER header;
+  short head;
+
+  memcpy(&header, pageBuf, AM_sl);
+  memcpy(&head,
+         pageBuf + AM_sl + (index - 1) * (header.keyWidth + AM_ss) + header.keyWidth,
+         AM_ss);
+  return (head);
+}
+
+/* The layout leaf pageBuf needs to also hold the canonical key canon, in
+*prefixLength and *keyWidth; TRUE if that is the layout it has */
+int AM_LeafLayout(char *pageBuf, AM_LEAFHEADER *header, char *canon,
+                  int *prefixLength, int *keyWidth) {
+  int p = header->prefixLength;
+  int len;
+
+  *prefixLength = p;
+  *keyWidth = header->keyWidth;
+  if (!header->packed)
+    return (TRUE);
+
+  len = AM_KeyLength(canon, header->attrLength);
+  if (header->numKeys == 0) {
+    /* a lone key is all prefix */
+    *prefixLength = len;
+    *keyWidth = 0;
+  } else {
+    *prefixLength = AM_CommonPrefix(pageBuf + PF_PAGE_SIZE - p, canon, p);
+    *keyWidth = ((p + header->keyWidth > len) ? p + header->keyWidth : len) - *prefixLength;
+  }
+  return (*prefixLength == p && *keyWidth == header->keyWidth);
+}
+
+/* The tightest layout of keys low .. high of leaf pageBuf, with the
+first of them copied into first (nothing for an empty range) */
+void AM_RangeLayout(char *pageBuf, AM_LEAFHEADER *header, int low, int high,
+                    char *first, int *prefixLength, int *keyWidth) {
+  char key[AM_MAXATTRLENGTH];
+  int i, len;
+
+  *prefixLength = 0;
+  *keyWidth = header->packed ? 0 : header->attrLength;
+  if (low > high)
+    return;
+  AM_LeafKey(pageBuf, header, low, first);
+  if (!header->packed)
+    return;
+
+  /* sorted keys share what the first and last share */
+  AM_LeafKey(pageBuf, header, high, key);
+  *prefixLength = AM_CommonPrefix(first, key, header->attrLength);
+  for (i = low; i <= high; i++) {
+    AM_LeafKey(pageBuf, header, i, key);
+    len = AM_KeyLength(key, header->attrLength) - *prefixLength;
+    if (len > *keyWidth)
+      *keyWidth = len;
+  }
+}
+
+/* The separator between keys left < right into key: right itself, or
+in a compressed index the shortest prefix of right above left */
+void AM_Separator(char *left, char *right, int attrLength, int packed, char *key) {
+  int n;
+
+  if (!packed) {
+    memcpy(key, right, attrLength);
+    return;
+  }
+  n = AM_CommonPrefix(left, right, attrLength) + 1;
+  memcpy(key, right, n);
+  memset(key + n, 0, attrLength - n);
+}
+
+/* The i'th (0-based) separator of compressed internal node pageBuf,
+its length in *len. A node being changed under a concurrent reader may
+hold anything, so the entry is checked before it is followed. */
+char *AM_IntKey(char *pageBuf, int attrLength, int i, int *len) {
+  AM_INTENTRY entry;
+
+  memcpy(&entry, pageBuf + AM_sint + AM_si + i * AM_se, AM_se);
+  if (entry.keyLen < 0 || entry.keyLen > attrLength ||
+      entry.keyOff < (int)(AM_sint + AM_si) || entry.keyOff > PF_PAGE_SIZE - entry.keyLen) {
+    entry.keyOff = AM_sint;
+    entry.keyLen = 0;
+  }
+  *len = entry.keyLen;
+  return (pageBuf + entry.keyOff);
+}
+
+/* The i'th (0-based) child pointer of internal node pageBuf */
+int AM_IntChild(char *pageBuf, AM_INTHEADER *header, int i) {
+  int child;
+
+  if (i == 0 || !header->packed)
+    memcpy(&child, pageBuf + AM_sint + i * (header->attrLength + AM_si), AM_si);
+  else
+    memcpy(&child, pageBuf + AM_sint + AM_si + (i - 1) * AM_se + 2 * AM_ss, AM_si);
+  return (child);
+}
+
+/* TRUE if internal node pageBuf has room for the separator value */
+int AM_IntPageFits(char *pageBuf, AM_INTHEADER *header, char *value) {
+  if (!header->packed)
+    return (header->numKeys < header->maxKeys);
+  return (header->keyPtr - (int)(AM_sint + AM_si + (header->numKeys + 1) * AM_se) >=
+          AM_KeyLength(value, header->attrLength));
+}
+
+/* Puts separator key of len bytes at offset of a compressed node, with
+child to its right */
+static void AM_PackedInsert(char *pageBuf, AM_INTHEADER *header, int offset,
+                            char *key, int len, int child) {
+  AM_INTENTRY entry;
+  char *entries = pageBuf + AM_sint + AM_si;
+
+  header->keyPtr -= len;
+  memcpy(pageBuf + header->keyPtr, key, len);
+  entry.keyOff = header->keyPtr;
+  entry.keyLen = len;
+  entry.child = child;
+  memmove(entries + (offset + 1) * AM_se, entries + offset * AM_se,
+          (header->numKeys - offset) * AM_se);
+  memcpy(entries + offset * AM_se, &entry, AM_se);
+  header->numKeys++;
+}
+
+/* AM_AddtoIntPage for a compressed node */
+void AM_AddtoPackedPage(char *pageBuf, char *value, int pageNum,
+                        AM_INTHEADER *header, int offset) {
+  AM_PackedInsert(pageBuf, header, offset, value,
+                  AM_KeyLength(value, header->attrLength), pageNum);
+}
+
+/* AM_SplitIntNode for a compressed node: the separators, value among
+them, are split where their bytes are halved, and the one there moves
+up into value */
+void AM_SplitPackedNode(char *pageBuf, char *pbuf1, char *pbuf2,
+                        AM_INTHEADER *header, char *value, int pageNum, int offset) {
+  char newKey[AM_MAXATTRLENGTH];
+  char *keys[AM_PACKED_MAXKEYS + 1];
+  int lens[AM_PACKED_MAXKEYS + 1];
+  int childs[AM_PACKED_MAXKEYS + 1]; /* child to the right of each key */
+  AM_INTHEADER temphead;
+  int i, j, n, m, total, left;
+
+  /* the separators in order, value at offset */
+  n = header->numKeys + 1;
+  memcpy(newKey, value, header->attrLength);
+  for (i = 0, j = 0; i < n; i++) {
+    if (i == offset) {
+      keys[i] = newKey;
+      lens[i] = AM_KeyLength(newKey, header->attrLength);
+      childs[i] = pageNum;
+    } else {
+      keys[i] = AM_IntKey(pageBuf, header->attrLength, j, &lens[i]);
+      childs[i] = AM_IntChild(pageBuf, header, j + 1);
+      j++;
+    }
+  }
+
+  /* the middle by bytes, leaving a key on either side */
+  for (i = 0, total = 0; i < n; i++)
+    total += AM_se + lens[i];
+  for (m = 0, left = 0; m < n - 2 && 2 * left + (int)AM_se + lens[m] < total; m++)
+    left += AM_se + lens[m];
+  if (m == 0)
+    m = 1;
+
+  memcpy(&temphead, header, AM_sint);
+  temphead.numKeys = 0;
+  temphead.keyPtr = PF_PAGE_SIZE;
+  i = AM_IntChild(pageBuf, header, 0);
+  memcpy(pbuf1 + AM_sint, (char *)&i, AM_si);
+  for (i = 0; i < m; i++)
+    AM_PackedInsert(pbuf1, &temphead, i, keys[i], lens[i], childs[i]);
+  memcpy(pbuf1, &temphead, AM_sint);
+
+  temphead.numKeys = 0;
+  temphead.keyPtr = PF_PAGE_SIZE;
+  memcpy(pbuf2 + AM_sint, (char *)&childs[m], AM_si);
+  for (i = m + 1; i < n; i++)
+    AM_PackedInsert(pbuf2, &temphead, i - m - 1, keys[i], lens[i], childs[i]);
+  memcpy(pbuf2, &temphead, AM_sint);
+
+  /* the middle separator goes to the parent */
+  memmove(newKey, keys[m], lens[m]);
+  memset(newKey + lens[m], 0, header->attrLength - lens[m]);
+  memcpy(value, newKey, header->attrLength);
+}
@@ -1,8 +1,10 @@
 #include "am.h"
 
 void AM_PrintIntNode(char *pageBuf, char attrType) {
-  int tempPageint;
+  char key[AM_MAXATTRLENGTH];
+  char *keyPtr;
   int i;
+  int len;
   int recSize;
   AM_INTHEADER *header;
 
@@ -14,13 +16,19 @@ void AM_PrintIntNode(char *pageBuf, char attrType) {
   printf("NUMKEYS %d\n", header->numKeys);
   printf("MAXKEYS %d\n", header->maxKeys);
   printf("ATTRLENGTH %d\n", header->attrLength);
-  memcpy(&tempPageint, pageBuf + AM_sint, AM_si);
-  printf("FIRSTPAGE is %d\n", tempPageint);
+  printf("FIRSTPAGE is %d\n", AM_IntChild(pageBuf, header, 0));
   for (i = 1; i <= (header->numKeys); i++) {
-    AM_PrintAttr(pageBuf + (i - 1) * recSize + AM_sint + AM_si, attrType,
-                 header->attrLength);
-    memcpy(&tempPageint, pageBuf + i * recSize + AM_sint, AM_si);
-    printf("NEXTPAGE is %d\n", tempPageint);
+    if (header->packed) {
+      /* a truncated separator, shown at full length */
+      keyPtr = AM_IntKey(pageBuf, header->attrLength, i - 1, &len);
+      memcpy(key, keyPtr, len);
+      memset(key + len, 0, header->attrLength - len);
+      AM_PrintAttr(key, attrType, header->attrLength);
+    } else {
+      AM_PrintAttr(pageBuf + (i - 1) * recSize + AM_sint + AM_si, attrType,
+                   header->attrLength);
+    }
+    printf("NEXTPAGE is %d\n", AM_IntChild(pageBuf, header, i));
   }
   free(header);
 }
@@ -28,15 +36,13 @@ void AM_PrintIntNode(char *pageBuf, char attrType) {
 void AM_PrintLeafNode(char *pageBuf, char attrType) {
   short nextRec;
   int i;
-  int recSize;
   int recId;
-  int offset1;
+  char key[AM_MAXATTRLENGTH];
   AM_LEAFHEADER *header;
 
   header = (AM_LEAFHEADER *)calloc(1, AM_sl);
   if (header == NULL) return; /* calloc failed */
   memcpy(header, pageBuf, AM_sl);
-  recSize = header->attrLength + AM_ss;
   printf("PAGETYPE %c\n", header->pageType);
   printf("NEXTLEAFPAGE %d\n", header->nextLeafPage);
   /*printf("RECIDPTR %d\n",header->recIdPtr);
@@ -47,10 +53,13 @@ void AM_PrintLeafNode(char *pageBuf, char attrType) {
   printf("MAXKEYS %d\n",header->maxKeys);*/
   printf("NUMKEYS %d\n", header->numKeys);
   for (i = 1; i <= header->numKeys; i++) {
-    offset1 = (i - 1) * recSize + AM_sl;
-    AM_PrintAttr(pageBuf + AM_sl + (i - 1) * recSize, attrType,
-                 header->attrLength);
-    memcpy(&nextRec, pageBuf + offset1 + header->attrLength, AM_ss);
+    AM_LeafKey(pageBuf, header, i, key);
+    AM_PrintAttr(key, attrType, header->attrLength);
+    nextRec = AM_LeafList(pageBuf, i);
+    if (header->postings) {
+      AM_PrintPostings(pageBuf, nextRec);
+      nextRec = 0;
+    }
     while (nextRec != 0) {
       memcpy(&recId, pageBuf + nextRec, AM_si);
       printf("RECID is %d\n", recId);
@@ -62,60 +71,59 @@ void AM_PrintLeafNode(char *pageBuf, char attrType) {
   free(header);
 }
 
-void AM_DumpLeafPages(int fileDesc, int min, char attrType, int attrLength) {
+void AM_DumpLeafPages(AM_IndexHandle *ih) {
   int pageNum;
-  char *value;
   char *pageBuf;
   int errVal;
+  int fileDesc = ih->fileDesc;
+  char attrType = ih->attrType;
   AM_LEAFHEADER *header;
 
-  value = malloc(AM_si);
-  if (value == NULL) return;
-  memcpy(value, &min, AM_si);
-  printf("%d PAGE \n", AM_LeftPageNum);
-  PF_GetThisPage(fileDesc, AM_LeftPageNum, &pageBuf);
+  pageNum = GetLeftPageNum(ih);
+  if (pageNum < 0) return;
+  printf("%d PAGE \n", pageNum);
+  PF_GetThisPage(fileDesc, pageNum, &pageBuf);
   header = (AM_LEAFHEADER *)calloc(1, AM_sl);
-  if (header == NULL) { free(value); return; }
+  if (header == NULL) return;
   
   memcpy(header, pageBuf, AM_sl);
-  pageNum = AM_LeftPageNum; /* Initialize pageNum */
 
   while (header->nextLeafPage != -1) {
     printf("PAGENUMBER = %d\n", pageNum);
     AM_PrintLeafKeys(pageBuf, attrType);
     errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
-    if (errVal != PFE_OK) { AM_Errno = AME_PF; free(value); free(header); return; }
+    if (errVal != PFE_OK) { AM_Errno = AME_PF; free(header); return; }
     pageNum = header->nextLeafPage;
     errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
-    if (errVal != PFE_OK) { AM_Errno = AME_PF; free(value); free(header); return; }
+    if (errVal != PFE_OK) { AM_Errno = AME_PF; free(header); return; }
     memcpy(header, pageBuf, AM_sl);
   }
   printf("PAGENUMBER = %d\n", pageNum);
   AM_PrintLeafKeys(pageBuf, attrType);
   errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
-  if (errVal != PFE_OK) { AM_Errno = AME_PF; free(value); free(header); return; }
+  if (errVal != PFE_OK) { AM_Errno = AME_PF; free(header); return; }
   
-  free(value);
   free(header);
 }
 
 void AM_PrintLeafKeys(char *pageBuf, char attrType) {
   short nextRec;
   int i;
-  int recSize;
   int recId;
-  int offset1;
+  char key[AM_MAXATTRLENGTH];
   AM_LEAFHEADER *header;
 
   header = (AM_LEAFHEADER *)calloc(1, AM_sl);
   if (header == NULL) return;
   memcpy(header, pageBuf, AM_sl);
-  recSize = header->attrLength + AM_ss;
   for (i = 1; i <= header->numKeys; i++) {
-    offset1 = (i - 1) * recSize + AM_sl;
-    AM_PrintAttr(pageBuf + AM_sl + (i - 1) * recSize, attrType,
-                 header->attrLength);
-    memcpy(&nextRec, pageBuf + offset1 + header->attrLength, AM_ss);
+    AM_LeafKey(pageBuf, header, i, key);
+    AM_PrintAttr(key, attrType, header->attrLength);
+    nextRec = AM_LeafList(pageBuf, i);
+    if (header->postings) {
+      AM_PrintPostings(pageBuf, nextRec);
+      nextRec = 0;
+    }
     while (nextRec != 0) {
       memcpy(&recId, pageBuf + nextRec, AM_si);
       printf("RECID is %d\n", recId);
@@ -150,6 +158,13 @@ void AM_PrintAttr(char *bufPtr, char attrType, int attrLength) {
     free(bufstr);
     break;
   }
+  case AM_KEY_BYTES: {
+    printf("ATTRIBUTE is ");
+    for (bufint = 0; bufint < attrLength; bufint++)
+      printf("%02x", (unsigned char)bufPtr[bufint]);
+    printf("\n");
+    break;
+  }
   }
 }
 
@@ -159,7 +174,6 @@ void AM_PrintTree(int fileDesc, int pageNum, char attrType) {
   AM_INTHEADER *header;
   char *tempPage;
   char *pageBuf;
-  int recSize;
   int i;
 
   printf("GETTING PAGE = %d\n", pageNum);
@@ -182,9 +196,8 @@ void AM_PrintTree(int fileDesc, int pageNum, char attrType) {
   if (header == NULL) { free(tempPage); return; }
 
   memcpy(header, tempPage, AM_sint);
-  recSize = header->attrLength + AM_si;
   for (i = 1; i <= (header->numKeys + 1); i++) {
-    memcpy(&nextPage, tempPage + AM_sint + (i - 1) * recSize, AM_si);
+    nextPage = AM_IntChild(tempPage, header, i - 1);
     AM_PrintTree(fileDesc, nextPage, attrType);
   }
   printf("PAGENUM = %d", pageNum);
@@ -1,239 +1,234 @@
 #include "am.h"
 
-/* The structure of the scan Table */
-struct {
-  int fileDesc;
-  int op;
-  int attrType;
-  int pageNum;
-  short index;
-  short actindex;
-  int nextpageNum;
-  char nextvalue[AM_MAXATTRLENGTH];
-  short nextIndex;
-  short nextRecIdPtr;
-  int lastpageNum;
-  short lastIndex;
-  int status;
-} AM_scanTable[MAXSCANS];
-
-/* Opens an index scan */
-int AM_OpenIndexScan(int fileDesc, char attrType, int attrLength, int op,
-                     char *value) {
-  int scanDesc; /* index into scan table */
+/* Puts scan sh at the start of the recIds of the index'th key of leaf
+pageBuf: the head of its list, or a first batch of its posting list */
+static int AM_ScanStart(AM_ScanHandle *sh, char *pageBuf, int index) {
+  AM_LEAFHEADER header;
+
+  memcpy(&header, pageBuf, AM_sl);
+  sh->nextRecIdPtr = AM_LeafList(pageBuf, index);
+  sh->batchLen = 0;
+  sh->batchPos = 0;
+  sh->batchMore = FALSE;
+  sh->listPage = AM_NULL_PAGE;
+  if (header.postings && index >= 1 && index <= header.numKeys)
+    return (AM_PostingFill(sh, pageBuf, index, FALSE));
+  return (AME_OK);
+}
+
+/* Opens a scan of the index ih in *sh, of the keys that stand in
+relation op to value (all keys if value is NULL) */
+static int AM_OpenScan(AM_IndexHandle *ih, AM_ScanHandle *sh, int op,
+                       char *value) {
   int status;   /* whether value is found or not in the tree */
   int index;    /* index of value in leaf */
   int pageNum;  /* page number of leaf page where value is found */
-  int recSize;  /* size of key,ptr pair in leaf */
   char *pageBuf; /* buffer for page */
   int errVal;    /* return value of functions */
   AM_LEAFHEADER head, *header; /* local header */
   int searchpageNum;
+  int leftPageNum = AM_NULL_PAGE; /* leftmost leaf */
+  int fileDesc;
 
   /* check the parameters */
-  if (fileDesc < 0) {
+  if (ih == NULL || ih->fileDesc < 0) {
     AM_Errno = AME_FD;
     return (AME_FD);
   }
-
-  if ((attrType != 'i') && (attrType != 'c') && (attrType != 'f')) {
-    AM_Errno = AME_INVALIDATTRTYPE;
-    return (AME_INVALIDATTRTYPE);
+  if (sh == NULL) {
+    AM_Errno = AME_INVALID_SCANDESC;
+    return (AME_INVALID_SCANDESC);
   }
+  fileDesc = ih->fileDesc;
 
   /* initialise header */
   header = &head;
 
-  /* find a vacant place in the scan table */
-  for (scanDesc = 0; scanDesc < MAXSCANS; scanDesc++) {
-    if (AM_scanTable[scanDesc].status == FREE)
-      break;
-  }
-
-  /* scan table is full */
-  if (scanDesc > MAXSCANS - 1) {
-    AM_Errno = AME_SCAN_TAB_FULL;
-    return (AME_SCAN_TAB_FULL);
+  sh->ih = ih;
+  sh->status = FIRST;
+  sh->batchLen = 0;
+  sh->batchPos = 0;
+
+  /* find the leftmost leaf, for the scans that start there */
+  if ((value == NULL) || (op == LESS_THAN) || (op == LESS_THAN_EQUAL) ||
+      (op == NOT_EQUAL)) {
+    leftPageNum = GetLeftPageNum(ih);
+    if (leftPageNum < 0) {
+      sh->status = FREE;
+      return (leftPageNum);
+    }
   }
 
-  /* there is room */
-  AM_scanTable[scanDesc].status = FIRST;
-  AM_scanTable[scanDesc].attrType = attrType;
-
-  /* initialise AM_LeftPageNum */
-  AM_LeftPageNum = GetLeftPageNum(fileDesc);
-
   /* scan of all keys */
   if (value == NULL) {
-    AM_scanTable[scanDesc].fileDesc = fileDesc;
-    AM_scanTable[scanDesc].op = ALL;
-    AM_scanTable[scanDesc].nextpageNum = AM_LeftPageNum;
-    AM_scanTable[scanDesc].nextIndex = 1;
-    AM_scanTable[scanDesc].actindex = 1;
-    errVal = PF_GetThisPage(fileDesc, AM_LeftPageNum, &pageBuf);
+    sh->op = ALL;
+    sh->nextpageNum = leftPageNum;
+    sh->nextIndex = 1;
+    sh->actindex = 1;
+    errVal = PF_GetThisPage(fileDesc, leftPageNum, &pageBuf);
+    AM_Check(errVal);
+    errVal = AM_ScanStart(sh, pageBuf, 1);
     AM_Check(errVal);
-    memcpy(&AM_scanTable[scanDesc].nextRecIdPtr, pageBuf + AM_sl + attrLength, AM_ss);
-    errVal = PF_UnfixPage(fileDesc, AM_LeftPageNum, FALSE);
+    errVal = PF_UnfixPage(fileDesc, leftPageNum, FALSE);
     AM_Check(errVal);
-    return (scanDesc);
+    return (AME_OK);
   }
 
-  /* search for the pagenumber and index of value */
-  status =
-      AM_Search(fileDesc, attrType, attrLength, value, &pageNum, &pageBuf, &index);
+  /* search for the pagenumber and index of value; a scan needs no path */
+  status = AM_Search(ih, value, NULL, &pageNum, &pageBuf, &index);
   searchpageNum = pageNum;
+
   /* check for errors */
   if (status < 0) {
-    AM_scanTable[scanDesc].status = FREE;
+    sh->status = FREE;
     AM_Errno = status;
     return (status);
   }
 
   memcpy(header, pageBuf, AM_sl);
-  recSize = attrLength + AM_ss;
-  AM_scanTable[scanDesc].fileDesc = fileDesc;
-  AM_scanTable[scanDesc].op = op;
+  sh->op = op;
 
   /* value is not in leaf but if inserted will have to be inserted after the last
   key */
   if (index > header->numKeys) {
     if (header->nextLeafPage != AM_NULL_PAGE) {
-      errVal = PF_GetThisPage(fileDesc, header->nextLeafPage, &pageBuf);
+      pageNum = header->nextLeafPage;
+      errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
       AM_Check(errVal);
       memcpy(header, pageBuf, AM_sl);
-      errVal = PF_UnfixPage(fileDesc, header->nextLeafPage, FALSE);
+      errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
       AM_Check(errVal);
-      pageNum = header->nextLeafPage;
       index = 1;
     } else {
       pageNum = AM_NULL_PAGE;
     }
   }
 
-  AM_scanTable[scanDesc].pageNum = pageNum;
-  AM_scanTable[scanDesc].index = index;
+  sh->pageNum = pageNum;
+  sh->index = index;
 
   /* case on op */
   switch (op) {
   case EQUAL: {
     /* value not in leaf - no match */
     if (status != AM_FOUND)
-      AM_scanTable[scanDesc].status = OVER;
+      sh->status = OVER;
     else {
-      AM_scanTable[scanDesc].nextpageNum = pageNum;
-      AM_scanTable[scanDesc].nextIndex = index;
-      AM_scanTable[scanDesc].actindex = index;
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + (index - 1) * recSize + attrLength, AM_ss);
-      AM_scanTable[scanDesc].lastpageNum = pageNum;
-      AM_scanTable[scanDesc].lastIndex = index;
+      sh->nextpageNum = pageNum;
+      sh->nextIndex = index;
+      sh->actindex = index;
+      errVal = AM_ScanStart(sh, pageBuf, index);
+      AM_Check(errVal);
+      sh->lastpageNum = pageNum;
+      sh->lastIndex = index;
     }
     break;
   }
   case LESS_THAN: {
-    AM_scanTable[scanDesc].nextpageNum = AM_LeftPageNum;
-    AM_scanTable[scanDesc].nextIndex = 1;
-    AM_scanTable[scanDesc].actindex = 1;
-    if (searchpageNum != AM_LeftPageNum) {
-      errVal = PF_GetThisPage(fileDesc, AM_LeftPageNum, &pageBuf);
+    sh->nextpageNum = leftPageNum;
+    sh->nextIndex = 1;
+    sh->actindex = 1;
+    if (searchpageNum != leftPageNum) {
+      errVal = PF_GetThisPage(fileDesc, leftPageNum, &pageBuf);
       AM_Check(errVal);
     }
-    memcpy(&AM_scanTable[scanDesc].nextRecIdPtr, pageBuf + AM_sl + attrLength,
-           AM_ss);
-    if (searchpageNum != AM_LeftPageNum) {
-      errVal = PF_UnfixPage(fileDesc, AM_LeftPageNum, FALSE);
+    errVal = AM_ScanStart(sh, pageBuf, 1);
+    AM_Check(errVal);
+    if (searchpageNum != leftPageNum) {
+      errVal = PF_UnfixPage(fileDesc, leftPageNum, FALSE);
       AM_Check(errVal);
     }
-    AM_scanTable[scanDesc].lastpageNum = pageNum;
-    AM_scanTable[scanDesc].lastIndex = index - 1;
+    sh->lastpageNum = pageNum;
+    sh->lastIndex = index - 1;
     break;
   }
   case GREATER_THAN: {
     if (status == AM_FOUND) {
       if ((index + 1) <= (header->numKeys)) {
-        AM_scanTable[scanDesc].nextpageNum = pageNum;
-        AM_scanTable[scanDesc].nextIndex = index + 1;
-        AM_scanTable[scanDesc].actindex = index + 1;
-        memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-               pageBuf + AM_sl + (index)*recSize + attrLength, AM_ss);
+        sh->nextpageNum = pageNum;
+        sh->nextIndex = index + 1;
+        sh->actindex = index + 1;
+        errVal = AM_ScanStart(sh, pageBuf, index + 1);
+        AM_Check(errVal);
       } else {
           /* got to start from next leaf page */
           if (header->nextLeafPage != AM_NULL_PAGE) {
-            AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
-            AM_scanTable[scanDesc].nextIndex = 1;
-            AM_scanTable[scanDesc].actindex = 1;
+            sh->nextpageNum = header->nextLeafPage;
+            sh->nextIndex = 1;
+            sh->actindex = 1;
             errVal =
                 PF_GetThisPage(fileDesc, header->nextLeafPage, &pageBuf);
             AM_Check(errVal);
-            memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-                   pageBuf + AM_sl + attrLength, AM_ss);
+            errVal = AM_ScanStart(sh, pageBuf, 1);
+            AM_Check(errVal);
             errVal = PF_UnfixPage(fileDesc, header->nextLeafPage, FALSE);
             AM_Check(errVal);
           } else { /* Nextleafpage is not last NULL page */
-            AM_scanTable[scanDesc].status = OVER;
+            sh->status = OVER;
           }
       }
     } else /* status == AM_NOT_FOUND */
     {
-      AM_scanTable[scanDesc].nextpageNum = pageNum;
-      AM_scanTable[scanDesc].nextIndex = index;
-      AM_scanTable[scanDesc].actindex = index;
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + (index - 1) * recSize + attrLength, AM_ss);
+      sh->nextpageNum = pageNum;
+      sh->nextIndex = index;
+      sh->actindex = index;
+      errVal = AM_ScanStart(sh, pageBuf, index);
+      AM_Check(errVal);
     }
     break;
   }
   case LESS_THAN_EQUAL: {
-    AM_scanTable[scanDesc].nextpageNum = AM_LeftPageNum;
-    AM_scanTable[scanDesc].nextIndex = 1;
-    AM_scanTable[scanDesc].actindex = 1;
-    if (searchpageNum != AM_LeftPageNum) {
-      errVal = PF_GetThisPage(fileDesc, AM_LeftPageNum, &pageBuf);
+    sh->nextpageNum = leftPageNum;
+    sh->nextIndex = 1;
+    sh->actindex = 1;
+    if (searchpageNum != leftPageNum) {
+      errVal = PF_GetThisPage(fileDesc, leftPageNum, &pageBuf);
       AM_Check(errVal);
     }
-    memcpy(&AM_scanTable[scanDesc].nextRecIdPtr, pageBuf + AM_sl + attrLength,
-           AM_ss);
-    if (searchpageNum != AM_LeftPageNum) {
-      errVal = PF_UnfixPage(fileDesc, AM_LeftPageNum, FALSE);
+    errVal = AM_ScanStart(sh, pageBuf, 1);
+    AM_Check(errVal);
+    if (searchpageNum != leftPageNum) {
+      errVal = PF_UnfixPage(fileDesc, leftPageNum, FALSE);
       AM_Check(errVal);
     }
-    AM_scanTable[scanDesc].lastpageNum = pageNum;
+    sh->lastpageNum = pageNum;
     if (status == AM_FOUND)
-      AM_scanTable[scanDesc].lastIndex = index;
+      sh->lastIndex = index;
     else
-      AM_scanTable[scanDesc].lastIndex = index - 1;
+      sh->lastIndex = index - 1;
     break;
   }
   case GREATER_THAN_EQUAL: {
-    AM_scanTable[scanDesc].nextpageNum = pageNum;
-    AM_scanTable[scanDesc].nextIndex = index;
-    AM_scanTable[scanDesc].actindex = index;
-    memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-           pageBuf + AM_sl + (index - 1) * recSize + attrLength, AM_ss);
+    sh->nextpageNum = pageNum;
+    sh->nextIndex = index;
+    sh->actindex = index;
+    errVal = AM_ScanStart(sh, pageBuf, index);
+    AM_Check(errVal);
     break;
   }
   case NOT_EQUAL: {
     if (status == AM_FOUND) {
-      AM_scanTable[scanDesc].nextpageNum = AM_LeftPageNum;
-      AM_scanTable[scanDesc].nextIndex = 1;
-      AM_scanTable[scanDesc].actindex = 1;
-      if (searchpageNum != AM_LeftPageNum) {
-        errVal = PF_GetThisPage(fileDesc, AM_LeftPageNum, &pageBuf);
+      sh->nextpageNum = leftPageNum;
+      sh->nextIndex = 1;
+      sh->actindex = 1;
+      if (searchpageNum != leftPageNum) {
+        errVal = PF_GetThisPage(fileDesc, leftPageNum, &pageBuf);
         AM_Check(errVal);
       }
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + attrLength, AM_ss);
-      if (searchpageNum != AM_LeftPageNum) {
-        errVal = PF_UnfixPage(fileDesc, AM_LeftPageNum, FALSE);
+      errVal = AM_ScanStart(sh, pageBuf, 1);
+      AM_Check(errVal);
+      if (searchpageNum != leftPageNum) {
+        errVal = PF_UnfixPage(fileDesc, leftPageNum, FALSE);
         AM_Check(errVal);
       }
     } else {
-      AM_scanTable[scanDesc].pageNum = AM_NULL_PAGE;
+      sh->pageNum = AM_NULL_PAGE;
     }
     break;
   }
   default: {
-    AM_scanTable[scanDesc].status = FREE;
+    sh->status = FREE;
+    PF_UnfixPage(fileDesc, searchpageNum, FALSE);
     AM_Errno = AME_INVALID_OP_TO_SCAN;
     return (AME_INVALID_OP_TO_SCAN);
   }
@@ -241,73 +236,81 @@ int AM_OpenIndexScan(int fileDesc, char attrType, int attrLength, int op,
 
   errVal = PF_UnfixPage(fileDesc, searchpageNum, FALSE);
   AM_Check(errVal);
-  return (scanDesc);
+  return (AME_OK);
+}
+
+int AM_OpenIndexScan(AM_IndexHandle *ih, AM_ScanHandle *sh, int op,
+                     char *value) {
+  int errVal;
+
+  AM_LatchPool();
+  errVal = AM_OpenScan(ih, sh, op, value);
+  AM_UnlatchPool();
+  return (errVal);
 }
 
 /* returns the record id of the next record that satisfies the conditions
-specified for index scan associated with scanDesc */
-int AM_FindNextEntry(int scanDesc) {
+specified for the index scan sh */
+static int AM_NextEntry(AM_ScanHandle *sh) {
   int recId;         /* recordId to be returned */
   char *pageBuf;     /* buffer for page */
   int errVal;        /* return value for functions */
   AM_LEAFHEADER head, *header; /* local header */
-  int recSize;       /* size of key,ptr pair for leaf */
+  char key[AM_MAXATTRLENGTH]; /* key at the scan position */
   int compareVal;    /* value returned by compare routine */
+  int over;          /* TRUE once the key's recIds are all returned */
 
-  /* check if scanDesc is valid */
-  if ((scanDesc < 0) || (scanDesc > MAXSCANS - 1)) {
+  /* check if the scan is open */
+  if ((sh == NULL) || (sh->status == FREE)) {
     AM_Errno = AME_INVALID_SCANDESC;
     return (AME_INVALID_SCANDESC);
   }
 
   /* check if scan is over */
-  if (AM_scanTable[scanDesc].status == OVER)
+  if (sh->status == OVER)
     return (AME_EOF);
 
-  if (AM_scanTable[scanDesc].nextpageNum == AM_NULL_PAGE) {
-    AM_scanTable[scanDesc].status = OVER;
+  /* inside a batch of a posting list the leaf need not be read: only
+  the first and last recIds of a batch move the scan on */
+  if (sh->batchPos > 0 && sh->batchPos < sh->batchLen - 1)
+    return (sh->batch[sh->batchPos++]);
+
+  if (sh->nextpageNum == AM_NULL_PAGE) {
+    sh->status = OVER;
     return (AME_EOF);
   }
 
   header = &head;
-  errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
-                          AM_scanTable[scanDesc].nextpageNum, &pageBuf);
+  errVal = PF_GetThisPage(sh->ih->fileDesc,
+                          sh->nextpageNum, &pageBuf);
   AM_Check(errVal);
 
   memcpy(header, pageBuf, AM_sl);
-  recSize = header->attrLength + AM_ss;
 
   /* Get next non empty leaf page */
   while (header->numKeys == 0) {
     if (header->nextLeafPage == AM_NULL_PAGE) {
-      AM_scanTable[scanDesc].status = OVER;
-      fprintf(stderr, "DEBUG AM_FindNextEntry -> PF_UnfixPage: scanDesc=%d fd=%d unfixing nextpageNum=%d pageNum=%d\n",
-          scanDesc, AM_scanTable[scanDesc].fileDesc,
-          AM_scanTable[scanDesc].nextpageNum, AM_scanTable[scanDesc].pageNum);
-        fprintf(stderr, "DEBUG AM_FindNextEntry -> PF_UnfixPage: scanDesc=%d fd=%d unfixing header->nextLeafPage=%d\n",
-                scanDesc, AM_scanTable[scanDesc].fileDesc, header->nextLeafPage);
-        errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                      header->nextLeafPage, FALSE);
+      sh->status = OVER;
+      errVal = PF_UnfixPage(sh->ih->fileDesc,
+                            sh->nextpageNum, FALSE);
         AM_Check(errVal);
       return (AME_EOF);
     } else {
-      int prevPageNum = AM_scanTable[scanDesc].nextpageNum;
-      AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
-      errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc, prevPageNum, FALSE);
+      int prevPageNum = sh->nextpageNum;
+      sh->nextpageNum = header->nextLeafPage;
+      errVal = PF_UnfixPage(sh->ih->fileDesc, prevPageNum, FALSE);
       AM_Check(errVal);
       
-      errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
-                              AM_scanTable[scanDesc].nextpageNum, &pageBuf);
+      errVal = PF_GetThisPage(sh->ih->fileDesc,
+                              sh->nextpageNum, &pageBuf);
       AM_Check(errVal);
       
-      AM_scanTable[scanDesc].nextIndex = 1;
-      AM_scanTable[scanDesc].actindex = 1;
+      sh->nextIndex = 1;
+      sh->actindex = 1;
       memcpy(header, pageBuf, AM_sl);
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize +
-                 header->attrLength,
-             AM_ss);
-      AM_scanTable[scanDesc].status = FIRST;
+      errVal = AM_ScanStart(sh, pageBuf, sh->nextIndex);
+      AM_Check(errVal);
+      sh->status = FIRST;
     }
   }
     
@@ -319,55 +322,48 @@ int AM_FindNextEntry(int scanDesc) {
   
   /* if op is < or <= check if you are done - might have overshot while scanning
   empty pages*/
-  if ((AM_scanTable[scanDesc].op == LESS_THAN) ||
-      (AM_scanTable[scanDesc].op == LESS_THAN_EQUAL)) {
-    if ((AM_scanTable[scanDesc].lastpageNum <=
-         AM_scanTable[scanDesc].nextpageNum) &&
-        (AM_scanTable[scanDesc].lastIndex == 0)) {
-        AM_scanTable[scanDesc].status = OVER;
-        fprintf(stderr, "DEBUG AM_FindNextEntry -> PF_UnfixPage: scanDesc=%d fd=%d unfixing nextpageNum=%d pageNum=%d\n",
-          scanDesc, AM_scanTable[scanDesc].fileDesc,
-          AM_scanTable[scanDesc].nextpageNum, AM_scanTable[scanDesc].pageNum);
-        fprintf(stderr, "DEBUG AM_FindNextEntry -> PF_UnfixPage: scanDesc=%d fd=%d unfixing header->nextLeafPage=%d\n",
-                scanDesc, AM_scanTable[scanDesc].fileDesc, header->nextLeafPage);
-        errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                      header->nextLeafPage, FALSE);
+  if ((sh->op == LESS_THAN) ||
+      (sh->op == LESS_THAN_EQUAL)) {
+    if ((sh->lastpageNum <=
+         sh->nextpageNum) &&
+        (sh->lastIndex == 0)) {
+        sh->status = OVER;
+        errVal = PF_UnfixPage(sh->ih->fileDesc,
+                              sh->nextpageNum, FALSE);
         AM_Check(errVal);
         return (AME_EOF);
     }
   }
 
   /* if op is not equal then check if we have to skip this value */
-  if (AM_scanTable[scanDesc].op == NOT_EQUAL) {
-    if ((AM_scanTable[scanDesc].pageNum ==
-         AM_scanTable[scanDesc].nextpageNum) &&
-        (AM_scanTable[scanDesc].index == AM_scanTable[scanDesc].actindex)) {
+  if (sh->op == NOT_EQUAL) {
+    if ((sh->pageNum ==
+         sh->nextpageNum) &&
+        (sh->index == sh->actindex)) {
       /*skip this value */
-      if ((AM_scanTable[scanDesc].nextIndex + 1) <= (header->numKeys)) {
-        AM_scanTable[scanDesc].nextIndex++;
-        AM_scanTable[scanDesc].actindex++;
-        memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-               pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize +
-                   header->attrLength,
-               AM_ss);
+      if ((sh->nextIndex + 1) <= (header->numKeys)) {
+        sh->nextIndex++;
+        sh->actindex++;
+        errVal = AM_ScanStart(sh, pageBuf, sh->nextIndex);
+        AM_Check(errVal);
       } else if (header->nextLeafPage == AM_NULL_PAGE) {
-        errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                              AM_scanTable[scanDesc].nextpageNum, FALSE);
+        errVal = PF_UnfixPage(sh->ih->fileDesc,
+                              sh->nextpageNum, FALSE);
         AM_Check(errVal);
         return (AME_EOF);
       } else {
-        errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                              AM_scanTable[scanDesc].nextpageNum, FALSE);
+        errVal = PF_UnfixPage(sh->ih->fileDesc,
+                              sh->nextpageNum, FALSE);
         AM_Check(errVal);
         
-        AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
-        AM_scanTable[scanDesc].nextIndex = 1;
-        AM_scanTable[scanDesc].actindex = 1;
-        errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
+        sh->nextpageNum = header->nextLeafPage;
+        sh->nextIndex = 1;
+        sh->actindex = 1;
+        errVal = PF_GetThisPage(sh->ih->fileDesc,
                                 header->nextLeafPage, &pageBuf);
         AM_Check(errVal);
-        memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-               pageBuf + AM_sl + header->attrLength, AM_ss);
+        errVal = AM_ScanStart(sh, pageBuf, 1);
+        AM_Check(errVal);
         memcpy(header, pageBuf, AM_sl);
       }
     }
@@ -375,130 +371,169 @@ int AM_FindNextEntry(int scanDesc) {
       
   /* if not the first call to findnextentry , check if previous record has
   been deleted */
-  if (AM_scanTable[scanDesc].status != FIRST) {
-    compareVal = AM_Compare(
-        pageBuf + (AM_scanTable[scanDesc].nextIndex - 1) * recSize + AM_sl,
-        AM_scanTable[scanDesc].attrType, header->attrLength,
-        AM_scanTable[scanDesc].nextvalue);
+  if (sh->status != FIRST) {
+    AM_LeafKey(pageBuf, header, sh->nextIndex, key);
+    compareVal = sh->ih->keyType.compare(key, sh->nextvalue, header->attrLength);
     if (compareVal != 0) {
       /* prev record deleted */
-      AM_scanTable[scanDesc].nextIndex--;
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize +
-                 header->attrLength,
-             AM_ss);
+      sh->nextIndex--;
+      if (!header->postings) {
+        sh->nextRecIdPtr = AM_LeafList(pageBuf, sh->nextIndex);
+      } else {
+        /* the batch stays; if the whole key is gone, it is the last */
+        if (sh->nextIndex >= 1)
+          AM_LeafKey(pageBuf, header, sh->nextIndex, key);
+        if (sh->nextIndex < 1 ||
+            sh->ih->keyType.compare(key, sh->nextvalue, header->attrLength) != 0)
+          sh->batchMore = FALSE;
+      }
     }
   } else {
     /* make the status busy - no more the first call */
-    AM_scanTable[scanDesc].status = BUSY;
-    memcpy(AM_scanTable[scanDesc].nextvalue,
-           pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize,
-           header->attrLength);
+    sh->status = BUSY;
+    AM_LeafKey(pageBuf, header, sh->nextIndex, sh->nextvalue);
   }
 
-  /* copy the recId to be returned */
-  memcpy(&recId, pageBuf + AM_scanTable[scanDesc].nextRecIdPtr, AM_si);
+  if (header->postings) {
+    /* the next of the batch, and another batch after the last */
+    recId = sh->batch[sh->batchPos++];
+    over = (sh->batchPos == sh->batchLen);
+    if (over && sh->batchMore) {
+      errVal = AM_PostingFill(sh, pageBuf, sh->nextIndex, TRUE);
+      AM_Check(errVal);
+      over = (sh->batchLen == 0);
+    }
+  } else {
+    /* copy the recId to be returned */
+    memcpy(&recId, pageBuf + sh->nextRecIdPtr, AM_si);
 
-  /* copy the place for next recId */
-  memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-         pageBuf + AM_scanTable[scanDesc].nextRecIdPtr + AM_si, AM_ss);
+    /* copy the place for next recId */
+    memcpy(&sh->nextRecIdPtr,
+           pageBuf + sh->nextRecIdPtr + AM_si, AM_ss);
+    over = (sh->nextRecIdPtr == (short)0);
+  }
 
   /* check if this keys list is over */
-  if (AM_scanTable[scanDesc].nextRecIdPtr == (short)0) {
-    if ((AM_scanTable[scanDesc].nextIndex + 1) <= (header->numKeys)) {
-      AM_scanTable[scanDesc].nextIndex++;
-      AM_scanTable[scanDesc].actindex++;
-      memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-             pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize +
-                 header->attrLength,
-             AM_ss);
-      memcpy(AM_scanTable[scanDesc].nextvalue,
-             pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize,
-             header->attrLength);
+  if (over) {
+    if ((sh->nextIndex + 1) <= (header->numKeys)) {
+      sh->nextIndex++;
+      sh->actindex++;
+      errVal = AM_ScanStart(sh, pageBuf, sh->nextIndex);
+      AM_Check(errVal);
+      AM_LeafKey(pageBuf, header, sh->nextIndex, sh->nextvalue);
     } else {
         /* got to go to next page */
         if (header->nextLeafPage == AM_NULL_PAGE) {
-          AM_scanTable[scanDesc].status = OVER;
+          sh->status = OVER;
         } else {
-          AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
-          AM_scanTable[scanDesc].nextIndex = 1;
-          AM_scanTable[scanDesc].actindex = 1;
-          
           /* Unfix the current page before getting the next one */
-          errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                                AM_scanTable[scanDesc].nextpageNum, FALSE);
+          errVal = PF_UnfixPage(sh->ih->fileDesc,
+                                sh->nextpageNum, FALSE);
           AM_Check(errVal);
+
+          sh->nextpageNum = header->nextLeafPage;
+          sh->nextIndex = 1;
+          sh->actindex = 1;
           
-          errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
+          errVal = PF_GetThisPage(sh->ih->fileDesc,
                                   header->nextLeafPage, &pageBuf);
           AM_Check(errVal);
           
-          memcpy(&AM_scanTable[scanDesc].nextRecIdPtr,
-                 pageBuf + AM_sl + header->attrLength, AM_ss);
+          errVal = AM_ScanStart(sh, pageBuf, 1);
+          AM_Check(errVal);
           
-          memcpy(AM_scanTable[scanDesc].nextvalue,
-                 pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex - 1) * recSize,
-                 header->attrLength);
           memcpy(header, pageBuf, AM_sl);
+          AM_LeafKey(pageBuf, header, sh->nextIndex, sh->nextvalue);
         }
     }
   }
 
   /* If op is equal then see if you are done */
-  if (AM_scanTable[scanDesc].op == EQUAL) {
-    if ((AM_scanTable[scanDesc].pageNum !=
-         AM_scanTable[scanDesc].nextpageNum) ||
-        (AM_scanTable[scanDesc].index != AM_scanTable[scanDesc].actindex))
-      AM_scanTable[scanDesc].status = OVER;
+  if (sh->op == EQUAL) {
+    if ((sh->pageNum !=
+         sh->nextpageNum) ||
+        (sh->index != sh->actindex))
+      sh->status = OVER;
   }
 
   /* see if you are at the last record if op is < or <= */
-  if ((AM_scanTable[scanDesc].op == LESS_THAN) ||
-      (AM_scanTable[scanDesc].op == LESS_THAN_EQUAL)) {
-    if ((AM_scanTable[scanDesc].lastpageNum ==
-         AM_scanTable[scanDesc].nextpageNum) &&
-        (AM_scanTable[scanDesc].lastIndex == AM_scanTable[scanDesc].actindex)) {
-      AM_scanTable[scanDesc].status = LAST;
-    } else if ((AM_scanTable[scanDesc].lastpageNum ==
-              AM_scanTable[scanDesc].nextpageNum) &&
-             (AM_scanTable[scanDesc].lastIndex <
-              AM_scanTable[scanDesc].actindex)) {
-      AM_scanTable[scanDesc].status = OVER;
-    } else if (AM_scanTable[scanDesc].status == LAST) {
-      AM_scanTable[scanDesc].status = OVER;
+  if ((sh->op == LESS_THAN) ||
+      (sh->op == LESS_THAN_EQUAL)) {
+    if ((sh->lastpageNum ==
+         sh->nextpageNum) &&
+        (sh->lastIndex == sh->actindex)) {
+      sh->status = LAST;
+    } else if ((sh->lastpageNum ==
+              sh->nextpageNum) &&
+             (sh->lastIndex <
+              sh->actindex)) {
+      sh->status = OVER;
+    } else if (sh->status == LAST) {
+      sh->status = OVER;
     }
   }
 
   /* Unfix the page before returning */
-  errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,
-                        AM_scanTable[scanDesc].nextpageNum, FALSE);
+  errVal = PF_UnfixPage(sh->ih->fileDesc,
+                        sh->nextpageNum, FALSE);
   AM_Check(errVal);
   
   return (recId);
 }
 
+int AM_FindNextEntry(AM_ScanHandle *sh) {
+  int recId;
+
+  AM_LatchPool();
+  recId = AM_NextEntry(sh);
+  AM_UnlatchPool();
+  return (recId);
+}
+
 /* terminates an index scan */
-int AM_CloseIndexScan(int scanDesc) {
-  if ((scanDesc < 0) || (scanDesc > MAXSCANS - 1)) {
+int AM_CloseIndexScan(AM_ScanHandle *sh) {
+  if ((sh == NULL) || (sh->status == FREE)) {
     AM_Errno = AME_INVALID_SCANDESC;
     return (AME_INVALID_SCANDESC);
   }
-  AM_scanTable[scanDesc].status = FREE;
+  sh->status = FREE;
   return (AME_OK);
 }
 
-int GetLeftPageNum(int fileDesc) {
+/* finds the leftmost leaf by following the first pointer of each node
+from the root down */
+int GetLeftPageNum(AM_IndexHandle *ih) {
   char *pageBuf;
   int pageNum;
+  int child;
   int errVal;
+  int fileDesc = ih->fileDesc;
+  AM_CACHEDNODE *node; /* cached copy of the current node, NULL if it is fixed */
 
-  errVal = PF_GetFirstPage(fileDesc, &pageNum, &pageBuf);
-  AM_Check(errVal);
-  if (*pageBuf == 'l')
-    AM_LeftPageNum = pageNum;
-  else
-    AM_LeftPageNum = 2;
+  node = AM_NodeCacheRoot(ih, &pageNum);
+  if (node != NULL) {
+    pageBuf = AM_NodeCachePage(node);
+  } else {
+    pageNum = ih->rootPageNum;
+    errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
+    AM_Check(errVal);
+  }
+  while (*pageBuf != 'l') {
+    memcpy(&child, pageBuf + AM_sint, AM_si);
+    if (node == NULL) {
+      errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
+      AM_Check(errVal);
+    }
+    pageNum = child;
+    node = AM_NodeCacheGet(ih, pageNum);
+    if (node != NULL) {
+      pageBuf = AM_NodeCachePage(node);
+    } else {
+      errVal = PF_GetThisPage(fileDesc, pageNum, &pageBuf);
+      AM_Check(errVal);
+    }
+  }
   errVal = PF_UnfixPage(fileDesc, pageNum, FALSE);
   AM_Check(errVal);
-  return (AM_LeftPageNum);
+  return (pageNum);
 }
\ No newline at end of file
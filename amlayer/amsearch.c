@@ -1,38 +1,258 @@
 #include "am.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AM_HAVE_X86 1
+#endif
+
+/*
+ * Nodes of 'i' and 'f' keys are not searched by compare calls. Their
+ * keys sit a fixed stride apart (key and child pointer in an internal
+ * node, key and list head in a leaf), so a branchless binary search on
+ * typed loads narrows the node down to AM_SEARCH_WINDOW keys, and those
+ * are compared with the value all at once: gathered 8 at a time with
+ * AVX2, loaded 4 at a time for SSE, or one by one. What comes out is
+ * the number of keys below the value, which is where it is or belongs.
+ * A NaN float value still goes through the compare function.
+ */
+#define AM_SEARCH_WINDOW 16
+
+/* Level in use; -1 until the CPU has been asked */
+static _Atomic int AM_SearchLevelInUse = -1;
+
+/* Best level this CPU supports */
+static int AM_SearchLevelSupported(void) {
+#ifdef AM_HAVE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return (AM_SEARCH_AVX2);
+  if (__builtin_cpu_supports("sse4.2"))
+    return (AM_SEARCH_SSE);
+#endif
+  return (AM_SEARCH_SCALAR);
+}
+
+/* Limits the search of 'i' and 'f' nodes to level (the best the CPU
+supports is used by default) and returns the level now in effect */
+int AM_SetSearchLevel(int level) {
+  int best = AM_SearchLevelSupported();
+
+  if (level < AM_SEARCH_COMPARE)
+    level = AM_SEARCH_COMPARE;
+  AM_SearchLevelInUse = (level < best) ? level : best;
+  return (AM_SearchLevelInUse);
+}
+
+/* the level in use, asking the CPU the first time */
+static int AM_SearchLevel(void) {
+  int level = AM_SearchLevelInUse;
+
+  return (level < 0 ? AM_SetSearchLevel(AM_SEARCH_AVX2) : level);
+}
+
+/* the number of the n keys at keys, stride bytes apart, below value */
+static int AM_CountBelowScalar(char *keys, int stride, int n, char attrType,
+                               char *value) {
+  int i, key, val, count = 0;
+  float fkey, fval;
+
+  if (attrType == 'i') {
+    memcpy(&val, value, AM_si);
+    for (i = 0; i < n; i++) {
+      memcpy(&key, keys + i * stride, AM_si);
+      count += (key < val);
+    }
+  } else {
+    memcpy(&fval, value, AM_sf);
+    for (i = 0; i < n; i++) {
+      memcpy(&fkey, keys + i * stride, AM_sf);
+      count += (fkey < fval);
+    }
+  }
+  return (count);
+}
+
+#ifdef AM_HAVE_X86
+/* AM_CountBelowScalar, 4 keys at a time */
+__attribute__((target("sse4.2")))
+static int AM_CountBelowSse(char *keys, int stride, int n, char attrType,
+                            char *value) {
+  int lane[4];
+  int i, j, val, mask, count = 0;
+  float fval;
+  __m128i vi;
+  __m128 vf;
+
+  memcpy(&val, value, AM_si);
+  memcpy(&fval, value, AM_sf);
+  vi = _mm_set1_epi32(val);
+  vf = _mm_set1_ps(fval);
+  for (i = 0; i + 4 <= n; i += 4) {
+    for (j = 0; j < 4; j++)
+      memcpy(&lane[j], keys + (i + j) * stride, AM_si);
+    if (attrType == 'i')
+      mask = _mm_movemask_ps(_mm_castsi128_ps(
+          _mm_cmpgt_epi32(vi, _mm_loadu_si128((__m128i *)lane))));
+    else
+      mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps((float *)lane), vf));
+    count += __builtin_popcount(mask);
+  }
+  return (count + AM_CountBelowScalar(keys + i * stride, stride, n - i, attrType, value));
+}
+
+/* AM_CountBelowScalar, 8 keys at a time; lanes past n are not read */
+__attribute__((target("avx2")))
+static int AM_CountBelowAvx2(char *keys, int stride, int n, char attrType,
+                             char *value) {
+  __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i offsets = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stride));
+  __m256i vi, key, live, below;
+  __m256 vf;
+  int i, val, count = 0;
+  float fval;
+
+  memcpy(&val, value, AM_si);
+  memcpy(&fval, value, AM_sf);
+  vi = _mm256_set1_epi32(val);
+  vf = _mm256_set1_ps(fval);
+  for (i = 0; i < n; i += 8) {
+    live = _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), lanes);
+    key = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (int *)(keys + i * stride),
+                                      offsets, live, 1);
+    if (attrType == 'i')
+      below = _mm256_cmpgt_epi32(vi, key);
+    else
+      below = _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(key), vf, _CMP_LT_OQ));
+    count += __builtin_popcount(
+        _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(below, live))));
+  }
+  return (count);
+}
+#endif
+
+/* Number of the n sorted 'i' or 'f' keys at keys, stride bytes apart,
+that are below value; *found tells whether the next one equals it.
+Inlined into one search function per key type. */
+static inline __attribute__((always_inline)) int AM_SearchKeys(char *keys, int stride, int n, char attrType,
+                         char *value, int level, int *found) {
+  int first = 0, half, total = n;
+  int key, val;
+  float fkey, fval;
+
+  /* the answer stays within first .. first + n */
+  memcpy(&val, value, AM_si);
+  memcpy(&fval, value, AM_sf);
+  while (n > AM_SEARCH_WINDOW) {
+    half = n / 2;
+    if (attrType == 'i') {
+      memcpy(&key, keys + (first + half) * stride, AM_si);
+      first = (key < val) ? first + half : first;
+    } else {
+      memcpy(&fkey, keys + (first + half) * stride, AM_sf);
+      first = (fkey < fval) ? first + half : first;
+    }
+    n -= half;
+  }
+
+  /* the keys of the window below value, all compared at once */
+  keys += first * stride;
+  switch (level) {
+#ifdef AM_HAVE_X86
+  case AM_SEARCH_AVX2:
+    half = AM_CountBelowAvx2(keys, stride, n, attrType, value);
+    break;
+  case AM_SEARCH_SSE:
+    half = AM_CountBelowSse(keys, stride, n, attrType, value);
+    break;
+#endif
+  default:
+    half = AM_CountBelowScalar(keys, stride, n, attrType, value);
+  }
+
+  /* the window may end just before the key itself */
+  *found = FALSE;
+  if (first + half < total) {
+    if (attrType == 'i') {
+      memcpy(&key, keys + half * stride, AM_si);
+      *found = (key == val);
+    } else {
+      memcpy(&fkey, keys + half * stride, AM_sf);
+      *found = (fkey == fval);
+    }
+  }
+  return (first + half);
+}
+
+/* The typed searches of AM_KEYTYPE: AM_SearchKeys, or -1 to have the
+node searched through the compare function */
+static int AM_SearchIntKeys(char *keys, int stride, int n, char *value,
+                            int *found) {
+  int level = AM_SearchLevel();
+
+  if (level == AM_SEARCH_COMPARE)
+    return (-1);
+  return (AM_SearchKeys(keys, stride, n, 'i', value, level, found));
+}
+
+static int AM_SearchFloatKeys(char *keys, int stride, int n, char *value,
+                              int *found) {
+  int level = AM_SearchLevel();
+  float fval;
+
+  memcpy(&fval, value, AM_sf);
+  if (level == AM_SEARCH_COMPARE || fval != fval)
+    return (-1);
+  return (AM_SearchKeys(keys, stride, n, 'f', value, level, found));
+}
+
 /* searches for a key in a binary tree - returns FOUND or NOTFOUND and
 returns the pagenumber and the offset where key is present or could
-be inserted */
-int AM_Search(int fileDesc, char attrType, int attrLength, char *value,
-              int *pageNum, char **pageBuf, int *indexPtr) {
+be inserted. The internal nodes on the way are pushed onto path, unless
+it is NULL. */
+int AM_Search(AM_IndexHandle *ih, char *value, AM_STACK *path, int *pageNum,
+              char **pageBuf, int *indexPtr) {
   int errVal;
   int nextPage; /* next page to be followed on the path from root to leaf*/
+  int depth;    /* depth of the current node, 0 for the root */
+  int fixed;    /* whether the current page is fixed in the buffer */
+  AM_KEYTYPE *kt;
+  int attrLength;
+  AM_CACHEDNODE *node;   /* cached copy of the current node, or NULL */
+  AM_CACHEDNODE *parent; /* cached copy of its parent, or NULL */
   AM_LEAFHEADER lhead, *lheader; /* local pointer to leaf header */
   AM_INTHEADER ihead, *iheader;  /* local pointer to internal node header */
 
   /* initialise the headeers */
   lheader = &lhead;
   iheader = &ihead;
+  kt = &ih->keyType;
+  attrLength = ih->attrLength;
 
-  /* get the root of the B+ tree */
-  errVal = PF_GetFirstPage(fileDesc, pageNum, pageBuf);
-  AM_Check(errVal);
-  
-  AM_RootPageNum = *pageNum; /* Save root page num */
+  /* get the root of the B+ tree, from the node cache if it is there */
+  node = AM_NodeCacheRoot(ih, pageNum);
+  fixed = (node == NULL);
+  if (!fixed) {
+    *pageBuf = AM_NodeCachePage(node);
+  } else {
+    *pageNum = ih->rootPageNum;
+    errVal = PF_GetThisPage(ih->fileDesc, *pageNum, pageBuf);
+    AM_Check(errVal);
+  }
 
   if (**pageBuf == 'l')
   /* if root is a leaf page */
   {
     memcpy(lheader, *pageBuf, AM_sl);
     if (lheader->attrLength != attrLength) {
-      PF_UnfixPage(fileDesc, *pageNum, FALSE); /* Unfix before returning */
+      PF_UnfixPage(ih->fileDesc, *pageNum, FALSE); /* Unfix before returning */
       return (AME_INVALIDATTRLENGTH);
     }
   } else /* root is not a leaf */
   {
     memcpy(iheader, *pageBuf, AM_sint);
     if (iheader->attrLength != attrLength) {
-      PF_UnfixPage(fileDesc, *pageNum, FALSE); /* Unfix before returning */
+      if (fixed)
+        PF_UnfixPage(ih->fileDesc, *pageNum, FALSE); /* Unfix before returning */
       return (AME_INVALIDATTRLENGTH);
     }
   }
@@ -40,28 +260,44 @@ int AM_Search(int fileDesc, char attrType, int attrLength, char *value,
   /* * find the leaf at which key is present or can be inserted.
    * The stack should only contain the path of *internal* nodes.
    */
+  depth = 0;
+  parent = NULL;
   while ((**pageBuf) != 'l') {
     
+    /* offer the node cache a copy of a node read through the PF layer */
+    if (fixed)
+      node = AM_NodeCacheAdd(ih, *pageNum, depth, *pageBuf, parent, *indexPtr);
+
     /* find the next page to be followed */
     /* We use iheader here. It's correct for the *current* page. */
     nextPage =
-        AM_BinSearch(*pageBuf, attrType, attrLength, value, indexPtr, iheader);
+        AM_BinSearch(*pageBuf, kt, value, indexPtr, iheader);
 
     /*
      * ========================================================
      * BUG FIX: Push the *PARENT* (which is an internal node)
      * ========================================================
      */
-    AM_PushStack(*pageNum, *indexPtr);
+    if (path != NULL && AM_PushStack(path, *pageNum, *indexPtr) != AME_OK) {
+      if (fixed)
+        PF_UnfixPage(ih->fileDesc, *pageNum, FALSE);
+      return (AME_INTERROR);
+    }
 
-    errVal = PF_UnfixPage(fileDesc, *pageNum, FALSE);
-    AM_Check(errVal);
+    if (fixed) {
+      errVal = PF_UnfixPage(ih->fileDesc, *pageNum, FALSE);
+      AM_Check(errVal);
+    }
 
     /* set pageNum to the next page to be followed */
     *pageNum = nextPage;
+    depth++;
 
-    /* Get the next page to be followed */
-    errVal = PF_GetThisPage(fileDesc, *pageNum, pageBuf);
+    /* Get the next page to be followed: through the swizzled pointer of
+    a cached node, from the node cache or from the buffer */
+    parent = node;
+    errVal = AM_NodeCacheFollow(ih, parent, *indexPtr, *pageNum, &node,
+                                pageBuf, &fixed);
     
     /*
      * ========================================================
@@ -78,39 +314,131 @@ int AM_Search(int fileDesc, char attrType, int attrLength, char *value,
       /* if next page is a leaf */
       memcpy(lheader, *pageBuf, AM_sl);
       if (lheader->attrLength != attrLength) {
-        PF_UnfixPage(fileDesc, *pageNum, FALSE);
+        PF_UnfixPage(ih->fileDesc, *pageNum, FALSE);
         return (AME_INVALIDATTRLENGTH);
       }
     } else {
       /* if next page is an internal node */
       memcpy(iheader, *pageBuf, AM_sint); /* This updates iheader for the next loop iter */
       if (iheader->attrLength != attrLength) {
-        PF_UnfixPage(fileDesc, *pageNum, FALSE);
+        if (fixed)
+          PF_UnfixPage(ih->fileDesc, *pageNum, FALSE);
         return (AME_INVALIDATTRLENGTH);
       }
     }
   }
   /* find whether key is in leaf or not */
-  return (AM_SearchLeaf(*pageBuf, attrType, attrLength, value, indexPtr, lheader));
+  return (AM_SearchLeaf(*pageBuf, kt, value, indexPtr, lheader));
+}
+
+/* Compressed nodes (amprefix.c): value, canonical and vlen bytes long
+without its trailing zeros, against a key stored as its first len bytes */
+static int AM_ComparePrefix(char *key, int len, char *value, int vlen) {
+  int compareVal = memcmp(value, key, len);
+
+  return (compareVal != 0 ? compareVal : (vlen > len));
+}
+
+/* AM_BinSearch of a compressed node */
+static int AM_BinSearchPacked(char *pageBuf, AM_KEYTYPE *kt, char *value,
+                              int *indexPtr, AM_INTHEADER *header) {
+  char canon[AM_MAXATTRLENGTH];
+  char *key;
+  int low, high, mid, len, vlen, compareVal;
+
+  vlen = AM_CanonKey(kt, value, canon);
+  low = 0;
+  high = header->numKeys - 1;
+  while (low <= high) {
+    mid = (low + high) / 2;
+    key = AM_IntKey(pageBuf, kt->attrLength, mid, &len);
+    compareVal = AM_ComparePrefix(key, len, canon, vlen);
+    if (compareVal == 0) {
+      *indexPtr = mid + 1;
+      return (AM_IntChild(pageBuf, header, mid + 1));
+    } else if (compareVal < 0) {
+      high = mid - 1;
+    } else {
+      low = mid + 1;
+    }
+  }
+  *indexPtr = low;
+  return (AM_IntChild(pageBuf, header, low));
+}
+
+/* AM_SearchLeaf of a compressed leaf: a value without the prefix of its
+keys is before or after all of them; otherwise only the bytes after the
+prefix are compared */
+static int AM_SearchLeafPacked(char *pageBuf, AM_KEYTYPE *kt, char *value,
+                               int *indexPtr, AM_LEAFHEADER *header) {
+  char canon[AM_MAXATTRLENGTH];
+  int low, high, mid, vlen, compareVal;
+  int p = header->prefixLength;
+  int w = header->keyWidth;
+
+  low = 0;
+  high = header->numKeys - 1;
+  if (high < 0) {
+    *indexPtr = 1;
+    return (AM_NOT_FOUND);
+  }
+
+  vlen = AM_CanonKey(kt, value, canon) - p;
+  compareVal = memcmp(canon, pageBuf + PF_PAGE_SIZE - p, p);
+  if (compareVal != 0) {
+    *indexPtr = (compareVal < 0) ? 1 : header->numKeys + 1;
+    return (AM_NOT_FOUND);
+  }
+  if (vlen < 0)
+    vlen = 0;
+
+  while (low <= high) {
+    mid = (low + high) / 2;
+    compareVal = AM_ComparePrefix(pageBuf + AM_sl + mid * (w + AM_ss), w, canon + p, vlen);
+    if (compareVal == 0) {
+      *indexPtr = mid + 1;
+      return (AM_FOUND);
+    } else if (compareVal < 0) {
+      high = mid - 1;
+    } else {
+      low = mid + 1;
+    }
+  }
+  *indexPtr = low + 1;
+  return (AM_NOT_FOUND);
 }
 
 /* Finds the place (index) from where the next page to be followed is got*/
-int AM_BinSearch(char *pageBuf, char attrType, int attrLength, char *value,
-                 int *indexPtr, AM_INTHEADER *header) {
+int AM_BinSearch(char *pageBuf, AM_KEYTYPE *kt, char *value, int *indexPtr,
+                 AM_INTHEADER *header) {
   int low, high, mid; /* for binary search */
   int compareVal;     /* result of comparison of key with value */
   int recSize;        /* size in bytes of a key,ptr pair */
   int pageNum;        /* page number of node to be followed along the B+ tree */
+  int found;
+
+  if (kt->packed)
+    return (AM_BinSearchPacked(pageBuf, kt, value, indexPtr, header));
+  recSize = AM_si + kt->attrLength;
+
+  /* typed keys: follow the pointer after the keys at or below value */
+  low = -1;
+  if (kt->search != NULL)
+    low = kt->search(pageBuf + AM_sint + AM_si, recSize, header->numKeys, value, &found);
+  if (low >= 0) {
+    *indexPtr = low + found;
+    memcpy(&pageNum, pageBuf + AM_sint + (low + found) * recSize, AM_si);
+    return pageNum;
+  }
 
-  recSize = AM_si + attrLength;
   low = 0;
   high = header->numKeys - 1;
   
   /* Binary search over the keys */
   while (low <= high) {
     mid = (low + high) / 2;
-    compareVal = AM_Compare(pageBuf + AM_sint + AM_si + (mid * recSize),
-                            attrType, attrLength, value);
+    compareVal = kt->compare(pageBuf + AM_sint + AM_si + (mid * recSize),
+                             value, kt->attrLength);
 
     if (compareVal == 0) {
       /* Found exact match */
@@ -137,13 +465,26 @@ int AM_BinSearch(char *pageBuf, char attrType, int attrLength, char *value,
 
 /* search a leaf node for the key- returns the place where it is found or can
 be inserted */
-int AM_SearchLeaf(char *pageBuf, char attrType, int attrLength, char *value,
-                  int *indexPtr, AM_LEAFHEADER *header) {
+int AM_SearchLeaf(char *pageBuf, AM_KEYTYPE *kt, char *value, int *indexPtr,
+                  AM_LEAFHEADER *header) {
   int low, high, mid; /* for binary search */
   int compareVal;     /* result of comparison of key with value */
   int recSize;        /* size in bytes of a key,ptr pair */
+  int found;
+
+  if (kt->packed)
+    return (AM_SearchLeafPacked(pageBuf, kt, value, indexPtr, header));
+  recSize = AM_ss + kt->attrLength;
+
+  /* typed keys */
+  low = -1;
+  if (kt->search != NULL)
+    low = kt->search(pageBuf + AM_sl, recSize, header->numKeys, value, &found);
+  if (low >= 0) {
+    *indexPtr = low + 1;
+    return (found ? AM_FOUND : AM_NOT_FOUND);
+  }
 
-  recSize = AM_ss + attrLength;
   low = 0;
   high = header->numKeys - 1;
 
@@ -156,8 +497,8 @@ int AM_SearchLeaf(char *pageBuf, char attrType, int attrLength, char *value,
   /* Binary search over the keys */
   while (low <= high) {
     mid = (low + high) / 2;
-    compareVal = AM_Compare(pageBuf + AM_sl + (mid * recSize),
-                            attrType, attrLength, value);
+    compareVal = kt->compare(pageBuf + AM_sl + (mid * recSize), value,
+                             kt->attrLength);
     
     if (compareVal == 0) {
       /* Found exact match */
@@ -182,30 +523,58 @@ int AM_SearchLeaf(char *pageBuf, char attrType, int attrLength, char *value,
 
 /* Compare value in bufPtr with value in valPtr - returns -1 ,0 or 1 according
 to whether value in valPtr is less than , equal to or greater than value
-in BufPtr*/
-int AM_Compare(char *bufPtr, char attrType, int attrLength, char *valPtr) {
-  int bufint, valint;     /* temporary aligned storage for comparison */
+in BufPtr; one function per key type */
+static int AM_CompareInt(char *bufPtr, char *valPtr, int attrLength) {
+  int bufint, valint; /* temporary aligned storage for comparison */
+
+  memcpy(&bufint, bufPtr, AM_si);
+  memcpy(&valint, valPtr, AM_si);
+  return ((valint > bufint) - (valint < bufint));
+}
+
+static int AM_CompareFloat(char *bufPtr, char *valPtr, int attrLength) {
   float buffloat, valfloat; /* temporary aligned storage for comparison */
 
+  memcpy(&buffloat, bufPtr, AM_sf);
+  memcpy(&valfloat, valPtr, AM_sf);
+  return ((valfloat > buffloat) - (valfloat < buffloat));
+}
+
+static int AM_CompareChar(char *bufPtr, char *valPtr, int attrLength) {
+  /* strncmp returns < 0, 0, or > 0 */
+  return (strncmp(valPtr, bufPtr, attrLength));
+}
+
+static int AM_CompareBytes(char *bufPtr, char *valPtr, int attrLength) {
+  /* normalized keys: byte order is key order */
+  return (memcmp(valPtr, bufPtr, attrLength));
+}
+
+/* Fills in *kt for keys of attrType and attrLength; AM_OpenIndex does
+this once, and everything below works on *kt */
+int AM_ResolveKeyType(AM_KEYTYPE *kt, char attrType, int attrLength) {
+  kt->attrType = attrType;
+  kt->attrLength = attrLength;
+  kt->packed = FALSE;
   switch (attrType) {
-  case 'i': {
-    memcpy(&bufint, bufPtr, AM_si);
-    memcpy(&valint, valPtr, AM_si);
-    if (valint < bufint) return (-1);
-    else if (valint > bufint) return (1);
-    else return (0);
-  }
-  case 'f': {
-    memcpy(&buffloat, bufPtr, AM_sf);
-    memcpy(&valfloat, valPtr, AM_sf);
-    if (valfloat < buffloat) return (-1);
-    else if (valfloat > buffloat) return (1);
-    else return (0);
-  }
-  case 'c': {
-    /* strncmp returns < 0, 0, or > 0 */
-    return (strncmp(valPtr, bufPtr, attrLength));
-  }
-  }
-  return 0; /* Should never reach here */
-}
\ No newline at end of file
+  case 'i':
+    kt->compare = AM_CompareInt;
+    kt->search = AM_SearchIntKeys;
+    break;
+  case 'f':
+    kt->compare = AM_CompareFloat;
+    kt->search = AM_SearchFloatKeys;
+    break;
+  case 'c':
+    kt->compare = AM_CompareChar;
+    kt->search = NULL;
+    break;
+  case AM_KEY_BYTES:
+    kt->compare = AM_CompareBytes;
+    kt->search = NULL;
+    break;
+  default:
+    return (AME_INVALIDATTRTYPE);
+  }
+  return (AME_OK);
+}
@@ -1,25 +1,21 @@
 #include "am.h"
 
-#define AM_MAXSTACK 50
-
-struct {
-  int pageNumber;
-  int offset;
-} AM_Stack[AM_MAXSTACK];
-
-int AM_topofStackPtr = -1;
-
-void AM_PushStack(int pageNum, int offset) {
-  AM_topofStackPtr++;
-  AM_Stack[AM_topofStackPtr].pageNumber = pageNum;
-  AM_Stack[AM_topofStackPtr].offset = offset;
+/* Pushes an internal node of the path; AME_INTERROR if the path is
+deeper than AM_MAXSTACK */
+int AM_PushStack(AM_STACK *stack, int pageNum, int offset) {
+  if (stack->top == AM_MAXSTACK - 1)
+    return (AME_INTERROR);
+  stack->top++;
+  stack->entry[stack->top].pageNumber = pageNum;
+  stack->entry[stack->top].offset = offset;
+  return (AME_OK);
 }
 
-void AM_PopStack(void) { AM_topofStackPtr--; }
+void AM_PopStack(AM_STACK *stack) { stack->top--; }
 
-void AM_topofStack(int *pageNum, int *offset) {
-  *pageNum = AM_Stack[AM_topofStackPtr].pageNumber;
-  *offset = AM_Stack[AM_topofStackPtr].offset;
+void AM_topofStack(AM_STACK *stack, int *pageNum, int *offset) {
+  *pageNum = stack->entry[stack->top].pageNumber;
+  *offset = stack->entry[stack->top].offset;
 }
 
-void AM_EmptyStack(void) { AM_topofStackPtr = -1; }
\ No newline at end of file
+void AM_EmptyStack(AM_STACK *stack) { stack->top = -1; }
@@ -1,6 +1,8 @@
 #include "am.h"
 #include "testam.h"
 
+#include <time.h>
+
 /**********************************************************
 pad end of str until up to length bytes with '\0'
 Assume that str is terminated with '\0'
@@ -25,6 +27,18 @@ int xAM_CreateIndex(char *fname, int indexno, char attrtype, int attrlen) {
   return (errval);
 }
 
+int xAM_CreateIndexFlags(char *fname, int indexno, char attrtype, int attrlen,
+                         int flags) {
+  int errval;
+
+  if ((errval = AM_CreateIndexFlags(fname, indexno, attrtype, attrlen, flags)) != AME_OK) {
+    printf("AM_CreateIndexFlags(%s,%d,'%c',%d,%#x) failed: %d\n", fname, indexno,
+           attrtype, attrlen, flags, errval);
+    exit(1);
+  }
+  return (errval);
+}
+
 int xAM_DestroyIndex(char *fname, int indexno) {
   int errval;
 
@@ -35,59 +49,78 @@ int xAM_DestroyIndex(char *fname, int indexno) {
   return (errval);
 }
 
-int xAM_InsertEntry(int fd, char attrtype, int attrlen, char *val,
-                    RecIdType recid) {
+int xAM_OpenIndex(char *fname, int indexno, char attrtype, AM_IndexHandle *ih) {
+  int errval;
+
+  if ((errval = AM_OpenIndex(fname, indexno, attrtype, ih)) != AME_OK) {
+    printf("AM_OpenIndex(%s,%d,'%c') failed: %d\n", fname, indexno, attrtype,
+           errval);
+    exit(1);
+  }
+  return (errval);
+}
+
+int xAM_CloseIndex(AM_IndexHandle *ih) {
   int errval;
 
-  if ((errval = AM_InsertEntry(fd, attrtype, attrlen, val, recid)) != AME_OK) {
-    printf("AM_InsertEntry(%d,'%c',%d,val,%d) failed: %d\n", fd, attrtype,
-           attrlen, RecIdToInt(recid), errval);
+  if ((errval = AM_CloseIndex(ih)) != AME_OK) {
+    printf("AM_CloseIndex(%d) failed: %d\n", ih->fileDesc, errval);
+    exit(1);
+  }
+  return (errval);
+}
+
+int xAM_InsertEntry(AM_IndexHandle *ih, char *val, RecIdType recid) {
+  int errval;
+
+  if ((errval = AM_InsertEntry(ih, val, recid)) != AME_OK) {
+    printf("AM_InsertEntry(%d,'%c',%d,val,%d) failed: %d\n", ih->fileDesc,
+           ih->attrType, ih->attrLength, RecIdToInt(recid), errval);
     AM_PrintError("AM_InsertEntry");
     exit(1);
   }
   return (errval);
 }
 
-int xAM_DeleteEntry(int fd, char attrtype, int attrlen, char *val,
-                    RecIdType recid) {
+int xAM_DeleteEntry(AM_IndexHandle *ih, char *val, RecIdType recid) {
   int errval;
 
-  if ((errval = AM_DeleteEntry(fd, attrtype, attrlen, val, recid)) != AME_OK) {
-    printf("AM_DeleteEntry(%d,'%c',%d,val,%d) failed: %d\n", fd, attrtype,
-           attrlen, RecIdToInt(recid), errval);
+  if ((errval = AM_DeleteEntry(ih, val, recid)) != AME_OK) {
+    printf("AM_DeleteEntry(%d,'%c',%d,val,%d) failed: %d\n", ih->fileDesc,
+           ih->attrType, ih->attrLength, RecIdToInt(recid), errval);
     exit(1);
   }
   return (errval);
 }
 
-int xAM_OpenIndexScan(int fd, char attrtype, int attrlen, int op, char *val) {
-  int sd;
+int xAM_OpenIndexScan(AM_IndexHandle *ih, AM_ScanHandle *sh, int op, char *val) {
+  int errval;
 
-  if ((sd = AM_OpenIndexScan(fd, attrtype, attrlen, op, val)) < 0) {
-    printf("AM_OpenIndexScan(%d,'%c',%d,%d,rec) failed: %d\n", fd, attrtype,
-           attrlen, op, sd);
+  if ((errval = AM_OpenIndexScan(ih, sh, op, val)) != AME_OK) {
+    printf("AM_OpenIndexScan(%d,'%c',%d,%d,rec) failed: %d\n", ih->fileDesc,
+           ih->attrType, ih->attrLength, op, errval);
     exit(1);
   }
-  return (sd);
+  return (errval);
 }
 
-RecIdType xAM_FindNextEntry(int sd) {
+RecIdType xAM_FindNextEntry(AM_ScanHandle *sh) {
   int errval;
   RecIdType recid;
 
-  recid = AM_FindNextEntry(sd);
+  recid = AM_FindNextEntry(sh);
   if ((errval = RecIdToInt(recid)) < AME_OK && errval != AME_EOF) {
-    printf("AM_FindNextEntry(%d) failed: %d\n", sd, errval);
+    printf("AM_FindNextEntry failed: %d\n", errval);
     exit(1);
   }
   return (recid);
 }
 
-int xAM_CloseIndexScan(int sd) {
+int xAM_CloseIndexScan(AM_ScanHandle *sh) {
   int errval;
 
-  if ((errval = AM_CloseIndexScan(sd)) != AME_OK) {
-    printf("AM_CloseIndexScan(%d) failed:%d\n", sd, errval);
+  if ((errval = AM_CloseIndexScan(sh)) != AME_OK) {
+    printf("AM_CloseIndexScan failed:%d\n", errval);
     exit(1);
   }
   return (errval);
@@ -112,4 +145,39 @@ int xPF_CloseFile(int fd) {
   }
 
   return (errval);
-}
\ No newline at end of file
+}
+
+/**********************************************************
+Helpers shared by the benchmark tests (test_*.c)
+***********************************************************/
+
+/* Seconds on a monotonic clock, for timing a phase */
+double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Position i of a permutation of 0 .. n - 1 (n not a multiple of 7919) */
+int perm_key(int i, int n) { return (int)((i * 7919L) % n); }
+
+/* A full scan of ih returns recIds 0 .. numKeys - 1, in order */
+void check_index(AM_IndexHandle *ih, int numKeys) {
+  AM_ScanHandle sh;
+  int recId, n = 0;
+
+  xAM_OpenIndexScan(ih, &sh, EQUAL, NULL);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    if (recId != n) {
+      printf("*** ERROR: index '%c' returned recId %d at position %d ***\n", ih->attrType,
+             recId, n);
+      exit(1);
+    }
+    n++;
+  }
+  xAM_CloseIndexScan(&sh);
+  if (n != numKeys) {
+    printf("*** ERROR: index '%c' holds %d keys, expected %d ***\n", ih->attrType, n, numKeys);
+    exit(1);
+  }
+}
@@ -0,0 +1,235 @@
+/* test_bulkload.c: Benchmark for AM_BulkLoad against per-key AM_InsertEntry */
+#include "am.h"
+#include "testam.h"
+
+#define INDEX_FILE "bulk_index"
+#define NUM_KEYS 200000
+#define DUPS 8
+#define CHAR_LEN 20
+
+/*
+ * Hands out keys 0, 2, 4, ... (or key i / DUPS with `dups`) as ints or
+ * strings, in order or in the order of `perm`. The recId of a key is its
+ * position in the sorted stream.
+ */
+typedef struct {
+  int next;
+  int count;
+  int dups;
+  char attrType;
+  int *perm;
+} KeyStream;
+
+static void make_key(char attrType, int k, char *value) {
+  if (attrType == 'c') {
+    memset(value, 0, CHAR_LEN);
+    sprintf(value, "key%08d", k);
+  } else {
+    memcpy(value, &k, sizeof(int));
+  }
+}
+
+static int stream_key(const KeyStream *ks, int i) {
+  return ks->dups ? i / DUPS : 2 * i;
+}
+
+static int next_pair(void *arg, char *value, int *recId) {
+  KeyStream *ks = (KeyStream *)arg;
+
+  if (ks->next == ks->count)
+    return (AME_EOF);
+  *recId = ks->perm ? ks->perm[ks->next] : ks->next;
+  make_key(ks->attrType, stream_key(ks, *recId), value);
+  ks->next++;
+  return (AME_OK);
+}
+
+/* Like next_pair, but one key near the end goes back to 0 */
+static int next_unsorted(void *arg, char *value, int *recId) {
+  KeyStream *ks = (KeyStream *)arg;
+  int err = next_pair(arg, value, recId);
+
+  if (err == AME_OK && ks->next == ks->count - 10)
+    make_key(ks->attrType, 0, value);
+  return (err);
+}
+
+static void open_new_index(char attrType, int attrLength, AM_IndexHandle *ih) {
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, attrType, attrLength);
+  xAM_OpenIndex(INDEX_FILE, 0, attrType, ih);
+}
+
+/* Scans the whole index: every recId once, keys in stream order */
+static void check_scan(AM_IndexHandle *ih, const KeyStream *ks, int expect) {
+  AM_ScanHandle sh;
+  int recId, last = -1, n = 0;
+
+  xAM_OpenIndexScan(ih, &sh, EQUAL, NULL);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    if (recId >= ks->count || (last >= 0 && stream_key(ks, recId) < stream_key(ks, last))) {
+      printf("*** ERROR: scan returned recId %d after %d ***\n", recId, last);
+      exit(1);
+    }
+    last = recId;
+    n++;
+  }
+  xAM_CloseIndexScan(&sh);
+  if (n != expect) {
+    printf("*** ERROR: scan returned %d entries, expected %d ***\n", n, expect);
+    exit(1);
+  }
+}
+
+/* Point lookups: present keys find their recIds (in input order), absent keys none */
+static void check_lookups(AM_IndexHandle *ih, const KeyStream *ks) {
+  char value[AM_MAXATTRLENGTH];
+  AM_ScanHandle sh;
+  int probe, i, recId, n;
+
+  for (probe = 0; probe < 500; probe++) {
+    i = (int)((probe * 7919L) % ks->count);
+    make_key(ks->attrType, stream_key(ks, i), value);
+    xAM_OpenIndexScan(ih, &sh, EQUAL, value);
+    n = 0;
+    while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+      if (stream_key(ks, recId) != stream_key(ks, i) || (ks->dups && recId != i - i % DUPS + n)) {
+        printf("*** ERROR: key of recId %d returned recId %d ***\n", i, recId);
+        exit(1);
+      }
+      n++;
+    }
+    xAM_CloseIndexScan(&sh);
+    if (n != (ks->dups ? DUPS : 1)) {
+      printf("*** ERROR: key of recId %d has %d entries ***\n", i, n);
+      exit(1);
+    }
+    if (ks->dups)
+      continue;
+    make_key(ks->attrType, stream_key(ks, i) + 1, value);
+    xAM_OpenIndexScan(ih, &sh, EQUAL, value);
+    if (xAM_FindNextEntry(&sh) >= 0) {
+      printf("*** ERROR: absent key found ***\n");
+      exit(1);
+    }
+    xAM_CloseIndexScan(&sh);
+  }
+}
+
+/* Builds an index of NUM_KEYS int keys and prints one table row */
+static void build(const char *label, int bulk, float fill, int *perm) {
+  KeyStream ks = {0, NUM_KEYS, 0, 'i', perm};
+  char value[sizeof(int)];
+  long logical, physical, writes;
+  double t0, elapsed;
+  AM_IndexHandle ih;
+  int recId, pages;
+
+  open_new_index('i', sizeof(int), &ih);
+  PF_ResetStats();
+  t0 = now_sec();
+  if (bulk) {
+    if (AM_BulkLoad(&ih, next_pair, &ks, fill) != AME_OK) {
+      AM_PrintError("AM_BulkLoad");
+      exit(1);
+    }
+  } else {
+    while (next_pair(&ks, value, &recId) == AME_OK)
+      xAM_InsertEntry(&ih, value, recId);
+  }
+  PF_GetNumPages(ih.fileDesc, &pages);
+  xAM_CloseIndex(&ih); // Flushes the dirty pages, counted as writes
+  elapsed = now_sec() - t0;
+  PF_GetStats(&logical, &physical, &writes);
+  printf("| %-28s | %10.4f | %6d | %13ld | %15.2f | %13ld |\n", label, elapsed, pages, writes,
+         (double)writes / pages, logical);
+
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  ks.perm = NULL;
+  check_scan(&ih, &ks, NUM_KEYS);
+  check_lookups(&ih, &ks);
+  xAM_CloseIndex(&ih);
+}
+
+int main(void) {
+  static int perm[NUM_KEYS];
+  KeyStream ks = {0, 0, 0, 'i', NULL};
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  unsigned int seed = 12345;
+  int i, j, t, n;
+
+  PF_Init();
+  for (i = 0; i < NUM_KEYS; i++)
+    perm[i] = i;
+  for (i = NUM_KEYS - 1; i > 0; i--) {
+    seed = seed * 1103515245u + 12345u;
+    j = (seed >> 8) % (i + 1);
+    t = perm[i]; perm[i] = perm[j]; perm[j] = t;
+  }
+
+  printf("Building an index of %d int keys\n\n", NUM_KEYS);
+  printf("| Method                       | Time (sec) | Pages  | Physical writes | Writes per page | Logical reads |\n");
+  printf("|------------------------------|------------|--------|-----------------|-----------------|---------------|\n");
+  build("AM_InsertEntry, random", 0, 1.0f, perm);
+  build("AM_InsertEntry, sorted", 0, 1.0f, NULL);
+  build("AM_BulkLoad, fill 100%", 1, 1.0f, NULL);
+  build("AM_BulkLoad, fill 70%", 1, 0.7f, NULL);
+
+  // 1. A bulk-loaded index keeps taking inserts (odd keys between the even ones)
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  for (i = 0; i < NUM_KEYS / 4; i++) {
+    int k = 4 * i + 1;
+    xAM_InsertEntry(&ih, (char *)&k, NUM_KEYS + i);
+  }
+  ks.next = 0; ks.count = NUM_KEYS + NUM_KEYS / 4; ks.dups = 0; ks.attrType = 'i';
+  xAM_OpenIndexScan(&ih, &sh, EQUAL, NULL);
+  for (n = 0; xAM_FindNextEntry(&sh) >= 0; n++)
+    ;
+  xAM_CloseIndexScan(&sh);
+  if (n != ks.count) {
+    printf("*** ERROR: %d entries after inserts, expected %d ***\n", n, ks.count);
+    exit(1);
+  }
+
+  // 2. Loading into a non-empty index is refused
+  ks.next = 0; ks.count = 10;
+  if (AM_BulkLoad(&ih, next_pair, &ks, 1.0f) != AME_NOTEMPTY) {
+    printf("*** ERROR: bulk load into a non-empty index accepted ***\n");
+    exit(1);
+  }
+  xAM_CloseIndex(&ih);
+
+  // 3. Duplicates stay together, in input order
+  ks.next = 0; ks.count = NUM_KEYS; ks.dups = 1; ks.attrType = 'i';
+  open_new_index('i', sizeof(int), &ih);
+  if (AM_BulkLoad(&ih, next_pair, &ks, 0.9f) != AME_OK) { AM_PrintError("AM_BulkLoad"); exit(1); }
+  check_scan(&ih, &ks, NUM_KEYS);
+  check_lookups(&ih, &ks);
+  xAM_CloseIndex(&ih);
+
+  // 4. String keys
+  ks.next = 0; ks.count = NUM_KEYS; ks.dups = 0; ks.attrType = 'c';
+  open_new_index('c', CHAR_LEN, &ih);
+  if (AM_BulkLoad(&ih, next_pair, &ks, 1.0f) != AME_OK) { AM_PrintError("AM_BulkLoad"); exit(1); }
+  check_scan(&ih, &ks, NUM_KEYS);
+  check_lookups(&ih, &ks);
+  xAM_CloseIndex(&ih);
+
+  // 5. Unsorted input is rejected and leaves the index empty and loadable
+  ks.next = 0; ks.count = NUM_KEYS; ks.attrType = 'i';
+  open_new_index('i', sizeof(int), &ih);
+  if (AM_BulkLoad(&ih, next_unsorted, &ks, 1.0f) != AME_UNSORTED) {
+    printf("*** ERROR: unsorted input accepted ***\n");
+    exit(1);
+  }
+  check_scan(&ih, &ks, 0);
+  ks.next = 0;
+  if (AM_BulkLoad(&ih, next_pair, &ks, 1.0f) != AME_OK) { AM_PrintError("AM_BulkLoad"); exit(1); }
+  check_scan(&ih, &ks, NUM_KEYS);
+  xAM_CloseIndex(&ih);
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\n*** Bulk Load Test Passed! ***\n");
+  return 0;
+}
@@ -0,0 +1,159 @@
+/* test_concurrent.c: Benchmark for concurrent mode (AM_SetConcurrent): threads inserting into and looking up in one index */
+#include "am.h"
+#include "testam.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define INDEX_FILE "concurrent_index"
+#define NUM_KEYS 50000     /* keys inserted by each run, split over its threads */
+#define NUM_LOOKUPS 100000 /* lookups of each run, split over its threads */
+#define NUM_MIXED 20000    /* insert + lookup pairs of each run */
+
+static const int thread_counts[] = {1, 2, 4, 8};
+
+/* Keys are perm_key(i, NUM_KEYS) for i in 0 .. NUM_KEYS - 1; the recId
+of key k is k */
+
+typedef struct {
+  AM_IndexHandle *ih;
+  int id;
+  int numThreads;
+  int phase;        /* 0: insert, 1: lookup, 2: mixed */
+  unsigned int seed;
+  pthread_t tid;
+  int failed;
+} Worker;
+
+/* TRUE if key k is in the index with recId k alone */
+static int present(AM_IndexHandle *ih, int k) {
+  int recIds[2];
+
+  return (AM_LookupEntry(ih, (char *)&k, recIds, 2) == 1 && recIds[0] == k);
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = (Worker *)arg;
+  int i, k;
+
+  switch (w->phase) {
+  case 0:
+    for (i = w->id; i < NUM_KEYS; i += w->numThreads) {
+      k = perm_key(i, NUM_KEYS);
+      if (AM_InsertEntry(w->ih, (char *)&k, k) != AME_OK)
+        w->failed = 1;
+    }
+    break;
+  case 1:
+    for (i = w->id; i < NUM_LOOKUPS; i += w->numThreads) {
+      w->seed = w->seed * 1103515245u + 12345u;
+      if (!present(w->ih, (w->seed >> 4) % NUM_KEYS))
+        w->failed = 1;
+    }
+    break;
+  default:
+    /* new keys above NUM_KEYS, while the old ones must stay visible */
+    for (i = w->id; i < NUM_MIXED; i += w->numThreads) {
+      k = NUM_KEYS + i;
+      if (AM_InsertEntry(w->ih, (char *)&k, k) != AME_OK)
+        w->failed = 1;
+      w->seed = w->seed * 1103515245u + 12345u;
+      if (!present(w->ih, (w->seed >> 4) % NUM_KEYS))
+        w->failed = 1;
+    }
+  }
+  return NULL;
+}
+
+/* Runs phase on numThreads threads; returns the elapsed seconds */
+static double run_phase(AM_IndexHandle *ih, int phase, int numThreads) {
+  Worker workers[8];
+  double t0;
+  int i;
+
+  t0 = now_sec();
+  for (i = 0; i < numThreads; i++) {
+    workers[i].ih = ih;
+    workers[i].id = i;
+    workers[i].numThreads = numThreads;
+    workers[i].phase = phase;
+    workers[i].seed = 12345u + i;
+    workers[i].failed = 0;
+    pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+  }
+  for (i = 0; i < numThreads; i++)
+    pthread_join(workers[i].tid, NULL);
+  for (i = 0; i < numThreads; i++) {
+    if (workers[i].failed) {
+      printf("*** ERROR: thread %d of phase %d went wrong ***\n", i, phase);
+      exit(1);
+    }
+  }
+  return now_sec() - t0;
+}
+
+/*
+ * run
+ * Builds a fresh index with numThreads threads inserting NUM_KEYS keys,
+ * then times NUM_LOOKUPS random lookups and NUM_MIXED inserts each
+ * followed by a lookup, with the index in concurrent mode or not.
+ */
+static void run(int concurrent, int numThreads, double *base) {
+  AM_IndexHandle ih;
+  AM_ConcurrencyStats stats;
+  double tInsert, tLookup, tMixed;
+  long hops;
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, 'i', sizeof(int));
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  if (AM_SetConcurrent(&ih, concurrent) != AME_OK) {
+    AM_PrintError("AM_SetConcurrent");
+    exit(1);
+  }
+
+  tInsert = run_phase(&ih, 0, numThreads);
+  tLookup = run_phase(&ih, 1, numThreads);
+  tMixed = run_phase(&ih, 2, numThreads);
+  AM_GetConcurrencyStats(&ih, &stats);
+  check_index(&ih, NUM_KEYS + NUM_MIXED);
+
+  if (numThreads == 1) {
+    base[0] = tInsert;
+    base[1] = tLookup;
+  }
+  /* in concurrent mode the upper levels are resident: past the first
+  few descents, every descent reaches its leaf's parent without the
+  pool latch and pins only the leaf under it */
+  hops = stats.residentHops + stats.latchedPins;
+  if (concurrent && stats.latchedPins > stats.residentHops + stats.residentHops / 10) {
+    printf("*** ERROR: %ld of %ld descent hops took the latch ***\n",
+           stats.latchedPins, hops);
+    exit(1);
+  }
+
+  printf("| %-7s | %7d | %9.0f | %5.2fx | %9.0f | %5.2fx | %11.0f | %11.4f | %6ld | %9.2f |\n",
+         concurrent ? "olc" : "latched", numThreads, NUM_KEYS / tInsert, base[0] / tInsert,
+         NUM_LOOKUPS / tLookup, base[1] / tLookup, 2 * NUM_MIXED / tMixed,
+         (double)stats.restarts / (NUM_KEYS + NUM_LOOKUPS + 2 * NUM_MIXED),
+         stats.splitInserts, hops > 0 ? (double)stats.residentHops / hops : 0.0);
+  xAM_CloseIndex(&ih);
+}
+
+int main(void) {
+  double base[2];
+  int c, t;
+
+  PF_Init();
+  printf("%d int keys inserted, %d lookups, %d insert + lookup pairs per run; %ld cores\n\n",
+         NUM_KEYS, NUM_LOOKUPS, NUM_MIXED, sysconf(_SC_NPROCESSORS_ONLN));
+  printf("| Mode    | Threads | Inserts/s | Scale  | Lookups/s | Scale  | Mixed ops/s | Restarts/op | Splits | Latch-free |\n");
+  printf("|---------|---------|-----------|--------|-----------|--------|-------------|-------------|--------|-----------|\n");
+  for (c = 0; c < 2; c++)
+    for (t = 0; t < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); t++)
+      run(c, thread_counts[t], base);
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\n*** Concurrent Index Test Passed! ***\n");
+  return 0;
+}
@@ -0,0 +1,172 @@
+/* test_handles.c: Several open indexes, hundreds of open scans and threads sharing the AM layer */
+#include "am.h"
+#include "testam.h"
+
+#include <pthread.h>
+
+#define INDEX_FILE "handles_index"
+#define NUM_KEYS 20000     /* keys per index */
+#define NUM_SCANS 500      /* scans open at once (the old scan table held 20) */
+#define SCAN_LEN 40        /* entries each of those scans returns */
+#define NUM_THREADS 8
+#define THREAD_KEYS 5000   /* keys each thread inserts into its own index */
+#define THREAD_SCANS 2000  /* point lookups each thread makes in the shared index */
+#define CHAR_LEN 24
+
+/* Keys are perm_key(i, NUM_KEYS) for i in 0 .. NUM_KEYS - 1; the recId
+of key k is k */
+
+static void make_key(char attrType, int k, char *value) {
+  float f;
+
+  switch (attrType) {
+  case 'c':
+    memset(value, 0, CHAR_LEN);
+    sprintf(value, "key%08d", k);
+    break;
+  case 'f':
+    f = k * 0.5f;
+    memcpy(value, &f, sizeof(float));
+    break;
+  default:
+    memcpy(value, &k, sizeof(int));
+  }
+}
+
+/* One thread: builds an index of its own while reading the shared one */
+typedef struct {
+  int id;
+  AM_IndexHandle *shared;
+  pthread_t tid;
+  int failed;
+} Worker;
+
+static void *worker_main(void *arg) {
+  Worker *w = (Worker *)arg;
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  char value[CHAR_LEN];
+  int i, k, first = 0;
+
+  if (AM_OpenIndex(INDEX_FILE, 10 + w->id, 'i', &ih) != AME_OK) {
+    w->failed = 1;
+    return NULL;
+  }
+  for (i = 0; i < THREAD_SCANS + THREAD_KEYS; i++) {
+    if (i < THREAD_KEYS) {
+      k = (int)((i * 7919L) % THREAD_KEYS);
+      if (AM_InsertEntry(&ih, (char *)&k, k) != AME_OK)
+        w->failed = 1;
+    }
+    if (i < THREAD_SCANS) {
+      k = perm_key(i * NUM_THREADS + w->id, NUM_KEYS);
+      make_key('c', k, value);
+      if (AM_OpenIndexScan(w->shared, &sh, EQUAL, value) != AME_OK ||
+          AM_FindNextEntry(&sh) != k || AM_FindNextEntry(&sh) != AME_EOF ||
+          AM_CloseIndexScan(&sh) != AME_OK)
+        w->failed = 1;
+    }
+  }
+
+  /* the thread's own index holds every key once, in order */
+  if (AM_OpenIndexScan(&ih, &sh, GREATER_THAN_EQUAL, (char *)&first) != AME_OK)
+    w->failed = 1;
+  for (i = 0; i < THREAD_KEYS; i++)
+    if (AM_FindNextEntry(&sh) != i)
+      w->failed = 1;
+  if (AM_FindNextEntry(&sh) != AME_EOF)
+    w->failed = 1;
+  AM_CloseIndexScan(&sh);
+  if (AM_CloseIndex(&ih) != AME_OK)
+    w->failed = 1;
+  return NULL;
+}
+
+int main(void) {
+  static const char types[3] = {'i', 'f', 'c'};
+  static const int lengths[3] = {sizeof(int), sizeof(float), CHAR_LEN};
+  static AM_ScanHandle scans[NUM_SCANS];
+  static int seen[NUM_SCANS];
+  AM_IndexHandle ih[3];
+  Worker workers[NUM_THREADS];
+  char value[CHAR_LEN];
+  int i, t, k, recId;
+
+  PF_Init();
+
+  // 1. Three indexes open at once, of three key types, filled in turns
+  for (t = 0; t < 3; t++) {
+    AM_DestroyIndex(INDEX_FILE, t);
+    xAM_CreateIndex(INDEX_FILE, t, types[t], lengths[t]);
+    xAM_OpenIndex(INDEX_FILE, t, types[t], &ih[t]);
+    if (ih[t].attrLength != lengths[t]) {
+      printf("*** ERROR: index %d opened with key length %d ***\n", t, ih[t].attrLength);
+      exit(1);
+    }
+  }
+  for (i = 0; i < NUM_KEYS; i++) {
+    for (t = 0; t < 3; t++) {
+      make_key(types[t], perm_key(i, NUM_KEYS), value);
+      xAM_InsertEntry(&ih[t], value, perm_key(i, NUM_KEYS));
+    }
+  }
+  for (t = 0; t < 3; t++)
+    check_index(&ih[t], NUM_KEYS);
+  printf("%d indexes of %d keys built side by side\n", 3, NUM_KEYS);
+
+  // 2. NUM_SCANS scans open at once over the three indexes, advanced in turns
+  for (i = 0; i < NUM_SCANS; i++) {
+    t = i % 3;
+    make_key(types[t], (i * 37) % (NUM_KEYS - SCAN_LEN), value);
+    xAM_OpenIndexScan(&ih[t], &scans[i], GREATER_THAN_EQUAL, value);
+  }
+  for (k = 0; k < SCAN_LEN; k++) {
+    for (i = 0; i < NUM_SCANS; i++) {
+      recId = xAM_FindNextEntry(&scans[i]);
+      if (recId != (i * 37) % (NUM_KEYS - SCAN_LEN) + seen[i]) {
+        printf("*** ERROR: scan %d returned %d as entry %d ***\n", i, recId, seen[i]);
+        exit(1);
+      }
+      seen[i]++;
+    }
+  }
+  for (i = 0; i < NUM_SCANS; i++)
+    xAM_CloseIndexScan(&scans[i]);
+  if (AM_FindNextEntry(&scans[0]) != AME_INVALID_SCANDESC) {
+    printf("*** ERROR: a closed scan returned an entry ***\n");
+    exit(1);
+  }
+  printf("%d scans open at once, %d entries each\n", NUM_SCANS, SCAN_LEN);
+
+  // 3. Threads, each inserting into its own index and reading the shared
+  //    char index through their own scans
+  xAM_CloseIndex(&ih[0]);
+  xAM_CloseIndex(&ih[1]);
+  for (i = 0; i < NUM_THREADS; i++) {
+    AM_DestroyIndex(INDEX_FILE, 10 + i);
+    xAM_CreateIndex(INDEX_FILE, 10 + i, 'i', sizeof(int));
+    workers[i].id = i;
+    workers[i].shared = &ih[2];
+    workers[i].failed = 0;
+  }
+  AM_SetNodeCache(&ih[2], 64);
+  for (i = 0; i < NUM_THREADS; i++)
+    pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+  for (i = 0; i < NUM_THREADS; i++) {
+    pthread_join(workers[i].tid, NULL);
+    if (workers[i].failed) {
+      printf("*** ERROR: thread %d went wrong ***\n", i);
+      exit(1);
+    }
+    AM_DestroyIndex(INDEX_FILE, 10 + i);
+  }
+  check_index(&ih[2], NUM_KEYS);
+  xAM_CloseIndex(&ih[2]);
+  printf("%d threads: %d inserts into their own index and %d lookups in a shared one each\n",
+         NUM_THREADS, THREAD_KEYS, THREAD_SCANS);
+
+  for (t = 0; t < 3; t++)
+    AM_DestroyIndex(INDEX_FILE, t);
+  printf("\n*** Index Handle Test Passed! ***\n");
+  return 0;
+}
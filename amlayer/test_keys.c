@@ -0,0 +1,222 @@
+/* test_keys.c: Normalized keys (AM_KEY_BYTES): memcmp order of the encodings, and a composite (tenant_id, timestamp) index */
+#include "am.h"
+#include "testam.h"
+
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#define INDEX_FILE "keys_index"
+#define NUM_PAIRS 200000  /* random pairs of values compared per type */
+#define NUM_ROWS 50000    /* (tenant_id, timestamp) rows in the index */
+#define NUM_TENANTS 64
+#define COMPOSITE_LEN (AM_KEY_INT_LEN + AM_KEY_INT64_LEN)
+
+static unsigned long long seed = 12345;
+
+static unsigned long long next_rand(void) {
+  seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+  return seed;
+}
+
+static int sign(int x) { return (x > 0) - (x < 0); }
+
+/* a and b encoded as ka and kb of len bytes must compare as want */
+static void check_order(const char *type, int pair, char *ka, char *kb, int len, int want) {
+  if (sign(memcmp(ka, kb, len)) != want) {
+    printf("*** ERROR: %s pair %d: memcmp order %d, expected %d ***\n", type, pair,
+           sign(memcmp(ka, kb, len)), want);
+    exit(1);
+  }
+}
+
+/* Edge values first, then random ones; NaN sorts last, -0 equals 0 */
+static void check_types(void) {
+  static const int ints[] = {INT_MIN, INT_MIN + 1, -256, -1, 0, 1, 255, 256, INT_MAX};
+  static const long long longs[] = {LLONG_MIN, -4294967296LL, -1, 0, 1, 4294967296LL, LLONG_MAX};
+  float floats[] = {-INFINITY, -1e30f, -1.0f, -1e-40f, -0.0f, 0.0f, 1e-40f, 1.0f, 1e30f,
+                    INFINITY, NAN};
+  double doubles[] = {-INFINITY, -1e300, -1.0, -0.0, 0.0, 5e-324, 1.0, 1e300, INFINITY, NAN};
+  char ka[AM_KEY_CHAR_LEN(8)], kb[AM_KEY_CHAR_LEN(8)];
+  char sa[8], sb[8];
+  int i, j, n, x, y;
+  long long lx, ly;
+  float fx, fy;
+  double dx, dy;
+
+#define EDGES(arr) (int)(sizeof(arr) / sizeof(arr[0]))
+  for (i = 0; i < EDGES(ints); i++)
+    for (j = 0; j < EDGES(ints); j++) {
+      AM_KeyInt(ka, 0, ints[i]);
+      AM_KeyInt(kb, 0, ints[j]);
+      check_order("int edge", i * 100 + j, ka, kb, AM_KEY_INT_LEN, sign(i - j));
+    }
+  for (i = 0; i < EDGES(longs); i++)
+    for (j = 0; j < EDGES(longs); j++) {
+      AM_KeyInt64(ka, 0, longs[i]);
+      AM_KeyInt64(kb, 0, longs[j]);
+      check_order("int64 edge", i * 100 + j, ka, kb, AM_KEY_INT64_LEN, sign(i - j));
+    }
+  /* -0 and 0 are neighbours in the table but equal */
+  for (i = 0; i < EDGES(floats); i++)
+    for (j = 0; j < EDGES(floats); j++) {
+      AM_KeyFloat(ka, 0, floats[i]);
+      AM_KeyFloat(kb, 0, floats[j]);
+      check_order("float edge", i * 100 + j, ka, kb, AM_KEY_FLOAT_LEN,
+                  (floats[i] == 0 && floats[j] == 0) ? 0 : sign(i - j));
+    }
+  for (i = 0; i < EDGES(doubles); i++)
+    for (j = 0; j < EDGES(doubles); j++) {
+      AM_KeyDouble(ka, 0, doubles[i]);
+      AM_KeyDouble(kb, 0, doubles[j]);
+      check_order("double edge", i * 100 + j, ka, kb, AM_KEY_DOUBLE_LEN,
+                  (doubles[i] == 0 && doubles[j] == 0) ? 0 : sign(i - j));
+    }
+
+  for (n = 0; n < NUM_PAIRS; n++) {
+    x = (int)next_rand();
+    y = (n % 4 == 0) ? x + (int)(next_rand() % 3) - 1 : (int)next_rand();
+    AM_KeyInt(ka, 0, x);
+    AM_KeyInt(kb, 0, y);
+    check_order("int", n, ka, kb, AM_KEY_INT_LEN, (x > y) - (x < y));
+
+    lx = (long long)next_rand();
+    ly = (long long)next_rand();
+    AM_KeyInt64(ka, 0, lx);
+    AM_KeyInt64(kb, 0, ly);
+    check_order("int64", n, ka, kb, AM_KEY_INT64_LEN, (lx > ly) - (lx < ly));
+
+    /* random bit patterns cover subnormals and both signs */
+    x = (int)next_rand();
+    y = (int)next_rand();
+    memcpy(&fx, &x, sizeof(float));
+    memcpy(&fy, &y, sizeof(float));
+    if (fx == fx && fy == fy) {
+      AM_KeyFloat(ka, 0, fx);
+      AM_KeyFloat(kb, 0, fy);
+      check_order("float", n, ka, kb, AM_KEY_FLOAT_LEN, (fx > fy) - (fx < fy));
+    }
+    lx = (long long)next_rand();
+    ly = (long long)next_rand();
+    memcpy(&dx, &lx, sizeof(double));
+    memcpy(&dy, &ly, sizeof(double));
+    if (dx == dx && dy == dy) {
+      AM_KeyDouble(ka, 0, dx);
+      AM_KeyDouble(kb, 0, dy);
+      check_order("double", n, ka, kb, AM_KEY_DOUBLE_LEN, (dx > dy) - (dx < dy));
+    }
+
+    /* short strings over a small alphabet, so prefixes are common */
+    memset(sa, 0, sizeof(sa));
+    memset(sb, 0, sizeof(sb));
+    for (i = 0; i < (int)(next_rand() % 8); i++)
+      sa[i] = 'a' + next_rand() % 3;
+    for (i = 0; i < (int)(next_rand() % 8); i++)
+      sb[i] = 'a' + next_rand() % 3;
+    AM_KeyChar(ka, 0, sa, 8);
+    AM_KeyChar(kb, 0, sb, 8);
+    check_order("char", n, ka, kb, AM_KEY_CHAR_LEN(8), sign(strncmp(sa, sb, 8)));
+
+    /* a NULL comes before every value */
+    AM_KeyNull(ka, 0, AM_KEY_INT_LEN);
+    AM_KeyInt(kb, 0, x);
+    check_order("null", n, ka, kb, AM_KEY_INT_LEN, -1);
+  }
+  printf("int, int64, float, double, char(8) and NULL encodings: memcmp order matches, %d random pairs each\n",
+         NUM_PAIRS);
+}
+
+/* Row r: tenant r % NUM_TENANTS (NULL for tenant 0), a random timestamp */
+static long long row_ts[NUM_ROWS];
+
+static void make_key(int r, char *key) {
+  int off;
+
+  if (r % NUM_TENANTS == 0)
+    off = AM_KeyNull(key, 0, AM_KEY_INT_LEN);
+  else
+    off = AM_KeyInt(key, 0, r % NUM_TENANTS - NUM_TENANTS / 2);
+  AM_KeyInt64(key, off, row_ts[r]);
+}
+
+/* TRUE if row a comes before row b in (tenant_id NULLS FIRST, timestamp) order */
+static int row_before(int a, int b) {
+  int ta = a % NUM_TENANTS, tb = b % NUM_TENANTS;
+
+  if ((ta == 0) != (tb == 0))
+    return (ta == 0);
+  if (ta != tb)
+    return (ta < tb);
+  return (row_ts[a] < row_ts[b]);
+}
+
+static void check_composite(void) {
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  char key[COMPOSITE_LEN];
+  int r, recId, prev = -1, n = 0, tenant = 7;
+  double t0;
+
+  for (r = 0; r < NUM_ROWS; r++)
+    row_ts[r] = (long long)(next_rand() >> 1) - (1LL << 40) * (long long)(next_rand() % 3);
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, AM_KEY_BYTES, COMPOSITE_LEN);
+  xAM_OpenIndex(INDEX_FILE, 0, AM_KEY_BYTES, &ih);
+  t0 = clock();
+  for (r = 0; r < NUM_ROWS; r++) {
+    make_key(r, key);
+    xAM_InsertEntry(&ih, key, r);
+  }
+  t0 = (clock() - t0) / CLOCKS_PER_SEC;
+
+  /* a full scan returns the rows in (tenant_id, timestamp) order */
+  xAM_OpenIndexScan(&ih, &sh, EQUAL, NULL);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    if (prev >= 0 && !row_before(prev, recId)) {
+      printf("*** ERROR: row %d returned after row %d ***\n", recId, prev);
+      exit(1);
+    }
+    prev = recId;
+    n++;
+  }
+  xAM_CloseIndexScan(&sh);
+  if (n != NUM_ROWS) {
+    printf("*** ERROR: scan returned %d rows, expected %d ***\n", n, NUM_ROWS);
+    exit(1);
+  }
+
+  /* a range scan from (tenant, smallest timestamp) reads one tenant's rows first */
+  AM_KeyInt64(key, AM_KeyInt(key, 0, tenant - NUM_TENANTS / 2), LLONG_MIN);
+  xAM_OpenIndexScan(&ih, &sh, GREATER_THAN_EQUAL, key);
+  n = 0;
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0 && recId % NUM_TENANTS == tenant)
+    n++;
+  xAM_CloseIndexScan(&sh);
+  if (n != NUM_ROWS / NUM_TENANTS + (NUM_ROWS % NUM_TENANTS > tenant)) {
+    printf("*** ERROR: tenant %d has %d rows in the index ***\n", tenant, n);
+    exit(1);
+  }
+
+  /* point lookups of every row */
+  for (r = 0; r < NUM_ROWS; r++) {
+    make_key(r, key);
+    if (AM_LookupEntry(&ih, key, &recId, 1) != 1 || recId != r) {
+      printf("*** ERROR: row %d not found by its key ***\n", r);
+      exit(1);
+    }
+  }
+
+  xAM_CloseIndex(&ih);
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("(tenant_id, timestamp) index of %d rows: %d-byte keys, %.2f s to insert, scans in order\n",
+         NUM_ROWS, COMPOSITE_LEN, t0);
+}
+
+int main(void) {
+  PF_Init();
+  check_types();
+  check_composite();
+  printf("\n*** Normalized Key Test Passed! ***\n");
+  return 0;
+}
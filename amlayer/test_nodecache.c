@@ -0,0 +1,154 @@
+/* test_nodecache.c: Benchmark for the node cache (AM_SetNodeCache) on descents, point lookups and inserts */
+#include "am.h"
+#include "testam.h"
+
+#define INDEX_FILE "nodecache_index"
+#define ATTR_LEN 128      /* wide keys: 30 per node, a four-level tree */
+#define NUM_KEYS 100000   /* keys 0, 2, 4, ... bulk loaded */
+#define NUM_LOOKUPS 100000
+#define NUM_INSERTS 20000 /* odd keys, inserted one by one */
+#define HOT_KEYS 300      /* about ten leaves: they stay in the buffer pool */
+
+static void make_key(int k, char *value) {
+  memset(value, 0, ATTR_LEN);
+  sprintf(value, "key%08d", k);
+}
+
+/* Feeds AM_BulkLoad the even keys in order */
+static int next_even(void *arg, char *value, int *recId) {
+  int *next = (int *)arg;
+
+  if (*next == NUM_KEYS)
+    return (AME_EOF);
+  make_key(2 * *next, value);
+  *recId = (*next)++;
+  return (AME_OK);
+}
+
+/* Looks up key k; returns its recId, or -1 if it is not in the index */
+static int lookup(AM_IndexHandle *ih, int k) {
+  char value[ATTR_LEN];
+  AM_ScanHandle sh;
+  int recId;
+
+  make_key(k, value);
+  xAM_OpenIndexScan(ih, &sh, EQUAL, value);
+  recId = xAM_FindNextEntry(&sh);
+  xAM_CloseIndexScan(&sh);
+  return (recId >= 0 ? recId : -1);
+}
+
+/* The PF requests and node-cache hits of one timed phase */
+static void print_row(const char *label, const char *phase, int ops, double elapsed,
+                      AM_IndexHandle *ih) {
+  AM_NodeCacheStats stats;
+  long logical, physical, writes;
+
+  PF_GetStats(&logical, &physical, &writes);
+  AM_GetNodeCacheStats(ih, &stats);
+  printf("| %-10s | %-7s | %10.0f | %14.2f | %13.2f | %12.2f | %13.2f | %5d |\n", label, phase,
+         ops / elapsed, (double)logical / ops, (double)stats.hits / ops,
+         (double)stats.swizzled / ops, (double)physical / ops, stats.nodes);
+}
+
+/*
+ * run
+ * Bulk loads a fresh index, then times NUM_LOOKUPS bare root-to-leaf
+ * descents (AM_Search) to resident leaves, as many random point
+ * lookups through a scan and
+ * NUM_INSERTS random inserts with a node cache of maxNodes (0: none),
+ * and checks every key afterwards.
+ */
+static void run(const char *label, int maxNodes) {
+  AM_IndexHandle ih;
+  char value[ATTR_LEN];
+  unsigned int seed = 12345;
+  double t0;
+  char *pageBuf;
+  int i, k, pageNum, index, next = 0;
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  /* compressed nodes would make the tree shallower */
+  xAM_CreateIndexFlags(INDEX_FILE, 0, 'c', ATTR_LEN, AM_CREATE_NOCOMPRESSION);
+  xAM_OpenIndex(INDEX_FILE, 0, 'c', &ih);
+  if (AM_BulkLoad(&ih, next_even, &next, 1.0f) != AME_OK) {
+    AM_PrintError("AM_BulkLoad");
+    exit(1);
+  }
+  if (AM_SetNodeCache(&ih, maxNodes) != AME_OK) {
+    AM_PrintError("AM_SetNodeCache");
+    exit(1);
+  }
+
+  // 1. Descents alone, to hot leaves: no disk reads, only the cost of each hop
+  PF_ResetStats();
+  t0 = now_sec();
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    make_key(2 * ((seed >> 4) % HOT_KEYS), value);
+    if (AM_Search(&ih, value, NULL, &pageNum, &pageBuf, &index) != AM_FOUND) {
+      printf("*** ERROR: AM_Search missed a key ***\n");
+      exit(1);
+    }
+    PF_UnfixPage(ih.fileDesc, pageNum, FALSE);
+  }
+  print_row(label, "descend", NUM_LOOKUPS, now_sec() - t0, &ih);
+
+  // 2. Point lookups of present keys
+  AM_SetNodeCache(&ih, maxNodes); // Counters start over, the cache refills
+  PF_ResetStats();
+  t0 = now_sec();
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    k = (seed >> 4) % NUM_KEYS;
+    if (lookup(&ih, 2 * k) != k) {
+      printf("*** ERROR: key %d not found ***\n", 2 * k);
+      exit(1);
+    }
+  }
+  print_row(label, "lookup", NUM_LOOKUPS, now_sec() - t0, &ih);
+
+  // 3. Inserts between the loaded keys: full leaves split, so cached parents go stale
+  AM_SetNodeCache(&ih, maxNodes); // Counters start over, the cache refills
+  PF_ResetStats();
+  t0 = now_sec();
+  for (i = 0; i < NUM_INSERTS; i++) {
+    k = (int)((i * 7919L) % NUM_KEYS);
+    make_key(2 * k + 1, value);
+    xAM_InsertEntry(&ih, value, NUM_KEYS + k);
+  }
+  print_row(label, "insert", NUM_INSERTS, now_sec() - t0, &ih);
+
+  // 4. Every key, old and new, through the (possibly cached) upper levels
+  for (i = 0; i < NUM_INSERTS; i++) {
+    k = (int)((i * 7919L) % NUM_KEYS);
+    if (lookup(&ih, 2 * k + 1) != NUM_KEYS + k) {
+      printf("*** ERROR: inserted key %d not found ***\n", 2 * k + 1);
+      exit(1);
+    }
+  }
+  for (k = 0; k < NUM_KEYS; k++) {
+    if (lookup(&ih, 2 * k) != k) {
+      printf("*** ERROR: key %d lost after inserts ***\n", 2 * k);
+      exit(1);
+    }
+  }
+
+  xAM_CloseIndex(&ih); // Drops the node cache
+}
+
+int main(void) {
+  PF_Init();
+  printf("Index: %d keys of %d bytes, bulk loaded (four levels); %d lookups, %d inserts\n\n",
+         NUM_KEYS, ATTR_LEN, NUM_LOOKUPS, NUM_INSERTS);
+  printf("| Node cache | Phase   | Ops/s      | PF requests/op | Cache hits/op | Swizzled/op  | Disk reads/op | Nodes |\n");
+  printf("|------------|---------|------------|----------------|---------------|--------------|---------------|-------|\n");
+  run("off", 0);
+  run("1 node", 1);
+  run("8 nodes", 8);
+  run("256 nodes", 256);
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\n*** Node Cache Test Passed! ***\n");
+  return 0;
+}
@@ -46,13 +46,36 @@ RID unpack_rid(int packed_rid) {
 /*
  * =================================================================
  * Method 1: Build index from an existing, (pre-sorted) file
- * This is our "efficient bulk-loading technique"
+ * This is our "efficient bulk-loading technique": AM_BulkLoad
+ * fills the leaves left to right and writes each page once
  * =================================================================
  */
+
+/* Feeds AM_BulkLoad the (key, packed RID) pairs of an RM scan */
+typedef struct {
+    RM_ScanHandle *scan;
+    int *count;
+} ScanFeed;
+
+int next_from_scan(void *arg, char *value, int *recId) {
+    ScanFeed *feed = (ScanFeed *)arg;
+    char record_data[30];
+    RID rid;
+    int key;
+
+    if (RM_GetNextRec(feed->scan, record_data, &rid) != PFE_OK)
+        return AME_EOF;
+    sscanf(record_data, "Student_Name_%d", &key);
+    memcpy(value, &key, sizeof(int));
+    *recId = pack_rid(rid);
+    (*feed->count)++;
+    return AME_OK;
+}
+
 void method1_BuildFromExisting(MethodStats *stats) {
     RM_FileHandle rm_fh;
     RM_ScanHandle rm_sh;
-    int am_fd;
+    AM_IndexHandle am_ih;
     RID rid;
     int i, err, key;
     char record_data[30];
@@ -87,11 +110,8 @@ void method1_BuildFromExisting(MethodStats *stats) {
     // 4. Create and open the new index file (AM)
     err = AM_CreateIndex(INDEX_FILE, INDEX_NO, ATTR_TYPE, ATTR_LEN);
     if (err != AME_OK) { AM_PrintError("AM_CreateIndex"); exit(1); }
-    
-    char index_fname[AM_MAX_FNAME_LENGTH];
-    sprintf(index_fname, "%s.%d", INDEX_FILE, INDEX_NO);
-    am_fd = PF_OpenFile(index_fname);
-    if (am_fd < 0) { PF_PrintError("PF_OpenFile (index)"); exit(1); }
+    err = AM_OpenIndex(INDEX_FILE, INDEX_NO, ATTR_TYPE, &am_ih);
+    if (err != AME_OK) { AM_PrintError("AM_OpenIndex"); exit(1); }
 
     // 5. Re-open the data file and scan it
     printf("Scanning data file and building index...\n");
@@ -100,15 +120,11 @@ void method1_BuildFromExisting(MethodStats *stats) {
     err = RM_ScanOpen(&rm_fh, &rm_sh);
     if (err != AME_OK) { PF_PrintError("RM_ScanOpen"); exit(1); }
 
-    // 6. For each record, add an entry to the index
+    // 6. Build the index bottom-up from the sorted scan
     int count = 0;
-    while((err = RM_GetNextRec(&rm_sh, record_data, &rid)) != RM_EOF) {
-        sscanf(record_data, "Student_Name_%d", &key);
-        int packed_rid = pack_rid(rid);
-        err = AM_InsertEntry(am_fd, ATTR_TYPE, ATTR_LEN, (char *)&key, packed_rid);
-        if (err != AME_OK) { AM_PrintError("AM_InsertEntry"); exit(1); }
-        count++;
-    }
+    ScanFeed feed = { &rm_sh, &count };
+    err = AM_BulkLoad(&am_ih, next_from_scan, &feed, 1.0f);
+    if (err != AME_OK) { AM_PrintError("AM_BulkLoad"); exit(1); }
     
     // 7. --- STOP TIMING ---
     end = clock();
@@ -121,7 +137,7 @@ void method1_BuildFromExisting(MethodStats *stats) {
     // 9. Close all files
     RM_ScanClose(&rm_sh);
     RM_CloseFile(&rm_fh);
-    PF_CloseFile(am_fd);
+    AM_CloseIndex(&am_ih);
     
     // 10. Cleanup
     RM_DestroyFile(DATA_FILE);
@@ -136,7 +152,7 @@ void method1_BuildFromExisting(MethodStats *stats) {
  */
 void method2_InsertOneByOne(MethodStats *stats) {
     RM_FileHandle rm_fh;
-    int am_fd;
+    AM_IndexHandle am_ih;
     RID rid;
     int i;
     int err;
@@ -156,11 +172,8 @@ void method2_InsertOneByOne(MethodStats *stats) {
     // 3. Create and open the index file (AM)
     err = AM_CreateIndex(INDEX_FILE, INDEX_NO, ATTR_TYPE, ATTR_LEN);
     if (err != AME_OK) { AM_PrintError("AM_CreateIndex"); exit(1); }
-    
-    char index_fname[AM_MAX_FNAME_LENGTH];
-    sprintf(index_fname, "%s.%d", INDEX_FILE, INDEX_NO);
-    am_fd = PF_OpenFile(index_fname);
-    if (am_fd < 0) { PF_PrintError("PF_OpenFile (index)"); exit(1); }
+    err = AM_OpenIndex(INDEX_FILE, INDEX_NO, ATTR_TYPE, &am_ih);
+    if (err != AME_OK) { AM_PrintError("AM_OpenIndex"); exit(1); }
 
     // 4. --- START TIMING ---
     start = clock();
@@ -181,7 +194,7 @@ void method2_InsertOneByOne(MethodStats *stats) {
         int packed_rid = pack_rid(rid);
 
         // 4c. Insert (key, packed_RID) into index file
-        err = AM_InsertEntry(am_fd, ATTR_TYPE, ATTR_LEN, (char *)&key, packed_rid);
+        err = AM_InsertEntry(&am_ih, (char *)&key, packed_rid);
         if (err != AME_OK) { AM_PrintError("AM_InsertEntry"); exit(1); }
     }
     
@@ -196,8 +209,8 @@ void method2_InsertOneByOne(MethodStats *stats) {
     // 7. Close files
     err = RM_CloseFile(&rm_fh);
     if (err != AME_OK) { PF_PrintError("RM_CloseFile"); exit(1); }
-    err = PF_CloseFile(am_fd);
-    if (err != AME_OK) { PF_PrintError("PF_CloseFile"); exit(1); }
+    err = AM_CloseIndex(&am_ih);
+    if (err != AME_OK) { AM_PrintError("AM_CloseIndex"); exit(1); }
     
     // 8. Cleanup
     RM_DestroyFile(DATA_FILE);
@@ -235,7 +248,7 @@ int main(void) {
     printf("| Method                                | Time (sec) | Physical Reads | Physical Writes | Logical Reads |\n");
     printf("|---------------------------------------|------------|----------------|-----------------|---------------|\n");
     
-    printf("| 1: Scan Sorted File (Simple Bulk Load) | %-10.4f | %-14ld | %-15ld | %-13ld |\n", 
+    printf("| 1: Scan Sorted File (AM_BulkLoad)     | %-10.4f | %-14ld | %-15ld | %-13ld |\n", 
            stats1.cpu_time, stats1.physical_reads, stats1.physical_writes, stats1.logical_reads);
     
     printf("| 2: Insert One-by-One (Random)         | %-10.4f | %-14ld | %-15ld | %-13ld |\n", 
@@ -0,0 +1,325 @@
+/* test_postings.c: Benchmark for posting lists (AM_CreateIndexFlags): entries per leaf and scan cost of low-cardinality indexes, and their lookups, scans, deletes and bulk load */
+#include "am.h"
+#include "testam.h"
+
+#define INDEX_FILE "postings_index"
+#define NUM_ROWS 200000  /* rows of each index; row r has recId r */
+#define SCAN_ROUNDS 5    /* full scans timed per index */
+
+static const int cardinalities[] = {20, 1000, 20000};
+
+/* Rows of each value in recId order: value v has rows[start[v] .. start[v + 1]) */
+static int rows[NUM_ROWS];
+static int start[NUM_ROWS + 1];
+
+/* The value of row r among card values, scattered over the rows */
+static int row_value(int r, int card) {
+  return (int)(((unsigned int)r * 2654435761u >> 7) % (unsigned int)card);
+}
+
+/* Sorts the rows by value into rows and start */
+static void group_rows(int card) {
+  int r, v;
+
+  memset(start, 0, (card + 1) * sizeof(int));
+  for (r = 0; r < NUM_ROWS; r++)
+    start[row_value(r, card) + 1]++;
+  for (v = 0; v < card; v++)
+    start[v + 1] += start[v];
+  for (r = 0; r < NUM_ROWS; r++)
+    rows[start[row_value(r, card)]++] = r;
+  for (v = card; v > 0; v--)
+    start[v] = start[v - 1];
+  start[0] = 0;
+}
+
+/* Feeds AM_BulkLoad the rows by value, each value's in recId order */
+typedef struct {
+  int next;
+  int card;
+} Loader;
+
+static int next_row(void *arg, char *value, int *recId) {
+  Loader *l = (Loader *)arg;
+  int v;
+
+  if (l->next == NUM_ROWS)
+    return (AME_EOF);
+  *recId = rows[l->next++];
+  v = row_value(*recId, l->card);
+  memcpy(value, &v, sizeof(int));
+  return (AME_OK);
+}
+
+/* Counts the leaves, and the posting pages their keys point to */
+static void count_pages(AM_IndexHandle *ih, int *numLeaves, int *numPostingPages) {
+  AM_LEAFHEADER header;
+  AM_POSTINGHEADER ph;
+  AM_POSTINGREF ref;
+  char page[PF_PAGE_SIZE];
+  char *pageBuf;
+  int pageNum = GetLeftPageNum(ih), p, i;
+  short off, size;
+
+  *numLeaves = 0;
+  *numPostingPages = 0;
+  while (pageNum != AM_NULL_PAGE) {
+    PF_GetThisPage(ih->fileDesc, pageNum, &pageBuf);
+    memcpy(page, pageBuf, PF_PAGE_SIZE);
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    memcpy(&header, page, AM_sl);
+    for (i = 1; header.postings && i <= header.numKeys; i++) {
+      off = AM_LeafList(page, i);
+      memcpy(&size, page + off, AM_ss);
+      if (size != AM_POSTING_PAGES)
+        continue;
+      memcpy(&ref, page + off + AM_ss, sizeof(ref));
+      for (p = ref.firstPage; p != AM_NULL_PAGE; p = ph.nextPage) {
+        PF_GetThisPage(ih->fileDesc, p, &pageBuf);
+        memcpy(&ph, pageBuf, AM_sp);
+        PF_UnfixPage(ih->fileDesc, p, FALSE);
+        (*numPostingPages)++;
+      }
+    }
+    pageNum = header.nextLeafPage;
+    (*numLeaves)++;
+  }
+}
+
+/* TRUE if row r was deleted: every step'th one, none for step 0 */
+static int deleted(int r, int step) { return (step > 0 && r % step == 0); }
+
+/* Every value has its rows, in recId order, and a value past the last none */
+static void check_lookups(AM_IndexHandle *ih, int card, int step) {
+  static int recIds[NUM_ROWS];
+  int v, i, j, n;
+
+  for (v = 0; v <= card; v++) {
+    n = AM_LookupEntry(ih, (char *)&v, recIds, NUM_ROWS);
+    for (i = (v < card) ? start[v] : 0, j = 0; v < card && i < start[v + 1]; i++) {
+      if (deleted(rows[i], step))
+        continue;
+      if (j >= n || recIds[j] != rows[i]) {
+        printf("*** ERROR: lookup of value %d (of %d) went wrong at row %d ***\n", v, card,
+               rows[i]);
+        exit(1);
+      }
+      j++;
+    }
+    if (n != j) {
+      printf("*** ERROR: value %d (of %d) has %d rows, expected %d ***\n", v, card, n, j);
+      exit(1);
+    }
+  }
+}
+
+/* A full scan returns the values in order, each value's rows in recId
+order; an equality scan returns just one value's */
+static void check_scans(AM_IndexHandle *ih, int card, int step) {
+  AM_ScanHandle sh;
+  int recId, i, n = 0, v = card / 2;
+
+  xAM_OpenIndexScan(ih, &sh, EQUAL, NULL);
+  for (i = 0; i < NUM_ROWS; i++) {
+    if (deleted(rows[i], step))
+      continue;
+    if ((recId = xAM_FindNextEntry(&sh)) != rows[i]) {
+      printf("*** ERROR: scan returned %d, expected row %d (of %d values) ***\n", recId,
+             rows[i], card);
+      exit(1);
+    }
+  }
+  if ((recId = xAM_FindNextEntry(&sh)) != AME_EOF) {
+    printf("*** ERROR: scan returned %d past the last row ***\n", recId);
+    exit(1);
+  }
+  xAM_CloseIndexScan(&sh);
+
+  xAM_OpenIndexScan(ih, &sh, EQUAL, (char *)&v);
+  for (i = start[v]; i < start[v + 1]; i++) {
+    if (deleted(rows[i], step))
+      continue;
+    if ((recId = xAM_FindNextEntry(&sh)) != rows[i]) {
+      printf("*** ERROR: scan of value %d returned %d, expected %d ***\n", v, recId, rows[i]);
+      exit(1);
+    }
+    n++;
+  }
+  if (xAM_FindNextEntry(&sh) != AME_EOF) {
+    printf("*** ERROR: scan of value %d ran past its %d rows ***\n", v, n);
+    exit(1);
+  }
+  xAM_CloseIndexScan(&sh);
+}
+
+/*
+ * run
+ * Builds an index of NUM_ROWS rows over card values by inserts in recId
+ * order, with posting lists or not, and prints its size and the cost of
+ * a full scan, then checks it. Without posting lists a value whose rows
+ * do not fit a leaf cannot be indexed, which the row says.
+ */
+static void run(int card, int postings) {
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  long logical, physical, writes;
+  double t0;
+  int r, v, i, errVal, numLeaves, numPostingPages;
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndexFlags(INDEX_FILE, 0, 'i', sizeof(int), postings ? 0 : AM_CREATE_NOPOSTINGS);
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  t0 = now_sec();
+  for (r = 0; r < NUM_ROWS; r++) {
+    v = row_value(r, card);
+    errVal = AM_InsertEntry(&ih, (char *)&v, r);
+    if (errVal == AME_DUPOVERFLOW) {
+      printf("| %6d | %-3s | %5d rows of a value overflow their leaf                              |\n",
+             card, postings ? "on" : "off", NUM_ROWS / card);
+      xAM_CloseIndex(&ih);
+      return;
+    }
+    if (errVal != AME_OK) {
+      AM_PrintError("AM_InsertEntry");
+      exit(1);
+    }
+  }
+  t0 = now_sec() - t0;
+  count_pages(&ih, &numLeaves, &numPostingPages);
+  printf("| %6d | %-3s | %7.2f | %6d | %8d | %9.1f | %9.2f |", card, postings ? "on" : "off", t0,
+         numLeaves, numPostingPages, (double)NUM_ROWS / (numLeaves + numPostingPages),
+         (double)(numLeaves + numPostingPages) * PF_PAGE_SIZE / NUM_ROWS);
+
+  PF_ResetStats();
+  t0 = now_sec();
+  for (i = 0; i < SCAN_ROUNDS; i++) {
+    xAM_OpenIndexScan(&ih, &sh, EQUAL, NULL);
+    while (xAM_FindNextEntry(&sh) >= 0)
+      ;
+    xAM_CloseIndexScan(&sh);
+  }
+  t0 = (now_sec() - t0) / SCAN_ROUNDS;
+  PF_GetStats(&logical, &physical, &writes);
+  printf(" %7.2f | %8.1f |\n", t0 * 1e3, (double)logical / SCAN_ROUNDS / NUM_ROWS * 1000);
+
+  /* linked lists hand recIds out in no particular order */
+  if (postings) {
+    check_lookups(&ih, card, 0);
+    check_scans(&ih, card, 0);
+  }
+  xAM_CloseIndex(&ih);
+}
+
+/*
+ * check_updates
+ * With posting lists: deletes every third row, from the back so lists
+ * shrink in the middle of their pages, and checks the index; inserts
+ * them back in the same order, so they land inside lists and split full
+ * posting pages; deletes all rows of one value while an equality scan
+ * of it runs, and looks up a value kept on posting pages in concurrent
+ * mode. Then builds the index again by bulk load and checks that.
+ */
+static void check_updates(int card) {
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  Loader loader = {0, 0};
+  int recIds[4];
+  int r, v, n, recId, numLeaves, numPostingPages;
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, 'i', sizeof(int));
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  for (r = 0; r < NUM_ROWS; r++) {
+    v = row_value(r, card);
+    xAM_InsertEntry(&ih, (char *)&v, r);
+  }
+
+  for (r = NUM_ROWS - 1; r >= 0; r--)
+    if (deleted(r, 3)) {
+      v = row_value(r, card);
+      xAM_DeleteEntry(&ih, (char *)&v, r);
+    }
+  check_lookups(&ih, card, 3);
+  check_scans(&ih, card, 3);
+  for (r = NUM_ROWS - 1; r >= 0; r--)
+    if (deleted(r, 3)) {
+      v = row_value(r, card);
+      xAM_InsertEntry(&ih, (char *)&v, r);
+    }
+  check_lookups(&ih, card, 0);
+  check_scans(&ih, card, 0);
+
+  /* a value on posting pages, looked up without the latch */
+  v = 0;
+  AM_SetConcurrent(&ih, TRUE);
+  n = AM_LookupEntry(&ih, (char *)&v, recIds, 4);
+  AM_SetConcurrent(&ih, FALSE);
+  for (r = 0; r < 4 && r < n; r++)
+    if (recIds[r] != rows[r])
+      n = -1;
+  if (n != start[1]) {
+    printf("*** ERROR: concurrent lookup of value 0 returned %d rows ***\n", n);
+    exit(1);
+  }
+
+  /* each row of value 0 deleted as the scan returns it */
+  n = 0;
+  xAM_OpenIndexScan(&ih, &sh, EQUAL, (char *)&v);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    if (recId != rows[n]) {
+      printf("*** ERROR: deleting scan returned %d, expected %d ***\n", recId, rows[n]);
+      exit(1);
+    }
+    xAM_DeleteEntry(&ih, (char *)&v, recId);
+    n++;
+  }
+  xAM_CloseIndexScan(&sh);
+  if (n != start[1] || AM_LookupEntry(&ih, (char *)&v, recIds, 4) != 0) {
+    printf("*** ERROR: deleting scan went over %d of %d rows ***\n", n, start[1]);
+    exit(1);
+  }
+  xAM_CloseIndex(&ih);
+
+  /* the same rows bulk loaded */
+  loader.card = card;
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, 'i', sizeof(int));
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', &ih);
+  if (AM_BulkLoad(&ih, next_row, &loader, 1.0f) != AME_OK) {
+    AM_PrintError("AM_BulkLoad");
+    exit(1);
+  }
+  count_pages(&ih, &numLeaves, &numPostingPages);
+  check_lookups(&ih, card, 0);
+  check_scans(&ih, card, 0);
+  xAM_CloseIndex(&ih);
+  printf("%6d values: deletes, inserts inside lists and a deleting scan checked; bulk load: "
+         "%d leaves, %d posting pages\n",
+         card, numLeaves, numPostingPages);
+}
+
+int main(void) {
+  int c, postings;
+
+  PF_Init();
+  printf("%d rows of 'i' values, inserted in recId order; %d full scans timed per index\n\n",
+         NUM_ROWS, SCAN_ROUNDS);
+  printf("| Values | Pst | Build s | Leaves | Posting  | Rows/page | Bytes/row | Scan    | PF reads |\n");
+  printf("|        |     |         |        | pages    |           |           | (ms)    | /1k rows |\n");
+  printf("|--------|-----|---------|--------|----------|-----------|-----------|---------|----------|\n");
+  for (c = 0; c < (int)(sizeof(cardinalities) / sizeof(cardinalities[0])); c++) {
+    group_rows(cardinalities[c]);
+    for (postings = 0; postings <= 1; postings++)
+      run(cardinalities[c], postings);
+  }
+
+  printf("\n");
+  for (c = 0; c < (int)(sizeof(cardinalities) / sizeof(cardinalities[0])); c++) {
+    group_rows(cardinalities[c]);
+    check_updates(cardinalities[c]);
+  }
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\n*** Posting List Test Passed! ***\n");
+  return 0;
+}
@@ -0,0 +1,235 @@
+/* test_prefix.c: Benchmark for compressed nodes (AM_CreateIndexFlags): tree height, fan-out and page reads per lookup with wide char keys */
+#include "am.h"
+#include "testam.h"
+
+#define INDEX_FILE "prefix_index"
+#define NUM_KEYS 100000   /* keys of each index, built by bulk load or by inserts */
+#define NUM_LOOKUPS 100000
+#define KEYS_PER_CUSTOMER 20
+
+static const int widths[] = {32, 128, 255};
+
+/* Key k: a path sharing most of its bytes with its neighbours, in
+ascending order of k */
+static void make_key(int k, char *value, int width) {
+  memset(value, 0, width);
+  snprintf(value, width, "/customers/%05d/orders/%07d", k / KEYS_PER_CUSTOMER, k);
+}
+
+/* Feeds AM_BulkLoad the keys in order */
+typedef struct {
+  int next;
+  int width;
+} Loader;
+
+static int next_key(void *arg, char *value, int *recId) {
+  Loader *l = (Loader *)arg;
+
+  if (l->next == NUM_KEYS)
+    return (AME_EOF);
+  make_key(l->next, value, l->width);
+  *recId = l->next++;
+  return (AME_OK);
+}
+
+/* Levels of the tree, down its leftmost path */
+static int height(AM_IndexHandle *ih) {
+  AM_INTHEADER header;
+  char *pageBuf;
+  int pageNum = ih->rootPageNum, child, levels = 1;
+
+  for (;;) {
+    PF_GetThisPage(ih->fileDesc, pageNum, &pageBuf);
+    memcpy(&header, pageBuf, AM_sint);
+    child = (header.pageType == 'i') ? AM_IntChild(pageBuf, &header, 0) : AM_NULL_PAGE;
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    if (child == AM_NULL_PAGE)
+      return (levels);
+    pageNum = child;
+    levels++;
+  }
+}
+
+/* Internal nodes of the subtree at pageNum, depth levels above the leaves */
+static int internal_nodes(AM_IndexHandle *ih, int pageNum, int depth) {
+  AM_INTHEADER header;
+  char page[PF_PAGE_SIZE];
+  char *pageBuf;
+  int i, n = 1;
+
+  if (depth == 0)
+    return (0);
+  PF_GetThisPage(ih->fileDesc, pageNum, &pageBuf);
+  memcpy(page, pageBuf, PF_PAGE_SIZE);
+  PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+  memcpy(&header, page, AM_sint);
+  for (i = 0; i <= header.numKeys; i++)
+    n += internal_nodes(ih, AM_IntChild(page, &header, i), depth - 1);
+  return (n);
+}
+
+/* Leaves, along their chain */
+static int leaves(AM_IndexHandle *ih) {
+  AM_LEAFHEADER header;
+  char *pageBuf;
+  int pageNum = GetLeftPageNum(ih), n = 0;
+
+  while (pageNum != AM_NULL_PAGE) {
+    PF_GetThisPage(ih->fileDesc, pageNum, &pageBuf);
+    memcpy(&header, pageBuf, AM_sl);
+    PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+    pageNum = header.nextLeafPage;
+    n++;
+  }
+  return (n);
+}
+
+/* TRUE if key k was deleted: every step'th one, none for step 0 */
+static int deleted(int k, int step) { return (step > 0 && k % step == 0); }
+
+/* Every key found with its recId, and a key just past each one not */
+static void check_lookups(AM_IndexHandle *ih, int width, int step) {
+  char value[AM_MAXATTRLENGTH];
+  int k, recIds[2];
+
+  for (k = 0; k < NUM_KEYS; k++) {
+    make_key(k, value, width);
+    if (AM_LookupEntry(ih, value, recIds, 2) != !deleted(k, step) ||
+        (!deleted(k, step) && recIds[0] != k)) {
+      printf("*** ERROR: lookup of %s (width %d) went wrong ***\n", value, width);
+      exit(1);
+    }
+    value[strlen(value)] = 'x';
+    if (AM_LookupEntry(ih, value, recIds, 2) != 0) {
+      printf("*** ERROR: absent key %s found ***\n", value);
+      exit(1);
+    }
+  }
+}
+
+/* A full scan returns the keys in order; so does a range scan from
+the middle of a customer's keys */
+static void check_scans(AM_IndexHandle *ih, int width, int step) {
+  AM_ScanHandle sh;
+  char value[AM_MAXATTRLENGTH];
+  int recId, prev = -1, n = 0;
+
+  xAM_OpenIndexScan(ih, &sh, EQUAL, NULL);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    if (recId <= prev || deleted(recId, step)) {
+      printf("*** ERROR: scan returned %d after %d (width %d) ***\n", recId, prev, width);
+      exit(1);
+    }
+    prev = recId;
+    n++;
+  }
+  xAM_CloseIndexScan(&sh);
+  if (n != NUM_KEYS - (step > 0 ? (NUM_KEYS + step - 1) / step : 0)) {
+    printf("*** ERROR: scan returned %d keys (width %d) ***\n", n, width);
+    exit(1);
+  }
+
+  make_key(NUM_KEYS / 2 + 5, value, width);
+  value[strlen(value) - 1] = '\0'; /* below key NUM_KEYS / 2, its customer's first */
+  xAM_OpenIndexScan(ih, &sh, GREATER_THAN_EQUAL, value);
+  recId = xAM_FindNextEntry(&sh);
+  xAM_CloseIndexScan(&sh);
+  if (recId != NUM_KEYS / 2 + deleted(NUM_KEYS / 2, step)) {
+    printf("*** ERROR: range scan started at %d (width %d) ***\n", recId, width);
+    exit(1);
+  }
+}
+
+/*
+ * run
+ * Builds an index of NUM_KEYS keys of width bytes, by bulk load or by
+ * inserts in random order, with compressed nodes or not; prints its
+ * shape and the cost of NUM_LOOKUPS random lookups, then checks it,
+ * deletes every third key and checks it again, and once more after they
+ * are inserted back.
+ */
+static void run(int width, int compress, int bulk) {
+  AM_IndexHandle ih;
+  Loader loader = {0, width};
+  char value[AM_MAXATTRLENGTH];
+  unsigned int seed = 12345;
+  long logical, physical, writes;
+  double t0, build;
+  int i, k, levels, numLeaves, numInternal, recIds[2];
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndexFlags(INDEX_FILE, 0, 'c', width, compress ? 0 : AM_CREATE_NOCOMPRESSION);
+  xAM_OpenIndex(INDEX_FILE, 0, 'c', &ih);
+  t0 = now_sec();
+  if (bulk) {
+    if (AM_BulkLoad(&ih, next_key, &loader, 1.0f) != AME_OK) {
+      AM_PrintError("AM_BulkLoad");
+      exit(1);
+    }
+  } else {
+    for (i = 0; i < NUM_KEYS; i++) {
+      k = (int)((i * 7919L) % NUM_KEYS);
+      make_key(k, value, width);
+      xAM_InsertEntry(&ih, value, k);
+    }
+  }
+  build = now_sec() - t0;
+
+  levels = height(&ih);
+  numLeaves = leaves(&ih);
+  numInternal = internal_nodes(&ih, ih.rootPageNum, levels - 1);
+
+  PF_ResetStats();
+  t0 = now_sec();
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    k = (seed >> 4) % NUM_KEYS;
+    make_key(k, value, width);
+    if (AM_LookupEntry(&ih, value, recIds, 2) != 1 || recIds[0] != k) {
+      printf("*** ERROR: lookup of key %d failed ***\n", k);
+      exit(1);
+    }
+  }
+  t0 = now_sec() - t0;
+  PF_GetStats(&logical, &physical, &writes);
+  printf("| %5d | %-3s | %-6s | %7.2f | %6d | %6d | %9.1f | %7.1f | %8.2f | %10.2f | %6.0f |\n",
+         width, compress ? "on" : "off", bulk ? "bulk" : "insert", build, levels, numLeaves,
+         (double)NUM_KEYS / numLeaves, (double)(numLeaves + numInternal - 1) / numInternal,
+         (double)logical / NUM_LOOKUPS, (double)physical / NUM_LOOKUPS, t0 / NUM_LOOKUPS * 1e9);
+
+  check_lookups(&ih, width, 0);
+  check_scans(&ih, width, 0);
+  for (k = 0; k < NUM_KEYS; k += 3) {
+    make_key(k, value, width);
+    xAM_DeleteEntry(&ih, value, k);
+  }
+  check_lookups(&ih, width, 3);
+  check_scans(&ih, width, 3);
+  for (k = NUM_KEYS - NUM_KEYS % 3; k >= 0; k -= 3) {
+    make_key(k, value, width);
+    xAM_InsertEntry(&ih, value, k);
+  }
+  check_lookups(&ih, width, 0);
+  check_scans(&ih, width, 0);
+  xAM_CloseIndex(&ih);
+}
+
+int main(void) {
+  int w, compress, bulk;
+
+  PF_Init();
+  printf("%d 'c' keys \"/customers/<5 digits>/orders/<7 digits>\" per index; %d random lookups\n\n",
+         NUM_KEYS, NUM_LOOKUPS);
+  printf("| Width | Cmp | Build  | Build s | Levels | Leaves | Keys/leaf | Fan-out | PF reads | Disk reads | Lookup |\n");
+  printf("|       |     |        |         |        |        |           |         | /lookup  | /lookup    | (ns)   |\n");
+  printf("|-------|-----|--------|---------|--------|--------|-----------|---------|----------|------------|--------|\n");
+  for (w = 0; w < (int)(sizeof(widths) / sizeof(widths[0])); w++)
+    for (bulk = 1; bulk >= 0; bulk--)
+      for (compress = 0; compress <= 1; compress++)
+        run(widths[w], compress, bulk);
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\nLookups, scans, deletes and inserts after them checked on every index\n");
+  printf("\n*** Prefix Compression Test Passed! ***\n");
+  return 0;
+}
@@ -0,0 +1,220 @@
+/* test_search.c: Benchmark for the typed node search (AM_SetSearchLevel) on int keys at several tree sizes */
+#include "am.h"
+#include "testam.h"
+
+#define INDEX_FILE "search_index"
+#define NUM_LOOKUPS 200000 /* random point lookups per level and size */
+#define NODE_SEARCHES 2000000 /* searches of one full leaf per level */
+#define NUM_INSERTS 20000  /* odd keys inserted one by one, per level */
+
+static const int sizes[] = {1000, 10000, 100000, 1000000};
+static const char *level_names[] = {"compare", "scalar", "sse", "avx2"};
+
+/* Key of recId i in an index of n keys: even, from -n up */
+static int key_of(int i, int n) { return 2 * i - n; }
+
+/* Feeds AM_BulkLoad the keys of an index of n keys in order */
+typedef struct {
+  int next;
+  int n;
+} Loader;
+
+static int next_key(void *arg, char *value, int *recId) {
+  Loader *l = (Loader *)arg;
+  int k;
+
+  if (l->next == l->n)
+    return (AME_EOF);
+  k = key_of(l->next, l->n);
+  memcpy(value, &k, sizeof(int));
+  *recId = l->next++;
+  return (AME_OK);
+}
+
+static void open_loaded(AM_IndexHandle *ih, int n) {
+  Loader loader = {0, n};
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  xAM_CreateIndex(INDEX_FILE, 0, 'i', sizeof(int));
+  xAM_OpenIndex(INDEX_FILE, 0, 'i', ih);
+  if (AM_BulkLoad(ih, next_key, &loader, 1.0f) != AME_OK) {
+    AM_PrintError("AM_BulkLoad");
+    exit(1);
+  }
+}
+
+/* Every present key at the level in use, and none of the odd keys between them */
+static void check_keys(AM_IndexHandle *ih, int n) {
+  int i, k, recIds[2];
+
+  for (i = 0; i < n; i++) {
+    k = key_of(i, n);
+    if (AM_LookupEntry(ih, (char *)&k, recIds, 2) != 1 || recIds[0] != i) {
+      printf("*** ERROR: key %d not found ***\n", k);
+      exit(1);
+    }
+    k++;
+    if (AM_LookupEntry(ih, (char *)&k, recIds, 2) != 0) {
+      printf("*** ERROR: absent key %d found ***\n", k);
+      exit(1);
+    }
+  }
+}
+
+/* Seconds per AM_SearchLeaf over the full first leaf of ih */
+static double time_node_search(AM_IndexHandle *ih, int n) {
+  AM_LEAFHEADER header;
+  char *pageBuf;
+  unsigned int seed = 12345;
+  double t0;
+  int i, k, pageNum, index, numKeys, hits = 0;
+
+  k = key_of(0, n);
+  if (AM_Search(ih, (char *)&k, NULL, &pageNum, &pageBuf, &index) != AM_FOUND) {
+    printf("*** ERROR: AM_Search missed the first key ***\n");
+    exit(1);
+  }
+  memcpy(&header, pageBuf, AM_sl);
+  numKeys = header.numKeys;
+  t0 = now_sec();
+  for (i = 0; i < NODE_SEARCHES; i++) {
+    seed = seed * 1103515245u + 12345u;
+    k = key_of(0, n) + (int)((seed >> 4) % (2 * numKeys));
+    hits += (AM_SearchLeaf(pageBuf, &ih->keyType, (char *)&k, &index, &header) == AM_FOUND);
+  }
+  t0 = now_sec() - t0;
+  PF_UnfixPage(ih->fileDesc, pageNum, FALSE);
+  if (hits == 0 || hits == NODE_SEARCHES) {
+    printf("*** ERROR: node search found %d of %d keys ***\n", hits, NODE_SEARCHES);
+    exit(1);
+  }
+  return t0 / NODE_SEARCHES;
+}
+
+/* Seconds per random point lookup of a present key */
+static double time_lookups(AM_IndexHandle *ih, int n) {
+  unsigned int seed = 54321;
+  double t0;
+  int i, r, k, recIds[2];
+
+  t0 = now_sec();
+  for (i = 0; i < NUM_LOOKUPS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    r = (seed >> 4) % n;
+    k = key_of(r, n);
+    if (AM_LookupEntry(ih, (char *)&k, recIds, 2) != 1 || recIds[0] != r) {
+      printf("*** ERROR: lookup of key %d failed ***\n", k);
+      exit(1);
+    }
+  }
+  return (now_sec() - t0) / NUM_LOOKUPS;
+}
+
+/* Inserts go through the same searches: odd keys between the loaded
+ones, then every key once and in order through a scan */
+static void check_inserts(int level) {
+  AM_IndexHandle ih;
+  AM_ScanHandle sh;
+  int i, k, recId, n = 10000, prev = -1, count = 0;
+
+  AM_SetSearchLevel(level);
+  open_loaded(&ih, n);
+  for (i = 0; i < NUM_INSERTS && i < n; i++) {
+    k = key_of((int)((i * 7919L) % n), n) + 1;
+    xAM_InsertEntry(&ih, (char *)&k, n + (k + n - 1) / 2);
+  }
+  xAM_OpenIndexScan(&ih, &sh, EQUAL, NULL);
+  while ((recId = xAM_FindNextEntry(&sh)) >= 0) {
+    /* loaded key 2i - n has recId i, inserted key 2i + 1 - n has n + i */
+    k = (recId < n) ? key_of(recId, n) : key_of(recId - n, n) + 1;
+    if (k <= prev && count > 0) {
+      printf("*** ERROR: scan out of order at level %s ***\n", level_names[level]);
+      exit(1);
+    }
+    prev = k;
+    count++;
+  }
+  xAM_CloseIndexScan(&sh);
+  xAM_CloseIndex(&ih);
+  if (count != 2 * n) {
+    printf("*** ERROR: %d keys after inserts at level %s, expected %d ***\n", count,
+           level_names[level], 2 * n);
+    exit(1);
+  }
+}
+
+/* Float keys, a NaN among the values looked up */
+static void check_floats(int level) {
+  AM_IndexHandle ih;
+  float f, nan = 0.0f / 0.0f;
+  int i, recIds[2], n = 5000;
+
+  AM_SetSearchLevel(level);
+  AM_DestroyIndex(INDEX_FILE, 1);
+  xAM_CreateIndex(INDEX_FILE, 1, 'f', sizeof(float));
+  xAM_OpenIndex(INDEX_FILE, 1, 'f', &ih);
+  for (i = 0; i < n; i++) {
+    f = (float)((i * 7919L) % n) * 0.25f - 100.0f;
+    xAM_InsertEntry(&ih, (char *)&f, (int)((i * 7919L) % n));
+  }
+  for (i = 0; i < n; i++) {
+    f = i * 0.25f - 100.0f;
+    if (AM_LookupEntry(&ih, (char *)&f, recIds, 2) != 1 || recIds[0] != i) {
+      printf("*** ERROR: float key %g not found at level %s ***\n", f, level_names[level]);
+      exit(1);
+    }
+    f += 0.125f;
+    if (AM_LookupEntry(&ih, (char *)&f, recIds, 2) != 0) {
+      printf("*** ERROR: absent float key %g found ***\n", f);
+      exit(1);
+    }
+  }
+  if (AM_LookupEntry(&ih, (char *)&nan, recIds, 2) < 0) {
+    AM_PrintError("AM_LookupEntry(NaN)");
+    exit(1);
+  }
+  xAM_CloseIndex(&ih);
+  AM_DestroyIndex(INDEX_FILE, 1);
+}
+
+int main(void) {
+  AM_IndexHandle ih;
+  double node[4], lookup[4];
+  int s, level, best;
+
+  PF_Init();
+  best = AM_SetSearchLevel(AM_SEARCH_AVX2);
+  printf("Int keys bulk loaded; %d random lookups, %d searches of one full leaf per level\n",
+         NUM_LOOKUPS, NODE_SEARCHES);
+  printf("Best search level of this CPU: %s\n\n", level_names[best]);
+  printf("| Keys    | Level   | Node search (ns) | Speedup | Lookup (ns) | Speedup |\n");
+  printf("|---------|---------|------------------|---------|-------------|---------|\n");
+  for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+    AM_SetSearchLevel(AM_SEARCH_COMPARE);
+    open_loaded(&ih, sizes[s]);
+    for (level = AM_SEARCH_COMPARE; level <= AM_SEARCH_AVX2; level++) {
+      if (AM_SetSearchLevel(level) != level) {
+        printf("| %7d | %-7s | (not supported by this CPU)                       |\n", sizes[s],
+               level_names[level]);
+        continue;
+      }
+      check_keys(&ih, sizes[s]);
+      node[level] = time_node_search(&ih, sizes[s]);
+      lookup[level] = time_lookups(&ih, sizes[s]);
+      printf("| %7d | %-7s | %16.1f | %6.2fx | %11.1f | %6.2fx |\n", sizes[s], level_names[level],
+             node[level] * 1e9, node[0] / node[level], lookup[level] * 1e9,
+             lookup[0] / lookup[level]);
+    }
+    xAM_CloseIndex(&ih);
+  }
+
+  for (level = AM_SEARCH_COMPARE; level <= best; level++) {
+    check_inserts(level);
+    check_floats(level);
+  }
+  printf("\nInserts and float keys checked at every supported level\n");
+
+  AM_DestroyIndex(INDEX_FILE, 0);
+  printf("\n*** Node Search Test Passed! ***\n");
+  return 0;
+}
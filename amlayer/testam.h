@@ -29,13 +29,20 @@ typedef int RecIdType;
 /* Function prototypes from misc.c */
 void padstring(char *str, int length);
 int xAM_CreateIndex(char *fname, int indexno, char attrtype, int attrlen);
+int xAM_CreateIndexFlags(char *fname, int indexno, char attrtype, int attrlen,
+                         int flags);
 int xAM_DestroyIndex(char *fname, int indexno);
-int xAM_InsertEntry(int fd, char attrtype, int attrlen, char *val, RecIdType recid);
-int xAM_DeleteEntry(int fd, char attrtype, int attrlen, char *val, RecIdType recid);
-int xAM_OpenIndexScan(int fd, char attrtype, int attrlen, int op, char *val);
-RecIdType xAM_FindNextEntry(int sd);
-int xAM_CloseIndexScan(int sd);
+int xAM_OpenIndex(char *fname, int indexno, char attrtype, AM_IndexHandle *ih);
+int xAM_CloseIndex(AM_IndexHandle *ih);
+int xAM_InsertEntry(AM_IndexHandle *ih, char *val, RecIdType recid);
+int xAM_DeleteEntry(AM_IndexHandle *ih, char *val, RecIdType recid);
+int xAM_OpenIndexScan(AM_IndexHandle *ih, AM_ScanHandle *sh, int op, char *val);
+RecIdType xAM_FindNextEntry(AM_ScanHandle *sh);
+int xAM_CloseIndexScan(AM_ScanHandle *sh);
 int xPF_OpenFile(char *fname);
 int xPF_CloseFile(int fd);
+double now_sec(void);
+int perm_key(int i, int n);
+void check_index(AM_IndexHandle *ih, int numKeys);
 
 #endif /* TESTAM_H */
\ No newline at end of file
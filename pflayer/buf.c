@@ -6,7 +6,8 @@
  *
  * Simple replacement policy:
  *   - MRU/LRU behavior is supported via moving frames to head on access.
- *   - When allocating and PF_MAX_BUFS reached, evict tail (LRU) if not fixed.
+ *   - When allocating and PF_MAX_BUFS reached, evict tail (LRU) if not fixed
+ *     and not pinned.
  *
  * Debug prints are kept (fprintf to stderr) to help trace behavior.
  */
@@ -112,8 +113,10 @@ static int PFbufInternalAlloc(PFbpage **bpage, int (*writefcn)(int,int,PFfpage *
         b->nextpage = b->prevpage = NULL;
         b->dirty = 0;
         b->fixed = 0;
+        b->pins = 0;
         b->page = -1;
         b->fd = -1;
+        b->swip = NULL;
         /* initialize the contained PFfpage to safe values */
         b->fpage.nextfree = PF_PAGE_LIST_END;
         /* Ensure pagebuf has defined contents (pftypes probably contains array) */
@@ -133,19 +136,19 @@ static int PFbufInternalAlloc(PFbpage **bpage, int (*writefcn)(int,int,PFfpage *
     if (pf_strategy == PF_LRU) {
         /* LRU: start from tail and walk backward to find non-fixed page */
         victim = PFlastbpage;
-        while (victim != NULL && victim->fixed) {
+        while (victim != NULL && (victim->fixed || victim->pins > 0)) {
             victim = victim->prevpage;
         }
     } else {
         /* MRU: start from head and walk forward to find non-fixed page */
         victim = PFfirstbpage;
-        while (victim != NULL && victim->fixed) {
+        while (victim != NULL && (victim->fixed || victim->pins > 0)) {
             victim = victim->nextpage;
         }
     }
     
     if (victim == NULL) {
-        /* no victim (all pages fixed) */
+        /* no victim (all pages fixed or pinned) */
         PFerrno = PFE_NOBUF; /* no buffer space available */
         return PFE_NOBUF;
     }
@@ -164,6 +167,9 @@ static int PFbufInternalAlloc(PFbpage **bpage, int (*writefcn)(int,int,PFfpage *
     /* delete from hash table */
     PFhashDelete(victim->fd, victim->page);
 
+    /* unswizzle: the reference to this frame no longer holds its page */
+    PFbufUnswizzle(victim);
+
     /* prepare victim frame to re-use: unlink from list (we will re-link as head) */
     PFbufUnlink(victim);
 
@@ -171,6 +177,7 @@ static int PFbufInternalAlloc(PFbpage **bpage, int (*writefcn)(int,int,PFfpage *
     victim->fd = -1;
     victim->page = -1;
     victim->fixed = 0;
+    victim->pins = 0;
     victim->dirty = 0;
     victim->fpage.nextfree = PF_PAGE_LIST_END;
     /* put it at head */
@@ -402,6 +409,78 @@ int PFbufUnfix(int fd, int pagenum, int dirty)
 }
 
 
+/****************************************************************************
+ * PFbufPin: like PFbufGet, but takes a shared pin instead of the fix.
+ * Any number of pins may be held on a page, with or without the fix;
+ * the frame is not evicted until all are released. Who may change the
+ * page while others read it is up to the callers.
+ ****************************************************************************/
+int PFbufPin(int fd, int pagenum, PFfpage **fpageptr,
+             int (*readfcn)(int,int,PFfpage *),
+             int (*writefcn)(int,int,PFfpage *))
+{
+    PFbpage *b;
+    int rc;
+
+    pf_stats.logical_reads++;
+    b = PFhashFind(fd, pagenum);
+    if (b != NULL) {
+        if (PFfirstbpage != b) {
+            PFbufUnlink(b);
+            PFbufLinkHead(b);
+        }
+        b->pins++;
+        *fpageptr = &b->fpage;
+        return PFE_OK;
+    }
+
+    /* not present: read it into a new frame, as PFbufGet does */
+    rc = PFbufInternalAlloc(&b, writefcn);
+    if (rc != PFE_OK) return rc;
+
+    b->fd = fd;
+    b->page = pagenum;
+    b->pins = 1;
+    b->dirty = 0;
+
+    rc = readfcn(fd, pagenum, &b->fpage);
+    if (rc == PFE_OK)
+        rc = PFhashInsert(fd, pagenum, b);
+    if (rc != PFE_OK) {
+        PFbufUnlink(b);
+        PFnumbpage--;
+        free(b);
+        return rc;
+    }
+
+    *fpageptr = &b->fpage;
+    return PFE_OK;
+}
+
+/****************************************************************************
+ * PFbufUnpin: release one pin taken by PFbufPin; dirty==TRUE marks the
+ * page dirty.
+ ****************************************************************************/
+int PFbufUnpin(int fd, int pagenum, int dirty)
+{
+    PFbpage *b;
+
+    b = PFhashFind(fd, pagenum);
+    if (b == NULL) {
+        PFerrno = PFE_HASHNOTFOUND;
+        return PFE_HASHNOTFOUND;
+    }
+    if (b->pins <= 0) {
+        PFerrno = PFE_PAGEUNFIXED;
+        return PFE_PAGEUNFIXED;
+    }
+
+    b->pins--;
+    if (dirty)
+        b->dirty = 1;
+    return PFE_OK;
+}
+
 /****************************************************************************
  * PFbufUsed: mark a page as used (fpage.nextfree = PF_PAGE_USED)
  ****************************************************************************/
@@ -419,6 +498,61 @@ int PFbufUsed(int fd, int pagenum)
     return PFE_OK;
 }
 
+/****************************************************************************
+ * PFbufSwizzle: record *swip as the in-memory reference to the frame of
+ * fd,pagenum (which must be in the buffer) and point *swip at it. A frame
+ * has at most one such reference; an older one is cleared. On eviction
+ * the frame sets *swip back to NULL, so a non-NULL swip always refers to
+ * a frame still holding its page.
+ ****************************************************************************/
+int PFbufSwizzle(int fd, int pagenum, void **swip)
+{
+    PFbpage *b;
+
+    b = PFhashFind(fd, pagenum);
+    if (b == NULL) {
+        PFerrno = PFE_HASHNOTFOUND;
+        return PFE_HASHNOTFOUND;
+    }
+
+    if (b->swip != NULL && b->swip != swip)
+        *b->swip = NULL;
+    b->swip = swip;
+    *swip = b;
+    return PFE_OK;
+}
+
+/****************************************************************************
+ * PFbufFixFrame: fix the page held by frame bpage, reached through a
+ * swip instead of the hash table. Same results as PFbufGet on a hit.
+ ****************************************************************************/
+int PFbufFixFrame(PFbpage *bpage, PFfpage **fpageptr)
+{
+    pf_stats.logical_reads++;
+    if (PFfirstbpage != bpage) {
+        PFbufUnlink(bpage);
+        PFbufLinkHead(bpage);
+    }
+    *fpageptr = &bpage->fpage;
+    if (bpage->fixed) {
+        PFerrno = PFE_PAGEFIXED;
+        return PFE_PAGEFIXED;
+    }
+    bpage->fixed = 1;
+    return PFE_OK;
+}
+
+/****************************************************************************
+ * PFbufUnswizzle: clear the swip of frame bpage, if any, and forget it
+ ****************************************************************************/
+void PFbufUnswizzle(PFbpage *bpage)
+{
+    if (bpage->swip != NULL) {
+        *bpage->swip = NULL;
+        bpage->swip = NULL;
+    }
+}
+
 /****************************************************************************
  * PFbufReleaseFile: release all frames for a file (write dirty pages),
  * called when closing a file. Return error if any page still fixed.
@@ -431,7 +565,7 @@ int PFbufReleaseFile(int fd, int (*writefcn)(int,int,PFfpage *))
     while (b != NULL) {
         next = b->nextpage;
         if (b->fd == fd) {
-            if (b->fixed) {
+            if (b->fixed || b->pins > 0) {
                 PFerrno = PFE_PAGEFIXED;
                 return PFE_PAGEFIXED;
             }
@@ -442,6 +576,7 @@ int PFbufReleaseFile(int fd, int (*writefcn)(int,int,PFfpage *))
             }
             /* remove from hash */
             PFhashDelete(b->fd, b->page);
+            PFbufUnswizzle(b);
             /* unlink and free frame */
             PFbufUnlink(b);
             PFnumbpage--;
@@ -466,6 +601,7 @@ void PFbufShutdown(void)
         if (b->fd >= 0 && b->page >= 0) {
             PFhashDelete(b->fd, b->page);
         }
+        PFbufUnswizzle(b);
         free(b);
         b = next;
     }
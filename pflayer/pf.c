@@ -5,6 +5,7 @@
 #include <unistd.h> /* For lseek, read, write, close, unlink */
 #include <fcntl.h>  /* For open flags O_CREAT etc. */
 #include <sys/types.h>
+#include <pthread.h>
 /* #include <sys/file.h> */ /* This is often not needed with unistd.h */
 #include "pf.h"
 #include "pftypes.h"
@@ -276,6 +277,15 @@ SPECIFICATIONS:
   return (fd);
 }
 
+int PF_FileIsOpen(char *fname)
+/****************************************************************************
+SPECIFICATIONS:
+    Return TRUE if the file named fname is open, else FALSE.
+*****************************************************************************/
+{
+  return (PFtabFindFname(fname) != -1);
+}
+
 int PF_CloseFile(int fd)
 /****************************************************************************
 SPECIFICATIONS:
@@ -447,35 +457,53 @@ SPECIFICATIONS:
     PFftab[fd].hdrchanged = TRUE;
   } else {
     /* Free list empty, allocate one more page from the file */
-    *pagenum = PFftab[fd].hdr.numpages;
-        if ((error = PFbufAlloc(fd, *pagenum, &fpage, PFwritefcn)) != PFE_OK) {
-      /* can't allocate a page */
-      #if PF_DEBUG
-      fprintf(stderr, "DEBUG PF_AllocPage: PFbufAlloc failed for fd=%d pagenum=%d error=%d\n",
-              fd, *pagenum, error);
-      #endif
-      return (error);
-    } else {
-      #if PF_DEBUG
-      fprintf(stderr, "DEBUG PF_AllocPage: PFbufAlloc succeeded for fd=%d pagenum=%d (fpage=%p)\n",
-              fd, *pagenum, (void *)fpage);
-      #endif
-    }
+    return (PF_AppendPage(fd, pagenum, pagebuf));
+  }
 
+  /* Mark the new page used */
+  fpage->nextfree = PF_PAGE_USED;
 
-    /* increment # of pages for this file */
-    PFftab[fd].hdr.numpages++;
-    PFftab[fd].hdrchanged = TRUE;
+  /* set return value */
+  *pagebuf = fpage->pagebuf;
 
-    /* mark this page dirty */
-    /* mark this page dirty (make page 'used' in buffer). If PFbufUsed fails,
-   return the error to the caller so it can be diagnosed by the caller. */
-    if ((error = PFbufUsed(fd, *pagenum)) != PFE_OK) {
-      /* propagate the PF error (do NOT exit the process here) */
-      PFerrno = error;
-      return (error);
-    }
+  return (PFE_OK);
+}
 
+int PF_AppendPage(int fd, int *pagenum, char **pagebuf)
+/****************************************************************************
+SPECIFICATIONS:
+    Allocate a new, empty page at the end of file "fd", bypassing the
+    free list. Successive calls return consecutive page numbers, so a
+    caller can lay out a contiguous extent.
+*****************************************************************************/
+{
+  PFfpage *fpage; /* pointer to file page */
+  int error;
+
+  if (PFinvalidFd(fd)) {
+    PFerrno = PFE_FD;
+    return (PFerrno);
+  }
+
+  *pagenum = PFftab[fd].hdr.numpages;
+  if ((error = PFbufAlloc(fd, *pagenum, &fpage, PFwritefcn)) != PFE_OK) {
+    /* can't allocate a page */
+    #if PF_DEBUG
+    fprintf(stderr, "DEBUG PF_AppendPage: PFbufAlloc failed for fd=%d pagenum=%d error=%d\n",
+            fd, *pagenum, error);
+    #endif
+    return (error);
+  }
+
+  /* increment # of pages for this file */
+  PFftab[fd].hdr.numpages++;
+  PFftab[fd].hdrchanged = TRUE;
+
+  /* mark this page dirty (make page 'used' in buffer). If PFbufUsed fails,
+     return the error to the caller so it can be diagnosed by the caller. */
+  if ((error = PFbufUsed(fd, *pagenum)) != PFE_OK) {
+    PFerrno = error;
+    return (error);
   }
 
   /* Mark the new page used */
@@ -565,6 +593,123 @@ SPECIFICATIONS:
   return (PFbufUnfix(fd, pagenum, dirty));
 }
 
+int PF_PinPage(int fd, int pagenum, char **pagebuf)
+/****************************************************************************
+SPECIFICATIONS:
+    Read the page "pagenum" and set *pagebuf to point to the page data,
+    taking a shared pin on it. Unlike a fix, any number of pins may be
+    held on a page at once, alongside the fix; the page stays in the
+    buffer until all of them are released with PF_UnpinPage.
+*****************************************************************************/
+{
+  int error;
+  PFfpage *fpage;
+
+  if (PFinvalidFd(fd)) {
+    PFerrno = PFE_FD;
+    return (PFerrno);
+  }
+
+  if (PFinvalidPagenum(fd, pagenum)) {
+    PFerrno = PFE_INVALIDPAGE;
+    return (PFerrno);
+  }
+
+  if ((error = PFbufPin(fd, pagenum, &fpage, PFreadfcn, PFwritefcn)) != PFE_OK)
+    return (error);
+
+  if (fpage->nextfree != PF_PAGE_USED) {
+    /* invalid page */
+    PFbufUnpin(fd, pagenum, FALSE);
+    PFerrno = PFE_INVALIDPAGE;
+    return (PFerrno);
+  }
+  *pagebuf = (char *)fpage->pagebuf;
+  return (PFE_OK);
+}
+
+int PF_UnpinPage(int fd, int pagenum, int dirty)
+/****************************************************************************
+SPECIFICATIONS:
+    Release a pin taken by PF_PinPage. Set "dirty" to TRUE if the page
+    has been modified.
+*****************************************************************************/
+{
+  if (PFinvalidFd(fd)) {
+    PFerrno = PFE_FD;
+    return (PFerrno);
+  }
+
+  if (PFinvalidPagenum(fd, pagenum)) {
+    PFerrno = PFE_INVALIDPAGE;
+    return (PFerrno);
+  }
+
+  return (PFbufUnpin(fd, pagenum, dirty));
+}
+
+int PF_SwizzlePage(int fd, int pagenum, void **swip)
+/****************************************************************************
+SPECIFICATIONS:
+    Point *swip at the buffer frame of page "pagenum", which must be
+    fixed, and register *swip as the one in-memory reference to that
+    frame. *swip is set back to NULL when the frame is evicted or the
+    file closed.
+*****************************************************************************/
+{
+  if (PFinvalidFd(fd)) {
+    PFerrno = PFE_FD;
+    return (PFerrno);
+  }
+
+  if (PFinvalidPagenum(fd, pagenum)) {
+    PFerrno = PFE_INVALIDPAGE;
+    return (PFerrno);
+  }
+
+  return (PFbufSwizzle(fd, pagenum, swip));
+}
+
+int PF_GetSwizzledPage(void *frame, char **pagebuf)
+/****************************************************************************
+SPECIFICATIONS:
+    Fix the page held by "frame", a non-NULL swip set by PF_SwizzlePage,
+    and set *pagebuf to point to its data. No page-table lookup.
+*****************************************************************************/
+{
+  int error;
+  PFfpage *fpage;
+
+  error = PFbufFixFrame((PFbpage *)frame, &fpage);
+  *pagebuf = fpage->pagebuf;
+  return (error);
+}
+
+void PF_UnswizzlePage(void *frame)
+/****************************************************************************
+SPECIFICATIONS:
+    Forget the swip registered for "frame"; the reference is going away.
+*****************************************************************************/
+{
+  PFbufUnswizzle((PFbpage *)frame);
+}
+
+int PF_GetNumPages(int fd, int *numpages)
+/****************************************************************************
+SPECIFICATIONS:
+    Set *numpages to the number of pages in the file "fd", counting
+    both used and free pages.
+*****************************************************************************/
+{
+  if (PFinvalidFd(fd)) {
+    PFerrno = PFE_FD;
+    return (PFerrno);
+  }
+
+  *numpages = PFftab[fd].hdr.numpages;
+  return (PFE_OK);
+}
+
 void PF_SetStrategy(int strategy)
 /****************************************************************************
 SPECIFICATIONS:
@@ -654,3 +799,45 @@ SPECIFICATIONS:
   *physical_reads = pf_stats.physical_reads;
   *physical_writes = pf_stats.physical_writes;
 }
+
+/*
+ * =================================================================
+ * Pool Latch
+ * =================================================================
+ */
+
+/* The buffer pool and file table are not thread-safe. Every thread
+that calls PF while others may be doing so holds this latch around its
+calls; it is recursive, so a holder may call into layers that take it
+again. */
+static pthread_mutex_t PF_poolLatch;
+static pthread_once_t PF_poolLatchOnce = PTHREAD_ONCE_INIT;
+
+static void PFinitLatch(void)
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&PF_poolLatch, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+void PF_LatchPool(void)
+/****************************************************************************
+SPECIFICATIONS:
+    Takes the latch of the buffer pool, waiting for other threads.
+*****************************************************************************/
+{
+  pthread_once(&PF_poolLatchOnce, PFinitLatch);
+  pthread_mutex_lock(&PF_poolLatch);
+}
+
+void PF_UnlatchPool(void)
+/****************************************************************************
+SPECIFICATIONS:
+    Releases the latch taken by PF_LatchPool.
+*****************************************************************************/
+{
+  pthread_mutex_unlock(&PF_poolLatch);
+}
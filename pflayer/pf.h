@@ -76,6 +76,14 @@ int PF_DestroyFile(char *fname);
  */
 int PF_OpenFile(char *fname);
 
+/*
+ * PF_FileIsOpen:
+ * Returns TRUE if the file with the given name is open. The PF layer
+ * lets a file be opened more than once; layers that cache per-file
+ * state use this to refuse a second open.
+ */
+int PF_FileIsOpen(char *fname);
+
 /*
  * PF_CloseFile:
  * Closes the file associated with the given fd.
@@ -111,6 +119,14 @@ int PF_GetThisPage(int fd, int pagenum, char **pagebuf);
  */
 int PF_AllocPage(int fd, int *pagenum, char **pagebuf);
 
+/*
+ * PF_AppendPage:
+ * Like PF_AllocPage, but always extends the file instead of reusing a
+ * disposed page, so successive calls return consecutive page numbers.
+ * The page is fixed in the buffer.
+ */
+int PF_AppendPage(int fd, int *pagenum, char **pagebuf);
+
 /*
  * PF_DisposePage:
  * Disposes of (deletes) a page from the file.
@@ -125,6 +141,52 @@ int PF_DisposePage(int fd, int pagenum);
  */
 int PF_UnfixPage(int fd, int pagenum, int dirty);
 
+/*
+ * PF_PinPage:
+ * Like PF_GetThisPage, but takes a shared pin: any number of pins may
+ * be held on a page at once, alongside a fix, and the page stays in
+ * the buffer until all are released. Pin holders order their own
+ * reads and writes of the page.
+ */
+int PF_PinPage(int fd, int pagenum, char **pagebuf);
+
+/*
+ * PF_UnpinPage:
+ * Releases a pin taken by PF_PinPage. 'dirty' is TRUE if the page
+ * was modified.
+ */
+int PF_UnpinPage(int fd, int pagenum, int dirty);
+
+/*
+ * PF_SwizzlePage:
+ * Points *swip at the buffer frame of the fixed page pagenum and
+ * registers it as the one in-memory reference to that frame. The
+ * frame sets *swip back to NULL when it is evicted or its file
+ * closed, so a non-NULL swip always refers to a resident page.
+ */
+int PF_SwizzlePage(int fd, int pagenum, void **swip);
+
+/*
+ * PF_GetSwizzledPage:
+ * Like PF_GetThisPage for the page held by frame (a non-NULL swip),
+ * without the page-table lookup. Unfix it with PF_UnfixPage.
+ */
+int PF_GetSwizzledPage(void *frame, char **pagebuf);
+
+/*
+ * PF_UnswizzlePage:
+ * Forgets the swip registered for frame (a non-NULL swip), before the
+ * memory holding it goes away.
+ */
+void PF_UnswizzlePage(void *frame);
+
+/*
+ * PF_GetNumPages:
+ * Returns in *numpages the number of pages in the file, including
+ * free pages. Valid page numbers are 0 .. *numpages - 1.
+ */
+int PF_GetNumPages(int fd, int *numpages);
+
 /*
  * PF_SetStrategy:
  * Sets the page replacement strategy (PF_LRU or PF_MRU).
@@ -144,6 +206,15 @@ void PF_PrintError(char *s);
  */
 void PF_PrintStats(void);
 
+/*
+ * PF_LatchPool / PF_UnlatchPool:
+ * The PF layer is not thread-safe. Threads that share it hold this
+ * process-wide, recursive latch around their PF calls; the AM layer
+ * and parallel RM scans all use it.
+ */
+void PF_LatchPool(void);
+void PF_UnlatchPool(void);
+
 /* NEW FUNCTIONS TO ADD */
 void PF_ResetStats(void);
 void PF_GetStats(long *logical_reads, long *physical_reads, long *physical_writes);
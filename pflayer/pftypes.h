@@ -57,8 +57,11 @@ typedef struct PFbpage {
                                         of buffer pages */
   unsigned short dirty : 1, /* TRUE if page is dirty */
       fixed : 1;            /* TRUE if page is fixed in buffer*/
+  short pins;               /* shared pins (PF_PinPage) held on the page */
   int page;                 /* page number of this page */
   int fd;                   /* file desciptor of this page */
+  void **swip;              /* in-memory reference to this frame, set
+                               to NULL on eviction; NULL if none */
   PFfpage fpage;            /* page data from the file */
 } PFbpage;
 
@@ -90,10 +93,17 @@ int PFbufGet(int fd, int pagenum, PFfpage **fpage,
              int (*readfcn)(int, int, PFfpage *),
              int (*writefcn)(int, int, PFfpage *));
 int PFbufUnfix(int fd, int pagenum, int dirty);
+int PFbufPin(int fd, int pagenum, PFfpage **fpage,
+             int (*readfcn)(int, int, PFfpage *),
+             int (*writefcn)(int, int, PFfpage *));
+int PFbufUnpin(int fd, int pagenum, int dirty);
 int PFbufAlloc(int fd, int pagenum, PFfpage **fpage,
              int (*writefcn)(int, int, PFfpage *));
 int PFbufReleaseFile(int fd, int (*writefcn)(int, int, PFfpage *));
 int PFbufUsed(int fd, int pagenum);
+int PFbufSwizzle(int fd, int pagenum, void **swip);
+int PFbufFixFrame(PFbpage *bpage, PFfpage **fpage);
+void PFbufUnswizzle(PFbpage *bpage);
 void PFbufPrint(void);
 
 /****************** Interface functions from PF (for buf.c) *************/
@@ -1,12 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <stddef.h>
 
 /*
  * rm_internal.h includes rm.h, which (thanks to our Makefile)
  * will find pf.h. By including this one file, we get everything.
  */
 #include "rm_internal.h"
+
+static int RM_FreeSlot(RM_FileHandle *fh, const RID *rid);
+static int RM_DirLoad(RM_FileHandle *fh);
+static void RM_DirFree(RM_FileHandle *fh);
+static int RM_WriteStats(RM_FileHandle *fh);
+
 /*
  * =================================================================
  * RM File Management Functions
@@ -28,14 +36,112 @@ void RM_Init() {
 
 /*
  * RM_CreateFile
- * Creates a new file named fname.
+ * Creates a new file named fname, using compact slotted pages.
  */
 int RM_CreateFile(char *fname) {
-  /*
-   * We just let the PF layer create the file.
-   * It will return PFE_OK or an error code.
-   */
-  return PF_CreateFile(fname);
+  return RM_CreateFileFormat(fname, RM_FORMAT_COMPACT, 0);
+}
+
+/*
+ * RM_WriteNewFile
+ * Creates fname through the PF layer with `hdr` on page 0.
+ */
+static int RM_WriteNewFile(char *fname, const RM_FileHeader *hdr) {
+  int pf_fd;
+  int pf_err;
+  int pageNum;
+  char *pageBuf;
+
+  // 1. Let the PF layer create the file
+  pf_err = PF_CreateFile(fname);
+  if (pf_err != PFE_OK) {
+    return pf_err;
+  }
+
+  pf_fd = PF_OpenFile(fname);
+  if (pf_fd < 0) {
+    return pf_fd;
+  }
+
+  // 2. Write the file header into page 0
+  pf_err = PF_AllocPage(pf_fd, &pageNum, &pageBuf);
+  if (pf_err != PFE_OK) {
+    PF_CloseFile(pf_fd);
+    return pf_err;
+  }
+  memset(pageBuf, 0, PF_PAGE_SIZE);
+  memcpy(pageBuf, hdr, sizeof(RM_FileHeader));
+
+  pf_err = PF_UnfixPage(pf_fd, pageNum, TRUE);
+  if (pf_err != PFE_OK) {
+    PF_CloseFile(pf_fd);
+    return pf_err;
+  }
+
+  return PF_CloseFile(pf_fd);
+}
+
+/*
+ * RM_CreateFileFormat
+ * Creates a new file named fname whose data pages use `pageFormat`.
+ * Page 0 of the file is reserved for the RM_FileHeader.
+ */
+int RM_CreateFileFormat(char *fname, int pageFormat, int record_len) {
+  RM_FileHeader hdr;
+
+  // 1. Validate the requested format
+  memset(&hdr, 0, sizeof(RM_FileHeader));
+  hdr.magic = RM_FILE_MAGIC;
+  hdr.pageFormat = pageFormat;
+  if (pageFormat == RM_FORMAT_FIXED) {
+    hdr.recordLength = record_len;
+    hdr.recsPerPage = RM_FixedCapacity(record_len);
+    if (hdr.recsPerPage <= 0) {
+      return RM_INVALID_RECLEN;
+    }
+  } else if (pageFormat != RM_FORMAT_SLOTTED && pageFormat != RM_FORMAT_COMPACT) {
+    return RM_INVALID_ARG;
+  }
+
+  // 2. Create the file with its header
+  return RM_WriteNewFile(fname, &hdr);
+}
+
+/*
+ * RM_CreateFileSchema
+ * A fixed-length (row or PAX) file whose record length is the layout's,
+ * with the layout stored after the space counters in the header.
+ */
+int RM_CreateFileSchema(char *fname, int pageFormat, RM_Attr *attrs, int numAttrs) {
+  RM_FileHeader hdr;
+  int record_len;
+
+  // 1. Validate the format and the layout
+  if (pageFormat != RM_FORMAT_FIXED && pageFormat != RM_FORMAT_PAX) {
+    return RM_INVALID_ARG;
+  }
+  if (numAttrs <= 0 || numAttrs > RM_MAX_ATTRS) {
+    return RM_INVALID_ARG;
+  }
+  record_len = RM_LayoutLength(attrs, numAttrs);
+  if (record_len < 0) {
+    return record_len;
+  }
+
+  // 2. Fill in the header of a fixed-length file
+  memset(&hdr, 0, sizeof(RM_FileHeader));
+  hdr.magic = RM_FILE_MAGIC;
+  hdr.pageFormat = pageFormat;
+  hdr.recordLength = record_len;
+  hdr.recsPerPage = RM_FixedCapacity(record_len);
+  if (hdr.recsPerPage <= 0) {
+    return RM_INVALID_RECLEN;
+  }
+  hdr.numAttrs = numAttrs;
+  memcpy(hdr.attrs, attrs, numAttrs * sizeof(RM_Attr));
+
+  // 3. Create the file with its header
+  return RM_WriteNewFile(fname, &hdr);
 }
 
 /*
@@ -54,19 +160,70 @@ int RM_DestroyFile(char *fname) {
  * Opens the file named fname and prepares it for RM operations.
  */
 int RM_OpenFile(char *fname, RM_FileHandle *fh) {
+  return RM_OpenFileFlags(fname, fh, 0);
+}
+
+/*
+ * RM_OpenFileFlags
+ * RM_OpenFile with RM_OPEN_* flags. In append mode the tail page is the
+ * last page in the page directory.
+ */
+int RM_OpenFileFlags(char *fname, RM_FileHandle *fh, int flags) {
   int pf_fd;
   int pf_err;
+  char *pageBuf;
 
   /*
-   * 1. Open the file using the PF layer.
+   * 1. Open the file using the PF layer. A second handle would keep its
+   *    own copy of the header and directory, so refuse one.
    * 2. Store the PF file descriptor in our RM_FileHandle.
    */
+    if (PF_FileIsOpen(fname)) {
+        return PFE_FILEOPEN;
+    }
     pf_fd = PF_OpenFile(fname);
     if (pf_fd < 0) { // PF_OpenFile returns < 0 on error
         return pf_fd; // Return the PF error code
     }
 
     fh->pf_fd = pf_fd;
+    fh->pageDir = NULL;
+    fh->dirBytes = 0;
+    fh->dirPages = NULL;
+    fh->numDirPages = 0;
+
+  /*
+   * 3. Load the file header from page 0 and check that this really is
+   *    an RM file.
+   * 4. Load the page directory, following its chain of pages.
+   */
+    pf_err = PF_GetThisPage(pf_fd, RM_HDR_PAGE, &pageBuf);
+    if (pf_err != PFE_OK) {
+        PF_CloseFile(pf_fd);
+        fh->pf_fd = -1;
+        return RM_INVALID_FILE;
+    }
+    memcpy(&fh->hdr, pageBuf, sizeof(RM_FileHeader));
+    pf_err = PF_UnfixPage(pf_fd, RM_HDR_PAGE, FALSE);
+    if (pf_err == PFE_OK && fh->hdr.magic != RM_FILE_MAGIC) {
+        pf_err = RM_INVALID_FILE;
+    }
+    if (pf_err == PFE_OK) {
+        pf_err = RM_DirLoad(fh);
+    }
+    if (pf_err != PFE_OK) {
+        RM_DirFree(fh);
+        PF_CloseFile(pf_fd);
+        fh->pf_fd = -1;
+        return pf_err;
+    }
+
+    fh->hdrChanged = FALSE;
+    fh->scanPos = RM_NO_PAGE;
+    fh->openFlags = flags;
+    fh->tailPage = RM_DirLastPage(fh);
+    fh->recCache = NULL;
+
   return PFE_OK;
 }
 
@@ -75,11 +232,27 @@ int RM_OpenFile(char *fname, RM_FileHandle *fh) {
  * Closes the file associated with the RM_FileHandle.
  */
 int RM_CloseFile(RM_FileHandle *fh) {
+  int pf_err;
+
+  /*
+   * 1. Write the space counters back if they changed since the last
+   *    flush (directory changes are always written through).
+   */
+  if (fh->hdrChanged) {
+    pf_err = RM_WriteStats(fh);
+    if (pf_err != PFE_OK) {
+      return pf_err;
+    }
+  }
+
   /*
-   * 1. Close the file using the PF layer.
-   * 2. Invalidate the handle (optional, but good practice).
+   * 2. Drop the record cache and the copy of the directory.
+   * 3. Close the file using the PF layer.
+   * 4. Invalidate the handle (optional, but good practice).
    */
-  int pf_err = PF_CloseFile(fh->pf_fd);
+  RM_SetRecCache(fh, 0);
+  RM_DirFree(fh);
+  pf_err = PF_CloseFile(fh->pf_fd);
   if (pf_err != PFE_OK) {
     return pf_err;
   }
@@ -88,6 +261,19 @@ int RM_CloseFile(RM_FileHandle *fh) {
   return PFE_OK;
 }
 
+/*
+ * RM_FlushFile
+ * Writes the space counters and free overflow runs to page 0 through
+ * the buffer pool if they changed since the last write. The page directory needs no flush: its
+ * bits are written through as they change.
+ */
+int RM_FlushFile(RM_FileHandle *fh) {
+    if (!fh->hdrChanged) {
+        return PFE_OK;
+    }
+    return RM_WriteStats(fh);
+}
+
 /*
  * =================================================================
  * Internal RM Helper Functions
@@ -95,75 +281,354 @@ int RM_CloseFile(RM_FileHandle *fh) {
  */
 
 /*
- * RM_InitPage
- * Initializes a new, empty page with the slotted-page layout.
- * The page must already be pinned (fixed) in the buffer.
+ * RM_WriteStats
+ * Copies the space counters and the free overflow runs into page 0
+ * through the buffer pool, which writes the page out like any other
+ * dirty page. Called at close and by
+ * RM_FlushFile, not on every change; if page 0 cannot be pinned,
+ * hdrChanged stays set.
  */
-int RM_InitPage(char *pageBuf) {
-    
-    // 1. Set up the header for an empty page
-    RM_PageHeader pageHeader;
-    pageHeader.numSlots = 0;
-    // Free space starts at the end of the page
-    pageHeader.freeSpaceOffset = PF_PAGE_SIZE; 
+static int RM_WriteStats(RM_FileHandle *fh) {
+    int pf_err;
+    char *pageBuf;
 
-    // 2. Copy the header into the very beginning of the page
-    memcpy(pageBuf, &pageHeader, sizeof(RM_PageHeader));
+    pf_err = PF_PinPage(fh->pf_fd, RM_HDR_PAGE, &pageBuf);
+    if (pf_err != PFE_OK) {
+        fh->hdrChanged = TRUE;
+        return pf_err;
+    }
+    memcpy(pageBuf + offsetof(RM_FileHeader, stats), &fh->hdr.stats, sizeof(RM_SpaceStats));
+    memcpy(pageBuf + offsetof(RM_FileHeader, numFreeRuns), &fh->hdr.numFreeRuns,
+           sizeof(int) + sizeof(fh->hdr.freeRuns));
+    fh->hdrChanged = FALSE;
+    return PF_UnpinPage(fh->pf_fd, RM_HDR_PAGE, TRUE);
+}
+
+/*
+ * RM_AccountSlot
+ * Adds (sign = 1) or removes (sign = -1) the share of the file's space
+ * counters held by slot `slotNum` of a pinned page and by the page
+ * itself (slotNum -1: the page alone, e.g. before an insert). Callers
+ * remove it before changing that slot and add it back afterwards, so
+ * only the changed slot is recounted. The counters reach page 0 at
+ * RM_CloseFile or RM_FlushFile.
+ */
+void RM_AccountSlot(RM_FileHandle *fh, char *pageBuf, int slotNum, int sign) {
+    RM_SpaceStats part;
+
+    memset(&part, 0, sizeof(RM_SpaceStats));
+    RM_PageSlotStats(fh, pageBuf, -1, &part);
+    if (slotNum >= 0) {
+        RM_PageSlotStats(fh, pageBuf, slotNum, &part);
+    }
 
+    fh->hdr.stats.numRecs += sign * part.numRecs;
+    fh->hdr.stats.recordBytes += sign * part.recordBytes;
+    fh->hdr.stats.deadBytes += sign * part.deadBytes;
+    fh->hdr.stats.freeBytes += sign * part.freeBytes;
+    fh->hdr.stats.overflowPages += sign * part.overflowPages;
+    fh->hdrChanged = TRUE;
+}
+
+/*
+ * RM_DirAddPart
+ * Adds directory page `pageNum`, holding `len` more bytes of bitmap, to
+ * the handle's copy of the directory. The new bytes are zeroed.
+ */
+static int RM_DirAddPart(RM_FileHandle *fh, int pageNum, int len) {
+    unsigned char *bitmap;
+    int *pages;
+
+    bitmap = realloc(fh->pageDir, fh->dirBytes + len);
+    if (bitmap == NULL) {
+        return RM_NOMEM;
+    }
+    fh->pageDir = bitmap;
+    pages = realloc(fh->dirPages, (fh->numDirPages + 1) * sizeof(int));
+    if (pages == NULL) {
+        return RM_NOMEM;
+    }
+    fh->dirPages = pages;
+
+    memset(fh->pageDir + fh->dirBytes, 0, len);
+    fh->dirBytes += len;
+    fh->dirPages[fh->numDirPages++] = pageNum;
     return PFE_OK;
 }
 
+/*
+ * RM_DirLocate
+ * Finds where byte `byte` of the directory bitmap is kept: in part
+ * *part of the directory (an index into fh->dirPages), at *offset.
+ */
+static void RM_DirLocate(int byte, int *part, int *offset) {
+    if (byte < RM_DIR_BYTES) {
+        *part = 0;
+        *offset = RM_DIR_OFFSET + byte;
+    } else {
+        byte -= RM_DIR_BYTES;
+        *part = 1 + byte / RM_DIR_PAGEBYTES;
+        *offset = (int)sizeof(RM_DirPageHeader) + byte % RM_DIR_PAGEBYTES;
+    }
+}
+
+/*
+ * RM_DirLoad
+ * Reads the page directory into the handle: the bitmap at the end of
+ * page 0, then the bitmap of every page on the chain from the header.
+ */
+static int RM_DirLoad(RM_FileHandle *fh) {
+    int pf_err;
+    int pageNum, next;
+    char *pageBuf;
+
+    for (pageNum = RM_HDR_PAGE; ; pageNum = next) {
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        if (pageNum == RM_HDR_PAGE) {
+            next = fh->hdr.dirNext;
+            pf_err = RM_DirAddPart(fh, pageNum, RM_DIR_BYTES);
+            if (pf_err == PFE_OK) {
+                memcpy(fh->pageDir, pageBuf + RM_DIR_OFFSET, RM_DIR_BYTES);
+            }
+        } else {
+            next = ((RM_DirPageHeader *)pageBuf)->next;
+            pf_err = RM_DirAddPart(fh, pageNum, RM_DIR_PAGEBYTES);
+            if (pf_err == PFE_OK) {
+                memcpy(fh->pageDir + fh->dirBytes - RM_DIR_PAGEBYTES,
+                       pageBuf + sizeof(RM_DirPageHeader), RM_DIR_PAGEBYTES);
+            }
+        }
+        PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        if (next == 0) {
+            return PFE_OK;
+        }
+    }
+}
+
+/*
+ * RM_DirFree
+ * Frees the handle's copy of the page directory.
+ */
+static void RM_DirFree(RM_FileHandle *fh) {
+    free(fh->pageDir);
+    free(fh->dirPages);
+    fh->pageDir = NULL;
+    fh->dirPages = NULL;
+    fh->dirBytes = 0;
+    fh->numDirPages = 0;
+}
+
+/*
+ * RM_DirExtend
+ * Appends a page directory page to the file and links it to the end of
+ * the chain, so the directory covers RM_DIR_PAGEBYTES * 8 more pages.
+ */
+static int RM_DirExtend(RM_FileHandle *fh) {
+    int pf_err;
+    int pageNum, last;
+    char *pageBuf;
+
+    // 1. Append and initialize the new page
+    pf_err = PF_AppendPage(fh->pf_fd, &pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    memset(pageBuf, 0, PF_PAGE_SIZE);
+    pf_err = PF_UnfixPage(fh->pf_fd, pageNum, TRUE);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+
+    // 2. Link it from the last page of the chain
+    last = fh->dirPages[fh->numDirPages - 1];
+    pf_err = PF_PinPage(fh->pf_fd, last, &pageBuf);
+    if (pf_err != PFE_OK) {
+        PF_DisposePage(fh->pf_fd, pageNum);
+        return pf_err;
+    }
+    if (last == RM_HDR_PAGE) {
+        fh->hdr.dirNext = pageNum;
+        memcpy(pageBuf + offsetof(RM_FileHeader, dirNext), &pageNum, sizeof(int));
+    } else {
+        ((RM_DirPageHeader *)pageBuf)->next = pageNum;
+    }
+    pf_err = PF_UnpinPage(fh->pf_fd, last, TRUE);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+
+    // 3. Extend the handle's copy
+    return RM_DirAddPart(fh, pageNum, RM_DIR_PAGEBYTES);
+}
+
+/*
+ * RM_DirTest
+ * Checks the page directory: TRUE if `pageNum` holds RM data.
+ */
+int RM_DirTest(RM_FileHandle *fh, int pageNum) {
+    if (pageNum <= RM_HDR_PAGE || pageNum >= fh->dirBytes * 8) {
+        return FALSE;
+    }
+    return (fh->pageDir[pageNum >> 3] >> (pageNum & 7)) & 1;
+}
+
+/*
+ * RM_DirSet
+ * Adds `pageNum` to (inUse TRUE) or removes it from the page directory.
+ * The change goes to the directory page through the buffer pool, then
+ * to the handle's copy.
+ */
+int RM_DirSet(RM_FileHandle *fh, int pageNum, int inUse) {
+    int pf_err;
+    int byte, part, offset;
+    unsigned char bits;
+    char *pageBuf;
+
+    // 1. Grow the directory until it reaches pageNum
+    byte = pageNum >> 3;
+    while (byte >= fh->dirBytes) {
+        if (!inUse) {
+            return PFE_OK; // Not in the directory anyway
+        }
+        pf_err = RM_DirExtend(fh);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+
+    // 2. Change the bit on the directory page, then in the copy
+    bits = fh->pageDir[byte];
+    if (inUse) {
+        bits |= (unsigned char)(1 << (pageNum & 7));
+    } else {
+        bits &= (unsigned char)~(1 << (pageNum & 7));
+    }
+    RM_DirLocate(byte, &part, &offset);
+    pf_err = PF_PinPage(fh->pf_fd, fh->dirPages[part], &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    pageBuf[offset] = (char)bits;
+    pf_err = PF_UnpinPage(fh->pf_fd, fh->dirPages[part], TRUE);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    fh->pageDir[byte] = bits;
+    return PFE_OK;
+}
+
+/*
+ * RM_DirNextPage
+ * Returns the first data page after `pageNum`, or RM_NO_PAGE. Only the
+ * in-memory directory is read, a byte (eight pages) at a time.
+ */
+int RM_DirNextPage(RM_FileHandle *fh, int pageNum) {
+    int byte;
+    unsigned int bits;
+
+    pageNum++;
+    if (pageNum <= RM_HDR_PAGE) {
+        pageNum = RM_HDR_PAGE + 1;
+    }
+    for (byte = pageNum >> 3; byte < fh->dirBytes; byte++) {
+        bits = fh->pageDir[byte];
+        if (byte == (pageNum >> 3)) {
+            bits &= 0xFFu << (pageNum & 7); // Pages before pageNum
+        }
+        if (bits != 0) {
+            return byte * 8 + __builtin_ctz(bits);
+        }
+    }
+    return RM_NO_PAGE;
+}
+
+/*
+ * RM_DirLastPage
+ * Returns the last data page in the page directory, or RM_NO_PAGE.
+ */
+int RM_DirLastPage(RM_FileHandle *fh) {
+    int byte;
+
+    for (byte = fh->dirBytes - 1; byte >= 0; byte--) {
+        if (fh->pageDir[byte] != 0) {
+            return byte * 8 + 31 - __builtin_clz(fh->pageDir[byte]);
+        }
+    }
+    return RM_NO_PAGE;
+}
 
 /*
  * RM_FindFreePage
  * Scans the file for a page with at least `record_len` bytes of free space.
  * If no such page exists, it allocates a new page and returns its number.
+ * In append mode only the tail page is tried, and a new page becomes
+ * the tail when it is full.
  */
 int RM_FindFreePage(RM_FileHandle *fh, int record_len, int *pageNum) {
     int pf_err;
     char *pageBuf;
-    int currentPageNum = -1; // Start scan from the beginning
-    
-    // We need space for the record data + one new slot
-    int requiredSpace = record_len + sizeof(RM_Slot); 
-
-    // 1. Scan all existing pages using PF_GetNextPage
-    while ((pf_err = PF_GetNextPage(fh->pf_fd, &currentPageNum, &pageBuf)) == PFE_OK) {
-        RM_PageHeader *pageHeader = (RM_PageHeader *)pageBuf;
+    int currentPageNum;
+    int append = (fh->openFlags & RM_OPEN_APPEND) != 0;
+
+    // 1. Check every data page in the page directory (append mode:
+    //    just the tail page)
+    for (currentPageNum = append ? fh->tailPage : RM_DirNextPage(fh, RM_HDR_PAGE);
+         currentPageNum != RM_NO_PAGE;
+         currentPageNum = append ? RM_NO_PAGE : RM_DirNextPage(fh, currentPageNum)) {
+        pf_err = PF_GetThisPage(fh->pf_fd, currentPageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
 
-        // Calculate free space on this page
-        // Free space = (start of record data) - (end of slot directory)
-        int freeSpace = pageHeader->freeSpaceOffset - 
-                        (sizeof(RM_PageHeader) + (pageHeader->numSlots * sizeof(RM_Slot)));
+        // Check if the record fits on this page
+        int hasRoom = RM_PageHasRoom(fh, pageBuf, record_len);
 
         // Unfix the page (we are only reading)
-        int unfix_err = PF_UnfixPage(fh->pf_fd, currentPageNum, FALSE);
-        if (unfix_err != PFE_OK) {
-            return unfix_err;
+        pf_err = PF_UnfixPage(fh->pf_fd, currentPageNum, FALSE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
         }
 
-        // Check if we have enough space
-        if (freeSpace >= requiredSpace) {
+        if (hasRoom) {
             *pageNum = currentPageNum;
             return PFE_OK; // Found a page!
         }
     }
 
-    // 2. Check if the loop ended for a reason other than EOF
-    if (pf_err != PFE_EOF) {
-        return pf_err; // An error occurred during scan
+    // 2. No suitable page was found. Allocate a new page (the PF layer
+    //    hands back a disposed page first, if there is one; append mode
+    //    always extends the file, so pages stay in insertion order).
+    if (append) {
+        pf_err = PF_AppendPage(fh->pf_fd, pageNum, &pageBuf);
+    } else {
+        pf_err = PF_AllocPage(fh->pf_fd, pageNum, &pageBuf);
+    }
+    if (pf_err != PFE_OK) {
+        return pf_err;
     }
 
-    // 3. No suitable page was found (we hit PFE_EOF). Allocate a new page.
-    pf_err = PF_AllocPage(fh->pf_fd, pageNum, &pageBuf);
+    // 3. Initialize the new page in the file's page format and enter
+    //    it in the page directory
+    RM_InitPage(fh, pageBuf);
+    pf_err = RM_DirSet(fh, *pageNum, TRUE);
     if (pf_err != PFE_OK) {
+        PF_UnfixPage(fh->pf_fd, *pageNum, FALSE);
+        PF_DisposePage(fh->pf_fd, *pageNum);
         return pf_err;
     }
-    
-    // 4. Initialize the new page with our slotted-page header
-    RM_InitPage(pageBuf);
+    fh->hdr.stats.numPages++;
+    RM_AccountSlot(fh, pageBuf, -1, 1);
+    if (append) {
+        fh->tailPage = *pageNum;
+    }
 
-    // 5. Unfix the newly allocated page, marking it dirty
+    // 4. Unfix the newly allocated page, marking it dirty
     pf_err = PF_UnfixPage(fh->pf_fd, *pageNum, TRUE);
     if (pf_err != PFE_OK) {
         return pf_err;
@@ -188,156 +653,618 @@ int RM_InsertRec(RM_FileHandle *fh, char *record_data, int record_len, RID *rid)
     int pf_err;
     int pageNum;
     char *pageBuf;
-    RM_PageHeader *pageHeader;
-    RM_Slot *slot;
+    int slotNum;
+    int large;
+    RM_OverflowStub stub;
 
-    // 1. Find a page with enough free space
-    pf_err = RM_FindFreePage(fh, record_len, &pageNum);
+    // 0. Fixed-length files only take records of exactly the declared length
+    if (RM_IsFixed(fh) && record_len != fh->hdr.recordLength) {
+        return RM_INVALID_RECLEN;
+    }
+    if (record_len < 0) {
+        return RM_INVALID_RECLEN;
+    }
+
+    // 1. A large record goes to an overflow extent first; only its
+    //    stub is placed on a data page
+    large = (!RM_IsFixed(fh) && record_len > RM_OVERFLOW_THRESHOLD);
+    if (large) {
+        pf_err = RM_OverflowWrite(fh, record_data, record_len, &stub);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+
+    // 2. Find a page with enough free space
+    pf_err = RM_FindFreePage(fh, large ? (int)sizeof(RM_OverflowStub) : record_len, &pageNum);
+    if (pf_err == PFE_OK) {
+        // We have a suitable page (pageNum). Get it and fix it.
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+    }
     if (pf_err != PFE_OK) {
+        if (large) {
+            RM_OverflowFree(fh, &stub);
+        }
         return pf_err;
     }
 
-    // 2. We have a suitable page (pageNum). Get it and fix it.
-    pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+    // 3. Place the record (or stub) on the page in the file's page format
+    RM_AccountSlot(fh, pageBuf, -1, -1);
+    if (large) {
+        slotNum = RM_PageInsertOverflow(fh, pageBuf, &stub);
+    } else {
+        slotNum = RM_PageInsert(fh, pageBuf, record_data, record_len);
+    }
+    RM_AccountSlot(fh, pageBuf, slotNum, 1);
+    if (slotNum < 0) {
+        PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        if (large) {
+            RM_OverflowFree(fh, &stub);
+        }
+        return RM_INVALID_RECLEN; // Record is larger than a page can hold
+    }
+
+    // 4. Update the output RID
+    rid->pageNum = pageNum;
+    rid->slotNum = slotNum;
+
+    // 5. Mark the page as dirty and unfix it
+    pf_err = PF_UnfixPage(fh->pf_fd, pageNum, TRUE);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
 
-    // 3. Get the page header and find the location for the new slot
-    pageHeader = (RM_PageHeader *)pageBuf;
-    // The new slot is at the end of the current slot directory
-    slot = (RM_Slot *)(pageBuf + sizeof(RM_PageHeader) + (pageHeader->numSlots * sizeof(RM_Slot)));
+    return PFE_OK;
+}
+/*
+ * RM_LookupRec
+ * Finds the record named by `rid`, following a forwarding stub (one
+ * hop) to where it lives now. An in-page record is copied out; a large
+ * record's stub is returned instead, leaving its extent unread.
+ */
+int RM_LookupRec(RM_FileHandle *fh, const RID *rid, char *record_data, int *record_len, RM_OverflowStub *stub) {
+    int pf_err;
+    int pageNum = rid->pageNum;
+    char *pageBuf;
+    char *recordLocation;
+    int status;
+
+    // 1. Only pages in the page directory hold records
+    if (!RM_DirTest(fh, pageNum)) {
+        return RM_INVALID_RID;
+    }
+
+    // 2. Get the correct page from the PF layer
+    pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
 
-    // 4. Calculate the new record's location and copy the data
-    // The record data is written at the *new* start of free space
-    int newFreeSpaceOffset = pageHeader->freeSpaceOffset - record_len;
-    char *recordLocation = pageBuf + newFreeSpaceOffset;
-    memcpy(recordLocation, record_data, record_len);
+    // 3. Locate the slot (validates the slot number and checks
+    //    that the record was not deleted)
+    status = RM_PageGetRec(fh, pageBuf, rid->slotNum, &recordLocation, record_len);
+    if (status == RM_REC_MOVED) {
+        status = RM_INVALID_RID; // Only the home RID names a moved record
+    }
+    if (status < 0) {
+        // Unfix the page before returning an error
+        PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        return status;
+    }
 
-    // 5. Update the slot with the record's info
-    slot->offset = newFreeSpaceOffset;
-    slot->length = record_len;
+    // 4. A stub: follow it to the relocated copy
+    if (status == RM_REC_FORWARDED) {
+        RID target;
+        memcpy(&target, recordLocation, sizeof(RID));
+        PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
 
-    // 6. Update the page header
-    pageHeader->numSlots++;
-    pageHeader->freeSpaceOffset = newFreeSpaceOffset;
+        pageNum = target.pageNum;
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        if (RM_PageGetRec(fh, pageBuf, target.slotNum, &recordLocation, record_len) != RM_REC_MOVED) {
+            PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+            return RM_INVALID_FILE; // Dangling forwarding stub
+        }
+        status = PFE_OK;
+    }
 
-    // 7. Update the output RID
-    rid->pageNum = pageNum;
-    rid->slotNum = pageHeader->numSlots - 1; // Slot numbers are 0-indexed
+    // 5. Copy the record data, or just the stub of a large record
+    if (status == RM_REC_OVERFLOW) {
+        memcpy(stub, recordLocation, sizeof(RM_OverflowStub));
+        *record_len = stub->totalLen;
+    } else {
+        memcpy(record_data, recordLocation, *record_len);
+    }
 
-    // 8. Mark the page as dirty and unfix it
-    pf_err = PF_UnfixPage(fh->pf_fd, pageNum, TRUE);
+    // 6. Unfix the page (no modifications were made)
+    pf_err = PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
 
-    return PFE_OK;
+    return status;
 }
+
 /*
  * RM_GetRec
  * Retrieves a specific record from the file given its RID.
- * The record data is copied into the `record_data` buffer.
+ * The record data is copied into the `record_data` buffer; a large
+ * record is read from its overflow extent in page order. With a record
+ * cache, a cached record is copied from there and a record read from
+ * its page is added to it.
  */
 int RM_GetRec(RM_FileHandle *fh, const RID *rid, char *record_data) {
+    RM_OverflowStub stub;
+    int record_len;
+    int err;
+
+    if (fh->recCache != NULL && RM_RecCacheGet(fh->recCache, rid, record_data) == PFE_OK) {
+        return PFE_OK;
+    }
+    err = RM_LookupRec(fh, rid, record_data, &record_len, &stub);
+    if (err == RM_REC_OVERFLOW) {
+        err = RM_OverflowRead(fh, &stub, 0, record_data, record_len);
+    } else if (err == PFE_OK && fh->recCache != NULL) {
+        RM_RecCachePut(fh->recCache, rid, record_data, record_len);
+    }
+    return err;
+}
+
+/*
+ * RM_DeleteRec
+ * Deletes a record from the file given its RID.
+ * Slotted pages mark the slot as empty ("tombstone"); fixed-length
+ * pages clear the slot's presence bit so the slot can be reused.
+ * A relocated record is freed in both places, a large record's
+ * overflow extent is disposed.
+ */
+int RM_DeleteRec(RM_FileHandle *fh, const RID *rid) {
     int pf_err;
     char *pageBuf;
-    RM_PageHeader *pageHeader;
-    RM_Slot *slot;
+    char *recordLocation;
+    int record_len;
+    int status;
+    RID target;
+    RM_OverflowStub stub;
+
+    // 0. The cached copy, if any, goes first
+    if (fh->recCache != NULL) {
+        RM_RecCacheInvalidate(fh->recCache, rid);
+    }
+
+    // 1. Only pages in the page directory hold records
+    if (!RM_DirTest(fh, rid->pageNum)) {
+        return RM_INVALID_RID;
+    }
 
-    // 1. Get the correct page from the PF layer
+    // 2. Get the correct page from the PF layer
     pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
 
-    // 2. Get the page header
-    pageHeader = (RM_PageHeader *)pageBuf;
-
-    // 3. Validate the slot number
-    if (rid->slotNum < 0 || rid->slotNum >= pageHeader->numSlots) {
+    // 3. Check the slot (fails on a bad or already-deleted slot)
+    status = RM_PageGetRec(fh, pageBuf, rid->slotNum, &recordLocation, &record_len);
+    if (status == RM_REC_MOVED) {
+        status = RM_INVALID_RID; // Only the home RID names a moved record
+    }
+    if (status < 0) {
         // Unfix the page before returning an error
         PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
-        return -1; // TODO: Define RM-specific error codes (e.g., RM_INVALID_RID)
+        return status;
+    }
+    if (status == RM_REC_OVERFLOW) {
+        memcpy(&stub, recordLocation, sizeof(RM_OverflowStub));
     }
 
-    // 4. Get the specific slot
-    slot = (RM_Slot *)(pageBuf + sizeof(RM_PageHeader) + (rid->slotNum * sizeof(RM_Slot)));
-
-    // 5. Check if the slot is valid (not deleted)
-    if (slot->offset == -1) {
-        // This slot is empty (record was deleted)
-        // Unfix the page before returning an error
-        PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
-        return -2; // TODO: Define RM-specific error codes (e.g., RM_RECORD_DELETED)
+    // 4. A stub: free the relocated copy first
+    if (status == RM_REC_FORWARDED) {
+        memcpy(&target, recordLocation, sizeof(RID));
+        pf_err = RM_FreeSlot(fh, &target);
+        if (pf_err != PFE_OK) {
+            PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+            return pf_err;
+        }
     }
 
-    // 6. Slot is valid, find the record data and copy it
-    char *recordLocation = pageBuf + slot->offset;
-    memcpy(record_data, recordLocation, slot->length);
+    // 5. Free the home slot
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, -1);
+    RM_PageDeleteRec(fh, pageBuf, rid->slotNum);
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, 1);
 
-    // 7. Unfix the page (no modifications were made)
-    pf_err = PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+    // 6. Mark the page as dirty and unfix it
+    pf_err = PF_UnfixPage(fh->pf_fd, rid->pageNum, TRUE);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
 
+    // 7. A large record: give its overflow extent back as well
+    if (status == RM_REC_OVERFLOW) {
+        return RM_OverflowFree(fh, &stub);
+    }
+
     return PFE_OK;
 }
 
 /*
- * RM_DeleteRec
- * Deletes a record from the file given its RID.
- * This is done by marking the slot as empty ("tombstone").
+ * =================================================================
+ * RM Update Functions
+ * =================================================================
  */
-int RM_DeleteRec(RM_FileHandle *fh, const RID *rid) {
+
+/*
+ * RM_FreeSlot
+ * Frees one slot (any kind) on a page that is not currently fixed.
+ */
+static int RM_FreeSlot(RM_FileHandle *fh, const RID *rid) {
     int pf_err;
     char *pageBuf;
-    RM_PageHeader *pageHeader;
-    RM_Slot *slot;
 
-    // 1. Get the correct page from the PF layer
     pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, -1);
+    pf_err = RM_PageDeleteRec(fh, pageBuf, rid->slotNum);
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, 1);
+    if (pf_err != PFE_OK) {
+        PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+        return pf_err;
+    }
+    return PF_UnfixPage(fh->pf_fd, rid->pageNum, TRUE);
+}
 
-    // 2. Get the page header
-    pageHeader = (RM_PageHeader *)pageBuf;
+/*
+ * RM_UpdateSlot
+ * Rewrites one slot on a page that is not currently fixed.
+ * Returns PFE_OK, RM_PAGE_FULL (nothing changed) or a PF error.
+ */
+static int RM_UpdateSlot(RM_FileHandle *fh, const RID *rid, const char *record_data, int record_len) {
+    int pf_err;
+    char *pageBuf;
 
-    // 3. Validate the slot number
-    if (rid->slotNum < 0 || rid->slotNum >= pageHeader->numSlots) {
-        // Unfix the page before returning an error
+    pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    if (!RM_PageRoomFor(fh, pageBuf, rid->slotNum, record_len)) {
         PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
-        return -1; // TODO: Define RM_INVALID_RID
+        return RM_PAGE_FULL;
     }
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, -1);
+    pf_err = RM_PageUpdate(fh, pageBuf, rid->slotNum, record_data, record_len);
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, 1);
+    if (pf_err != PFE_OK) {
+        PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+        return pf_err;
+    }
+    return PF_UnfixPage(fh->pf_fd, rid->pageNum, TRUE);
+}
 
-    // 4. Get the specific slot
-    slot = (RM_Slot *)(pageBuf + sizeof(RM_PageHeader) + (rid->slotNum * sizeof(RM_Slot)));
+/*
+ * RM_Relocate
+ * Stores a copy of record `home` on some page with room for it (never
+ * the home page, which has none) and returns where it went in `target`.
+ */
+static int RM_Relocate(RM_FileHandle *fh, const RID *home, const char *record_data, int record_len, RID *target) {
+    int pf_err;
+    char *pageBuf;
+    int slotNum;
 
-    // 5. Check if it's already deleted
-    if (slot->offset == -1) {
-        // Unfix the page before returning an error
+    pf_err = RM_FindFreePage(fh, record_len + sizeof(RID), &target->pageNum);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    pf_err = PF_GetThisPage(fh->pf_fd, target->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    RM_AccountSlot(fh, pageBuf, -1, -1);
+    slotNum = RM_PageInsertMoved(fh, pageBuf, home, record_data, record_len);
+    RM_AccountSlot(fh, pageBuf, slotNum, 1);
+    if (slotNum < 0) {
+        PF_UnfixPage(fh->pf_fd, target->pageNum, FALSE);
+        return RM_INVALID_RECLEN; // Record is larger than a page can hold
+    }
+    target->slotNum = slotNum;
+    return PF_UnfixPage(fh->pf_fd, target->pageNum, TRUE);
+}
+
+/*
+ * RM_UpdateInPage
+ * Writes new data for a record that stays on data pages (see
+ * RM_UpdateRec). `status` and `target` describe the home slot.
+ */
+static int RM_UpdateInPage(RM_FileHandle *fh, const RID *rid, int status, const RID *target,
+                           const char *record_data, int record_len) {
+    int pf_err;
+    char *pageBuf;
+    RID newTarget;
+
+    // 1. Try the home page first: in place, or back home for a moved record
+    pf_err = RM_UpdateSlot(fh, rid, record_data, record_len);
+    if (pf_err != RM_PAGE_FULL) {
+        if (pf_err == PFE_OK && status == RM_REC_FORWARDED) {
+            pf_err = RM_FreeSlot(fh, target); // Drop the old moved copy
+        }
+        return pf_err;
+    }
+
+    // 2. Already moved: try to update the moved copy where it is
+    if (status == RM_REC_FORWARDED) {
+        pf_err = RM_UpdateSlot(fh, target, record_data, record_len);
+        if (pf_err != RM_PAGE_FULL) {
+            return pf_err;
+        }
+    }
+
+    // 3. Move the record to a page with room. The home page must still
+    //    be able to hold the stub.
+    pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    if (!RM_PageRoomFor(fh, pageBuf, rid->slotNum, sizeof(RID))) {
+        PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+        return RM_PAGE_NOROOM;
+    }
+    pf_err = PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+
+    pf_err = RM_Relocate(fh, rid, record_data, record_len, &newTarget);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    if (status == RM_REC_FORWARDED) {
+        pf_err = RM_FreeSlot(fh, target);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+
+    // 4. Point the home slot at the new location
+    pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, -1);
+    RM_PageSetForward(fh, pageBuf, rid->slotNum, &newTarget);
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, 1);
+    return PF_UnfixPage(fh->pf_fd, rid->pageNum, TRUE);
+}
+
+/*
+ * RM_UpdateOverflow
+ * Writes a large record's new data out of line and puts its stub in
+ * the home slot, dropping a moved copy the record may have had. A
+ * record that is large already (`oldStub`) is rewritten over its own
+ * extent when the new data fits there; otherwise it gets a new extent
+ * and the old one is freed.
+ */
+static int RM_UpdateOverflow(RM_FileHandle *fh, const RID *rid, int status, const RID *target,
+                             const RM_OverflowStub *oldStub, const char *record_data, int record_len) {
+    int pf_err;
+    char *pageBuf;
+    RM_OverflowStub stub;
+    int inPlace = FALSE;
+
+    // 1. The stub always replaces the home slot, which must have room
+    pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    if (!RM_PageRoomFor(fh, pageBuf, rid->slotNum, sizeof(RM_OverflowStub))) {
         PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
-        return -2; // TODO: Define RM_RECORD_DELETED
+        return RM_PAGE_NOROOM;
     }
 
-    // 6. Mark the slot as deleted (tombstone)
-    // We set the offset to -1 to indicate it's free.
-    // Note: We are NOT reclaiming the data space yet.
-    // This creates "holes" in the page, which is normal.
-    // A full implementation might have a "compact" function.
-    slot->offset = -1;
-    // slot->length could also be set to 0, but offset=-1 is sufficient
+    // 2. Write the data: over the old extent if it fits, else to a new one
+    if (status == RM_REC_OVERFLOW) {
+        stub = *oldStub;
+        pf_err = RM_OverflowRewrite(fh, &stub, record_data, record_len);
+        inPlace = (pf_err != RM_PAGE_FULL);
+    }
+    if (!inPlace) {
+        pf_err = RM_OverflowWrite(fh, record_data, record_len, &stub);
+    }
+    if (pf_err != PFE_OK) {
+        PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+        return pf_err;
+    }
 
-    // 7. Mark the page as dirty and unfix it
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, -1);
+    RM_PageSetOverflow(fh, pageBuf, rid->slotNum, &stub);
+    RM_AccountSlot(fh, pageBuf, rid->slotNum, 1);
     pf_err = PF_UnfixPage(fh->pf_fd, rid->pageNum, TRUE);
     if (pf_err != PFE_OK) {
         return pf_err;
     }
 
+    // 3. Drop the old moved copy or the old extent
+    if (status == RM_REC_FORWARDED) {
+        return RM_FreeSlot(fh, target);
+    }
+    if (status == RM_REC_OVERFLOW && !inPlace) {
+        return RM_OverflowFree(fh, oldStub);
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_UpdateRec
+ * Replaces the record at `rid` with `record_len` bytes of new data.
+ * The RID never changes:
+ *   - if the new data fits on the record's page (after compacting it,
+ *     if need be) it is written there;
+ *   - otherwise it is moved to another page and the home slot becomes
+ *     a forwarding stub. Updating a moved record again moves it back
+ *     home if it now fits, and always repoints the home stub directly,
+ *     so a lookup never follows more than one hop;
+ *   - a large record is written over its old overflow extent if it
+ *     fits there, or else to a new extent whose stub the home slot
+ *     gets. An extent no longer used is freed once the update is done.
+ */
+int RM_UpdateRec(RM_FileHandle *fh, const RID *rid, char *record_data, int record_len) {
+    int pf_err;
+    char *pageBuf;
+    char *recordLocation;
+    int record_len_old;
+    int status;
+    RID target;
+    RM_OverflowStub oldStub;
+
+    // 0. Fixed-length files only take records of exactly the declared length
+    if (RM_IsFixed(fh) && record_len != fh->hdr.recordLength) {
+        return RM_INVALID_RECLEN;
+    }
+    if (!RM_DirTest(fh, rid->pageNum) || record_len < 0) {
+        return RM_INVALID_RID;
+    }
+    if (fh->recCache != NULL) {
+        RM_RecCacheInvalidate(fh->recCache, rid);
+    }
+
+    // 1. Look at the home slot
+    pf_err = PF_GetThisPage(fh->pf_fd, rid->pageNum, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    status = RM_PageGetRec(fh, pageBuf, rid->slotNum, &recordLocation, &record_len_old);
+    if (status == RM_REC_FORWARDED) {
+        memcpy(&target, recordLocation, sizeof(RID));
+    } else if (status == RM_REC_OVERFLOW) {
+        memcpy(&oldStub, recordLocation, sizeof(RM_OverflowStub));
+    }
+    pf_err = PF_UnfixPage(fh->pf_fd, rid->pageNum, FALSE);
+    if (status == RM_REC_MOVED) {
+        return RM_INVALID_RID; // Only the home RID names a moved record
+    }
+    if (status < 0) {
+        return status;
+    }
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+
+    // 2. Write the new data, in the data pages or out of line
+    if (!RM_IsFixed(fh) && record_len > RM_OVERFLOW_THRESHOLD) {
+        return RM_UpdateOverflow(fh, rid, status, &target, &oldStub, record_data, record_len);
+    }
+    pf_err = RM_UpdateInPage(fh, rid, status, &target, record_data, record_len);
+
+    // 3. A record that is no longer large leaves its old extent behind
+    if (pf_err == PFE_OK && status == RM_REC_OVERFLOW) {
+        pf_err = RM_OverflowFree(fh, &oldStub);
+    }
+    return pf_err;
+}
+
+/*
+ * RM_CompactFile
+ * Reclaims the holes on every data page, then brings each moved
+ * record back to its home page if it now fits there, turning the
+ * stub into the record again. Pages left empty are disposed and
+ * removed from the page directory.
+ */
+int RM_CompactFile(RM_FileHandle *fh) {
+    int pf_err;
+    char *pageBuf;
+    char *targetBuf;
+    char *recordLocation;
+    char record[PF_PAGE_SIZE];
+    int record_len;
+    int currentPageNum;
+    int slotNum;
+    int status;
+    RID target;
+
+    for (currentPageNum = RM_DirNextPage(fh, RM_HDR_PAGE); currentPageNum != RM_NO_PAGE;
+         currentPageNum = RM_DirNextPage(fh, currentPageNum)) {
+        pf_err = PF_GetThisPage(fh->pf_fd, currentPageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+
+        // 1. Close up the holes on this page (only the page's part of
+        //    the counters changes: dead bytes become free bytes)
+        RM_AccountSlot(fh, pageBuf, -1, -1);
+        RM_PageCompact(fh, pageBuf);
+        RM_AccountSlot(fh, pageBuf, -1, 1);
+
+        // 2. Pull moved records home where they fit now
+        for (slotNum = 0; !RM_IsFixed(fh); slotNum++) {
+            status = RM_PageGetRec(fh, pageBuf, slotNum, &recordLocation, &record_len);
+            if (status == RM_INVALID_RID)
+                break; // Past the last slot
+            if (status != RM_REC_FORWARDED)
+                continue;
+            memcpy(&target, recordLocation, sizeof(RID));
+            if (target.pageNum == currentPageNum)
+                continue;
+
+            pf_err = PF_GetThisPage(fh->pf_fd, target.pageNum, &targetBuf);
+            if (pf_err != PFE_OK) {
+                break;
+            }
+            if (RM_PageGetRec(fh, targetBuf, target.slotNum, &recordLocation, &record_len) == RM_REC_MOVED &&
+                RM_PageRoomFor(fh, pageBuf, slotNum, record_len)) {
+                memcpy(record, recordLocation, record_len);
+                RM_AccountSlot(fh, pageBuf, slotNum, -1);
+                RM_PageUpdate(fh, pageBuf, slotNum, record, record_len);
+                RM_AccountSlot(fh, pageBuf, slotNum, 1);
+
+                RM_AccountSlot(fh, targetBuf, target.slotNum, -1);
+                RM_PageDeleteRec(fh, targetBuf, target.slotNum);
+                RM_AccountSlot(fh, targetBuf, target.slotNum, 1);
+                pf_err = PF_UnfixPage(fh->pf_fd, target.pageNum, TRUE);
+            } else {
+                pf_err = PF_UnfixPage(fh->pf_fd, target.pageNum, FALSE);
+            }
+            if (pf_err != PFE_OK) {
+                break;
+            }
+        }
+        if (pf_err != PFE_OK) {
+            PF_UnfixPage(fh->pf_fd, currentPageNum, TRUE);
+            return pf_err;
+        }
+
+        // 3. Give a page with nothing left on it back to the PF layer
+        if (RM_PageIsEmpty(fh, pageBuf)) {
+            RM_AccountSlot(fh, pageBuf, -1, -1);
+            fh->hdr.stats.numPages--;
+            pf_err = RM_DirSet(fh, currentPageNum, FALSE);
+            if (currentPageNum == fh->tailPage) {
+                fh->tailPage = RM_NO_PAGE;
+            }
+            if (pf_err != PFE_OK) {
+                PF_UnfixPage(fh->pf_fd, currentPageNum, TRUE);
+                return pf_err;
+            }
+            pf_err = PF_UnfixPage(fh->pf_fd, currentPageNum, TRUE);
+            if (pf_err == PFE_OK) {
+                pf_err = PF_DisposePage(fh->pf_fd, currentPageNum);
+            }
+            if (pf_err != PFE_OK) {
+                return pf_err;
+            }
+            continue;
+        }
+
+        // 4. Mark the page as dirty and unfix it
+        pf_err = PF_UnfixPage(fh->pf_fd, currentPageNum, TRUE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+
     return PFE_OK;
 }
+
 /*
  * =================================================================
  * RM Scan Functions
@@ -352,85 +1279,231 @@ int RM_ScanOpen(RM_FileHandle *fh, RM_ScanHandle *sh) {
     // 1. Store the file handle
     sh->fh = fh;
     
-    // 2. Start the scan before the first page
-    sh->currentPageNum = -1; 
+    // 2. Start the scan before the first data page
+    sh->currentPageNum = RM_HDR_PAGE;
     
     // 3. Start the scan before the first slot
     sh->currentSlotNum = -1;
+    sh->shared = FALSE;
+    sh->startPage = RM_NO_PAGE;
+    sh->wrapped = FALSE;
+    sh->preds = NULL;
+    sh->numPreds = 0;
+    sh->selPage = RM_NO_PAGE;
+
+    return PFE_OK;
+}
+
+/*
+ * RM_ScanOpenFilter
+ * Initializes a scan that skips the records the predicates reject.
+ * The selection bitmap of a page is computed when the scan reaches it.
+ */
+int RM_ScanOpenFilter(RM_FileHandle *fh, RM_ScanHandle *sh, const RM_Pred *preds, int numPreds) {
+    int err;
+
+    err = RM_CheckPreds(fh, preds, numPreds);
+    if (err != PFE_OK) {
+        return err;
+    }
+    RM_ScanOpen(fh, sh);
+    sh->preds = preds;
+    sh->numPreds = numPreds;
+    return PFE_OK;
+}
 
+/*
+ * RM_ScanOpenShared
+ * Initializes a shared scan. Where it starts is decided by the first
+ * RM_GetNextRec, so it joins whichever scan is furthest along then.
+ */
+int RM_ScanOpenShared(RM_FileHandle *fh, RM_ScanHandle *sh) {
+    RM_ScanOpen(fh, sh);
+    sh->shared = TRUE;
     return PFE_OK;
 }
 
+/*
+ * RM_ScanFirstPage
+ * The page a scan starts on. A shared scan attaches to the page the
+ * latest shared scan reported, if it still holds data.
+ */
+static int RM_ScanFirstPage(RM_ScanHandle *sh) {
+    RM_FileHandle *fh = sh->fh;
+
+    if (!sh->shared) {
+        return RM_DirNextPage(fh, RM_HDR_PAGE);
+    }
+    if (RM_DirTest(fh, fh->scanPos)) {
+        sh->startPage = fh->scanPos;
+    } else {
+        sh->startPage = RM_DirNextPage(fh, RM_HDR_PAGE);
+    }
+    fh->scanPos = sh->startPage;
+    return sh->startPage;
+}
+
+/*
+ * RM_ScanNextPage
+ * The page after the scan's current one, or RM_NO_PAGE when the scan
+ * is done. A shared scan wraps around to the first page once, stops on
+ * reaching the page it started on, and reports every page it moves to
+ * so that newly opened shared scans can join it there.
+ */
+static int RM_ScanNextPage(RM_ScanHandle *sh) {
+    RM_FileHandle *fh = sh->fh;
+    int next = RM_DirNextPage(fh, sh->currentPageNum);
+
+    if (!sh->shared) {
+        return next;
+    }
+    if (next == RM_NO_PAGE && !sh->wrapped) {
+        sh->wrapped = TRUE;
+        next = RM_DirNextPage(fh, RM_HDR_PAGE);
+    }
+    if (sh->wrapped && next != RM_NO_PAGE && next >= sh->startPage) {
+        next = RM_NO_PAGE; // Back where we started
+    }
+    if (next != RM_NO_PAGE) {
+        fh->scanPos = next;
+    }
+    return next;
+}
+
+/*
+ * RM_ScanNextSelected
+ * The first slot >= sh->currentSlotNum in the selection bitmap that
+ * still holds a record, or RM_NO_SLOT.
+ */
+static int RM_ScanNextSelected(RM_ScanHandle *sh, char *pageBuf) {
+    int slotNum = sh->currentSlotNum < 0 ? 0 : sh->currentSlotNum;
+    int w = slotNum >> 6;
+    uint64_t word;
+
+    if (w >= RM_SEL_WORDS) {
+        return RM_NO_SLOT;
+    }
+    word = sh->sel[w] & (~(uint64_t)0 << (slotNum & 63));
+    while (TRUE) {
+        while (word == 0) {
+            if (++w == RM_SEL_WORDS) {
+                return RM_NO_SLOT;
+            }
+            word = sh->sel[w];
+        }
+        slotNum = (w << 6) + __builtin_ctzll(word);
+        if (RM_PageNextSlot(sh->fh, pageBuf, slotNum) == slotNum) {
+            return slotNum; // Not deleted since the page was filtered
+        }
+        word &= word - 1;
+    }
+}
+
 /*
  * RM_GetNextRec
  * Retrieves the next valid record from the scan.
  */
 int RM_GetNextRec(RM_ScanHandle *sh, char *record_data, RID *rid) {
-    int pf_err;
-    char *pageBuf;
-    RM_PageHeader *pageHeader;
-    RM_Slot *slot;
+    int record_len;
+
+    return RM_ScanNext(sh, record_data, INT_MAX, &record_len, rid);
+}
+
+/*
+ * RM_ScanNext
+ * RM_GetNextRec, also reporting the record's length and refusing to
+ * copy more than max_len bytes.
+ */
+int RM_ScanNext(RM_ScanHandle *sh, char *record_data, int max_len, int *record_len_out, RID *rid) {
+    RM_FileHandle *fh = sh->fh;
 
     // We loop indefinitely, breaking out when we find a record or hit EOF
     while (TRUE) {
         
         char *pageBuf;
-        RM_PageHeader *pageHeader;
+        char *recordLocation;
+        int record_len;
+        int slotNum;
         int pf_err;
 
-        // 1. Get the current page buffer
-        if (sh->currentPageNum == -1) { 
-            // This is the first call. Get the first page.
-            pf_err = PF_GetNextPage(sh->fh->pf_fd, &sh->currentPageNum, &pageBuf);
-            if (pf_err == PFE_EOF) {
-                return RM_EOF;
-            }
-            if (pf_err != PFE_OK) {
-                return pf_err;
-            }
+        // 1. Move to the first data page on the first call, and
+        //    stop once the page directory has no page left
+        if (sh->currentPageNum == RM_HDR_PAGE) {
+            sh->currentPageNum = RM_ScanFirstPage(sh);
             sh->currentSlotNum = 0; // Start scan from slot 0
-        } else {
-            // We are in the middle of a scan. Re-get the *current* page.
-            pf_err = PF_GetThisPage(sh->fh->pf_fd, sh->currentPageNum, &pageBuf);
-            if (pf_err != PFE_OK) {
-                // Page doesn't exist, we've gone past EOF
-                return RM_EOF;
-            }
+        }
+        if (sh->currentPageNum == RM_NO_PAGE) {
+            return RM_EOF;
         }
 
-        // We have a valid page, get its header
-        pageHeader = (RM_PageHeader *)pageBuf;
-
-        // 2. Scan slots *on this page*, starting from our saved slot number
-        while (sh->currentSlotNum < pageHeader->numSlots) {
-            slot = (RM_Slot *)(pageBuf + sizeof(RM_PageHeader) + (sh->currentSlotNum * sizeof(RM_Slot)));
+        // 2. Get the current page buffer. The directory only lists live
+        //    pages, so any failure here is a real error, not EOF.
+        pf_err = PF_GetThisPage(fh->pf_fd, sh->currentPageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
 
-            // Check if this slot is valid (not deleted)
-            if (slot->offset != -1) {
-                // 3. Found one!
-                char *recordLocation = pageBuf + slot->offset;
-                memcpy(record_data, recordLocation, slot->length);
+        // 3. Find the next valid slot *on this page*, starting from our
+        //    saved slot number. A filtered scan evaluates its predicates
+        //    over the whole page on arrival and then only visits the
+        //    slots left in the selection bitmap.
+        if (sh->numPreds > 0) {
+            if (sh->selPage != sh->currentPageNum) {
+                RM_PageSelect(fh, pageBuf, sh->preds, sh->numPreds, sh->sel);
+                sh->selPage = sh->currentPageNum;
+            }
+            slotNum = RM_ScanNextSelected(sh, pageBuf);
+        } else {
+            slotNum = RM_PageNextSlot(fh, pageBuf, sh->currentSlotNum);
+        }
+        if (slotNum != RM_NO_SLOT) {
+            RM_OverflowStub stub;
+            int status;
+
+            // 4. Found one!
+            status = RM_PageGetRec(fh, pageBuf, slotNum, &recordLocation, &record_len);
+            if (status == RM_REC_MOVED) {
+                // A relocated record is reported under its home RID
+                RM_MovedHomeRID(recordLocation, rid);
+            } else {
                 rid->pageNum = sh->currentPageNum;
-                rid->slotNum = sh->currentSlotNum;
-
-                // 4. Unfix page and return
-                PF_UnfixPage(sh->fh->pf_fd, sh->currentPageNum, FALSE);
-                
-                // 5. Save our state for the *next* call
-                sh->currentSlotNum++; // Next time, start at the *next* slot
-                return PFE_OK; // Return with state saved
+                rid->slotNum = slotNum;
+            }
+            if (status == RM_REC_OVERFLOW) {
+                memcpy(&stub, recordLocation, sizeof(RM_OverflowStub));
+                record_len = stub.totalLen;
             }
-            
-            // 6. Slot was empty, try the next one
-            sh->currentSlotNum++;
+            *record_len_out = record_len;
+            if (record_len > max_len) {
+                // Too long for the caller's buffer: stay on this record
+                PF_UnfixPage(fh->pf_fd, sh->currentPageNum, FALSE);
+                sh->currentSlotNum = slotNum;
+                return RM_INVALID_RECLEN;
+            }
+            if (status != RM_REC_OVERFLOW) {
+                memcpy(record_data, recordLocation, record_len);
+            }
+
+            // 5. Unfix page (a large record is then read from its extent)
+            PF_UnfixPage(fh->pf_fd, sh->currentPageNum, FALSE);
+            if (status == RM_REC_OVERFLOW) {
+                pf_err = RM_OverflowRead(fh, &stub, 0, record_data, record_len);
+                if (pf_err != PFE_OK) {
+                    return pf_err;
+                }
+            }
+
+            // 6. Save our state for the *next* call
+            sh->currentSlotNum = slotNum + 1; // Next time, start at the *next* slot
+            return PFE_OK; // Return with state saved
         }
 
         // 7. If we're here, we scanned all slots on this page.
         // Unfix the page and advance to the next page.
-        PF_UnfixPage(sh->fh->pf_fd, sh->currentPageNum, FALSE);
+        PF_UnfixPage(fh->pf_fd, sh->currentPageNum, FALSE);
         
-        // Advance to next page for the next iteration
-        sh->currentPageNum++;
+        // Advance to the next data page, skipping disposed pages without I/O
+        sh->currentPageNum = RM_ScanNextPage(sh);
         
         // Reset slot to 0 so we scan the new page from the beginning
         sh->currentSlotNum = 0;
@@ -449,7 +1522,7 @@ int RM_ScanClose(RM_ScanHandle *sh) {
     sh->currentSlotNum = -1;
     
     // 2. There's nothing to "close" on the PF layer,
-    // as PF_GetNextPage unfixes pages as it goes.
+    // as RM_GetNextRec unfixes pages as it goes.
     return PFE_OK;
 }
 /*
@@ -460,68 +1533,59 @@ int RM_ScanClose(RM_ScanHandle *sh) {
 
 /*
  * RM_GetSpaceUtilization
- * Scans the entire file to report on space usage.
+ * Reports on space usage from the counters in the file header, without
+ * reading any data page. The header page is not counted.
  */
 int RM_GetSpaceUtilization(RM_FileHandle *fh, int *total_pages, int *total_record_bytes, int *total_wasted_bytes) {
-    int pf_err;
-    char *pageBuf;
-    int currentPageNum = -1;
-    
-    // Initialize output parameters
-    *total_pages = 0;
-    *total_record_bytes = 0;
-    *total_wasted_bytes = 0;
-
-    // 1. Scan all existing pages using PF_GetNextPage
-    while ((pf_err = PF_GetNextPage(fh->pf_fd, &currentPageNum, &pageBuf)) == PFE_OK) {
-        (*total_pages)++;
-        
-        RM_PageHeader *pageHeader = (RM_PageHeader *)pageBuf;
-        int used_bytes_on_page = 0;
-        int wasted_bytes_on_page = 0;
+    RM_SpaceStats *stats = &fh->hdr.stats;
 
-        // Calculate space used by header and slots
-        int header_and_slot_space = sizeof(RM_PageHeader) + (pageHeader->numSlots * sizeof(RM_Slot));
-        wasted_bytes_on_page += header_and_slot_space;
+    *total_pages = stats->numPages + stats->overflowPages;
+    *total_record_bytes = stats->recordBytes;
 
-        // Calculate contiguous free space
-        int free_space = pageHeader->freeSpaceOffset - header_and_slot_space;
-        wasted_bytes_on_page += free_space;
+    // Total wasted = (Page Size) - (bytes used by *actual* records):
+    // header, slot directory or bitmap, free space, holes and the
+    // unused tail of each overflow extent.
+    *total_wasted_bytes = *total_pages * PF_PAGE_SIZE - stats->recordBytes;
 
-        // 2. Scan all slots on this page
-        for (int i = 0; i < pageHeader->numSlots; i++) {
-            RM_Slot *slot = (RM_Slot *)(pageBuf + sizeof(RM_PageHeader) + (i * sizeof(RM_Slot)));
+    return PFE_OK;
+}
 
-            if (slot->offset != -1) {
-                // This is a valid record
-                used_bytes_on_page += slot->length;
-            } else {
-                // This is a deleted record. The slot itself is already
-                // counted, but the *data* it used to point to is now
-                // "wasted" (a "hole").
-                // Note: a simple implementation just counts the slot length.
-                // A better one would track the hole size.
-                // For now, we'll just track *record* bytes vs *other* bytes.
-                // Let's refine:
-                // wasted = (page size) - (bytes used by records)
-            }
+/*
+ * RM_GetSpaceStats
+ * Returns the stored space counters, or with `verify` recomputes them
+ * from every data page and checks them against the stored ones.
+ */
+int RM_GetSpaceStats(RM_FileHandle *fh, RM_SpaceStats *stats, int verify) {
+    int pf_err;
+    char *pageBuf;
+    int currentPageNum;
+
+    if (!verify) {
+        *stats = fh->hdr.stats;
+        return PFE_OK;
+    }
+
+    // 1. Visit every data page in the page directory
+    memset(stats, 0, sizeof(RM_SpaceStats));
+    for (currentPageNum = RM_DirNextPage(fh, RM_HDR_PAGE); currentPageNum != RM_NO_PAGE;
+         currentPageNum = RM_DirNextPage(fh, currentPageNum)) {
+        pf_err = PF_GetThisPage(fh->pf_fd, currentPageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
         }
-        
-        *total_record_bytes += used_bytes_on_page;
-        
-        // Total wasted = (Page Size) - (bytes used by *actual* records)
-        *total_wasted_bytes += (PF_PAGE_SIZE - used_bytes_on_page);
+        stats->numPages++;
+        RM_PageCollectStats(fh, pageBuf, stats);
 
-        // Unfix the page
-        int unfix_err = PF_UnfixPage(fh->pf_fd, currentPageNum, FALSE);
-        if (unfix_err != PFE_OK) {
-            return unfix_err;
+        // 2. Unfix the page
+        pf_err = PF_UnfixPage(fh->pf_fd, currentPageNum, FALSE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
         }
     }
 
-    // Check if the loop ended for a reason other than EOF
-    if (pf_err != PFE_EOF) {
-        return pf_err; // An error occurred during scan
+    // 3. Compare with the incrementally maintained counters
+    if (memcmp(stats, &fh->hdr.stats, sizeof(RM_SpaceStats)) != 0) {
+        return RM_STATS_MISMATCH;
     }
 
     return PFE_OK;
@@ -2,6 +2,8 @@
 #ifndef RM_H
 #define RM_H
 
+#include <stdint.h>
+
 #include "../pflayer/pf.h" /* We depend on the PF Layer */
 
 /*
@@ -14,15 +16,137 @@ typedef struct {
   int slotNum; /* Slot number within the page */
 } RID;
 
+/*
+ * Page formats (RM_FileHeader.pageFormat)
+ */
+#define RM_FORMAT_SLOTTED 0 /* Variable-length records, 8-byte slots */
+#define RM_FORMAT_FIXED 1   /* Fixed-length records, presence bitmap */
+#define RM_FORMAT_COMPACT 2 /* Variable-length records, 4-byte slots */
+#define RM_FORMAT_PAX 3     /* Fixed-length records stored attribute by
+                               attribute (needs a schema) */
+
+/*
+ * Attribute types for fixed-width record layouts. A layout is an array
+ * of RM_Attr; attributes are stored back to back in that order, in the
+ * machine's byte order, with no padding.
+ */
+#define RM_TYPE_INT32 0  /* 4-byte signed integer */
+#define RM_TYPE_INT64 1  /* 8-byte signed integer */
+#define RM_TYPE_FLOAT 2  /* 4-byte float */
+#define RM_TYPE_DOUBLE 3 /* 8-byte double */
+#define RM_TYPE_CHAR 4   /* char(length), NUL-padded */
+
+typedef struct {
+  int type;   /* One of the RM_TYPE_* values */
+  int length; /* Bytes: set by the caller for RM_TYPE_CHAR only */
+} RM_Attr;
+
+/* Largest number of attributes a file schema can describe */
+#define RM_MAX_ATTRS 24
+
+/*
+ * RM_SpaceStats:
+ * Space accounting for a file. Kept up to date by every insert and
+ * delete in the file handle, so reading it costs no I/O, and written
+ * to the file header at close or by RM_FlushFile.
+ */
+typedef struct {
+  int numPages;    /* Data pages (the header page is not counted) */
+  int numRecs;     /* Live records */
+  int recordBytes; /* Bytes held by live records */
+  int deadBytes;   /* Holes, stubs and other bytes only compaction reclaims */
+  int freeBytes;   /* Bytes on data pages still available for records */
+  int overflowPages; /* Pages in the overflow extents of large records */
+} RM_SpaceStats;
+
+/*
+ * RM_FreeRun: consecutive pages of freed overflow extents, kept for
+ * the next large record instead of being disposed (see rmoverflow.c).
+ * Up to RM_MAX_FREE_RUNS runs are kept; pages freed when the list is
+ * full go back to the PF layer.
+ */
+#define RM_MAX_FREE_RUNS 16
+
+typedef struct {
+  int firstPage; /* First page of the run */
+  int numPages;  /* Pages in the run */
+} RM_FreeRun;
+
+/*
+ * RM_FileHeader:
+ * File-level metadata, stored at the start of page 0 of every RM file.
+ */
+typedef struct {
+  int magic;           /* RM_FILE_MAGIC, identifies an RM file */
+  int pageFormat;      /* One of the RM_FORMAT_* values */
+  int recordLength;    /* Record length (RM_FORMAT_FIXED and _PAX only) */
+  int recsPerPage;     /* Records per page (RM_FORMAT_FIXED and _PAX only) */
+  RM_SpaceStats stats; /* Incrementally maintained space counters */
+  int numAttrs;        /* Attributes in the schema, 0 if it has none */
+  RM_Attr attrs[RM_MAX_ATTRS]; /* Schema (RM_CreateFileSchema) */
+  int dirNext;         /* First page directory page after page 0, or 0 */
+  int numFreeRuns;     /* Entries in freeRuns */
+  RM_FreeRun freeRuns[RM_MAX_FREE_RUNS]; /* Free overflow pages, by run */
+} RM_FileHeader;
+
+/*
+ * Page directory: one bit per page number, set for every page that
+ * currently holds RM data. The bits for the first RM_DIR_MAXPAGES
+ * pages are kept at the end of page 0, after the file header; later
+ * page numbers are covered by directory pages chained from the header
+ * (RM_FileHeader.dirNext). A directory page is appended whenever a data
+ * page falls past the end of the chain, so the directory does not
+ * bound the size of a file.
+ */
+#define RM_DIR_BYTES 3712
+#define RM_DIR_MAXPAGES (RM_DIR_BYTES * 8)
+
+/*
+ * Large records: a record longer than RM_OVERFLOW_THRESHOLD bytes is
+ * stored out of line, in an extent of consecutive overflow pages, and
+ * its slot only holds a small stub describing the extent. Fixed-length
+ * files never use overflow pages.
+ */
+#define RM_OVERFLOW_THRESHOLD (PF_PAGE_SIZE / 4)
+
+struct RM_RecCache; /* Record cache of a file handle (rmcache.c) */
+typedef struct RM_RecCache RM_RecCache;
+
 /*
  * RM_FileHandle:
  * Used to access a file managed by the RM layer.
  */
 typedef struct {
-  int pf_fd; /* The PF layer's file descriptor */
-  /* We might add file-level metadata here later */
+  int pf_fd;                          /* The PF layer's file descriptor */
+  RM_FileHeader hdr;                  /* In-memory copy of the file header */
+  unsigned char *pageDir;             /* Copy of the page directory: the
+                                         bitmaps of all its pages, back to
+                                         back (malloc'd) */
+  int dirBytes;                       /* Bytes in pageDir */
+  int *dirPages;                      /* Page holding each part of the
+                                         directory; dirPages[0] is page 0 */
+  int numDirPages;                    /* Entries in dirPages */
+  int hdrChanged;                     /* TRUE if the counters or free runs
+                                         changed since they were last
+                                         written to page 0 */
+  int scanPos;                        /* Page the latest shared scan moved
+                                         to, or -1 (kept in memory only) */
+  int openFlags;                      /* RM_OPEN_* flags given at open */
+  int tailPage;                       /* RM_OPEN_APPEND: page inserts go
+                                         to, or -1 */
+  RM_RecCache *recCache;              /* Record cache (RM_SetRecCache),
+                                         or NULL */
 } RM_FileHandle;
 
+/*
+ * Open flags (RM_OpenFileFlags)
+ * RM_OPEN_APPEND - append-only inserts: every record goes to the tail
+ *                  page, and a new page is appended to the file when it
+ *                  is full. Earlier pages are never searched for space,
+ *                  so room freed by deletes is not reused.
+ */
+#define RM_OPEN_APPEND 0x1
+
 /*
  * =================================================================
  * Public API Functions
@@ -32,36 +156,185 @@ typedef struct {
 /* Initialize the RM layer */
 void RM_Init(void);
 
-/* Create a new file */
+/* Create a new file (compact slotted pages, variable-length records) */
 int RM_CreateFile(char *fname);
 
+/*
+ * Create a new file with the given page format. record_len is the
+ * length of every record for RM_FORMAT_FIXED and ignored otherwise.
+ */
+int RM_CreateFileFormat(char *fname, int pageFormat, int record_len);
+
+/*
+ * Create a fixed-length file whose records follow the layout
+ * attrs[0..numAttrs-1]. The schema is kept in the file header; it lets
+ * RM_ScanOpenFilter evaluate predicates a page at a time. pageFormat is
+ * RM_FORMAT_FIXED (records stored whole) or RM_FORMAT_PAX (each page
+ * keeps every attribute of its records in a contiguous array, so
+ * predicates on one attribute read only that array). Both formats
+ * place the same number of records on a page and use the same RIDs.
+ */
+int RM_CreateFileSchema(char *fname, int pageFormat, RM_Attr *attrs, int numAttrs);
+
 /* Destroy a file */
 int RM_DestroyFile(char *fname);
 
-/* Open a file */
+/*
+ * Open a file. Every change to the header and page directory is
+ * written through to page 0 in the buffer pool, and the handle keeps
+ * a copy, so a file may only be open once at a time: a second open
+ * returns PFE_FILEOPEN.
+ */
 int RM_OpenFile(char *fname, RM_FileHandle *fh);
 
+/* Open a file with RM_OPEN_* flags */
+int RM_OpenFileFlags(char *fname, RM_FileHandle *fh, int flags);
+
 /* Close a file */
 int RM_CloseFile(RM_FileHandle *fh);
 
+/* Write the file's space counters and free runs to page 0 (done at close) */
+int RM_FlushFile(RM_FileHandle *fh);
+
 /* Insert a new record */
 int RM_InsertRec(RM_FileHandle *fh, char *record_data, int record_len, RID *rid);
 
 /* Delete a record */
 int RM_DeleteRec(RM_FileHandle *fh, const RID *rid);
 
-/* Get a specific record */
+/*
+ * Get a specific record. A large record is copied whole, so the buffer
+ * must hold it: RM_OpenRecStream reports its length without reading it.
+ */
 int RM_GetRec(RM_FileHandle *fh, const RID *rid, char *record_data);
 
-/* Get space utilization info */
+/*
+ * Replace a record with new data of any length. The RID stays valid:
+ * a record that no longer fits on its page is moved and its old slot
+ * forwards to it, so indexes on unchanged keys need no maintenance.
+ */
+int RM_UpdateRec(RM_FileHandle *fh, const RID *rid, char *record_data, int record_len);
+
+/* Reclaim holes on every page and move forwarded records back home */
+int RM_CompactFile(RM_FileHandle *fh);
+
+/* Get space utilization info (O(1), read from the file header) */
 int RM_GetSpaceUtilization(RM_FileHandle *fh, int *total_pages, int *total_record_bytes, int *total_wasted_bytes);
 
+/*
+ * RM_GetSpaceStats
+ * Copies the file's space counters into `stats` without touching any
+ * data page. With `verify` TRUE the counters are instead recomputed by
+ * scanning every data page; the scanned values are returned, and
+ * RM_STATS_MISMATCH is reported if they disagree with the stored ones.
+ */
+int RM_GetSpaceStats(RM_FileHandle *fh, RM_SpaceStats *stats, int verify);
+
+/*
+ * =================================================================
+ * Record Cache
+ * =================================================================
+ */
+
+/*
+ * RM_RecCacheStats:
+ * Record-cache counters of one file handle, and the buffer pool's page
+ * counters (shared by all open files, since the last PF_ResetStats).
+ */
+typedef struct {
+  long lookups;       /* RM_GetRec calls that consulted the cache */
+  long hits;          /* ... answered from it without the PF layer */
+  long evictions;     /* Entries evicted to stay within the budget */
+  long invalidations; /* Entries dropped by deletes and updates */
+  long bytes;         /* Bytes charged against the budget now */
+  int entries;        /* Records cached now */
+  long pageRequests;  /* Pages asked of the buffer pool */
+  long pageMisses;    /* ... that had to be read from disk */
+} RM_RecCacheStats;
+
+/*
+ * RM_SetRecCache
+ * Gives the handle a cache of up to budgetBytes of records keyed by
+ * RID (each entry is also charged a small fixed overhead), or removes
+ * it with 0. RM_GetRec answers from the cache when it can and adds
+ * what it reads from a page; the least recently referenced entries
+ * are evicted by a CLOCK sweep. RM_DeleteRec and RM_UpdateRec drop the
+ * entry of the RID they change. Large (overflow) records are never
+ * cached. Changes made through another handle of the same file are
+ * not seen by this handle's cache.
+ */
+int RM_SetRecCache(RM_FileHandle *fh, long budgetBytes);
+
+/* RM_GetRecCacheStats: fills in `stats` (all zero if there is no cache) */
+int RM_GetRecCacheStats(RM_FileHandle *fh, RM_RecCacheStats *stats);
+
+/* RM_ResetRecCacheStats: zeroes the handle's record-cache counters */
+void RM_ResetRecCacheStats(RM_FileHandle *fh);
+
+/*
+ * =================================================================
+ * Streaming Record Reads
+ * =================================================================
+ */
+
+/*
+ * RM_RecStream:
+ * Reads one record in pieces. A large record is read straight from its
+ * overflow extent, page after page, as the caller asks for more; a
+ * record kept on its data page is copied into `data` when opened.
+ */
+typedef struct {
+  RM_FileHandle *fh;        /* File the record belongs to */
+  int length;               /* Total record length */
+  int pos;                  /* Bytes already returned */
+  int firstPage;            /* First page of its overflow extent, or -1 */
+  char data[PF_PAGE_SIZE];  /* The record itself when firstPage is -1 */
+} RM_RecStream;
+
+/* RM_OpenRecStream: starts reading the record at `rid` (length in rs->length) */
+int RM_OpenRecStream(RM_FileHandle *fh, const RID *rid, RM_RecStream *rs);
+
+/*
+ * RM_ReadRecStream
+ * Copies the next min(max_len, bytes left) bytes into `buf` and sets
+ * *nread. Returns RM_EOF once the whole record has been read.
+ */
+int RM_ReadRecStream(RM_RecStream *rs, char *buf, int max_len, int *nread);
+
+/* RM_CloseRecStream: finishes a stream */
+int RM_CloseRecStream(RM_RecStream *rs);
+
 /*
  * =================================================================
  * Scan Functions
  * =================================================================
  */
 
+/*
+ * Comparison operators for RM_Pred
+ */
+#define RM_OP_EQ 0
+#define RM_OP_NE 1
+#define RM_OP_LT 2
+#define RM_OP_LE 3
+#define RM_OP_GT 4
+#define RM_OP_GE 5
+
+/*
+ * RM_Pred:
+ * One comparison `attribute op constant` against the file schema.
+ * `value` points to a constant of the attribute's type; for
+ * RM_TYPE_CHAR it points to `length` bytes compared with memcmp.
+ */
+typedef struct {
+  int attr;          /* Index of the attribute in the schema */
+  int op;            /* One of the RM_OP_* values */
+  const void *value; /* The constant */
+} RM_Pred;
+
+/* Selection bitmap words per page: one bit per slot */
+#define RM_SEL_WORDS (PF_PAGE_SIZE / 64)
+
 /*
  * RM_ScanHandle:
  * Used to keep track of the state of a scan.
@@ -70,6 +343,13 @@ typedef struct {
   RM_FileHandle *fh;   /* File handle for the file being scanned */
   int currentPageNum;  /* Page number of the current page */
   int currentSlotNum;  /* Slot number of the next record to return */
+  int shared;          /* TRUE for a scan opened with RM_ScanOpenShared */
+  int startPage;       /* Shared scans: page the scan attached at */
+  int wrapped;         /* Shared scans: TRUE once past the last page */
+  const RM_Pred *preds; /* Filtered scans: the conjunction to apply */
+  int numPreds;        /* Filtered scans: number of predicates, else 0 */
+  int selPage;         /* Page `sel` was computed for, or RM_NO_PAGE */
+  uint64_t sel[RM_SEL_WORDS]; /* Slots of selPage that satisfy preds */
 } RM_ScanHandle;
 
 /*
@@ -78,6 +358,44 @@ typedef struct {
  */
 int RM_ScanOpen(RM_FileHandle *fh, RM_ScanHandle *sh);
 
+/*
+ * RM_ScanOpenShared
+ * Initializes a scan that cooperates with the other shared scans of
+ * the same file handle: it starts on the page the most recent shared
+ * scan is reading, runs to the end of the file, then wraps around and
+ * stops where it started. Scans that run side by side thus ask the
+ * buffer pool for the same pages at about the same time, and each page
+ * is read from disk about once for all of them. Records come back in
+ * file order rotated to the starting page.
+ */
+int RM_ScanOpenShared(RM_FileHandle *fh, RM_ScanHandle *sh);
+
+/*
+ * RM_ScanOpenFilter
+ * Initializes a scan that returns only the records satisfying every
+ * predicate in preds[0..numPreds-1], which must stay valid until the
+ * scan is closed. The file needs a schema (RM_CreateFileSchema). Each
+ * page is filtered once, one predicate at a time over all its records,
+ * with SIMD compares where the CPU has them (see RM_SetSimdLevel); the
+ * result is a selection bitmap the scan then walks.
+ */
+int RM_ScanOpenFilter(RM_FileHandle *fh, RM_ScanHandle *sh, const RM_Pred *preds, int numPreds);
+
+/*
+ * Instruction sets for predicate evaluation
+ */
+#define RM_SIMD_SCALAR 0 /* Plain C, one record at a time */
+#define RM_SIMD_SSE 1    /* SSE4.2: 4 x 32-bit or 2 x 64-bit lanes */
+#define RM_SIMD_AVX2 2   /* AVX2: 8 x 32-bit or 4 x 64-bit lanes */
+
+/*
+ * RM_SetSimdLevel
+ * Limits predicate evaluation to `level` (the best level the CPU
+ * supports is used by default) and returns the level now in effect,
+ * which may be lower than asked for.
+ */
+int RM_SetSimdLevel(int level);
+
 /*
  * RM_GetNextRec
  * Retrieves the next valid record from the scan.
@@ -91,6 +409,237 @@ int RM_GetNextRec(RM_ScanHandle *sh, char *record_data, RID *rid);
  */
 int RM_ScanClose(RM_ScanHandle *sh);
 
+/*
+ * =================================================================
+ * Parallel Scan Functions
+ * =================================================================
+ */
+
+/*
+ * RM_ScanCallback:
+ * Called once for every valid record a parallel scan visits.
+ * `arg` is the per-thread argument given to RM_ParallelScan.
+ * Return PFE_OK to keep going; any other value stops the scan
+ * and is passed back to the caller.
+ */
+typedef int (*RM_ScanCallback)(void *arg, const char *record_data,
+                               int record_len, const RID *rid);
+
+/* Number of pages a worker claims at a time */
+#define RM_PSCAN_MORSEL 8
+
+/* Upper bound on the number of worker threads */
+#define RM_PSCAN_MAXTHREADS 64
+
+/*
+ * RM_ParallelScan
+ * Scans the whole file with `numThreads` worker threads. Pages are
+ * handed out in morsels of RM_PSCAN_MORSEL from a shared counter;
+ * worker i calls fn(args[i], ...) for each record on its pages.
+ * `args` may be NULL, in which case every callback gets NULL.
+ */
+int RM_ParallelScan(RM_FileHandle *fh, int numThreads, RM_ScanCallback fn, void **args);
+
+/*
+ * =================================================================
+ * External Sort Functions
+ * =================================================================
+ */
+
+/*
+ * RM_SortCmp:
+ * Orders two records: < 0, 0 or > 0 as rec1 sorts before, with or
+ * after rec2. Records are passed where they sit in the sort buffers,
+ * so the comparator reads its key straight from fixed offsets inside
+ * them; no key is extracted or copied. `arg` is passed through.
+ */
+typedef int (*RM_SortCmp)(void *arg, const char *rec1, int len1,
+                          const char *rec2, int len2);
+
+/* Smallest useful budget: two input pages and one output page */
+#define RM_SORT_MINPAGES 3
+
+struct RM_SortRun; /* Merge cursor over one sorted run (rm_internal.h) */
+
+/*
+ * RM_SortHandle:
+ * A sort in progress. RM_SortOpen consumes the input and leaves the
+ * sorted runs behind; RM_SortGetNext streams the final merge.
+ */
+typedef struct {
+  RM_SortCmp cmp;          /* Record comparator */
+  void *cmpArg;            /* Passed to cmp */
+  int memPages;            /* Memory budget in pages */
+  char *area;              /* Run buffer: memPages pages */
+  int *offsets;            /* Sorted record offsets into area */
+  int memRecs;             /* Records left in area (input fit in memory) */
+  int memNext;             /* Next of them to return */
+  int runFd;               /* PF file holding the final runs, or -1 */
+  char runFile[64];        /* Its name (a temporary file) */
+  int numRuns;             /* Runs being merged */
+  struct RM_SortRun *runs; /* One cursor per run */
+  int *tree;               /* Loser tree: tree[0] is the winning run */
+  long numSpilled;         /* Run pages written over all passes */
+  int numPasses;           /* Merge passes before the final merge */
+  int maxRecLen;           /* Longest record in the input */
+} RM_SortHandle;
+
+/*
+ * RM_SortOpen
+ * Sorts every record of `fh` with at most `memPages` pages of memory.
+ * Runs that do not fit are written to temporary PF files and merged
+ * (in several passes if there are more runs than memPages - 1).
+ * Records of any length are sorted: one longer than a run page spans
+ * several, and one longer than the whole budget becomes a run of its
+ * own (the merge then holds a copy of each spanned record it is on,
+ * beyond the budget).
+ */
+int RM_SortOpen(RM_FileHandle *fh, RM_SortCmp cmp, void *cmpArg, int memPages, RM_SortHandle *sh);
+
+/*
+ * RM_SortGetNext
+ * Returns the next record in sorted order and its length. record_data
+ * must hold sh->maxRecLen bytes. Returns RM_EOF after the last record.
+ */
+int RM_SortGetNext(RM_SortHandle *sh, char *record_data, int *record_len);
+
+/* RM_SortClose: frees the sort's memory and temporary files */
+int RM_SortClose(RM_SortHandle *sh);
+
+/*
+ * RM_SortFile
+ * Sorts `fh` into a new RM file `outFname` (same page format and schema).
+ */
+int RM_SortFile(RM_FileHandle *fh, RM_SortCmp cmp, void *cmpArg, int memPages, char *outFname);
+
+/*
+ * =================================================================
+ * Record Layouts
+ * =================================================================
+ */
+
+/*
+ * RM_LayoutLength
+ * Record length of a layout, filling in attrs[i].length for the
+ * fixed-size types. Returns RM_INVALID_ARG for an unknown type.
+ */
+int RM_LayoutLength(RM_Attr *attrs, int numAttrs);
+
+/*
+ * =================================================================
+ * Aggregation
+ * =================================================================
+ */
+
+/*
+ * Aggregate functions. SUM, MIN and MAX take a numeric attribute of
+ * the schema; COUNT counts rows and ignores `attr`.
+ */
+#define RM_AGG_COUNT 0
+#define RM_AGG_SUM 1
+#define RM_AGG_MIN 2
+#define RM_AGG_MAX 3
+
+/* Most aggregates one call computes */
+#define RM_AGG_MAXAGGS 16
+
+typedef struct {
+  int func; /* One of the RM_AGG_* values */
+  int attr; /* Attribute to aggregate */
+} RM_AggSpec;
+
+/*
+ * RM_AggValue:
+ * An aggregate's value: `i` for COUNT and for integer attributes
+ * (sums are 64-bit), `d` for float and double attributes.
+ */
+typedef union {
+  long long i;
+  double d;
+} RM_AggValue;
+
+/*
+ * RM_Aggregate
+ * Computes aggs[0..numAggs-1] over the records of a schema'd file that
+ * satisfy preds (numPreds may be 0), and sets *numRows to how many did.
+ * Pages are processed whole: the predicates yield a selection bitmap
+ * (as in RM_ScanOpenFilter) and each aggregate reduces its attribute
+ * over the selected slots, with AVX2 when RM_SetSimdLevel allows it.
+ * MIN and MAX are 0 when no row qualifies.
+ */
+int RM_Aggregate(RM_FileHandle *fh, const RM_Pred *preds, int numPreds,
+                 const RM_AggSpec *aggs, int numAggs, RM_AggValue *results, long *numRows);
+
+/* Grouping keys: int32, int64 or char(n) with n up to this many bytes */
+#define RM_GROUP_MAXKEY 16
+
+/* Spilled rows are split into this many partitions by key hash */
+#define RM_GROUP_PARTITIONS 16
+
+/* Smallest memory budget for RM_GroupBy (partition buffers and a table) */
+#define RM_GROUP_MINMEM ((RM_GROUP_PARTITIONS + 4) * PF_PAGE_SIZE)
+
+/*
+ * RM_GroupCallback:
+ * Called once per group with its key (keyLen bytes of the key
+ * attribute) and its aggregate values, in the order of `aggs`.
+ * Return PFE_OK to go on; any other value stops RM_GroupBy with it.
+ */
+typedef int (*RM_GroupCallback)(void *arg, const char *key, int keyLen, const RM_AggValue *values);
+
+/* RM_GroupStats: how a grouping went */
+typedef struct {
+  long groups;      /* Groups reported */
+  long spilledRows; /* Rows written to spill partitions (all passes) */
+  int spillPages;   /* Pages written to the spill file */
+  int passes;       /* Passes over the data: 1 if nothing spilled */
+} RM_GroupStats;
+
+/*
+ * RM_GroupBy
+ * GROUP BY keyAttr over the rows of a schema'd file that satisfy preds,
+ * reporting every group to fn. Groups are aggregated in a hash table
+ * that holds at most memBytes (>= RM_GROUP_MINMEM). Once it is full,
+ * rows of groups not in it are hashed into RM_GROUP_PARTITIONS spill
+ * partitions in a temporary PF file; each partition is then grouped in
+ * turn, partitioned again with other hash bits if it is still too big.
+ * `stats` may be NULL.
+ */
+int RM_GroupBy(RM_FileHandle *fh, const RM_Pred *preds, int numPreds, int keyAttr,
+               const RM_AggSpec *aggs, int numAggs, long memBytes,
+               RM_GroupCallback fn, void *arg, RM_GroupStats *stats);
+
+/*
+ * =================================================================
+ * Bulk Loading
+ * =================================================================
+ */
+
+/* RM_LoadCSV flags */
+#define RM_LOAD_HEADER 0x1 /* Skip the first line of the file */
+
+/* Input is cut at line ends into chunks of about this many bytes */
+#define RM_LOAD_CHUNK (1 << 20)
+
+/* RM_LoadStats: what a load did */
+typedef struct {
+  long rows;     /* Records loaded */
+  long rejected; /* Lines with the wrong field count or a bad number */
+  int pages;     /* Data pages appended */
+} RM_LoadStats;
+
+/*
+ * RM_LoadCSV
+ * Appends the rows of a comma-separated file to `fh`. The file is
+ * memory-mapped and cut into chunks that `numThreads` workers parse into
+ * records of the given layout, packing them into complete pages of the
+ * file's format in private memory. The pages are then appended to the
+ * file in input order, each with a single page write. Fields may be
+ * quoted ("" inside quotes is a quote) but may not contain newlines.
+ */
+int RM_LoadCSV(RM_FileHandle *fh, const char *csvFile, RM_Attr *attrs, int numAttrs,
+               int numThreads, int flags, RM_LoadStats *stats);
+
 /*
  * =================================================================
  * RM-specific Error Codes
@@ -99,5 +648,13 @@ int RM_ScanClose(RM_ScanHandle *sh);
 #define RM_EOF -100 // End of file/scan
 #define RM_INVALID_RID -101
 #define RM_RECORD_DELETED -102
+#define RM_INVALID_ARG -103
+#define RM_THREAD_ERROR -104
+#define RM_INVALID_FILE -105   // Not an RM file (bad header page)
+#define RM_INVALID_RECLEN -106 // Wrong length for a fixed-length file
+#define RM_STATS_MISMATCH -107 // Stored space counters disagree with a full scan
+#define RM_PAGE_NOROOM -108    // No room left for a forwarding stub on the home page
+#define RM_NOMEM -110          // malloc failed
+#define RM_IO_ERROR -111       // A file outside the PF layer could not be read
 
 #endif /* RM_H */
\ No newline at end of file
@@ -4,6 +4,44 @@
 
 #include "rm.h"
 
+/*
+ * =================================================================
+ * File Layout Definitions
+ * =================================================================
+ */
+
+/*
+ * Page 0 of every RM file holds the RM_FileHeader (see rm.h).
+ * Data pages start at page 1.
+ */
+#define RM_HDR_PAGE 0
+
+/* Magic number stored in RM_FileHeader.magic ("RMF6") */
+#define RM_FILE_MAGIC 0x524D4636
+
+/*
+ * The page directory (see rm.h) occupies the last RM_DIR_BYTES of page 0;
+ * the RM_FileHeader sits at the start, with room to grow in between.
+ */
+#define RM_DIR_OFFSET (PF_PAGE_SIZE - RM_DIR_BYTES)
+
+/* The header, schema included, must end before the directory starts */
+typedef char RM_HeaderFitsPage[(sizeof(RM_FileHeader) <= RM_DIR_OFFSET) ? 1 : -1];
+
+/*
+ * RM_DirPageHeader: starts every page directory page after page 0. The
+ * bitmap fills the rest of the page and continues where the previous
+ * directory page's bitmap ends.
+ */
+typedef struct {
+  int next; /* Next page directory page, or 0 at the end of the chain */
+} RM_DirPageHeader;
+
+#define RM_DIR_PAGEBYTES (PF_PAGE_SIZE - (int)sizeof(RM_DirPageHeader))
+
+/* Returned by RM_DirNextPage when no data page is left */
+#define RM_NO_PAGE -1
+
 /*
  * =================================================================
  * Page Layout Definitions
@@ -11,7 +49,7 @@
  */
 
 /*
- * RM_PageHeader: Sits at the beginning of each page.
+ * RM_PageHeader: Sits at the beginning of each slotted page.
  */
 typedef struct {
   int numSlots;            /* Number of slots on this page (used or unused) */
@@ -28,9 +66,129 @@ typedef struct {
 typedef struct {
   int offset; /* Offset from the start of the page to the
                  start of the record. -1 if slot is free. */
-  int length; /* Length of the record in bytes. */
+  int length; /* Length of the record in bytes, plus RM_SLOT_* flags */
 } RM_Slot;
 
+/*
+ * RM_CompactPageHeader / RM_CompactSlot: the compact slotted format
+ * (RM_FORMAT_COMPACT). Same layout as RM_PageHeader/RM_Slot, but every
+ * field is 16 bits: offsets and lengths never exceed PF_PAGE_SIZE.
+ * A deleted slot keeps its length and sets RM_CSLOT_TOMBSTONE.
+ */
+typedef struct {
+  unsigned short numSlots;        /* Number of slots on this page */
+  unsigned short freeSpaceOffset; /* Start of the free space (see above) */
+} RM_CompactPageHeader;
+
+typedef struct {
+  unsigned short offset; /* Offset from the start of the page to the record */
+  unsigned short length; /* Record length (low 13 bits) and flag bits */
+} RM_CompactSlot;
+
+#define RM_CSLOT_TOMBSTONE 0x8000 /* Slot is free */
+#define RM_CSLOT_LENMASK 0x1FFF   /* Lengths go up to PF_PAGE_SIZE */
+
+/*
+ * Flags kept above the length bits of a slot (both slotted formats).
+ * RM_UpdateRec moves a record that outgrew its page elsewhere and
+ * leaves a FORWARD stub holding the new RID in the home slot; the
+ * relocated copy is a MOVED slot whose bytes start with the home RID,
+ * so scans can report the record under the RID its users know.
+ */
+#define RM_SLOT_FORWARD 0x4000 /* Slot holds the RID of the moved record */
+#define RM_SLOT_MOVED 0x2000   /* Slot holds [home RID][record data] */
+#define RM_SLOT_FLAGS (RM_SLOT_FORWARD | RM_SLOT_MOVED)
+
+/*
+ * A large record's slot holds an RM_OverflowStub. There is no spare bit
+ * under the tombstone flag, so it is the one combination of the flags
+ * above that a relocated record never uses; compare flags with ==.
+ */
+#define RM_SLOT_OVERFLOW RM_SLOT_FLAGS
+
+/*
+ * RM_OverflowStub: where a large record lives. Its bytes fill pages
+ * firstPage .. firstPage + numPages - 1 in order; these pages have no
+ * header and are not in the page directory.
+ */
+typedef struct {
+  int totalLen;  /* Record length */
+  int firstPage; /* First page of the extent */
+  int numPages;  /* Pages in the extent */
+} RM_OverflowStub;
+
+/*
+ * RM_SlotInfo: decoded view of one slot on a slotted or compact page,
+ * used by rmpage.c so both variable-length formats share one code path.
+ */
+typedef struct {
+  int offset; /* Offset of the record, or -1 if the slot is free */
+  int length; /* Bytes stored in the slot */
+  int flags;  /* RM_SLOT_FORWARD, RM_SLOT_MOVED, RM_SLOT_OVERFLOW or 0 */
+} RM_SlotInfo;
+
+/*
+ * RM_FixedPageHeader: Sits at the beginning of each fixed-length page.
+ * It is followed by a presence bitmap of RM_FixedBitmapBytes() bytes
+ * (bit i set = slot i holds a record), then by the records themselves,
+ * packed back to back: slot i lives at RM_FixedDataOffset() + i * recordLength.
+ */
+typedef struct {
+  int numRecs;             /* Number of live records on this page */
+} RM_FixedPageHeader;
+
+/*
+ * RM_FORMAT_PAX pages have the same header and presence bitmap, and
+ * the same capacity, but the record area is split into one minipage
+ * per attribute: attribute a of slot i lives at
+ * RM_FixedDataOffset() + cap * (offset of a in the record) + i * (length of a).
+ */
+#define RM_IsFixed(fh) \
+  ((fh)->hdr.pageFormat == RM_FORMAT_FIXED || (fh)->hdr.pageFormat == RM_FORMAT_PAX)
+
+/* Bitmap words are scanned 64 slots at a time */
+#define RM_FixedBitmapBytes(cap) ((((cap) + 63) / 64) * 8)
+#define RM_FixedDataOffset(cap) \
+  ((int)sizeof(RM_FixedPageHeader) + RM_FixedBitmapBytes(cap))
+
+/*
+ * =================================================================
+ * External Sort Definitions
+ * =================================================================
+ */
+
+/*
+ * A run is a range of consecutive pages in a temporary PF file. Each
+ * run page starts with an RM_SortRunPage header, followed by records
+ * packed as [int length][bytes]. The length word never straddles two
+ * pages; a record that does not fit on one page (or would not fit on
+ * a fresh one) carries on over the following pages.
+ */
+typedef struct {
+  int numBytes; /* Bytes of run data after this header */
+} RM_SortRunPage;
+
+/* Run data a page can hold */
+#define RM_SORT_PAGEDATA (PF_PAGE_SIZE - (int)sizeof(RM_SortRunPage))
+
+/*
+ * RM_SortRun: merge cursor over one run. It holds a private copy of
+ * the run's current page, so a merge pins no buffer pool frames. A
+ * record spanning pages is put together in `big`.
+ */
+struct RM_SortRun {
+  int firstPage;            /* First page of the run */
+  int endPage;              /* One past its last page */
+  int nextPage;             /* Next page to load */
+  int pos;                  /* Offset of the next record on the page */
+  int end;                  /* End of the data on the page */
+  char *rec;                /* Current record, or NULL once exhausted */
+  int len;                  /* Its length */
+  char *big;                /* Spanned records (malloc'd), or NULL */
+  int bigLen;               /* Bytes allocated for big */
+  char page[PF_PAGE_SIZE];  /* Copy of the loaded page */
+};
+
 /*
  * =================================================================
  * Useful Constants and Macros
@@ -40,19 +198,178 @@ typedef struct {
 /* A page is full if the free space is less than a new slot + header */
 #define RM_PAGE_FULL -1
 
+/* Returned by RM_PageNextSlot when no valid slot is left on the page */
+#define RM_NO_SLOT -1
+
 /*
- * Magic number to check if a page is initialized.
- * (We can add this to the header later if we want)
+ * Extra (non-error) results of RM_PageGetRec for relocated records:
+ * RM_REC_FORWARDED - the slot is a stub; record_ptr points at the RID
+ *                    the record moved to.
+ * RM_REC_MOVED     - the slot holds a relocated record; record_ptr and
+ *                    record_len describe the data, and the home RID is
+ *                    stored just before it (see RM_MovedHomeRID).
+ * RM_REC_OVERFLOW  - the slot holds the RM_OverflowStub of a large record.
  */
+#define RM_REC_FORWARDED 1
+#define RM_REC_MOVED 2
+#define RM_REC_OVERFLOW 3
+
+#define RM_MovedHomeRID(record_ptr, ridp) \
+  memcpy((ridp), (record_ptr) - sizeof(RID), sizeof(RID))
 
 /*
- * Internal Function Prototypes (to be implemented in rm.c)
+ * Internal Function Prototypes
  */
 
-/* Finds a page with enough free space for a new record */
+/* rm.c: Adds (sign 1) or removes (sign -1) a slot's share of the space counters */
+void RM_AccountSlot(RM_FileHandle *fh, char *pageBuf, int slotNum, int sign);
+
+/* rm.c: Finds a page with enough free space for a new record */
 int RM_FindFreePage(RM_FileHandle *fh, int record_len, int *pageNum);
 
-/* Initializes a new page with the slotted-page layout */
-int RM_InitPage(char *pageBuf);
+/*
+ * rm.c: RM_GetNextRec that also returns the record length. A record
+ * longer than max_len is not copied: RM_INVALID_RECLEN is returned with
+ * its length in *record_len, and the scan stays on it.
+ */
+int RM_ScanNext(RM_ScanHandle *sh, char *record_data, int max_len, int *record_len, RID *rid);
+
+/*
+ * rm.c: Resolves `rid` (following a forwarding stub). An in-page record
+ * is copied into record_data; for a large record only its stub is
+ * filled in and RM_REC_OVERFLOW returned. *record_len is set either way.
+ */
+int RM_LookupRec(RM_FileHandle *fh, const RID *rid, char *record_data, int *record_len, RM_OverflowStub *stub);
+
+/* rmcache.c: Copies the cached record `rid` out (PFE_OK), or RM_EOF on a miss */
+int RM_RecCacheGet(RM_RecCache *rc, const RID *rid, char *record_data);
+
+/* rmcache.c: Caches a copy of record `rid`, evicting to make room */
+void RM_RecCachePut(RM_RecCache *rc, const RID *rid, const char *record_data, int record_len);
+
+/* rmcache.c: Drops the entry for `rid`, if any */
+void RM_RecCacheInvalidate(RM_RecCache *rc, const RID *rid);
+
+/* rmoverflow.c: Writes a large record to a new extent described by `stub` */
+int RM_OverflowWrite(RM_FileHandle *fh, const char *record_data, int record_len, RM_OverflowStub *stub);
+
+/* rmoverflow.c: Rewrites a large record over its own extent, RM_PAGE_FULL if too short */
+int RM_OverflowRewrite(RM_FileHandle *fh, RM_OverflowStub *stub, const char *record_data, int record_len);
+
+/* rmoverflow.c: Copies `len` bytes starting at `offset` out of an extent */
+int RM_OverflowRead(RM_FileHandle *fh, const RM_OverflowStub *stub, int offset, char *buf, int len);
+
+/* rmoverflow.c: Gives an extent's pages back to the free run list */
+int RM_OverflowFree(RM_FileHandle *fh, const RM_OverflowStub *stub);
+
+/* rm.c: TRUE if `pageNum` is a data page according to the page directory */
+int RM_DirTest(RM_FileHandle *fh, int pageNum);
+
+/*
+ * rm.c: Marks `pageNum` as a data page (inUse TRUE) or not, appending
+ * page directory pages if the directory does not reach it yet
+ */
+int RM_DirSet(RM_FileHandle *fh, int pageNum, int inUse);
+
+/* rm.c: First data page after `pageNum`, or RM_NO_PAGE (no I/O) */
+int RM_DirNextPage(RM_FileHandle *fh, int pageNum);
+
+/* rm.c: Last data page in the directory, or RM_NO_PAGE (no I/O) */
+int RM_DirLastPage(RM_FileHandle *fh);
+
+/*
+ * rmpage.c: page-format helpers. Each one works on a page buffer
+ * (pinned or a private copy) and dispatches on fh->hdr.pageFormat.
+ */
+
+/* Initializes a new, empty page in the file's format */
+int RM_InitPage(RM_FileHandle *fh, char *pageBuf);
+
+/* TRUE if a record of record_len bytes can be placed on the page */
+int RM_PageHasRoom(RM_FileHandle *fh, char *pageBuf, int record_len);
+
+/* Places a record on the page; returns its slot number or RM_PAGE_FULL */
+int RM_PageInsert(RM_FileHandle *fh, char *pageBuf, const char *record_data, int record_len);
+
+/*
+ * Locates slot `slotNum`; returns PFE_OK, RM_REC_FORWARDED, RM_REC_MOVED,
+ * RM_REC_OVERFLOW, RM_INVALID_RID or RM_RECORD_DELETED
+ */
+int RM_PageGetRec(RM_FileHandle *fh, char *pageBuf, int slotNum, char **record_ptr, int *record_len);
+
+/* Frees slot `slotNum` (of any kind); returns PFE_OK or a GetRec error */
+int RM_PageDeleteRec(RM_FileHandle *fh, char *pageBuf, int slotNum);
+
+/* Returns the first slot >= slotNum a scan should visit, or RM_NO_SLOT */
+int RM_PageNextSlot(RM_FileHandle *fh, char *pageBuf, int slotNum);
+
+/* TRUE if slot `slotNum` could be rewritten to hold record_len bytes */
+int RM_PageRoomFor(RM_FileHandle *fh, char *pageBuf, int slotNum, int record_len);
+
+/*
+ * Rewrites slot `slotNum` with new data, compacting the page if needed.
+ * A stub becomes an ordinary record again; a moved record keeps its
+ * home RID. Returns PFE_OK or RM_PAGE_FULL (page left unchanged).
+ */
+int RM_PageUpdate(RM_FileHandle *fh, char *pageBuf, int slotNum, const char *record_data, int record_len);
+
+/* Places a relocated copy of record `home`; returns its slot or RM_PAGE_FULL */
+int RM_PageInsertMoved(RM_FileHandle *fh, char *pageBuf, const RID *home, const char *record_data, int record_len);
+
+/* Adds a slot holding a large record's stub; returns its slot or RM_PAGE_FULL */
+int RM_PageInsertOverflow(RM_FileHandle *fh, char *pageBuf, const RM_OverflowStub *stub);
+
+/* Rewrites slot `slotNum` to hold a large record's stub (PFE_OK or RM_PAGE_FULL) */
+int RM_PageSetOverflow(RM_FileHandle *fh, char *pageBuf, int slotNum, const RM_OverflowStub *stub);
+
+/* Turns slot `slotNum` into a stub pointing at `target` (PFE_OK or RM_PAGE_FULL) */
+int RM_PageSetForward(RM_FileHandle *fh, char *pageBuf, int slotNum, const RID *target);
+
+/* Slides the records on the page together, reclaiming dead bytes */
+void RM_PageCompact(RM_FileHandle *fh, char *pageBuf);
+
+/* TRUE if no slot on the page is in use (after RM_PageCompact) */
+int RM_PageIsEmpty(RM_FileHandle *fh, char *pageBuf);
+
+/* Bytes on the page still available for new records (O(1)) */
+int RM_PageFreeBytes(RM_FileHandle *fh, char *pageBuf);
+
+/* Adds one slot's share of the counters to `stats` (-1: the page's part) */
+void RM_PageSlotStats(RM_FileHandle *fh, char *pageBuf, int slotNum, RM_SpaceStats *stats);
+
+/* Adds the page's contribution to `stats` by walking its slots */
+void RM_PageCollectStats(RM_FileHandle *fh, char *pageBuf, RM_SpaceStats *stats);
+
+/* Records per page for a fixed-length file with the given record length */
+int RM_FixedCapacity(int record_len);
+
+/* Byte offset of attribute `attr` within a record of the file's schema */
+int RM_AttrOffset(RM_FileHandle *fh, int attr);
+
+/*
+ * Where slot 0's value of attribute `attr` sits on a fixed-length (row
+ * or PAX) page; slot i's is *stride bytes further on per slot
+ */
+char *RM_PageColumn(RM_FileHandle *fh, char *pageBuf, int attr, int *stride);
+
+/* rmfilter.c: The RM_SIMD_* level predicates and aggregates run at */
+int RM_SimdLevel(void);
+
+/* rmfilter.c: PFE_OK if the predicates fit the schema, else RM_INVALID_ARG */
+int RM_CheckPreds(RM_FileHandle *fh, const RM_Pred *preds, int numPreds);
+
+/*
+ * rmfilter.c: Sets bit i of sel[] for every live slot i of the page
+ * that satisfies all the predicates, and returns how many there are.
+ */
+int RM_PageSelect(RM_FileHandle *fh, char *pageBuf, const RM_Pred *preds, int numPreds, uint64_t *sel);
+
+/*
+ * rmfilter.c: Clears bit i of sel[] (i < count) unless the value of
+ * type `type` at base + i * stride satisfies `op value`. `length` is
+ * the width of an RM_TYPE_CHAR value.
+ */
+void RM_FilterColumn(int type, int length, int op, const void *value,
+                     const char *base, int stride, int count, uint64_t *sel);
 
-#endif /* RM_INTERNAL_H */
\ No newline at end of file
+#endif /* RM_INTERNAL_H */
@@ -0,0 +1,734 @@
+/* rmagg.c: Aggregation and hash GROUP BY over schema'd RM files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "rm_internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RM_HAVE_X86 1
+#endif
+
+/*
+ * Both operators take a page at a time: RM_PageSelect turns the
+ * predicates into a selection bitmap, then each aggregate reads its
+ * attribute as a column (strided on row pages, packed on PAX pages).
+ * RM_Aggregate reduces the column with AVX2 lanes masked by the
+ * bitmap; RM_GroupBy feeds the selected rows to a hash table.
+ */
+
+/* Attribute types whose aggregates are kept in RM_AggValue.i */
+static int RM_AggIsInt(int type) {
+    return type == RM_TYPE_INT32 || type == RM_TYPE_INT64;
+}
+
+/* Value of a numeric attribute as an RM_AggValue */
+static RM_AggValue RM_AggLoad(int type, const char *ptr) {
+    RM_AggValue v;
+    int32_t i32;
+    float f;
+
+    switch (type) {
+    case RM_TYPE_INT32: memcpy(&i32, ptr, 4); v.i = i32; break;
+    case RM_TYPE_INT64: memcpy(&v.i, ptr, 8); break;
+    case RM_TYPE_FLOAT: memcpy(&f, ptr, 4); v.d = f; break;
+    default:            memcpy(&v.d, ptr, 8); break;
+    }
+    return v;
+}
+
+/* Folds one value (COUNT and SUM inputs are added) into an aggregate */
+static void RM_AggUpdate(int func, int isInt, RM_AggValue *acc, RM_AggValue v) {
+    switch (func) {
+    case RM_AGG_MIN:
+        if (isInt ? v.i < acc->i : v.d < acc->d)
+            *acc = v;
+        break;
+    case RM_AGG_MAX:
+        if (isInt ? v.i > acc->i : v.d > acc->d)
+            *acc = v;
+        break;
+    default:
+        if (isInt)
+            acc->i += v.i;
+        else
+            acc->d += v.d;
+        break;
+    }
+}
+
+/*
+ * RM_AggCheck
+ * The file needs a schema; every aggregate a known function and, unless
+ * it is COUNT, a numeric attribute.
+ */
+static int RM_AggCheck(RM_FileHandle *fh, const RM_AggSpec *aggs, int numAggs) {
+    int a;
+
+    if (fh->hdr.numAttrs == 0 || !RM_IsFixed(fh) || numAggs < 1 || numAggs > RM_AGG_MAXAGGS)
+        return RM_INVALID_ARG;
+    for (a = 0; a < numAggs; a++) {
+        if (aggs[a].func == RM_AGG_COUNT)
+            continue;
+        if (aggs[a].func < RM_AGG_SUM || aggs[a].func > RM_AGG_MAX ||
+            aggs[a].attr < 0 || aggs[a].attr >= fh->hdr.numAttrs ||
+            fh->hdr.attrs[aggs[a].attr].type == RM_TYPE_CHAR)
+            return RM_INVALID_ARG;
+    }
+    return PFE_OK;
+}
+
+/*
+ * =================================================================
+ * Column Reductions
+ * =================================================================
+ */
+
+/* Reduces the selected slots first..count-1 of a column, one at a time */
+static void RM_ReduceScalar(int type, int func, const char *base, int stride,
+                            int first, int count, const uint64_t *sel, RM_AggValue *acc) {
+    int isInt = RM_AggIsInt(type);
+    int w, slot;
+    uint64_t word;
+
+    for (w = first / 64; w * 64 < count; w++) {
+        for (word = sel[w]; word != 0; word &= word - 1) {
+            slot = w * 64 + __builtin_ctzll(word);
+            RM_AggUpdate(func, isInt, acc, RM_AggLoad(type, base + (size_t)slot * stride));
+        }
+    }
+}
+
+#ifdef RM_HAVE_X86
+/*
+ * RM_ReduceAvx2
+ * Reduces the column over the whole 64-slot words of sel[], 8 (32-bit)
+ * or 4 (64-bit) values at a time. Each group of lanes is masked with
+ * its bits of sel[]: unselected lanes add 0 to a SUM and the neutral
+ * extreme to a MIN or MAX. int32 and float sums are widened to 64-bit
+ * lanes first, as the scalar code widens them, so integer sums match it
+ * exactly (floating-point ones may differ in the last bits, since the
+ * additions happen in another order). Returns the first slot left for
+ * the scalar tail.
+ */
+__attribute__((target("avx2")))
+static int RM_ReduceAvx2(int type, int func, const char *base, int stride,
+                         int count, const uint64_t *sel, RM_AggValue *acc) {
+    int full = count - count % 64;
+    __m256i idx32 = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    __m128i idx64 = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(stride));
+    __m256i bit32 = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i bit64 = _mm256_setr_epi64x(1, 2, 4, 8);
+    __m256i isum = _mm256_setzero_si256(), imin, imax, v, lane;
+    __m256d dsum = _mm256_setzero_pd(), dmin, dmax, dv;
+    __m256 fmin, fmax, fv;
+    long long il[4];
+    int32_t i32[8];
+    double dl[4];
+    float fl[8];
+    const char *p;
+    int i, j, k, m, lanes;
+    uint64_t word;
+
+    lanes = (type == RM_TYPE_INT32 || type == RM_TYPE_FLOAT) ? 8 : 4;
+    imin = (type == RM_TYPE_INT32) ? _mm256_set1_epi32(INT32_MAX) : _mm256_set1_epi64x(LLONG_MAX);
+    imax = (type == RM_TYPE_INT32) ? _mm256_set1_epi32(INT32_MIN) : _mm256_set1_epi64x(LLONG_MIN);
+    fmin = _mm256_set1_ps(INFINITY);
+    fmax = _mm256_set1_ps(-INFINITY);
+    dmin = _mm256_set1_pd(INFINITY);
+    dmax = _mm256_set1_pd(-INFINITY);
+
+    for (i = 0; i < full; i += 64) {
+        if ((word = sel[i >> 6]) == 0)
+            continue;
+        for (j = 0; j < 64; j += lanes) {
+            m = (int)((word >> j) & ((1u << lanes) - 1));
+            if (m == 0)
+                continue;
+            p = base + (size_t)(i + j) * stride;
+            switch (type) {
+            case RM_TYPE_INT32:
+                v = (stride == 4) ? _mm256_loadu_si256((const __m256i *)p)
+                                  : _mm256_i32gather_epi32((const int *)p, idx32, 1);
+                lane = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(m), bit32), bit32);
+                if (func == RM_AGG_SUM) {
+                    v = _mm256_and_si256(v, lane);
+                    isum = _mm256_add_epi64(isum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                    isum = _mm256_add_epi64(isum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+                } else if (func == RM_AGG_MIN) {
+                    imin = _mm256_min_epi32(imin, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MAX), v, lane));
+                } else {
+                    imax = _mm256_max_epi32(imax, _mm256_blendv_epi8(_mm256_set1_epi32(INT32_MIN), v, lane));
+                }
+                break;
+            case RM_TYPE_INT64:
+                v = (stride == 8) ? _mm256_loadu_si256((const __m256i *)p)
+                                  : _mm256_i32gather_epi64((const long long *)p, idx64, 1);
+                lane = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(m), bit64), bit64);
+                if (func == RM_AGG_SUM) {
+                    isum = _mm256_add_epi64(isum, _mm256_and_si256(v, lane));
+                } else if (func == RM_AGG_MIN) {
+                    v = _mm256_blendv_epi8(_mm256_set1_epi64x(LLONG_MAX), v, lane);
+                    imin = _mm256_blendv_epi8(imin, v, _mm256_cmpgt_epi64(imin, v));
+                } else {
+                    v = _mm256_blendv_epi8(_mm256_set1_epi64x(LLONG_MIN), v, lane);
+                    imax = _mm256_blendv_epi8(imax, v, _mm256_cmpgt_epi64(v, imax));
+                }
+                break;
+            case RM_TYPE_FLOAT:
+                fv = (stride == 4) ? _mm256_loadu_ps((const float *)p)
+                                   : _mm256_i32gather_ps((const float *)p, idx32, 1);
+                lane = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(m), bit32), bit32);
+                if (func == RM_AGG_SUM) {
+                    fv = _mm256_and_ps(fv, _mm256_castsi256_ps(lane));
+                    dsum = _mm256_add_pd(dsum, _mm256_cvtps_pd(_mm256_castps256_ps128(fv)));
+                    dsum = _mm256_add_pd(dsum, _mm256_cvtps_pd(_mm256_extractf128_ps(fv, 1)));
+                } else if (func == RM_AGG_MIN) {
+                    fmin = _mm256_min_ps(fmin, _mm256_blendv_ps(_mm256_set1_ps(INFINITY), fv, _mm256_castsi256_ps(lane)));
+                } else {
+                    fmax = _mm256_max_ps(fmax, _mm256_blendv_ps(_mm256_set1_ps(-INFINITY), fv, _mm256_castsi256_ps(lane)));
+                }
+                break;
+            default:
+                dv = (stride == 8) ? _mm256_loadu_pd((const double *)p)
+                                   : _mm256_i32gather_pd((const double *)p, idx64, 1);
+                lane = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(m), bit64), bit64);
+                if (func == RM_AGG_SUM) {
+                    dsum = _mm256_add_pd(dsum, _mm256_and_pd(dv, _mm256_castsi256_pd(lane)));
+                } else if (func == RM_AGG_MIN) {
+                    dmin = _mm256_min_pd(dmin, _mm256_blendv_pd(_mm256_set1_pd(INFINITY), dv, _mm256_castsi256_pd(lane)));
+                } else {
+                    dmax = _mm256_max_pd(dmax, _mm256_blendv_pd(_mm256_set1_pd(-INFINITY), dv, _mm256_castsi256_pd(lane)));
+                }
+                break;
+            }
+        }
+    }
+
+    // Fold the lanes into the running aggregate
+    if (func == RM_AGG_SUM) {
+        _mm256_storeu_si256((__m256i *)il, isum);
+        _mm256_storeu_pd(dl, dsum);
+        for (k = 0; k < 4; k++) {
+            if (RM_AggIsInt(type))
+                acc->i += il[k];
+            else
+                acc->d += dl[k];
+        }
+    } else if (type == RM_TYPE_INT32) {
+        _mm256_storeu_si256((__m256i *)i32, func == RM_AGG_MIN ? imin : imax);
+        for (k = 0; k < 8; k++)
+            RM_AggUpdate(func, TRUE, acc, (RM_AggValue){.i = i32[k]});
+    } else if (type == RM_TYPE_INT64) {
+        _mm256_storeu_si256((__m256i *)il, func == RM_AGG_MIN ? imin : imax);
+        for (k = 0; k < 4; k++)
+            RM_AggUpdate(func, TRUE, acc, (RM_AggValue){.i = il[k]});
+    } else if (type == RM_TYPE_FLOAT) {
+        _mm256_storeu_ps(fl, func == RM_AGG_MIN ? fmin : fmax);
+        for (k = 0; k < 8; k++)
+            RM_AggUpdate(func, FALSE, acc, (RM_AggValue){.d = fl[k]});
+    } else {
+        _mm256_storeu_pd(dl, func == RM_AGG_MIN ? dmin : dmax);
+        for (k = 0; k < 4; k++)
+            RM_AggUpdate(func, FALSE, acc, (RM_AggValue){.d = dl[k]});
+    }
+    return full;
+}
+#endif /* RM_HAVE_X86 */
+
+/*
+ * RM_Aggregate
+ * One pass over the page directory; each page is pinned once for all
+ * the aggregates.
+ */
+int RM_Aggregate(RM_FileHandle *fh, const RM_Pred *preds, int numPreds,
+                 const RM_AggSpec *aggs, int numAggs, RM_AggValue *results, long *numRows) {
+    uint64_t sel[RM_SEL_WORDS];
+    int cap = fh->hdr.recsPerPage;
+    const char *column;
+    char *pageBuf;
+    int pageNum, a, type, stride, done, pf_err, err;
+    long rows = 0;
+
+    // 1. Check the request and start every aggregate at its identity
+    err = RM_CheckPreds(fh, preds, numPreds);
+    if (err == PFE_OK)
+        err = RM_AggCheck(fh, aggs, numAggs);
+    if (err != PFE_OK)
+        return err;
+
+    for (a = 0; a < numAggs; a++) {
+        int isInt = aggs[a].func == RM_AGG_COUNT || RM_AggIsInt(fh->hdr.attrs[aggs[a].attr].type);
+        if (isInt)
+            results[a].i = (aggs[a].func == RM_AGG_MIN) ? LLONG_MAX : (aggs[a].func == RM_AGG_MAX) ? LLONG_MIN : 0;
+        else
+            results[a].d = (aggs[a].func == RM_AGG_MIN) ? INFINITY : (aggs[a].func == RM_AGG_MAX) ? -INFINITY : 0.0;
+    }
+
+    // 2. Filter each page, then reduce each aggregate's column over
+    //    the selected slots
+    for (pageNum = RM_DirNextPage(fh, RM_HDR_PAGE); pageNum != RM_NO_PAGE;
+         pageNum = RM_DirNextPage(fh, pageNum)) {
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK)
+            return pf_err;
+
+        if (RM_PageSelect(fh, pageBuf, preds, numPreds, sel) > 0) {
+            for (a = 0; a < numAggs; a++) {
+                if (aggs[a].func == RM_AGG_COUNT)
+                    continue;
+                type = fh->hdr.attrs[aggs[a].attr].type;
+                column = RM_PageColumn(fh, pageBuf, aggs[a].attr, &stride);
+                done = 0;
+#ifdef RM_HAVE_X86
+                if (RM_SimdLevel() == RM_SIMD_AVX2)
+                    done = RM_ReduceAvx2(type, aggs[a].func, column, stride, cap, sel, &results[a]);
+#endif
+                RM_ReduceScalar(type, aggs[a].func, column, stride, done, cap, sel, &results[a]);
+            }
+            for (a = 0; a < RM_SEL_WORDS; a++)
+                rows += __builtin_popcountll(sel[a]);
+        }
+
+        pf_err = PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        if (pf_err != PFE_OK)
+            return pf_err;
+    }
+
+    // 3. COUNT is the number of selected rows; MIN and MAX of nothing are 0
+    for (a = 0; a < numAggs; a++) {
+        if (aggs[a].func == RM_AGG_COUNT)
+            results[a].i = rows;
+        else if (rows == 0 && aggs[a].func != RM_AGG_SUM)
+            memset(&results[a], 0, sizeof(RM_AggValue));
+    }
+    *numRows = rows;
+    return PFE_OK;
+}
+
+/*
+ * =================================================================
+ * Hash Aggregation
+ * =================================================================
+ */
+
+/*
+ * A row on its way into the hash table: the key, zero-padded to
+ * RM_GROUP_MAXKEY bytes, and one input per aggregate (1 for COUNT).
+ * Spill partitions store rows like this, cut after the last input.
+ */
+typedef struct {
+    char key[RM_GROUP_MAXKEY];
+    RM_AggValue vals[RM_AGG_MAXAGGS];
+} RM_GroupRow;
+
+/*
+ * The table itself is an array of 8-byte slots, probed linearly: a slot
+ * holds 32 bits of the key's hash and the index of its group. Groups
+ * ([key][aggregates]) are packed in a separate array in insertion
+ * order. A probe thus reads a few slots from one cache line and touches
+ * a group only when the hash bits match.
+ */
+typedef struct {
+    uint32_t tag; /* Low 32 bits of the hash */
+    int group;    /* Index into the group array, -1 if free */
+} RM_GroupSlot;
+
+/* A spill partition: the pages of the spill file that hold its rows */
+typedef struct {
+    int *pages;
+    int numPages;
+    int maxPages;
+    int level; /* Hash partitioning rounds its rows went through */
+} RM_GroupPart;
+
+/* Spill page layout: [int numRows][rows of rowSize bytes] */
+typedef struct {
+    int numRows;
+} RM_GroupSpillPage;
+
+typedef struct {
+    RM_FileHandle *fh;
+    const RM_AggSpec *aggs;
+    int numAggs;
+    int isInt[RM_AGG_MAXAGGS];
+    int keyLen;
+    RM_GroupCallback fn;
+    void *arg;
+
+    RM_GroupSlot *slots; /* 2 x maxGroups slots */
+    int slotMask;
+    char *groups;        /* maxGroups x groupSize bytes */
+    int groupSize;
+    int numGroups;
+    int maxGroups;
+
+    int spillFd;         /* Spill file, -1 until the first spill */
+    char spillName[64];
+    int rowSize;         /* Bytes per spilled row */
+    char *partBuf[RM_GROUP_PARTITIONS]; /* Page being filled, per partition */
+    int outPart[RM_GROUP_PARTITIONS];   /* Its index in parts[], or -1 */
+    RM_GroupPart *parts; /* Every partition created so far */
+    int numParts;
+    int maxParts;
+
+    RM_GroupStats stats;
+} RM_GroupState;
+
+/* Used to give every spill file a distinct name */
+static int RM_GroupSeq = 0;
+
+/* Mixes the 16 key bytes into a 64-bit hash */
+static uint64_t RM_GroupHash(const char *key) {
+    uint64_t a, b, h;
+
+    memcpy(&a, key, 8);
+    memcpy(&b, key + 8, 8);
+    h = a * 0x9E3779B97F4A7C15ULL ^ (b + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Top bits of the hash choose the partition, a new 4 bits per level */
+static int RM_GroupPartOf(uint64_t h, int level) {
+    return (int)((h >> (60 - 4 * level)) & (RM_GROUP_PARTITIONS - 1));
+}
+
+/* Deepest level: below it the hash has no fresh partition bits left */
+#define RM_GROUP_MAXLEVEL 8
+
+/*
+ * RM_GroupSpillFlush
+ * Writes partition p's page buffer to a page of the spill file.
+ */
+static int RM_GroupSpillFlush(RM_GroupState *st, int p) {
+    RM_GroupPart *part = &st->parts[st->outPart[p]];
+    char *pageBuf;
+    int pageNum, pf_err;
+
+    if (((RM_GroupSpillPage *)st->partBuf[p])->numRows == 0)
+        return PFE_OK;
+
+    if (part->numPages == part->maxPages) {
+        int *pages = realloc(part->pages, (part->maxPages * 2 + 8) * sizeof(int));
+        if (pages == NULL)
+            return RM_NOMEM;
+        part->pages = pages;
+        part->maxPages = part->maxPages * 2 + 8;
+    }
+
+    // Disposed pages of finished partitions are reused here
+    pf_err = PF_AllocPage(st->spillFd, &pageNum, &pageBuf);
+    if (pf_err != PFE_OK)
+        return pf_err;
+    memcpy(pageBuf, st->partBuf[p], PF_PAGE_SIZE);
+    pf_err = PF_UnfixPage(st->spillFd, pageNum, TRUE);
+    if (pf_err != PFE_OK)
+        return pf_err;
+
+    part->pages[part->numPages++] = pageNum;
+    st->stats.spillPages++;
+    ((RM_GroupSpillPage *)st->partBuf[p])->numRows = 0;
+    return PFE_OK;
+}
+
+/*
+ * RM_GroupSpill
+ * Appends a row to the partition of the current pass it hashes to,
+ * creating the spill file and the partition as needed.
+ */
+static int RM_GroupSpill(RM_GroupState *st, const RM_GroupRow *row, uint64_t h, int level) {
+    RM_GroupSpillPage *page;
+    int p = RM_GroupPartOf(h, level);
+    int err;
+
+    if (level >= RM_GROUP_MAXLEVEL)
+        return RM_NOMEM; // Partitioning no longer splits these keys
+
+    // 1. The spill file is created by the first spilled row
+    if (st->spillFd < 0) {
+        sprintf(st->spillName, "rmgroup.%d.%d.tmp", (int)getpid(), RM_GroupSeq++);
+        PF_DestroyFile(st->spillName); // Left over from a crashed run
+        err = PF_CreateFile(st->spillName);
+        if (err != PFE_OK)
+            return err;
+        st->spillFd = PF_OpenFile(st->spillName);
+        if (st->spillFd < 0) {
+            err = st->spillFd;
+            st->spillFd = -1;
+            PF_DestroyFile(st->spillName);
+            return err;
+        }
+    }
+
+    // 2. So is each partition of this pass
+    if (st->outPart[p] < 0) {
+        if (st->numParts == st->maxParts) {
+            RM_GroupPart *parts = realloc(st->parts, (st->maxParts * 2 + 16) * sizeof(RM_GroupPart));
+            if (parts == NULL)
+                return RM_NOMEM;
+            st->parts = parts;
+            st->maxParts = st->maxParts * 2 + 16;
+        }
+        memset(&st->parts[st->numParts], 0, sizeof(RM_GroupPart));
+        st->parts[st->numParts].level = level + 1;
+        st->outPart[p] = st->numParts++;
+    }
+
+    // 3. Add the row to the partition's page, writing it out when full
+    page = (RM_GroupSpillPage *)st->partBuf[p];
+    if ((int)sizeof(RM_GroupSpillPage) + (page->numRows + 1) * st->rowSize > PF_PAGE_SIZE) {
+        err = RM_GroupSpillFlush(st, p);
+        if (err != PFE_OK)
+            return err;
+    }
+    memcpy(st->partBuf[p] + sizeof(RM_GroupSpillPage) + page->numRows * st->rowSize, row, st->rowSize);
+    page->numRows++;
+    st->stats.spilledRows++;
+    return PFE_OK;
+}
+
+/*
+ * RM_GroupAdd
+ * Folds a row into its group, creating the group if the table has
+ * room and spilling the row otherwise. A key gets a group on its first
+ * row or never in this pass, so each group's rows are either all in
+ * the table or all in one partition.
+ */
+static int RM_GroupAdd(RM_GroupState *st, const RM_GroupRow *row, int level) {
+    uint64_t h = RM_GroupHash(row->key);
+    uint32_t tag = (uint32_t)h;
+    int i = (int)(h & st->slotMask);
+    RM_AggValue *acc;
+    char *group;
+    int a;
+
+    for (;; i = (i + 1) & st->slotMask) {
+        RM_GroupSlot *slot = &st->slots[i];
+        if (slot->group < 0)
+            break;
+        if (slot->tag != tag)
+            continue;
+        group = st->groups + (size_t)slot->group * st->groupSize;
+        if (memcmp(group, row->key, RM_GROUP_MAXKEY) == 0) {
+            acc = (RM_AggValue *)(group + RM_GROUP_MAXKEY);
+            for (a = 0; a < st->numAggs; a++)
+                RM_AggUpdate(st->aggs[a].func, st->isInt[a], &acc[a], row->vals[a]);
+            return PFE_OK;
+        }
+    }
+
+    if (st->numGroups == st->maxGroups)
+        return RM_GroupSpill(st, row, h, level);
+
+    // A new group starts from its first row's inputs
+    st->slots[i].tag = tag;
+    st->slots[i].group = st->numGroups;
+    group = st->groups + (size_t)st->numGroups++ * st->groupSize;
+    memcpy(group, row->key, RM_GROUP_MAXKEY);
+    memcpy(group + RM_GROUP_MAXKEY, row->vals, st->numAggs * sizeof(RM_AggValue));
+    return PFE_OK;
+}
+
+/* Feeds the selected rows of every data page of the file to the table */
+static int RM_GroupScanFile(RM_GroupState *st, const RM_Pred *preds, int numPreds, int keyAttr) {
+    RM_FileHandle *fh = st->fh;
+    uint64_t sel[RM_SEL_WORDS];
+    const char *columns[RM_AGG_MAXAGGS];
+    int strides[RM_AGG_MAXAGGS];
+    const char *keyColumn;
+    int keyStride;
+    RM_GroupRow row;
+    char *pageBuf;
+    int pageNum, a, w, slot, pf_err, err = PFE_OK;
+    uint64_t word;
+
+    memset(&row, 0, sizeof(row));
+    for (pageNum = RM_DirNextPage(fh, RM_HDR_PAGE); pageNum != RM_NO_PAGE && err == PFE_OK;
+         pageNum = RM_DirNextPage(fh, pageNum)) {
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK)
+            return pf_err;
+
+        RM_PageSelect(fh, pageBuf, preds, numPreds, sel);
+        keyColumn = RM_PageColumn(fh, pageBuf, keyAttr, &keyStride);
+        for (a = 0; a < st->numAggs; a++) {
+            if (st->aggs[a].func == RM_AGG_COUNT)
+                row.vals[a].i = 1;
+            else
+                columns[a] = RM_PageColumn(fh, pageBuf, st->aggs[a].attr, &strides[a]);
+        }
+
+        for (w = 0; w < RM_SEL_WORDS && err == PFE_OK; w++) {
+            for (word = sel[w]; word != 0 && err == PFE_OK; word &= word - 1) {
+                slot = w * 64 + __builtin_ctzll(word);
+                memcpy(row.key, keyColumn + (size_t)slot * keyStride, st->keyLen);
+                for (a = 0; a < st->numAggs; a++) {
+                    if (st->aggs[a].func != RM_AGG_COUNT)
+                        row.vals[a] = RM_AggLoad(fh->hdr.attrs[st->aggs[a].attr].type,
+                                                 columns[a] + (size_t)slot * strides[a]);
+                }
+                err = RM_GroupAdd(st, &row, 0);
+            }
+        }
+
+        pf_err = PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        if (err == PFE_OK)
+            err = pf_err;
+    }
+    return err;
+}
+
+/* Feeds the rows of spill partition `part` to the table, freeing its pages */
+static int RM_GroupScanPart(RM_GroupState *st, int part) {
+    RM_GroupRow row;
+    char *pageBuf;
+    int i, r, numRows, pageNum, level, pf_err, err = PFE_OK;
+
+    memset(&row, 0, sizeof(row));
+    level = st->parts[part].level;
+    for (i = 0; i < st->parts[part].numPages && err == PFE_OK; i++) {
+        pageNum = st->parts[part].pages[i]; // parts[] may move as we spill
+        pf_err = PF_GetThisPage(st->spillFd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK)
+            return pf_err;
+        numRows = ((RM_GroupSpillPage *)pageBuf)->numRows;
+        for (r = 0; r < numRows && err == PFE_OK; r++) {
+            memcpy(&row, pageBuf + sizeof(RM_GroupSpillPage) + r * st->rowSize, st->rowSize);
+            err = RM_GroupAdd(st, &row, level);
+        }
+        pf_err = PF_UnfixPage(st->spillFd, pageNum, FALSE);
+        if (pf_err == PFE_OK)
+            pf_err = PF_DisposePage(st->spillFd, pageNum);
+        if (err == PFE_OK)
+            err = pf_err;
+    }
+    return err;
+}
+
+/*
+ * RM_GroupPass
+ * One pass: an empty table takes the rows of the file (part < 0) or of
+ * a spill partition, every group that fit is reported, and the rows
+ * that did not are left in new partitions for later passes.
+ */
+static int RM_GroupPass(RM_GroupState *st, int part, const RM_Pred *preds, int numPreds, int keyAttr) {
+    char *group;
+    int i, p, err;
+
+    st->numGroups = 0;
+    for (i = 0; i <= st->slotMask; i++)
+        st->slots[i].group = -1;
+    for (p = 0; p < RM_GROUP_PARTITIONS; p++) {
+        st->outPart[p] = -1;
+        ((RM_GroupSpillPage *)st->partBuf[p])->numRows = 0;
+    }
+    st->stats.passes++;
+
+    // 1. Aggregate the input, spilling what does not fit
+    if (part < 0)
+        err = RM_GroupScanFile(st, preds, numPreds, keyAttr);
+    else
+        err = RM_GroupScanPart(st, part);
+    for (p = 0; p < RM_GROUP_PARTITIONS && err == PFE_OK; p++) {
+        if (st->outPart[p] >= 0)
+            err = RM_GroupSpillFlush(st, p);
+    }
+    if (err != PFE_OK)
+        return err;
+
+    // 2. Report the groups that stayed in memory
+    for (i = 0; i < st->numGroups; i++) {
+        group = st->groups + (size_t)i * st->groupSize;
+        err = st->fn(st->arg, group, st->keyLen, (RM_AggValue *)(group + RM_GROUP_MAXKEY));
+        if (err != PFE_OK)
+            return err;
+        st->stats.groups++;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_GroupBy
+ * Splits the budget between the partition buffers and the table, runs
+ * a pass over the file, then one pass per spill partition (including
+ * partitions that those passes spill in turn).
+ */
+int RM_GroupBy(RM_FileHandle *fh, const RM_Pred *preds, int numPreds, int keyAttr,
+               const RM_AggSpec *aggs, int numAggs, long memBytes,
+               RM_GroupCallback fn, void *arg, RM_GroupStats *stats) {
+    RM_GroupState st;
+    long avail;
+    int numSlots, a, p, part, err;
+
+    // 1. Check the request
+    err = RM_CheckPreds(fh, preds, numPreds);
+    if (err == PFE_OK)
+        err = RM_AggCheck(fh, aggs, numAggs);
+    if (err != PFE_OK)
+        return err;
+    if (keyAttr < 0 || keyAttr >= fh->hdr.numAttrs || fn == NULL || memBytes < RM_GROUP_MINMEM ||
+        fh->hdr.attrs[keyAttr].type == RM_TYPE_FLOAT || fh->hdr.attrs[keyAttr].type == RM_TYPE_DOUBLE ||
+        fh->hdr.attrs[keyAttr].length > RM_GROUP_MAXKEY)
+        return RM_INVALID_ARG;
+
+    memset(&st, 0, sizeof(st));
+    st.fh = fh;
+    st.aggs = aggs;
+    st.numAggs = numAggs;
+    st.keyLen = fh->hdr.attrs[keyAttr].length;
+    st.fn = fn;
+    st.arg = arg;
+    st.spillFd = -1;
+    st.groupSize = RM_GROUP_MAXKEY + numAggs * (int)sizeof(RM_AggValue);
+    st.rowSize = st.groupSize;
+    for (a = 0; a < numAggs; a++)
+        st.isInt[a] = aggs[a].func == RM_AGG_COUNT || RM_AggIsInt(fh->hdr.attrs[aggs[a].attr].type);
+
+    // 2. The largest power-of-two slot array that fits next to half as
+    //    many groups (load factor <= 1/2) and the partition buffers
+    avail = memBytes - (long)RM_GROUP_PARTITIONS * PF_PAGE_SIZE;
+    for (numSlots = 16; (long)numSlots * 2 * sizeof(RM_GroupSlot) + (long)numSlots * st.groupSize <= avail &&
+                        numSlots < (1 << 28);
+         numSlots *= 2)
+        ;
+    st.slotMask = numSlots - 1;
+    st.maxGroups = numSlots / 2;
+    st.slots = malloc(numSlots * sizeof(RM_GroupSlot));
+    st.groups = malloc((size_t)st.maxGroups * st.groupSize);
+    err = (st.slots == NULL || st.groups == NULL) ? RM_NOMEM : PFE_OK;
+    for (p = 0; p < RM_GROUP_PARTITIONS && err == PFE_OK; p++) {
+        st.partBuf[p] = malloc(PF_PAGE_SIZE);
+        if (st.partBuf[p] == NULL)
+            err = RM_NOMEM;
+    }
+
+    // 3. The file, then every spill partition, oldest first
+    if (err == PFE_OK)
+        err = RM_GroupPass(&st, -1, preds, numPreds, keyAttr);
+    for (part = 0; part < st.numParts && err == PFE_OK; part++)
+        err = RM_GroupPass(&st, part, preds, numPreds, keyAttr);
+
+    // 4. Clean up
+    for (part = 0; part < st.numParts; part++)
+        free(st.parts[part].pages);
+    free(st.parts);
+    for (p = 0; p < RM_GROUP_PARTITIONS; p++)
+        free(st.partBuf[p]);
+    free(st.slots);
+    free(st.groups);
+    if (st.spillFd >= 0) {
+        PF_CloseFile(st.spillFd);
+        PF_DestroyFile(st.spillName);
+    }
+    if (stats != NULL)
+        *stats = st.stats;
+    return err;
+}
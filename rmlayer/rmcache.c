@@ -0,0 +1,313 @@
+/* rmcache.c: Record cache keyed by RID, above the buffer pool */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rm_internal.h"
+
+/*
+ * A record cache keeps copies of recently read records, so a hot
+ * record costs its own bytes instead of a whole page frame. Entries
+ * live in one array and are found through a chained hash table on the
+ * RID; a CLOCK hand sweeps the array to pick victims, clearing the
+ * reference bit of every entry read since its last visit. Each entry is
+ * charged its record length plus RM_RECCACHE_OVERHEAD bytes against the
+ * budget. Deletes and updates drop the entry of the RID they change;
+ * nothing else alters a record without changing its RID.
+ */
+
+/* A cached record, or a free entry (len < 0) on the free list */
+typedef struct {
+    RID rid;
+    int next;   /* Next entry in the bucket chain or free list, -1 ends it */
+    int len;    /* Record length, -1 if the entry is free */
+    int ref;    /* CLOCK reference bit */
+    char *data; /* The record, malloc'd */
+} RM_CacheEntry;
+
+/* Bytes charged per entry on top of its record: the entry and a bucket */
+#define RM_RECCACHE_OVERHEAD ((long)(sizeof(RM_CacheEntry) + sizeof(int)))
+
+struct RM_RecCache {
+    long budget;            /* Byte budget given to RM_SetRecCache */
+    long bytes;             /* Bytes charged now */
+    RM_CacheEntry *entries; /* Entry array */
+    int numEntries;         /* Entries in use or on the free list */
+    int maxEntries;         /* Allocated length of `entries` */
+    int numCached;          /* Entries holding a record */
+    int freeList;           /* First free entry, -1 if none */
+    int *buckets;           /* Chain heads, -1 for an empty bucket */
+    int numBuckets;         /* A power of two */
+    int hand;               /* CLOCK hand: next entry to look at */
+    RM_RecCacheStats stats; /* Counters (pool fields unused here) */
+};
+
+/*
+ * =================================================================
+ * Hash Table
+ * =================================================================
+ */
+
+static int RM_CacheBucket(const RM_RecCache *rc, const RID *rid) {
+    unsigned int h = (unsigned int)rid->pageNum * 0x9E3779B1u ^ (unsigned int)rid->slotNum * 0x85EBCA77u;
+    h ^= h >> 15;
+    return (int)(h & (unsigned int)(rc->numBuckets - 1));
+}
+
+/* Index of the entry for `rid`, or -1 */
+static int RM_CacheFind(const RM_RecCache *rc, const RID *rid) {
+    int e;
+
+    for (e = rc->buckets[RM_CacheBucket(rc, rid)]; e >= 0; e = rc->entries[e].next) {
+        if (rc->entries[e].rid.pageNum == rid->pageNum && rc->entries[e].rid.slotNum == rid->slotNum)
+            return e;
+    }
+    return -1;
+}
+
+/* Doubles the bucket array and rechains every cached entry */
+static int RM_CacheGrowBuckets(RM_RecCache *rc) {
+    int *buckets = malloc(2 * rc->numBuckets * sizeof(int));
+    int b, e;
+
+    if (buckets == NULL)
+        return RM_NOMEM;
+    free(rc->buckets);
+    rc->buckets = buckets;
+    rc->numBuckets *= 2;
+    for (b = 0; b < rc->numBuckets; b++)
+        rc->buckets[b] = -1;
+    for (e = 0; e < rc->numEntries; e++) {
+        if (rc->entries[e].len < 0)
+            continue;
+        b = RM_CacheBucket(rc, &rc->entries[e].rid);
+        rc->entries[e].next = rc->buckets[b];
+        rc->buckets[b] = e;
+    }
+    return PFE_OK;
+}
+
+/* Unchains entry e, frees its record and puts it on the free list */
+static void RM_CacheRemove(RM_RecCache *rc, int e) {
+    RM_CacheEntry *entry = &rc->entries[e];
+    int *link = &rc->buckets[RM_CacheBucket(rc, &entry->rid)];
+
+    while (*link != e)
+        link = &rc->entries[*link].next;
+    *link = entry->next;
+
+    rc->bytes -= entry->len + RM_RECCACHE_OVERHEAD;
+    rc->numCached--;
+    free(entry->data);
+    entry->data = NULL;
+    entry->len = -1;
+    entry->next = rc->freeList;
+    rc->freeList = e;
+}
+
+/*
+ * RM_CacheEvict
+ * Advances the CLOCK hand to the first cached entry whose reference
+ * bit is clear, clearing the bits it passes, and evicts that entry.
+ * Ends within two sweeps as long as something is cached.
+ */
+static void RM_CacheEvict(RM_RecCache *rc) {
+    RM_CacheEntry *entry;
+    int e;
+
+    for (;;) {
+        e = rc->hand;
+        rc->hand = (rc->hand + 1) % rc->numEntries;
+        entry = &rc->entries[e];
+        if (entry->len < 0)
+            continue;
+        if (entry->ref) {
+            entry->ref = 0;
+            continue;
+        }
+        RM_CacheRemove(rc, e);
+        rc->stats.evictions++;
+        return;
+    }
+}
+
+/* Frees everything the cache holds, the cache included */
+static void RM_CacheFree(RM_RecCache *rc) {
+    int e;
+
+    for (e = 0; e < rc->numEntries; e++)
+        free(rc->entries[e].data);
+    free(rc->entries);
+    free(rc->buckets);
+    free(rc);
+}
+
+/*
+ * =================================================================
+ * Record Cache Functions
+ * =================================================================
+ */
+
+/*
+ * RM_SetRecCache
+ * Turns the handle's record cache on with a budget of budgetBytes,
+ * or off (dropping every entry) with 0. Changing the budget starts
+ * over with an empty cache.
+ */
+int RM_SetRecCache(RM_FileHandle *fh, long budgetBytes) {
+    RM_RecCache *rc;
+    int b;
+
+    // 1. Drop the old cache, if any
+    if (budgetBytes < 0) {
+        return RM_INVALID_ARG;
+    }
+    if (fh->recCache != NULL) {
+        RM_CacheFree(fh->recCache);
+        fh->recCache = NULL;
+    }
+    if (budgetBytes == 0) {
+        return PFE_OK;
+    }
+
+    // 2. Start with a small table; entries and buckets grow on demand
+    rc = calloc(1, sizeof(RM_RecCache));
+    if (rc == NULL) {
+        return RM_NOMEM;
+    }
+    rc->budget = budgetBytes;
+    rc->freeList = -1;
+    rc->numBuckets = 64;
+    rc->buckets = malloc(rc->numBuckets * sizeof(int));
+    if (rc->buckets == NULL) {
+        free(rc);
+        return RM_NOMEM;
+    }
+    for (b = 0; b < rc->numBuckets; b++)
+        rc->buckets[b] = -1;
+    fh->recCache = rc;
+    return PFE_OK;
+}
+
+/*
+ * RM_RecCacheGet
+ * Copies the cached record `rid` into record_data and returns PFE_OK,
+ * or returns RM_EOF on a miss. Either way the lookup is counted.
+ */
+int RM_RecCacheGet(RM_RecCache *rc, const RID *rid, char *record_data) {
+    int e;
+
+    rc->stats.lookups++;
+    e = RM_CacheFind(rc, rid);
+    if (e < 0) {
+        return RM_EOF;
+    }
+    rc->stats.hits++;
+    rc->entries[e].ref = 1;
+    memcpy(record_data, rc->entries[e].data, rc->entries[e].len);
+    return PFE_OK;
+}
+
+/*
+ * RM_RecCachePut
+ * Caches a copy of record `rid`, evicting entries until it fits.
+ * A record that would take more than an eighth of the budget is not
+ * cached, so one large record cannot empty the cache. Failing to
+ * cache is not an error: the record is simply read from its page
+ * next time.
+ */
+void RM_RecCachePut(RM_RecCache *rc, const RID *rid, const char *record_data, int record_len) {
+    long cost = record_len + RM_RECCACHE_OVERHEAD;
+    RM_CacheEntry *entry;
+    RM_CacheEntry *grown;
+    char *data;
+    int e;
+
+    // 1. Only records that are small next to the budget
+    if (cost > rc->budget / 8) {
+        return;
+    }
+    e = RM_CacheFind(rc, rid);
+    if (e >= 0) {
+        RM_CacheRemove(rc, e);
+    }
+
+    // 2. Make room
+    while (rc->bytes + cost > rc->budget) {
+        RM_CacheEvict(rc);
+    }
+    data = malloc(record_len > 0 ? record_len : 1);
+    if (data == NULL) {
+        return;
+    }
+
+    // 3. Take a free entry, or a new one at the end of the array
+    if (rc->freeList >= 0) {
+        e = rc->freeList;
+        rc->freeList = rc->entries[e].next;
+    } else {
+        if (rc->numEntries == rc->maxEntries) {
+            int maxEntries = rc->maxEntries ? 2 * rc->maxEntries : 64;
+            grown = realloc(rc->entries, maxEntries * sizeof(RM_CacheEntry));
+            if (grown == NULL) {
+                free(data);
+                return;
+            }
+            rc->entries = grown;
+            rc->maxEntries = maxEntries;
+        }
+        e = rc->numEntries++;
+    }
+
+    // 4. Fill it in and chain it, keeping about one entry per bucket
+    entry = &rc->entries[e];
+    entry->rid = *rid;
+    entry->len = record_len;
+    entry->ref = 1;
+    entry->data = data;
+    memcpy(data, record_data, record_len);
+    rc->bytes += cost;
+    rc->numCached++;
+    if (rc->numCached > rc->numBuckets && RM_CacheGrowBuckets(rc) == PFE_OK) {
+        return; // Rechaining linked the new entry as well
+    }
+    entry->next = rc->buckets[RM_CacheBucket(rc, rid)];
+    rc->buckets[RM_CacheBucket(rc, rid)] = e;
+}
+
+/* RM_RecCacheInvalidate: drops the entry for `rid`, if there is one */
+void RM_RecCacheInvalidate(RM_RecCache *rc, const RID *rid) {
+    int e = RM_CacheFind(rc, rid);
+
+    if (e >= 0) {
+        RM_CacheRemove(rc, e);
+        rc->stats.invalidations++;
+    }
+}
+
+/*
+ * RM_GetRecCacheStats
+ * Reports the handle's record-cache counters next to the buffer pool's,
+ * so the two hit rates can be told apart. The pool is shared by every
+ * open file; its counters cover all of them since PF_ResetStats.
+ */
+int RM_GetRecCacheStats(RM_FileHandle *fh, RM_RecCacheStats *stats) {
+    long physicalWrites;
+
+    if (fh->recCache != NULL) {
+        *stats = fh->recCache->stats;
+        stats->bytes = fh->recCache->bytes;
+        stats->entries = fh->recCache->numCached;
+    } else {
+        memset(stats, 0, sizeof(RM_RecCacheStats));
+    }
+    PF_GetStats(&stats->pageRequests, &stats->pageMisses, &physicalWrites);
+    return PFE_OK;
+}
+
+/* RM_ResetRecCacheStats: zeroes the record-cache counters (not the pool's) */
+void RM_ResetRecCacheStats(RM_FileHandle *fh) {
+    if (fh->recCache != NULL) {
+        memset(&fh->recCache->stats, 0, sizeof(RM_RecCacheStats));
+    }
+}
@@ -0,0 +1,450 @@
+/* rmfilter.c: Predicate evaluation over the records of a page */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "rm_internal.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RM_HAVE_X86 1
+#endif
+
+/*
+ * A filtered scan does not test records one by one. When it reaches a
+ * page it takes one predicate at a time and compares that attribute of
+ * every record on the page with the constant, narrowing a selection
+ * bitmap that starts as the page's presence bitmap. The compares run
+ * 8 (AVX2) or 4 (SSE) 32-bit values at a time, half as many 64-bit
+ * ones; in a row page the values of one attribute are recordLength
+ * bytes apart, so AVX2 gathers them and SSE loads them lane by lane.
+ * char(n) attributes and the tail of a page are compared in plain C.
+ */
+
+/* Level in use; -1 until the CPU has been asked */
+static int RM_SimdLevelInUse = -1;
+
+/* Best level this CPU supports */
+static int RM_SimdLevelSupported(void) {
+#ifdef RM_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return RM_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return RM_SIMD_SSE;
+#endif
+    return RM_SIMD_SCALAR;
+}
+
+/*
+ * RM_SetSimdLevel
+ * Caps the level at what the CPU supports and returns it.
+ */
+int RM_SetSimdLevel(int level) {
+    int best = RM_SimdLevelSupported();
+
+    if (level < RM_SIMD_SCALAR)
+        level = RM_SIMD_SCALAR;
+    RM_SimdLevelInUse = (level < best) ? level : best;
+    return RM_SimdLevelInUse;
+}
+
+/* RM_SimdLevel: the level in use, asking the CPU the first time */
+int RM_SimdLevel(void) {
+    if (RM_SimdLevelInUse < 0)
+        RM_SetSimdLevel(RM_SIMD_AVX2);
+    return RM_SimdLevelInUse;
+}
+
+/*
+ * =================================================================
+ * Scalar Comparisons
+ * =================================================================
+ */
+
+/* Turns a three-way comparison result into the outcome of `op` */
+static int RM_OpHolds(int op, int cmp) {
+    switch (op) {
+    case RM_OP_EQ: return cmp == 0;
+    case RM_OP_NE: return cmp != 0;
+    case RM_OP_LT: return cmp < 0;
+    case RM_OP_LE: return cmp <= 0;
+    case RM_OP_GT: return cmp > 0;
+    default:       return cmp >= 0;
+    }
+}
+
+/*
+ * RM_TestValue
+ * Evaluates `*ptr op *value` for one attribute value. Floating-point
+ * values use C's comparisons, so only != holds for a NaN.
+ */
+static int RM_TestValue(int type, int length, int op, const void *value, const char *ptr) {
+    int32_t i32, c32;
+    int64_t i64, c64;
+    float f, cf;
+    double d, cd;
+
+    switch (type) {
+    case RM_TYPE_INT32:
+        memcpy(&i32, ptr, 4);
+        memcpy(&c32, value, 4);
+        return RM_OpHolds(op, (i32 > c32) - (i32 < c32));
+    case RM_TYPE_INT64:
+        memcpy(&i64, ptr, 8);
+        memcpy(&c64, value, 8);
+        return RM_OpHolds(op, (i64 > c64) - (i64 < c64));
+    case RM_TYPE_FLOAT:
+        memcpy(&f, ptr, 4);
+        memcpy(&cf, value, 4);
+        if (f != f || cf != cf)
+            return op == RM_OP_NE;
+        return RM_OpHolds(op, (f > cf) - (f < cf));
+    case RM_TYPE_DOUBLE:
+        memcpy(&d, ptr, 8);
+        memcpy(&cd, value, 8);
+        if (d != d || cd != cd)
+            return op == RM_OP_NE;
+        return RM_OpHolds(op, (d > cd) - (d < cd));
+    default:
+        return RM_OpHolds(op, memcmp(ptr, value, length));
+    }
+}
+
+/* Clears the bits of slots first..count-1 in sel[] that fail the test */
+static void RM_FilterScalar(int type, int length, int op, const void *value,
+                            const char *base, int stride, int first, int count, uint64_t *sel) {
+    int i;
+
+    for (i = first; i < count; i++) {
+        if (((sel[i >> 6] >> (i & 63)) & 1) &&
+            !RM_TestValue(type, length, op, value, base + (size_t)i * stride)) {
+            sel[i >> 6] &= ~((uint64_t)1 << (i & 63));
+        }
+    }
+}
+
+#ifdef RM_HAVE_X86
+/*
+ * =================================================================
+ * SSE4.2 Kernels
+ * =================================================================
+ */
+
+/*
+ * Integer compares only come as == and >, so every kernel computes
+ * EQ, GT or LT (GT with the operands swapped) and inverts the lane
+ * mask for NE, LE and GE.
+ */
+static int RM_OpInverted(int op) {
+    return op == RM_OP_NE || op == RM_OP_LE || op == RM_OP_GE;
+}
+
+__attribute__((target("sse4.2")))
+static int RM_MaskI32Sse(int op, __m128i v, __m128i c) {
+    __m128i r;
+
+    if (op == RM_OP_EQ || op == RM_OP_NE)
+        r = _mm_cmpeq_epi32(v, c);
+    else if (op == RM_OP_GT || op == RM_OP_LE)
+        r = _mm_cmpgt_epi32(v, c);
+    else
+        r = _mm_cmpgt_epi32(c, v);
+    return _mm_movemask_ps(_mm_castsi128_ps(r)) ^ (RM_OpInverted(op) ? 0xF : 0);
+}
+
+__attribute__((target("sse4.2")))
+static int RM_MaskI64Sse(int op, __m128i v, __m128i c) {
+    __m128i r;
+
+    if (op == RM_OP_EQ || op == RM_OP_NE)
+        r = _mm_cmpeq_epi64(v, c);
+    else if (op == RM_OP_GT || op == RM_OP_LE)
+        r = _mm_cmpgt_epi64(v, c);
+    else
+        r = _mm_cmpgt_epi64(c, v);
+    return _mm_movemask_pd(_mm_castsi128_pd(r)) ^ (RM_OpInverted(op) ? 0x3 : 0);
+}
+
+__attribute__((target("sse4.2")))
+static int RM_MaskF32Sse(int op, __m128 v, __m128 c) {
+    switch (op) {
+    case RM_OP_EQ: return _mm_movemask_ps(_mm_cmpeq_ps(v, c));
+    case RM_OP_NE: return _mm_movemask_ps(_mm_cmpneq_ps(v, c));
+    case RM_OP_LT: return _mm_movemask_ps(_mm_cmplt_ps(v, c));
+    case RM_OP_LE: return _mm_movemask_ps(_mm_cmple_ps(v, c));
+    case RM_OP_GT: return _mm_movemask_ps(_mm_cmpgt_ps(v, c));
+    default:       return _mm_movemask_ps(_mm_cmpge_ps(v, c));
+    }
+}
+
+__attribute__((target("sse4.2")))
+static int RM_MaskF64Sse(int op, __m128d v, __m128d c) {
+    switch (op) {
+    case RM_OP_EQ: return _mm_movemask_pd(_mm_cmpeq_pd(v, c));
+    case RM_OP_NE: return _mm_movemask_pd(_mm_cmpneq_pd(v, c));
+    case RM_OP_LT: return _mm_movemask_pd(_mm_cmplt_pd(v, c));
+    case RM_OP_LE: return _mm_movemask_pd(_mm_cmple_pd(v, c));
+    case RM_OP_GT: return _mm_movemask_pd(_mm_cmpgt_pd(v, c));
+    default:       return _mm_movemask_pd(_mm_cmpge_pd(v, c));
+    }
+}
+
+/* Loads `lanes` values of `width` bytes spaced `stride` bytes apart */
+static void RM_LoadLanes(char *dst, const char *src, int width, int stride, int lanes) {
+    int k;
+
+    if (stride == width) {
+        memcpy(dst, src, width * lanes);
+        return;
+    }
+    for (k = 0; k < lanes; k++)
+        memcpy(dst + k * width, src + (size_t)k * stride, width);
+}
+
+/*
+ * RM_FilterSse
+ * Narrows sel[] for a numeric attribute, 128 bits of values at a time.
+ * 64-slot words that are already empty are skipped. Returns the first
+ * slot left for the scalar tail.
+ */
+__attribute__((target("sse4.2")))
+static int RM_FilterSse(int type, int op, const void *value,
+                        const char *base, int stride, int count, uint64_t *sel) {
+    int width = (type == RM_TYPE_INT32 || type == RM_TYPE_FLOAT) ? 4 : 8;
+    int lanes = 16 / width;
+    int full = count - count % 64; // Slots covered by whole words
+    char lane[16];
+    __m128i ci = _mm_setzero_si128();
+    __m128 cf = _mm_setzero_ps();
+    __m128d cd = _mm_setzero_pd();
+    int32_t c32;
+    int64_t c64;
+    float f;
+    double d;
+    int i, j, m;
+    uint64_t bits;
+
+    switch (type) {
+    case RM_TYPE_INT32: memcpy(&c32, value, 4); ci = _mm_set1_epi32(c32); break;
+    case RM_TYPE_INT64: memcpy(&c64, value, 8); ci = _mm_set1_epi64x(c64); break;
+    case RM_TYPE_FLOAT: memcpy(&f, value, 4); cf = _mm_set1_ps(f); break;
+    default:            memcpy(&d, value, 8); cd = _mm_set1_pd(d); break;
+    }
+
+    for (i = 0; i < full; i += 64) {
+        if (sel[i >> 6] == 0)
+            continue;
+        bits = 0;
+        for (j = 0; j < 64; j += lanes) {
+            RM_LoadLanes(lane, base + (size_t)(i + j) * stride, width, stride, lanes);
+            switch (type) {
+            case RM_TYPE_INT32: m = RM_MaskI32Sse(op, _mm_loadu_si128((const __m128i *)lane), ci); break;
+            case RM_TYPE_INT64: m = RM_MaskI64Sse(op, _mm_loadu_si128((const __m128i *)lane), ci); break;
+            case RM_TYPE_FLOAT: m = RM_MaskF32Sse(op, _mm_loadu_ps((const float *)lane), cf); break;
+            default:            m = RM_MaskF64Sse(op, _mm_loadu_pd((const double *)lane), cd); break;
+            }
+            bits |= (uint64_t)m << j;
+        }
+        sel[i >> 6] &= bits;
+    }
+    return full;
+}
+
+/*
+ * =================================================================
+ * AVX2 Kernels
+ * =================================================================
+ */
+
+__attribute__((target("avx2")))
+static int RM_MaskI32Avx2(int op, __m256i v, __m256i c) {
+    __m256i r;
+
+    if (op == RM_OP_EQ || op == RM_OP_NE)
+        r = _mm256_cmpeq_epi32(v, c);
+    else if (op == RM_OP_GT || op == RM_OP_LE)
+        r = _mm256_cmpgt_epi32(v, c);
+    else
+        r = _mm256_cmpgt_epi32(c, v);
+    return _mm256_movemask_ps(_mm256_castsi256_ps(r)) ^ (RM_OpInverted(op) ? 0xFF : 0);
+}
+
+__attribute__((target("avx2")))
+static int RM_MaskI64Avx2(int op, __m256i v, __m256i c) {
+    __m256i r;
+
+    if (op == RM_OP_EQ || op == RM_OP_NE)
+        r = _mm256_cmpeq_epi64(v, c);
+    else if (op == RM_OP_GT || op == RM_OP_LE)
+        r = _mm256_cmpgt_epi64(v, c);
+    else
+        r = _mm256_cmpgt_epi64(c, v);
+    return _mm256_movemask_pd(_mm256_castsi256_pd(r)) ^ (RM_OpInverted(op) ? 0xF : 0);
+}
+
+__attribute__((target("avx2")))
+static int RM_MaskF32Avx2(int op, __m256 v, __m256 c) {
+    switch (op) {
+    case RM_OP_EQ: return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_EQ_OQ));
+    case RM_OP_NE: return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_NEQ_UQ));
+    case RM_OP_LT: return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_LT_OQ));
+    case RM_OP_LE: return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_LE_OQ));
+    case RM_OP_GT: return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_GT_OQ));
+    default:       return _mm256_movemask_ps(_mm256_cmp_ps(v, c, _CMP_GE_OQ));
+    }
+}
+
+__attribute__((target("avx2")))
+static int RM_MaskF64Avx2(int op, __m256d v, __m256d c) {
+    switch (op) {
+    case RM_OP_EQ: return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_EQ_OQ));
+    case RM_OP_NE: return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_NEQ_UQ));
+    case RM_OP_LT: return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_LT_OQ));
+    case RM_OP_LE: return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_LE_OQ));
+    case RM_OP_GT: return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_GT_OQ));
+    default:       return _mm256_movemask_pd(_mm256_cmp_pd(v, c, _CMP_GE_OQ));
+    }
+}
+
+/*
+ * RM_FilterAvx2
+ * Narrows sel[] for a numeric attribute, 256 bits of values at a time.
+ * Values packed back to back are loaded directly; values `stride`
+ * bytes apart are gathered. Returns the first slot left for the
+ * scalar tail.
+ */
+__attribute__((target("avx2")))
+static int RM_FilterAvx2(int type, int op, const void *value,
+                         const char *base, int stride, int count, uint64_t *sel) {
+    int width = (type == RM_TYPE_INT32 || type == RM_TYPE_FLOAT) ? 4 : 8;
+    int lanes = 32 / width;
+    int full = count - count % 64;
+    int packed = (stride == width);
+    __m256i idx32 = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+    __m128i idx64 = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(stride));
+    __m256i ci = _mm256_setzero_si256();
+    __m256 cf = _mm256_setzero_ps();
+    __m256d cd = _mm256_setzero_pd();
+    int32_t c32;
+    int64_t c64;
+    float f;
+    double d;
+    int i, j, m;
+    uint64_t bits;
+    const char *p;
+
+    switch (type) {
+    case RM_TYPE_INT32: memcpy(&c32, value, 4); ci = _mm256_set1_epi32(c32); break;
+    case RM_TYPE_INT64: memcpy(&c64, value, 8); ci = _mm256_set1_epi64x(c64); break;
+    case RM_TYPE_FLOAT: memcpy(&f, value, 4); cf = _mm256_set1_ps(f); break;
+    default:            memcpy(&d, value, 8); cd = _mm256_set1_pd(d); break;
+    }
+
+    for (i = 0; i < full; i += 64) {
+        if (sel[i >> 6] == 0)
+            continue;
+        bits = 0;
+        for (j = 0; j < 64; j += lanes) {
+            p = base + (size_t)(i + j) * stride;
+            switch (type) {
+            case RM_TYPE_INT32:
+                m = RM_MaskI32Avx2(op, packed ? _mm256_loadu_si256((const __m256i *)p)
+                                              : _mm256_i32gather_epi32((const int *)p, idx32, 1), ci);
+                break;
+            case RM_TYPE_INT64:
+                m = RM_MaskI64Avx2(op, packed ? _mm256_loadu_si256((const __m256i *)p)
+                                              : _mm256_i32gather_epi64((const long long *)p, idx64, 1), ci);
+                break;
+            case RM_TYPE_FLOAT:
+                m = RM_MaskF32Avx2(op, packed ? _mm256_loadu_ps((const float *)p)
+                                              : _mm256_i32gather_ps((const float *)p, idx32, 1), cf);
+                break;
+            default:
+                m = RM_MaskF64Avx2(op, packed ? _mm256_loadu_pd((const double *)p)
+                                              : _mm256_i32gather_pd((const double *)p, idx64, 1), cd);
+                break;
+            }
+            bits |= (uint64_t)m << j;
+        }
+        sel[i >> 6] &= bits;
+    }
+    return full;
+}
+#endif /* RM_HAVE_X86 */
+
+/*
+ * =================================================================
+ * Page Filtering
+ * =================================================================
+ */
+
+/*
+ * RM_FilterColumn
+ * Picks the widest kernel the level allows for the attribute type and
+ * finishes the slots it leaves over in plain C.
+ */
+void RM_FilterColumn(int type, int length, int op, const void *value,
+                     const char *base, int stride, int count, uint64_t *sel) {
+    int done = 0;
+
+#ifdef RM_HAVE_X86
+    if (type != RM_TYPE_CHAR) {
+        if (RM_SimdLevel() == RM_SIMD_AVX2)
+            done = RM_FilterAvx2(type, op, value, base, stride, count, sel);
+        else if (RM_SimdLevel() == RM_SIMD_SSE)
+            done = RM_FilterSse(type, op, value, base, stride, count, sel);
+    }
+#endif
+    RM_FilterScalar(type, length, op, value, base, stride, done, count, sel);
+}
+
+/*
+ * RM_CheckPreds
+ * Every predicate must name an attribute of the schema and a known
+ * operator. Only fixed-length (row or PAX) files can carry a schema.
+ */
+int RM_CheckPreds(RM_FileHandle *fh, const RM_Pred *preds, int numPreds) {
+    int i;
+
+    if (fh->hdr.numAttrs == 0 || !RM_IsFixed(fh) || numPreds < 0)
+        return RM_INVALID_ARG;
+    for (i = 0; i < numPreds; i++) {
+        if (preds[i].attr < 0 || preds[i].attr >= fh->hdr.numAttrs ||
+            preds[i].op < RM_OP_EQ || preds[i].op > RM_OP_GE || preds[i].value == NULL)
+            return RM_INVALID_ARG;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_PageSelect
+ * Starts from the presence bitmap and applies each predicate to the
+ * whole page in turn.
+ */
+int RM_PageSelect(RM_FileHandle *fh, char *pageBuf, const RM_Pred *preds, int numPreds, uint64_t *sel) {
+    int cap = fh->hdr.recsPerPage;
+    int words = (cap + 63) / 64;
+    const RM_Attr *attr;
+    const char *column;
+    int i, stride, count = 0;
+
+    // 1. The live slots (bits past `cap` are always clear)
+    memset(sel, 0, RM_SEL_WORDS * sizeof(uint64_t));
+    memcpy(sel, pageBuf + sizeof(RM_FixedPageHeader), words * sizeof(uint64_t));
+
+    // 2. Narrow by each predicate. In a row page the attribute sits at
+    //    the same offset in every record; in a PAX page its values are
+    //    packed in one minipage.
+    for (i = 0; i < numPreds; i++) {
+        attr = &fh->hdr.attrs[preds[i].attr];
+        column = RM_PageColumn(fh, pageBuf, preds[i].attr, &stride);
+        RM_FilterColumn(attr->type, attr->length, preds[i].op, preds[i].value,
+                        column, stride, cap, sel);
+    }
+
+    for (i = 0; i < words; i++)
+        count += __builtin_popcountll(sel[i]);
+    return count;
+}
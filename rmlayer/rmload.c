@@ -0,0 +1,446 @@
+/* rmload.c: Parallel CSV bulk loader for the RM Layer */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rm_internal.h"
+
+/*
+ * The loader never goes through RM_InsertRec. The input is mapped into
+ * memory and cut at line ends into chunks of about RM_LOAD_CHUNK bytes.
+ * Each worker parses its chunk into records and packs them into pages
+ * of its own, built with the same rmpage.c helpers RM_InsertRec uses.
+ * The PF layer is not thread-safe, so the calling thread then appends
+ * the finished pages one batch of chunks at a time, in input order.
+ */
+
+/*
+ * =================================================================
+ * Record Layouts
+ * =================================================================
+ */
+
+/*
+ * RM_LayoutLength
+ * Sums the attribute widths of a layout.
+ */
+int RM_LayoutLength(RM_Attr *attrs, int numAttrs) {
+    int i, len = 0;
+
+    if (numAttrs <= 0)
+        return RM_INVALID_ARG;
+
+    for (i = 0; i < numAttrs; i++) {
+        switch (attrs[i].type) {
+        case RM_TYPE_INT32: attrs[i].length = sizeof(int); break;
+        case RM_TYPE_INT64: attrs[i].length = sizeof(long long); break;
+        case RM_TYPE_FLOAT: attrs[i].length = sizeof(float); break;
+        case RM_TYPE_DOUBLE: attrs[i].length = sizeof(double); break;
+        case RM_TYPE_CHAR:
+            if (attrs[i].length <= 0)
+                return RM_INVALID_ARG;
+            break;
+        default:
+            return RM_INVALID_ARG;
+        }
+        len += attrs[i].length;
+    }
+    return len;
+}
+
+/*
+ * =================================================================
+ * CSV Parsing
+ * =================================================================
+ */
+
+/* Longest numeric field the parser accepts */
+#define RM_LOAD_NUMLEN 64
+
+/*
+ * RM_LoadNextField
+ * Copies the field starting at `p` (unquoted, at most `max` bytes are
+ * kept) into `out` and returns where the next field starts, or NULL at
+ * the end of the line. *len is set to the field's full length.
+ */
+static const char *RM_LoadNextField(const char *p, const char *end, char *out, int max, int *len) {
+    int n = 0;
+
+    if (p < end && *p == '"') {
+        // Quoted: runs to the closing quote, "" stands for one quote
+        for (p++; p < end; p++) {
+            if (*p == '"') {
+                if (p + 1 < end && p[1] == '"') {
+                    p++;
+                } else {
+                    p++;
+                    break;
+                }
+            }
+            if (n < max)
+                out[n] = *p;
+            n++;
+        }
+        while (p < end && *p != ',')
+            p++; // Anything after the closing quote is ignored
+    } else {
+        for (; p < end && *p != ','; p++) {
+            if (n < max)
+                out[n] = *p;
+            n++;
+        }
+    }
+    *len = n;
+    return (p < end) ? p + 1 : NULL;
+}
+
+/*
+ * RM_LoadParseLine
+ * Parses one line (without its line end) into a record of the layout.
+ * Returns PFE_OK, or RM_INVALID_ARG if the line does not match it.
+ */
+static int RM_LoadParseLine(const char *p, const char *end, const RM_Attr *attrs, int numAttrs, char *rec) {
+    char num[RM_LOAD_NUMLEN + 1];
+    char *stop;
+    int i, len;
+
+    for (i = 0; i < numAttrs; i++) {
+        if (p == NULL)
+            return RM_INVALID_ARG; // Too few fields
+
+        if (attrs[i].type == RM_TYPE_CHAR) {
+            memset(rec, 0, attrs[i].length);
+            p = RM_LoadNextField(p, end, rec, attrs[i].length, &len);
+            rec += attrs[i].length;
+            continue;
+        }
+
+        // Numbers are parsed from a NUL-terminated copy of the field
+        p = RM_LoadNextField(p, end, num, RM_LOAD_NUMLEN, &len);
+        if (len == 0 || len > RM_LOAD_NUMLEN)
+            return RM_INVALID_ARG;
+        num[len] = '\0';
+        errno = 0;
+        switch (attrs[i].type) {
+        case RM_TYPE_INT32: {
+            long v = strtol(num, &stop, 10);
+            int v32 = (int)v;
+            if (v < INT_MIN || v > INT_MAX)
+                errno = ERANGE;
+            memcpy(rec, &v32, sizeof(int));
+            break;
+        }
+        case RM_TYPE_INT64: {
+            long long v = strtoll(num, &stop, 10);
+            memcpy(rec, &v, sizeof(long long));
+            break;
+        }
+        case RM_TYPE_FLOAT: {
+            float v = strtof(num, &stop);
+            memcpy(rec, &v, sizeof(float));
+            break;
+        }
+        default: {
+            double v = strtod(num, &stop);
+            memcpy(rec, &v, sizeof(double));
+            break;
+        }
+        }
+        if (errno != 0 || *stop != '\0')
+            return RM_INVALID_ARG;
+        rec += attrs[i].length;
+    }
+
+    return (p == NULL) ? PFE_OK : RM_INVALID_ARG; // Too many fields
+}
+
+/*
+ * =================================================================
+ * Workers
+ * =================================================================
+ */
+
+typedef struct {
+    RM_FileHandle *fh;
+    const RM_Attr *attrs;
+    int numAttrs;
+    int recLen;
+    const char *start;   /* The chunk: whole lines from start to end */
+    const char *end;
+    char **pages;        /* Pages built so far, in order */
+    RM_SpaceStats *slotStats; /* Counters of each page's records, taken
+                                 as they are packed */
+    int numPages;
+    int maxPages;
+    long rows;
+    long rejected;
+    int result;          /* PFE_OK or the first error */
+    pthread_t tid;
+} RM_LoadWorker;
+
+/*
+ * RM_LoadNewPage
+ * Adds an empty page in the file's format to the worker's list.
+ */
+static char *RM_LoadNewPage(RM_LoadWorker *w) {
+    char **pages;
+    RM_SpaceStats *slotStats;
+    char *page;
+    int maxPages;
+
+    if (w->numPages == w->maxPages) {
+        maxPages = (w->maxPages == 0) ? 64 : w->maxPages * 2;
+        pages = realloc(w->pages, maxPages * sizeof(char *));
+        if (pages == NULL)
+            return NULL;
+        w->pages = pages;
+        slotStats = realloc(w->slotStats, maxPages * sizeof(RM_SpaceStats));
+        if (slotStats == NULL)
+            return NULL;
+        w->slotStats = slotStats;
+        w->maxPages = maxPages;
+    }
+    page = calloc(1, PF_PAGE_SIZE);
+    if (page == NULL)
+        return NULL;
+    RM_InitPage(w->fh, page);
+    memset(&w->slotStats[w->numPages], 0, sizeof(RM_SpaceStats));
+    w->pages[w->numPages++] = page;
+    return page;
+}
+
+/*
+ * RM_LoadWorkerMain
+ * Parses every line of the worker's chunk and packs the records into
+ * pages. Lines that do not match the layout are counted and skipped.
+ */
+static void *RM_LoadWorkerMain(void *p) {
+    RM_LoadWorker *w = (RM_LoadWorker *)p;
+    const char *line, *eol, *next;
+    char *page = NULL;
+    char *rec;
+    int slotNum = -1;
+
+    rec = malloc(w->recLen);
+    if (rec == NULL) {
+        w->result = RM_NOMEM;
+        return NULL;
+    }
+
+    for (line = w->start; line < w->end; line = next) {
+        // 1. Find the end of the line; a \r before the \n is dropped
+        eol = memchr(line, '\n', w->end - line);
+        if (eol == NULL)
+            eol = w->end;
+        next = eol + 1;
+        if (eol > line && eol[-1] == '\r')
+            eol--;
+        if (eol == line)
+            continue; // Blank line
+
+        // 2. Parse it into a record
+        if (RM_LoadParseLine(line, eol, w->attrs, w->numAttrs, rec) != PFE_OK) {
+            w->rejected++;
+            continue;
+        }
+
+        // 3. Pack it into the current page, starting a new one when full,
+        //    and count the new slot toward that page's counters
+        if (page != NULL)
+            slotNum = RM_PageInsert(w->fh, page, rec, w->recLen);
+        if (page == NULL || slotNum < 0) {
+            page = RM_LoadNewPage(w);
+            if (page == NULL) {
+                w->result = RM_NOMEM;
+                break;
+            }
+            slotNum = RM_PageInsert(w->fh, page, rec, w->recLen);
+        }
+        RM_PageSlotStats(w->fh, page, slotNum, &w->slotStats[w->numPages - 1]);
+        w->rows++;
+    }
+
+    free(rec);
+    return NULL;
+}
+
+/*
+ * RM_LoadAppendPages
+ * Appends a worker's finished pages to the file, one page write each,
+ * and enters them in the page directory and the space counters (the
+ * page's own part, plus its records as the worker counted them).
+ */
+static int RM_LoadAppendPages(RM_FileHandle *fh, RM_LoadWorker *w, RM_LoadStats *stats) {
+    int pf_err;
+    int pageNum;
+    char *pageBuf;
+    RM_SpaceStats *part;
+    int i;
+
+    for (i = 0; i < w->numPages; i++) {
+        pf_err = PF_AppendPage(fh->pf_fd, &pageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        pf_err = RM_DirSet(fh, pageNum, TRUE);
+        if (pf_err != PFE_OK) {
+            PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+            PF_DisposePage(fh->pf_fd, pageNum);
+            return pf_err;
+        }
+        memcpy(pageBuf, w->pages[i], PF_PAGE_SIZE);
+        fh->hdr.stats.numPages++;
+        RM_AccountSlot(fh, pageBuf, -1, 1);
+        part = &w->slotStats[i];
+        fh->hdr.stats.numRecs += part->numRecs;
+        fh->hdr.stats.recordBytes += part->recordBytes;
+        fh->hdr.stats.deadBytes += part->deadBytes;
+        fh->hdr.stats.overflowPages += part->overflowPages;
+        if (fh->openFlags & RM_OPEN_APPEND) {
+            fh->tailPage = pageNum;
+        }
+        pf_err = PF_UnfixPage(fh->pf_fd, pageNum, TRUE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        stats->pages++;
+    }
+    return PFE_OK;
+}
+
+/* Frees the pages a worker built */
+static void RM_LoadFreeWorker(RM_LoadWorker *w) {
+    int i;
+
+    for (i = 0; i < w->numPages; i++)
+        free(w->pages[i]);
+    free(w->pages);
+    free(w->slotStats);
+    w->pages = NULL;
+    w->slotStats = NULL;
+    w->numPages = 0;
+    w->maxPages = 0;
+}
+
+/*
+ * =================================================================
+ * Public Entry Point
+ * =================================================================
+ */
+
+/*
+ * RM_LoadCSV
+ * Loads `csvFile` into `fh` in batches of numThreads chunks: the chunks
+ * of a batch are parsed in parallel, then their pages are appended.
+ */
+int RM_LoadCSV(RM_FileHandle *fh, const char *csvFile, RM_Attr *attrs, int numAttrs,
+               int numThreads, int flags, RM_LoadStats *stats) {
+    RM_LoadWorker workers[RM_PSCAN_MAXTHREADS];
+    struct stat st;
+    const char *base, *nl;
+    size_t size, pos, end;
+    int recLen, fd, started, i, n;
+    int result = PFE_OK;
+
+    memset(stats, 0, sizeof(RM_LoadStats));
+
+    // 1. Check the layout against the file
+    if (numThreads < 1 || numThreads > RM_PSCAN_MAXTHREADS) {
+        return RM_INVALID_ARG;
+    }
+    recLen = RM_LayoutLength(attrs, numAttrs);
+    if (recLen < 0) {
+        return recLen;
+    }
+    if (RM_IsFixed(fh) ? recLen != fh->hdr.recordLength
+                       : recLen > RM_OVERFLOW_THRESHOLD) {
+        return RM_INVALID_RECLEN;
+    }
+
+    // 2. Map the input
+    fd = open(csvFile, O_RDONLY);
+    if (fd < 0) {
+        return RM_IO_ERROR;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return RM_IO_ERROR;
+    }
+    size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return PFE_OK;
+    }
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return RM_IO_ERROR;
+    }
+    madvise((void *)base, size, MADV_SEQUENTIAL);
+
+    pos = 0;
+    if (flags & RM_LOAD_HEADER) {
+        nl = memchr(base, '\n', size);
+        pos = (nl != NULL) ? (size_t)(nl - base) + 1 : size;
+    }
+
+    while (pos < size && result == PFE_OK) {
+        // 3. Cut the next batch of chunks at line ends
+        for (n = 0; n < numThreads && pos < size; n++) {
+            end = pos + RM_LOAD_CHUNK;
+            if (end >= size) {
+                end = size;
+            } else {
+                nl = memchr(base + end, '\n', size - end);
+                end = (nl != NULL) ? (size_t)(nl - base) + 1 : size;
+            }
+            memset(&workers[n], 0, sizeof(RM_LoadWorker));
+            workers[n].fh = fh;
+            workers[n].attrs = attrs;
+            workers[n].numAttrs = numAttrs;
+            workers[n].recLen = recLen;
+            workers[n].start = base + pos;
+            workers[n].end = base + end;
+            workers[n].result = PFE_OK;
+            pos = end;
+        }
+
+        // 4. Parse them in parallel (the last chunk on this thread)
+        for (started = 0; started < n - 1; started++) {
+            if (pthread_create(&workers[started].tid, NULL, RM_LoadWorkerMain,
+                               &workers[started]) != 0) {
+                result = RM_THREAD_ERROR;
+                break;
+            }
+        }
+        if (result == PFE_OK) {
+            RM_LoadWorkerMain(&workers[n - 1]);
+        }
+        for (i = 0; i < started; i++) {
+            pthread_join(workers[i].tid, NULL);
+        }
+
+        // 5. Append their pages in input order
+        for (i = 0; i < n; i++) {
+            if (result == PFE_OK) {
+                result = workers[i].result;
+            }
+            if (result == PFE_OK) {
+                result = RM_LoadAppendPages(fh, &workers[i], stats);
+                stats->rows += workers[i].rows;
+                stats->rejected += workers[i].rejected;
+            }
+            RM_LoadFreeWorker(&workers[i]);
+        }
+    }
+
+    munmap((void *)base, size);
+    return result;
+}
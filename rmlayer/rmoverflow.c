@@ -0,0 +1,369 @@
+/* rmoverflow.c: Overflow extents and streaming reads for large records */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rm_internal.h"
+
+static int RM_OverflowDispose(RM_FileHandle *fh, const RM_OverflowStub *stub);
+
+/*
+ * A record longer than RM_OVERFLOW_THRESHOLD keeps only an
+ * RM_OverflowStub in its slot. Its bytes are written to an extent of
+ * consecutive pages, so a read walks it with ascending page numbers.
+ * Overflow pages carry no header: the stub alone says where the record
+ * starts and how long it is.
+ *
+ * A freed extent is not disposed: its pages are entered as a run in
+ * the file header's free run list (merged with runs next to it), and
+ * the next extent is cut from the first run long enough. Only when no
+ * run fits is the extent appended to the end of the file with
+ * PF_AppendPage, which never reuses disposed pages and so keeps it
+ * contiguous. An update that fits in the record's current extent,
+ * possibly grown into a free run right after it, rewrites it in place.
+ */
+
+/*
+ * =================================================================
+ * Free Runs
+ * =================================================================
+ */
+
+/*
+ * RM_FreeRunTake
+ * Cuts `numPages` pages from the front of the first free run with at
+ * least that many. Returns the first page, or -1 if no run is long
+ * enough. With `at` >= 0 only a run starting at page `at` is taken.
+ */
+static int RM_FreeRunTake(RM_FileHandle *fh, int numPages, int at) {
+    RM_FreeRun *run;
+    int firstPage;
+    int i;
+
+    for (i = 0; i < fh->hdr.numFreeRuns; i++) {
+        run = &fh->hdr.freeRuns[i];
+        if (run->numPages < numPages || (at >= 0 && run->firstPage != at))
+            continue;
+        firstPage = run->firstPage;
+        run->firstPage += numPages;
+        run->numPages -= numPages;
+        if (run->numPages == 0) {
+            *run = fh->hdr.freeRuns[--fh->hdr.numFreeRuns];
+        }
+        fh->hdrChanged = TRUE;
+        return firstPage;
+    }
+    return -1;
+}
+
+/*
+ * RM_FreeRunAdd
+ * Enters pages firstPage .. firstPage + numPages - 1 in the free run
+ * list, merging them with the runs they touch. Returns FALSE if the
+ * list is full and they touch no run.
+ */
+static int RM_FreeRunAdd(RM_FileHandle *fh, int firstPage, int numPages) {
+    RM_FreeRun *run;
+    int i;
+
+    if (numPages <= 0) {
+        return TRUE;
+    }
+
+    // 1. Absorb every run that ends where this one starts or starts
+    //    where it ends (at most one of each)
+    for (i = 0; i < fh->hdr.numFreeRuns; ) {
+        run = &fh->hdr.freeRuns[i];
+        if (run->firstPage + run->numPages == firstPage) {
+            firstPage = run->firstPage;
+            numPages += run->numPages;
+        } else if (firstPage + numPages == run->firstPage) {
+            numPages += run->numPages;
+        } else {
+            i++;
+            continue;
+        }
+        *run = fh->hdr.freeRuns[--fh->hdr.numFreeRuns];
+    }
+
+    // 2. Enter the merged run
+    if (fh->hdr.numFreeRuns == RM_MAX_FREE_RUNS) {
+        return FALSE;
+    }
+    fh->hdr.freeRuns[fh->hdr.numFreeRuns].firstPage = firstPage;
+    fh->hdr.freeRuns[fh->hdr.numFreeRuns].numPages = numPages;
+    fh->hdr.numFreeRuns++;
+    fh->hdrChanged = TRUE;
+    return TRUE;
+}
+
+/*
+ * =================================================================
+ * Overflow Extents
+ * =================================================================
+ */
+
+/*
+ * RM_OverflowPages
+ * Pages in an extent holding `record_len` bytes.
+ */
+static int RM_OverflowPages(int record_len) {
+    return (record_len + PF_PAGE_SIZE - 1) / PF_PAGE_SIZE;
+}
+
+/*
+ * RM_OverflowFill
+ * Copies the record into the extent's pages, zero-padding the last
+ * one. `append` means the pages do not exist yet and are appended to
+ * the file one by one; stub->numPages counts the pages written so far,
+ * so a failed write can be freed with RM_OverflowFree.
+ */
+static int RM_OverflowFill(RM_FileHandle *fh, RM_OverflowStub *stub, const char *record_data,
+                           int record_len, int append) {
+    int pf_err;
+    int pageNum;
+    char *pageBuf;
+    int done, chunk;
+
+    for (done = 0; done < record_len; done += chunk) {
+        // 1. Get the next page of the extent
+        if (append) {
+            pf_err = PF_AppendPage(fh->pf_fd, &pageNum, &pageBuf);
+            if (pf_err == PFE_OK && stub->numPages == 0) {
+                stub->firstPage = pageNum;
+            }
+        } else {
+            pageNum = stub->firstPage + done / PF_PAGE_SIZE;
+            pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        }
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        if (append) {
+            stub->numPages++;
+        }
+
+        // 2. Fill it with the next piece of the record
+        chunk = record_len - done;
+        if (chunk > PF_PAGE_SIZE) {
+            chunk = PF_PAGE_SIZE;
+        }
+        memcpy(pageBuf, record_data + done, chunk);
+        if (chunk < PF_PAGE_SIZE) {
+            memset(pageBuf + chunk, 0, PF_PAGE_SIZE - chunk);
+        }
+
+        pf_err = PF_UnfixPage(fh->pf_fd, pageNum, TRUE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_OverflowWrite
+ * Writes the record to a new extent of ceil(record_len / PF_PAGE_SIZE)
+ * pages, cut from a free run if one is long enough and appended to the
+ * file otherwise, and describes it in `stub`. On failure the pages
+ * already taken are freed again.
+ */
+int RM_OverflowWrite(RM_FileHandle *fh, const char *record_data, int record_len, RM_OverflowStub *stub) {
+    int pf_err;
+    int numPages = RM_OverflowPages(record_len);
+
+    stub->totalLen = record_len;
+    stub->firstPage = RM_FreeRunTake(fh, numPages, -1);
+    stub->numPages = (stub->firstPage >= 0) ? numPages : 0;
+
+    pf_err = RM_OverflowFill(fh, stub, record_data, record_len, stub->firstPage < 0);
+    if (pf_err != PFE_OK) {
+        RM_OverflowFree(fh, stub);
+        return pf_err;
+    }
+
+    // The space counters pick the extent up from the stub, once the
+    // caller has placed it on a data page
+    return PFE_OK;
+}
+
+/*
+ * RM_OverflowRewrite
+ * Writes new data for a large record over its own extent `stub`, if
+ * the extent is long enough or can grow into a free run that starts
+ * right after it. Pages the new data no longer needs are freed. The
+ * caller puts the updated stub in the record's slot. Returns
+ * RM_PAGE_FULL, with nothing changed, if the data does not fit.
+ */
+int RM_OverflowRewrite(RM_FileHandle *fh, RM_OverflowStub *stub, const char *record_data, int record_len) {
+    int numPages = RM_OverflowPages(record_len);
+    int extra = numPages - stub->numPages;
+
+    // 1. Grow the extent into the free run after it, if it must
+    if (extra > 0) {
+        if (RM_FreeRunTake(fh, extra, stub->firstPage + stub->numPages) < 0) {
+            return RM_PAGE_FULL;
+        }
+    }
+
+    // 2. Free the pages past the new end
+    if (extra < 0 && !RM_FreeRunAdd(fh, stub->firstPage + numPages, -extra)) {
+        RM_OverflowStub tail;
+        tail.firstPage = stub->firstPage + numPages;
+        tail.numPages = -extra;
+        RM_OverflowDispose(fh, &tail);
+    }
+    stub->numPages = numPages;
+    stub->totalLen = record_len;
+
+    // 3. Overwrite the pages in place
+    return RM_OverflowFill(fh, stub, record_data, record_len, FALSE);
+}
+
+/*
+ * RM_OverflowRead
+ * Copies `len` bytes starting at byte `offset` of the record out of
+ * its extent, one page at a time in page order.
+ */
+int RM_OverflowRead(RM_FileHandle *fh, const RM_OverflowStub *stub, int offset, char *buf, int len) {
+    int pf_err;
+    char *pageBuf;
+    int pageNum, pageOffset, chunk;
+
+    if (offset < 0 || len < 0 || offset + len > stub->totalLen) {
+        return RM_INVALID_ARG;
+    }
+
+    while (len > 0) {
+        pageNum = stub->firstPage + offset / PF_PAGE_SIZE;
+        pageOffset = offset % PF_PAGE_SIZE;
+        chunk = PF_PAGE_SIZE - pageOffset;
+        if (chunk > len) {
+            chunk = len;
+        }
+
+        pf_err = PF_GetThisPage(fh->pf_fd, pageNum, &pageBuf);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+        memcpy(buf, pageBuf + pageOffset, chunk);
+        pf_err = PF_UnfixPage(fh->pf_fd, pageNum, FALSE);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+
+        buf += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_OverflowFree
+ * Gives every page of the extent back to the free run list, or to the
+ * PF layer if the list is full. Only the pages it counted are freed,
+ * so this also cleans up after a partial RM_OverflowWrite.
+ */
+int RM_OverflowFree(RM_FileHandle *fh, const RM_OverflowStub *stub) {
+    if (stub->numPages <= 0 || RM_FreeRunAdd(fh, stub->firstPage, stub->numPages)) {
+        return PFE_OK;
+    }
+    return RM_OverflowDispose(fh, stub);
+}
+
+/*
+ * RM_OverflowDispose
+ * Disposes every page of the extent with the PF layer.
+ */
+static int RM_OverflowDispose(RM_FileHandle *fh, const RM_OverflowStub *stub) {
+    int pf_err;
+    int i;
+    int result = PFE_OK;
+
+    for (i = 0; i < stub->numPages; i++) {
+        pf_err = PF_DisposePage(fh->pf_fd, stub->firstPage + i);
+        if (pf_err != PFE_OK && result == PFE_OK) {
+            result = pf_err;
+        }
+    }
+    return result;
+}
+
+/*
+ * =================================================================
+ * Streaming Record Reads
+ * =================================================================
+ */
+
+/*
+ * RM_OpenRecStream
+ * Resolves `rid`. A large record is left in its extent (nothing but the
+ * home page is read yet); any other record is copied into rs->data.
+ */
+int RM_OpenRecStream(RM_FileHandle *fh, const RID *rid, RM_RecStream *rs) {
+    RM_OverflowStub stub;
+    int err;
+
+    err = RM_LookupRec(fh, rid, rs->data, &rs->length, &stub);
+    if (err < 0) {
+        return err;
+    }
+
+    rs->fh = fh;
+    rs->pos = 0;
+    rs->firstPage = (err == RM_REC_OVERFLOW) ? stub.firstPage : -1;
+    return PFE_OK;
+}
+
+/*
+ * RM_ReadRecStream
+ * Returns the next piece of the record. Each call touches only the
+ * overflow pages that piece covers, so reading a large record in
+ * chunks pins one page at a time and never needs a buffer for all of it.
+ */
+int RM_ReadRecStream(RM_RecStream *rs, char *buf, int max_len, int *nread) {
+    RM_OverflowStub stub;
+    int len, err;
+
+    *nread = 0;
+    if (rs->fh == NULL || max_len < 0) {
+        return RM_INVALID_ARG;
+    }
+    if (rs->pos >= rs->length) {
+        return RM_EOF;
+    }
+
+    len = rs->length - rs->pos;
+    if (len > max_len) {
+        len = max_len;
+    }
+
+    if (rs->firstPage == -1) {
+        memcpy(buf, rs->data + rs->pos, len);
+    } else {
+        stub.totalLen = rs->length;
+        stub.firstPage = rs->firstPage;
+        stub.numPages = (rs->length + PF_PAGE_SIZE - 1) / PF_PAGE_SIZE;
+        err = RM_OverflowRead(rs->fh, &stub, rs->pos, buf, len);
+        if (err != PFE_OK) {
+            return err;
+        }
+    }
+
+    rs->pos += len;
+    *nread = len;
+    return PFE_OK;
+}
+
+/*
+ * RM_CloseRecStream
+ * Finishes a stream. Nothing stays pinned between reads.
+ */
+int RM_CloseRecStream(RM_RecStream *rs) {
+    rs->fh = NULL;
+    rs->length = 0;
+    rs->pos = 0;
+    rs->firstPage = -1;
+    return PFE_OK;
+}
@@ -0,0 +1,778 @@
+/* rmpage.c: Page layout routines for the RM Layer */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "rm_internal.h"
+
+/*
+ * Every RM file uses one page format, recorded in its file header:
+ *
+ *   RM_FORMAT_SLOTTED  variable-length records, slot directory growing
+ *                      forward, record data growing backward.
+ *   RM_FORMAT_COMPACT  the same layout with 16-bit header and slot
+ *                      fields (4 bytes per slot instead of 8).
+ *   RM_FORMAT_FIXED    fixed-length records packed at computed offsets,
+ *                      with a presence bitmap instead of a slot directory.
+ *   RM_FORMAT_PAX      the fixed-length layout with each attribute of
+ *                      the schema in its own minipage (a column array).
+ *
+ * The functions below hide the difference from rm.c and the scans.
+ */
+
+/*
+ * =================================================================
+ * Fixed-Length Page Helpers
+ * =================================================================
+ */
+
+/*
+ * RM_FixedCapacity
+ * Largest number of records of `record_len` bytes that fit on a page
+ * together with the header and the presence bitmap.
+ */
+int RM_FixedCapacity(int record_len) {
+    int cap;
+
+    if (record_len <= 0)
+        return 0;
+
+    // Start from the bit-exact bound and shrink for bitmap word padding
+    cap = ((PF_PAGE_SIZE - (int)sizeof(RM_FixedPageHeader)) * 8) / (record_len * 8 + 1);
+    while (cap > 0 && RM_FixedDataOffset(cap) + cap * record_len > PF_PAGE_SIZE)
+        cap--;
+    return cap;
+}
+
+/* Bitmap words are loaded with memcpy: page buffers are only int-aligned */
+static uint64_t RM_FixedLoadWord(const char *bitmap, int w) {
+    uint64_t word;
+    memcpy(&word, bitmap + w * sizeof(uint64_t), sizeof(uint64_t));
+    return word;
+}
+
+static int RM_FixedTestBit(const char *bitmap, int slot) {
+    return (bitmap[slot >> 3] >> (slot & 7)) & 1;
+}
+
+/*
+ * RM_AttrOffset
+ * Where attribute `attr` starts in a record: the attributes before it
+ * are stored back to back.
+ */
+int RM_AttrOffset(RM_FileHandle *fh, int attr) {
+    int a, offset = 0;
+
+    for (a = 0; a < attr; a++)
+        offset += fh->hdr.attrs[a].length;
+    return offset;
+}
+
+/*
+ * RM_PageColumn
+ * A row page repeats the attribute every recordLength bytes; a PAX
+ * page packs its values in the attribute's minipage.
+ */
+char *RM_PageColumn(RM_FileHandle *fh, char *pageBuf, int attr, int *stride) {
+    int cap = fh->hdr.recsPerPage;
+    int offset = RM_AttrOffset(fh, attr);
+
+    if (fh->hdr.pageFormat == RM_FORMAT_PAX) {
+        *stride = fh->hdr.attrs[attr].length;
+        return pageBuf + RM_FixedDataOffset(cap) + cap * offset;
+    }
+    *stride = fh->hdr.recordLength;
+    return pageBuf + RM_FixedDataOffset(cap) + offset;
+}
+
+/*
+ * A PAX record is assembled in a per-thread buffer, so RM_PageGetRec
+ * can hand out a pointer as it does for the other formats. The pointer
+ * stays valid until the same thread looks up its next record.
+ */
+static __thread char RM_PaxRecord[PF_PAGE_SIZE];
+
+/* Copies slot `slot` of a PAX page into `record`, one minipage at a time */
+static void RM_PaxGather(RM_FileHandle *fh, const char *pageBuf, int slot, char *record) {
+    const char *minipage = pageBuf + RM_FixedDataOffset(fh->hdr.recsPerPage);
+    int a, len;
+
+    for (a = 0; a < fh->hdr.numAttrs; a++) {
+        len = fh->hdr.attrs[a].length;
+        memcpy(record, minipage + slot * len, len);
+        record += len;
+        minipage += fh->hdr.recsPerPage * len;
+    }
+}
+
+/* Spreads `record` over the minipages of slot `slot` of a PAX page */
+static void RM_PaxScatter(RM_FileHandle *fh, char *pageBuf, int slot, const char *record) {
+    char *minipage = pageBuf + RM_FixedDataOffset(fh->hdr.recsPerPage);
+    int a, len;
+
+    for (a = 0; a < fh->hdr.numAttrs; a++) {
+        len = fh->hdr.attrs[a].length;
+        memcpy(minipage + slot * len, record, len);
+        record += len;
+        minipage += fh->hdr.recsPerPage * len;
+    }
+}
+
+/*
+ * =================================================================
+ * Slot Directory Helpers (RM_FORMAT_SLOTTED and RM_FORMAT_COMPACT)
+ * =================================================================
+ */
+
+static int RM_VarHeaderSize(RM_FileHandle *fh) {
+    return (fh->hdr.pageFormat == RM_FORMAT_COMPACT) ? (int)sizeof(RM_CompactPageHeader)
+                                                     : (int)sizeof(RM_PageHeader);
+}
+
+static int RM_VarSlotSize(RM_FileHandle *fh) {
+    return (fh->hdr.pageFormat == RM_FORMAT_COMPACT) ? (int)sizeof(RM_CompactSlot)
+                                                     : (int)sizeof(RM_Slot);
+}
+
+static void RM_VarGetHeader(RM_FileHandle *fh, char *pageBuf, int *numSlots, int *freeSpaceOffset) {
+    if (fh->hdr.pageFormat == RM_FORMAT_COMPACT) {
+        RM_CompactPageHeader *compactHeader = (RM_CompactPageHeader *)pageBuf;
+        *numSlots = compactHeader->numSlots;
+        *freeSpaceOffset = compactHeader->freeSpaceOffset;
+    } else {
+        RM_PageHeader *pageHeader = (RM_PageHeader *)pageBuf;
+        *numSlots = pageHeader->numSlots;
+        *freeSpaceOffset = pageHeader->freeSpaceOffset;
+    }
+}
+
+static void RM_VarSetHeader(RM_FileHandle *fh, char *pageBuf, int numSlots, int freeSpaceOffset) {
+    if (fh->hdr.pageFormat == RM_FORMAT_COMPACT) {
+        RM_CompactPageHeader *compactHeader = (RM_CompactPageHeader *)pageBuf;
+        compactHeader->numSlots = (unsigned short)numSlots;
+        compactHeader->freeSpaceOffset = (unsigned short)freeSpaceOffset;
+    } else {
+        RM_PageHeader *pageHeader = (RM_PageHeader *)pageBuf;
+        pageHeader->numSlots = numSlots;
+        pageHeader->freeSpaceOffset = freeSpaceOffset;
+    }
+}
+
+static void RM_VarGetSlot(RM_FileHandle *fh, char *pageBuf, int slotNum, RM_SlotInfo *info) {
+    char *slotPtr = pageBuf + RM_VarHeaderSize(fh) + slotNum * RM_VarSlotSize(fh);
+    int raw;
+
+    if (fh->hdr.pageFormat == RM_FORMAT_COMPACT) {
+        RM_CompactSlot *slot = (RM_CompactSlot *)slotPtr;
+        info->offset = (slot->length & RM_CSLOT_TOMBSTONE) ? -1 : slot->offset;
+        raw = slot->length;
+    } else {
+        RM_Slot *slot = (RM_Slot *)slotPtr;
+        info->offset = slot->offset;
+        raw = slot->length;
+    }
+    info->length = raw & RM_CSLOT_LENMASK;
+    info->flags = raw & RM_SLOT_FLAGS;
+}
+
+static void RM_VarSetSlot(RM_FileHandle *fh, char *pageBuf, int slotNum, const RM_SlotInfo *info) {
+    char *slotPtr = pageBuf + RM_VarHeaderSize(fh) + slotNum * RM_VarSlotSize(fh);
+    int raw = (info->length & RM_CSLOT_LENMASK) | (info->flags & RM_SLOT_FLAGS);
+
+    if (fh->hdr.pageFormat == RM_FORMAT_COMPACT) {
+        RM_CompactSlot *slot = (RM_CompactSlot *)slotPtr;
+        if (info->offset == -1) {
+            // Tombstone: the offset is meaningless, the flag bit says it all
+            slot->offset = 0;
+            slot->length = (unsigned short)(raw | RM_CSLOT_TOMBSTONE);
+        } else {
+            slot->offset = (unsigned short)info->offset;
+            slot->length = (unsigned short)raw;
+        }
+    } else {
+        RM_Slot *slot = (RM_Slot *)slotPtr;
+        slot->offset = info->offset;
+        slot->length = raw;
+    }
+}
+
+/* Bytes held by every non-free slot except `skipSlot` */
+static int RM_VarUsedBytes(RM_FileHandle *fh, char *pageBuf, int skipSlot) {
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    int used = 0;
+    int i;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    for (i = 0; i < numSlots; i++) {
+        RM_VarGetSlot(fh, pageBuf, i, &slot);
+        if (slot.offset != -1 && i != skipSlot)
+            used += slot.length;
+    }
+    return used;
+}
+
+/*
+ * RM_VarCompact
+ * Packs the bytes of every non-free slot except `skipSlot` against the
+ * end of the page, so all holes join the free gap. `skipSlot`'s bytes
+ * are dropped (the caller is about to rewrite that slot).
+ */
+static void RM_VarCompact(RM_FileHandle *fh, char *pageBuf, int skipSlot) {
+    char packed[PF_PAGE_SIZE];
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    int i;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    freeSpaceOffset = PF_PAGE_SIZE;
+    for (i = 0; i < numSlots; i++) {
+        RM_VarGetSlot(fh, pageBuf, i, &slot);
+        if (slot.offset == -1 || i == skipSlot)
+            continue;
+        freeSpaceOffset -= slot.length;
+        memcpy(packed + freeSpaceOffset, pageBuf + slot.offset, slot.length);
+        slot.offset = freeSpaceOffset;
+        RM_VarSetSlot(fh, pageBuf, i, &slot);
+    }
+    memcpy(pageBuf + freeSpaceOffset, packed + freeSpaceOffset, PF_PAGE_SIZE - freeSpaceOffset);
+    RM_VarSetHeader(fh, pageBuf, numSlots, freeSpaceOffset);
+}
+
+/*
+ * RM_VarPlace
+ * Stores [prefix][data] in slot `slotNum` with the given flags: over
+ * the slot's old bytes if they are big enough, else in the free gap,
+ * compacting the page first if that is the only way to make room.
+ * Returns PFE_OK, or RM_PAGE_FULL with the page unchanged.
+ */
+static int RM_VarPlace(RM_FileHandle *fh, char *pageBuf, int slotNum, int flags,
+                       const void *prefix, int prefixLen, const char *data, int len) {
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    int need = prefixLen + len;
+    int dirEnd;
+
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    RM_VarGetSlot(fh, pageBuf, slotNum, &slot);
+    dirEnd = RM_VarHeaderSize(fh) + numSlots * RM_VarSlotSize(fh);
+
+    if (slot.offset != -1 && slot.length >= need) {
+        // 1. Fits over the old bytes; any tail becomes a hole
+    } else if (freeSpaceOffset - dirEnd >= need) {
+        // 2. Fits in the free gap; the old bytes become a hole
+        freeSpaceOffset -= need;
+        slot.offset = freeSpaceOffset;
+        RM_VarSetHeader(fh, pageBuf, numSlots, freeSpaceOffset);
+    } else {
+        // 3. Only fits once the holes (and the old bytes) are reclaimed
+        if (dirEnd + RM_VarUsedBytes(fh, pageBuf, slotNum) + need > PF_PAGE_SIZE)
+            return RM_PAGE_FULL;
+        RM_VarCompact(fh, pageBuf, slotNum);
+        RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+        freeSpaceOffset -= need;
+        slot.offset = freeSpaceOffset;
+        RM_VarSetHeader(fh, pageBuf, numSlots, freeSpaceOffset);
+    }
+
+    if (prefixLen > 0)
+        memcpy(pageBuf + slot.offset, prefix, prefixLen);
+    memcpy(pageBuf + slot.offset + prefixLen, data, len);
+    slot.length = need;
+    slot.flags = flags;
+    RM_VarSetSlot(fh, pageBuf, slotNum, &slot);
+    return PFE_OK;
+}
+
+/*
+ * =================================================================
+ * Page Operations
+ * =================================================================
+ */
+
+/*
+ * RM_InitPage
+ * Initializes a new, empty page in the file's layout.
+ * The page must already be pinned (fixed) in the buffer.
+ */
+int RM_InitPage(RM_FileHandle *fh, char *pageBuf) {
+
+    if (RM_IsFixed(fh)) {
+        // Empty header and an all-zero presence bitmap
+        memset(pageBuf, 0, RM_FixedDataOffset(fh->hdr.recsPerPage));
+        return PFE_OK;
+    }
+
+    // Set up the header for an empty page: no slots, and free space
+    // starts at the end of the page
+    RM_VarSetHeader(fh, pageBuf, 0, PF_PAGE_SIZE);
+
+    return PFE_OK;
+}
+
+/*
+ * RM_PageHasRoom
+ * Checks whether a record of `record_len` bytes fits on the page.
+ */
+int RM_PageHasRoom(RM_FileHandle *fh, char *pageBuf, int record_len) {
+
+    if (RM_IsFixed(fh)) {
+        RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+        return fixedHeader->numRecs < fh->hdr.recsPerPage;
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    // Free space = (start of record data) - (end of slot directory)
+    int freeSpace = freeSpaceOffset - (RM_VarHeaderSize(fh) + numSlots * RM_VarSlotSize(fh));
+
+    // We need space for the record data + one new slot
+    return freeSpace >= record_len + RM_VarSlotSize(fh);
+}
+
+/*
+ * RM_PageInsert
+ * Places a record on the page and returns its slot number.
+ */
+int RM_PageInsert(RM_FileHandle *fh, char *pageBuf, const char *record_data, int record_len) {
+
+    if (!RM_PageHasRoom(fh, pageBuf, record_len)) {
+        return RM_PAGE_FULL;
+    }
+
+    if (RM_IsFixed(fh)) {
+        RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+        char *bitmap = pageBuf + sizeof(RM_FixedPageHeader);
+        int cap = fh->hdr.recsPerPage;
+        int w, slot = RM_PAGE_FULL;
+
+        // 1. Find the first clear bit, one 64-slot word at a time
+        for (w = 0; w * 64 < cap; w++) {
+            uint64_t word = RM_FixedLoadWord(bitmap, w);
+            if (word != ~(uint64_t)0) {
+                slot = w * 64 + __builtin_ctzll(~word);
+                break;
+            }
+        }
+        if (slot < 0 || slot >= cap)
+            return RM_PAGE_FULL;
+
+        // 2. Copy the record into its computed position (or positions,
+        //    one per minipage) and mark it present
+        if (fh->hdr.pageFormat == RM_FORMAT_PAX)
+            RM_PaxScatter(fh, pageBuf, slot, record_data);
+        else
+            memcpy(pageBuf + RM_FixedDataOffset(cap) + slot * fh->hdr.recordLength,
+                   record_data, record_len);
+        bitmap[slot >> 3] |= (char)(1 << (slot & 7));
+        fixedHeader->numRecs++;
+        return slot;
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    // The record data is written at the *new* start of free space
+    int newFreeSpaceOffset = freeSpaceOffset - record_len;
+    memcpy(pageBuf + newFreeSpaceOffset, record_data, record_len);
+
+    // The new slot goes at the end of the current slot directory
+    slot.offset = newFreeSpaceOffset;
+    slot.length = record_len;
+    slot.flags = 0;
+    RM_VarSetSlot(fh, pageBuf, numSlots, &slot);
+
+    // Update the page header
+    RM_VarSetHeader(fh, pageBuf, numSlots + 1, newFreeSpaceOffset);
+
+    return numSlots; // Slot numbers are 0-indexed
+}
+
+/*
+ * RM_PageGetRec
+ * Finds the record in slot `slotNum` without copying it.
+ */
+int RM_PageGetRec(RM_FileHandle *fh, char *pageBuf, int slotNum, char **record_ptr, int *record_len) {
+
+    if (RM_IsFixed(fh)) {
+        int cap = fh->hdr.recsPerPage;
+
+        if (slotNum < 0 || slotNum >= cap)
+            return RM_INVALID_RID;
+        if (!RM_FixedTestBit(pageBuf + sizeof(RM_FixedPageHeader), slotNum))
+            return RM_RECORD_DELETED;
+
+        // O(1): the position is computed from the slot number
+        if (fh->hdr.pageFormat == RM_FORMAT_PAX) {
+            RM_PaxGather(fh, pageBuf, slotNum, RM_PaxRecord);
+            *record_ptr = RM_PaxRecord;
+        } else {
+            *record_ptr = pageBuf + RM_FixedDataOffset(cap) + slotNum * fh->hdr.recordLength;
+        }
+        *record_len = fh->hdr.recordLength;
+        return PFE_OK;
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    if (slotNum < 0 || slotNum >= numSlots)
+        return RM_INVALID_RID;
+
+    RM_VarGetSlot(fh, pageBuf, slotNum, &slot);
+    if (slot.offset == -1)
+        return RM_RECORD_DELETED;
+
+    *record_ptr = pageBuf + slot.offset;
+    *record_len = slot.length;
+    if (slot.flags == RM_SLOT_OVERFLOW)
+        return RM_REC_OVERFLOW;
+    if (slot.flags == RM_SLOT_FORWARD)
+        return RM_REC_FORWARDED;
+    if (slot.flags == RM_SLOT_MOVED) {
+        // Skip the home RID in front of the data
+        *record_ptr += sizeof(RID);
+        *record_len -= sizeof(RID);
+        return RM_REC_MOVED;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_PageDeleteRec
+ * Frees slot `slotNum`. For slotted pages the slot becomes a tombstone
+ * and its bytes a hole; for fixed pages the slot is simply reusable.
+ * Stubs and moved records are freed like any other slot.
+ */
+int RM_PageDeleteRec(RM_FileHandle *fh, char *pageBuf, int slotNum) {
+    char *record_ptr;
+    int record_len;
+    int err;
+
+    err = RM_PageGetRec(fh, pageBuf, slotNum, &record_ptr, &record_len);
+    if (err < 0)
+        return err;
+
+    if (RM_IsFixed(fh)) {
+        RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+        char *bitmap = pageBuf + sizeof(RM_FixedPageHeader);
+
+        bitmap[slotNum >> 3] &= (char)~(1 << (slotNum & 7));
+        fixedHeader->numRecs--;
+        return PFE_OK;
+    }
+
+    // Mark the slot as deleted (tombstone). We are NOT reclaiming
+    // the data space yet, which leaves a "hole" in the page.
+    RM_SlotInfo slot;
+    slot.offset = -1;
+    slot.length = 0;
+    slot.flags = 0;
+    RM_VarSetSlot(fh, pageBuf, slotNum, &slot);
+    return PFE_OK;
+}
+
+/*
+ * RM_PageNextSlot
+ * Returns the first slot at or after `slotNum` holding record data.
+ */
+int RM_PageNextSlot(RM_FileHandle *fh, char *pageBuf, int slotNum) {
+
+    if (slotNum < 0)
+        slotNum = 0;
+
+    if (RM_IsFixed(fh)) {
+        char *bitmap = pageBuf + sizeof(RM_FixedPageHeader);
+        int cap = fh->hdr.recsPerPage;
+        int w;
+
+        if (slotNum >= cap)
+            return RM_NO_SLOT;
+
+        // Mask off the slots before slotNum in the first word, then
+        // jump straight to set bits: no per-slot branches.
+        w = slotNum / 64;
+        uint64_t word = RM_FixedLoadWord(bitmap, w) & (~(uint64_t)0 << (slotNum % 64));
+        for (;;) {
+            if (word != 0) {
+                int slot = w * 64 + __builtin_ctzll(word);
+                return (slot < cap) ? slot : RM_NO_SLOT;
+            }
+            if (++w * 64 >= cap)
+                return RM_NO_SLOT;
+            word = RM_FixedLoadWord(bitmap, w);
+        }
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+
+    // Stubs are skipped: the record is visited where it was moved to
+    for (; slotNum < numSlots; slotNum++) {
+        RM_VarGetSlot(fh, pageBuf, slotNum, &slot);
+        if (slot.offset != -1 && slot.flags != RM_SLOT_FORWARD)
+            return slotNum;
+    }
+    return RM_NO_SLOT;
+}
+
+/*
+ * RM_PageFreeBytes
+ * Bytes on the page not yet handed out: the gap between the slot
+ * directory and the record data, or the unused fixed-length slots.
+ */
+int RM_PageFreeBytes(RM_FileHandle *fh, char *pageBuf) {
+
+    if (RM_IsFixed(fh)) {
+        RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+        return (fh->hdr.recsPerPage - fixedHeader->numRecs) * fh->hdr.recordLength;
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    return freeSpaceOffset - (RM_VarHeaderSize(fh) + numSlots * RM_VarSlotSize(fh));
+}
+
+/*
+ * RM_PageSlotStats
+ * Adds one slot's contribution to `stats`, or with slotNum -1 the
+ * page's own part (free bytes, and the whole record area as dead bytes
+ * for the slots to take back). Page part plus every slot is the page's
+ * total, so a change to one slot only needs that slot recounted.
+ */
+void RM_PageSlotStats(RM_FileHandle *fh, char *pageBuf, int slotNum, RM_SpaceStats *stats) {
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+
+    if (RM_IsFixed(fh)) {
+        // Deleted fixed-length slots are free again, never dead, and
+        // the header already counts the records
+        if (slotNum < 0) {
+            RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+            stats->freeBytes += RM_PageFreeBytes(fh, pageBuf);
+            stats->numRecs += fixedHeader->numRecs;
+            stats->recordBytes += fixedHeader->numRecs * fh->hdr.recordLength;
+        }
+        return;
+    }
+
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    if (slotNum < 0) {
+        // Whatever in the record area no slot claims as live (holes,
+        // stubs, home RIDs) can only be reclaimed by compaction
+        stats->freeBytes += RM_PageFreeBytes(fh, pageBuf);
+        stats->deadBytes += PF_PAGE_SIZE - freeSpaceOffset;
+        return;
+    }
+    if (slotNum >= numSlots)
+        return;
+    RM_VarGetSlot(fh, pageBuf, slotNum, &slot);
+    if (slot.offset == -1)
+        return;
+
+    // A relocated record counts once: as a record on its home page
+    // (the stub) and as live bytes where its data is. A large record
+    // counts here with all its bytes and overflow pages.
+    if (slot.flags == RM_SLOT_OVERFLOW) {
+        RM_OverflowStub stub;
+        memcpy(&stub, pageBuf + slot.offset, sizeof(RM_OverflowStub));
+        stats->numRecs++;
+        stats->recordBytes += stub.totalLen;
+        stats->overflowPages += stub.numPages;
+    } else if (slot.flags == RM_SLOT_FORWARD) {
+        stats->numRecs++;
+    } else if (slot.flags == RM_SLOT_MOVED) {
+        stats->recordBytes += slot.length - (int)sizeof(RID);
+        stats->deadBytes -= slot.length - (int)sizeof(RID);
+    } else {
+        stats->numRecs++;
+        stats->recordBytes += slot.length;
+        stats->deadBytes -= slot.length;
+    }
+}
+
+/*
+ * RM_PageCollectStats
+ * Adds the page's records, live bytes, dead bytes and free bytes to
+ * `stats` (numPages is left to the caller) by walking every slot. Only
+ * RM_GetSpaceStats' verify mode needs this.
+ */
+void RM_PageCollectStats(RM_FileHandle *fh, char *pageBuf, RM_SpaceStats *stats) {
+    int numSlots, freeSpaceOffset;
+    int i;
+
+    RM_PageSlotStats(fh, pageBuf, -1, stats);
+    if (RM_IsFixed(fh))
+        return;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    for (i = 0; i < numSlots; i++) {
+        RM_PageSlotStats(fh, pageBuf, i, stats);
+    }
+}
+
+/*
+ * RM_PageRoomFor
+ * Checks whether slot `slotNum` can be rewritten to hold `record_len`
+ * bytes, counting its current bytes and every hole as reusable.
+ */
+int RM_PageRoomFor(RM_FileHandle *fh, char *pageBuf, int slotNum, int record_len) {
+
+    if (RM_IsFixed(fh))
+        return record_len == fh->hdr.recordLength;
+
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    RM_VarGetSlot(fh, pageBuf, slotNum, &slot);
+
+    if (slot.flags == RM_SLOT_MOVED)
+        record_len += sizeof(RID);
+    return RM_VarHeaderSize(fh) + numSlots * RM_VarSlotSize(fh) +
+           RM_VarUsedBytes(fh, pageBuf, slotNum) + record_len <= PF_PAGE_SIZE;
+}
+
+/*
+ * RM_PageUpdate
+ * Overwrites the record in slot `slotNum`. A stub (forwarding or
+ * overflow) turns back into an ordinary record; a moved record keeps
+ * its home RID in front.
+ */
+int RM_PageUpdate(RM_FileHandle *fh, char *pageBuf, int slotNum, const char *record_data, int record_len) {
+    char *record_ptr;
+    int old_len;
+    int err;
+
+    err = RM_PageGetRec(fh, pageBuf, slotNum, &record_ptr, &old_len);
+    if (err < 0)
+        return err;
+
+    if (RM_IsFixed(fh)) {
+        if (fh->hdr.pageFormat == RM_FORMAT_PAX)
+            RM_PaxScatter(fh, pageBuf, slotNum, record_data);
+        else
+            memcpy(record_ptr, record_data, record_len);
+        return PFE_OK;
+    }
+
+    if (err == RM_REC_MOVED) {
+        RID home;
+        RM_MovedHomeRID(record_ptr, &home);
+        return RM_VarPlace(fh, pageBuf, slotNum, RM_SLOT_MOVED, &home, sizeof(RID),
+                           record_data, record_len);
+    }
+    return RM_VarPlace(fh, pageBuf, slotNum, 0, NULL, 0, record_data, record_len);
+}
+
+/*
+ * RM_VarOpenSlot
+ * Appends a new, free slot to the directory and returns its number.
+ * The caller has checked RM_PageHasRoom for the bytes it will place.
+ */
+static int RM_VarOpenSlot(RM_FileHandle *fh, char *pageBuf) {
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    RM_VarSetHeader(fh, pageBuf, numSlots + 1, freeSpaceOffset);
+    slot.offset = -1;
+    slot.length = 0;
+    slot.flags = 0;
+    RM_VarSetSlot(fh, pageBuf, numSlots, &slot);
+    return numSlots;
+}
+
+/*
+ * RM_PageInsertMoved
+ * Adds a slot holding a relocated copy of the record whose home is `home`.
+ */
+int RM_PageInsertMoved(RM_FileHandle *fh, char *pageBuf, const RID *home, const char *record_data, int record_len) {
+    int slotNum;
+
+    if (!RM_PageHasRoom(fh, pageBuf, record_len + sizeof(RID)))
+        return RM_PAGE_FULL;
+
+    // Open a new (free) slot, then fill it from the free gap
+    slotNum = RM_VarOpenSlot(fh, pageBuf);
+    RM_VarPlace(fh, pageBuf, slotNum, RM_SLOT_MOVED, home, sizeof(RID), record_data, record_len);
+    return slotNum;
+}
+
+/*
+ * RM_PageInsertOverflow
+ * Adds a slot holding the stub of a large record.
+ */
+int RM_PageInsertOverflow(RM_FileHandle *fh, char *pageBuf, const RM_OverflowStub *stub) {
+    int slotNum;
+
+    if (!RM_PageHasRoom(fh, pageBuf, sizeof(RM_OverflowStub)))
+        return RM_PAGE_FULL;
+
+    slotNum = RM_VarOpenSlot(fh, pageBuf);
+    RM_VarPlace(fh, pageBuf, slotNum, RM_SLOT_OVERFLOW, NULL, 0,
+                (const char *)stub, sizeof(RM_OverflowStub));
+    return slotNum;
+}
+
+/*
+ * RM_PageSetOverflow
+ * Replaces the record in slot `slotNum` with the stub of a large record.
+ */
+int RM_PageSetOverflow(RM_FileHandle *fh, char *pageBuf, int slotNum, const RM_OverflowStub *stub) {
+    return RM_VarPlace(fh, pageBuf, slotNum, RM_SLOT_OVERFLOW, NULL, 0,
+                       (const char *)stub, sizeof(RM_OverflowStub));
+}
+
+/*
+ * RM_PageSetForward
+ * Replaces the record in slot `slotNum` with a stub holding `target`.
+ */
+int RM_PageSetForward(RM_FileHandle *fh, char *pageBuf, int slotNum, const RID *target) {
+    return RM_VarPlace(fh, pageBuf, slotNum, RM_SLOT_FORWARD, NULL, 0,
+                       (const char *)target, sizeof(RID));
+}
+
+/*
+ * RM_PageCompact
+ * Reclaims every hole on a slotted page and drops trailing free slots
+ * (no RID refers to them). Fixed-length pages never have holes.
+ */
+void RM_PageCompact(RM_FileHandle *fh, char *pageBuf) {
+    int numSlots, freeSpaceOffset;
+    RM_SlotInfo slot;
+
+    if (RM_IsFixed(fh))
+        return;
+
+    RM_VarCompact(fh, pageBuf, RM_NO_SLOT);
+
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    while (numSlots > 0) {
+        RM_VarGetSlot(fh, pageBuf, numSlots - 1, &slot);
+        if (slot.offset != -1)
+            break;
+        numSlots--;
+    }
+    RM_VarSetHeader(fh, pageBuf, numSlots, freeSpaceOffset);
+}
+
+/*
+ * RM_PageIsEmpty
+ * A page is empty once it has no live records, stubs or moved records;
+ * for slotted pages that means RM_PageCompact trimmed every slot.
+ */
+int RM_PageIsEmpty(RM_FileHandle *fh, char *pageBuf) {
+
+    if (RM_IsFixed(fh)) {
+        RM_FixedPageHeader *fixedHeader = (RM_FixedPageHeader *)pageBuf;
+        return fixedHeader->numRecs == 0;
+    }
+
+    int numSlots, freeSpaceOffset;
+    RM_VarGetHeader(fh, pageBuf, &numSlots, &freeSpaceOffset);
+    return numSlots == 0;
+}
@@ -0,0 +1,208 @@
+/* rmpscan.c: Parallel (morsel-driven) heap scan for the RM Layer */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "rm_internal.h"
+
+/*
+ * =================================================================
+ * Parallel Scan State
+ * =================================================================
+ */
+
+/*
+ * The PF layer keeps one global buffer pool and is not thread-safe,
+ * so workers take the PF pool latch (shared with other scans and the
+ * AM layer) only around PF_GetThisPage/PF_UnfixPage and copy the page
+ * out. All per-record work (the callback) then runs on the private
+ * copy without holding the latch.
+ */
+typedef struct {
+    RM_FileHandle *fh;
+    RM_ScanCallback fn;
+    int numPages;               /* Pages in the file when the scan started */
+    atomic_int nextPage;        /* Next unclaimed page number */
+    atomic_int stop;            /* Set when any worker fails */
+} RM_PScanShared;
+
+typedef struct {
+    RM_PScanShared *shared;
+    void *arg;                  /* Per-thread callback argument */
+    int result;                 /* PFE_OK or the first error seen */
+    pthread_t tid;
+} RM_PScanWorker;
+
+/*
+ * RM_PScanFetchPage
+ * Copies page `pageNum` into `pageCopy` through the buffer pool.
+ */
+static int RM_PScanFetchPage(RM_PScanShared *shared, int pageNum, char *pageCopy) {
+    int pf_err;
+    char *pageBuf;
+
+    PF_LatchPool();
+    pf_err = PF_GetThisPage(shared->fh->pf_fd, pageNum, &pageBuf);
+    if (pf_err == PFE_OK) {
+        memcpy(pageCopy, pageBuf, PF_PAGE_SIZE);
+        pf_err = PF_UnfixPage(shared->fh->pf_fd, pageNum, FALSE);
+    }
+    PF_UnlatchPool();
+
+    return pf_err;
+}
+
+/*
+ * RM_PScanFetchLarge
+ * Reads a large record out of its overflow extent into a new buffer,
+ * which the caller frees.
+ */
+static int RM_PScanFetchLarge(RM_PScanShared *shared, const char *stubPtr, char **record, int *record_len) {
+    RM_OverflowStub stub;
+    int pf_err;
+
+    memcpy(&stub, stubPtr, sizeof(RM_OverflowStub));
+    *record_len = stub.totalLen;
+    *record = malloc(stub.totalLen > 0 ? stub.totalLen : 1);
+    if (*record == NULL)
+        return RM_NOMEM;
+
+    PF_LatchPool();
+    pf_err = RM_OverflowRead(shared->fh, &stub, 0, *record, stub.totalLen);
+    PF_UnlatchPool();
+
+    if (pf_err != PFE_OK) {
+        free(*record);
+        *record = NULL;
+    }
+    return pf_err;
+}
+
+/*
+ * RM_PScanPage
+ * Hands every valid record on a (private) page copy to the callback.
+ */
+static int RM_PScanPage(RM_PScanWorker *w, int pageNum, char *pageBuf) {
+    RM_FileHandle *fh = w->shared->fh;
+    char *record_ptr;
+    char *large;
+    int record_len;
+    RID rid;
+    int slotNum, status, err;
+
+    for (slotNum = RM_PageNextSlot(fh, pageBuf, 0); slotNum != RM_NO_SLOT;
+         slotNum = RM_PageNextSlot(fh, pageBuf, slotNum + 1)) {
+        rid.pageNum = pageNum;
+        rid.slotNum = slotNum;
+        status = RM_PageGetRec(fh, pageBuf, slotNum, &record_ptr, &record_len);
+        if (status == RM_REC_MOVED)
+            RM_MovedHomeRID(record_ptr, &rid); // Report it under its home RID
+        if (status == RM_REC_OVERFLOW) {
+            err = RM_PScanFetchLarge(w->shared, record_ptr, &large, &record_len);
+            if (err != PFE_OK)
+                return err;
+            err = w->shared->fn(w->arg, large, record_len, &rid);
+            free(large);
+        } else {
+            err = w->shared->fn(w->arg, record_ptr, record_len, &rid);
+        }
+        if (err != PFE_OK)
+            return err;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_PScanWorkerMain
+ * Claims morsels of RM_PSCAN_MORSEL pages until the file is exhausted.
+ */
+static void *RM_PScanWorkerMain(void *p) {
+    RM_PScanWorker *w = (RM_PScanWorker *)p;
+    RM_PScanShared *shared = w->shared;
+    char pageCopy[PF_PAGE_SIZE];
+    int first, last, pageNum, err;
+
+    w->result = PFE_OK;
+    while (!atomic_load(&shared->stop)) {
+        // 1. Claim the next morsel
+        first = atomic_fetch_add(&shared->nextPage, RM_PSCAN_MORSEL);
+        if (first >= shared->numPages)
+            break;
+        last = first + RM_PSCAN_MORSEL;
+        if (last > shared->numPages)
+            last = shared->numPages;
+
+        // 2. Process its pages one at a time, skipping pages the
+        //    page directory does not list without touching them
+        for (pageNum = first; pageNum < last; pageNum++) {
+            if (!RM_DirTest(shared->fh, pageNum))
+                continue;
+            err = RM_PScanFetchPage(shared, pageNum, pageCopy);
+            if (err == PFE_OK)
+                err = RM_PScanPage(w, pageNum, pageCopy);
+            if (err != PFE_OK) {
+                w->result = err;
+                atomic_store(&shared->stop, TRUE);
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * =================================================================
+ * Public Entry Point
+ * =================================================================
+ */
+
+/*
+ * RM_ParallelScan
+ * Runs `numThreads` workers over the file and waits for all of them.
+ * Returns PFE_OK, or the first error reported by a worker.
+ */
+int RM_ParallelScan(RM_FileHandle *fh, int numThreads, RM_ScanCallback fn, void **args) {
+    RM_PScanShared shared;
+    RM_PScanWorker workers[RM_PSCAN_MAXTHREADS];
+    int pf_err;
+    int started, i;
+    int result = PFE_OK;
+
+    if (fn == NULL || numThreads < 1 || numThreads > RM_PSCAN_MAXTHREADS) {
+        return RM_INVALID_ARG;
+    }
+
+    // 1. Snapshot the page range to divide up
+    pf_err = PF_GetNumPages(fh->pf_fd, &shared.numPages);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    shared.fh = fh;
+    shared.fn = fn;
+    atomic_init(&shared.nextPage, RM_HDR_PAGE + 1); // Skip the header page
+    atomic_init(&shared.stop, FALSE);
+
+    // 2. Start the workers
+    for (started = 0; started < numThreads; started++) {
+        workers[started].shared = &shared;
+        workers[started].arg = (args != NULL) ? args[started] : NULL;
+        workers[started].result = PFE_OK;
+        if (pthread_create(&workers[started].tid, NULL, RM_PScanWorkerMain,
+                           &workers[started]) != 0) {
+            atomic_store(&shared.stop, TRUE);
+            result = RM_THREAD_ERROR;
+            break;
+        }
+    }
+
+    // 3. Wait for them and collect the first error
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].tid, NULL);
+        if (result == PFE_OK && workers[i].result != PFE_OK)
+            result = workers[i].result;
+    }
+
+    return result;
+}
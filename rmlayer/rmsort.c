@@ -0,0 +1,745 @@
+/* rmsort.c: External merge sort over RM files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rm_internal.h"
+
+/*
+ * The sort works in three steps:
+ *
+ *   1. Run generation: records are read with a scan and packed into a
+ *      buffer of memPages pages. When it is full, an array of record
+ *      offsets is sorted with the caller's comparator (the records
+ *      themselves never move) and written out as a run.
+ *   2. Merge passes: while there are more runs than memPages - 1,
+ *      groups of that many runs are merged into longer runs.
+ *   3. Final merge: RM_SortGetNext pops records from a loser tree over
+ *      the remaining runs.
+ *
+ * All runs of one pass live in a single temporary PF file (the PF file
+ * table is small), each as a range of consecutive pages.
+ */
+
+/* Run boundaries within a temporary file */
+typedef struct {
+    int firstPage;
+    int endPage;
+} RM_SortRunDesc;
+
+/* Appends records to runs in a temporary file */
+typedef struct {
+    int fd;              /* Temporary PF file */
+    int pageNum;         /* Page being filled */
+    char *pageBuf;       /* Its (fixed) buffer, or NULL */
+    int pos;             /* Next free byte on it */
+    int runStart;        /* First page of the current run, or -1 */
+    RM_SortRunDesc *runs;
+    int numRuns;
+    int maxRuns;
+    long pagesWritten;
+} RM_SortWriter;
+
+/* Used to give every temporary file a distinct name */
+static int RM_SortSeq = 0;
+
+static void RM_SortTempName(char *fname) {
+    sprintf(fname, "rmsort.%d.%d.tmp", (int)getpid(), RM_SortSeq++);
+}
+
+/*
+ * =================================================================
+ * Run Writer
+ * =================================================================
+ */
+
+static int RM_SortWriterOpen(RM_SortWriter *w, char *fname) {
+    int pf_err;
+
+    w->fd = -1;
+    RM_SortTempName(fname);
+    PF_DestroyFile(fname); // Left over from a crashed sort
+    pf_err = PF_CreateFile(fname);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    w->fd = PF_OpenFile(fname);
+    if (w->fd < 0) {
+        pf_err = w->fd;
+        w->fd = -1;
+        PF_DestroyFile(fname);
+        return pf_err;
+    }
+    w->pageBuf = NULL;
+    w->runStart = -1;
+    w->runs = NULL;
+    w->numRuns = 0;
+    w->maxRuns = 0;
+    w->pagesWritten = 0;
+    return PFE_OK;
+}
+
+/* Unfixes the page being filled */
+static int RM_SortWriterFlush(RM_SortWriter *w) {
+    int pf_err;
+
+    if (w->pageBuf == NULL) {
+        return PFE_OK;
+    }
+    pf_err = PF_UnfixPage(w->fd, w->pageNum, TRUE);
+    w->pageBuf = NULL;
+    w->pagesWritten++;
+    return pf_err;
+}
+
+/* Starts a new page of the current run */
+static int RM_SortWriterNewPage(RM_SortWriter *w) {
+    int pf_err;
+
+    pf_err = RM_SortWriterFlush(w);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    pf_err = PF_AllocPage(w->fd, &w->pageNum, &w->pageBuf);
+    if (pf_err != PFE_OK) {
+        w->pageBuf = NULL;
+        return pf_err;
+    }
+    ((RM_SortRunPage *)w->pageBuf)->numBytes = 0;
+    w->pos = sizeof(RM_SortRunPage);
+    if (w->runStart < 0) {
+        w->runStart = w->pageNum;
+    }
+    return PFE_OK;
+}
+
+/* Copies n bytes to the run at the current position of the page */
+static void RM_SortWriterCopy(RM_SortWriter *w, const void *src, int n) {
+    memcpy(w->pageBuf + w->pos, src, n);
+    w->pos += n;
+    ((RM_SortRunPage *)w->pageBuf)->numBytes += n;
+}
+
+static int RM_SortWriterPut(RM_SortWriter *w, const char *rec, int len) {
+    int pf_err, n;
+
+    // 1. Start a new page when the length word does not fit on this
+    //    one, or the record does not but would fit on a fresh page
+    if (w->pageBuf == NULL || w->pos + (int)sizeof(int) > PF_PAGE_SIZE ||
+        (w->pos + (int)sizeof(int) + len > PF_PAGE_SIZE &&
+         (int)sizeof(int) + len <= RM_SORT_PAGEDATA)) {
+        pf_err = RM_SortWriterNewPage(w);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+
+    // 2. Append [length][bytes], carrying the bytes over to new pages
+    //    as each one fills up
+    RM_SortWriterCopy(w, &len, sizeof(int));
+    while (len > 0) {
+        if (w->pos == PF_PAGE_SIZE) {
+            pf_err = RM_SortWriterNewPage(w);
+            if (pf_err != PFE_OK) {
+                return pf_err;
+            }
+        }
+        n = (len < PF_PAGE_SIZE - w->pos) ? len : PF_PAGE_SIZE - w->pos;
+        RM_SortWriterCopy(w, rec, n);
+        rec += n;
+        len -= n;
+    }
+    return PFE_OK;
+}
+
+/* Ends the current run: the next record starts a new page */
+static int RM_SortWriterEndRun(RM_SortWriter *w) {
+    int pf_err;
+
+    if (w->runStart < 0) {
+        return PFE_OK; // Empty run
+    }
+    if (w->numRuns == w->maxRuns) {
+        RM_SortRunDesc *grown;
+        w->maxRuns = w->maxRuns ? w->maxRuns * 2 : 16;
+        grown = realloc(w->runs, w->maxRuns * sizeof(RM_SortRunDesc));
+        if (grown == NULL) {
+            return RM_NOMEM;
+        }
+        w->runs = grown;
+    }
+    w->runs[w->numRuns].firstPage = w->runStart;
+    w->runs[w->numRuns].endPage = w->pageNum + 1;
+    w->numRuns++;
+    w->runStart = -1;
+
+    pf_err = RM_SortWriterFlush(w);
+    return pf_err;
+}
+
+/*
+ * =================================================================
+ * Run Cursors and the Loser Tree
+ * =================================================================
+ */
+
+static void RM_SortRunInit(struct RM_SortRun *r, const RM_SortRunDesc *desc) {
+    r->firstPage = desc->firstPage;
+    r->endPage = desc->endPage;
+    r->nextPage = desc->firstPage;
+    r->pos = 0;
+    r->end = 0;
+    r->rec = NULL;
+}
+
+/* Copies the run's next page into the cursor */
+static int RM_SortRunLoad(int fd, struct RM_SortRun *r) {
+    int pf_err;
+    char *pageBuf;
+
+    pf_err = PF_GetThisPage(fd, r->nextPage, &pageBuf);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    memcpy(r->page, pageBuf, PF_PAGE_SIZE);
+    pf_err = PF_UnfixPage(fd, r->nextPage, FALSE);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+    r->nextPage++;
+    r->pos = sizeof(RM_SortRunPage);
+    r->end = r->pos + ((RM_SortRunPage *)r->page)->numBytes;
+    return PFE_OK;
+}
+
+/* Moves the cursor to the run's next record (rec = NULL at the end) */
+static int RM_SortRunAdvance(int fd, struct RM_SortRun *r) {
+    int pf_err;
+    int got, n;
+    char *grown;
+
+    // 1. Move to the next page once this one is used up
+    if (r->pos == r->end) {
+        if (r->nextPage == r->endPage) {
+            r->rec = NULL;
+            return PFE_OK;
+        }
+        pf_err = RM_SortRunLoad(fd, r);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    memcpy(&r->len, r->page + r->pos, sizeof(int));
+    r->pos += sizeof(int);
+
+    // 2. A record that ends on this page is used where it is
+    if (r->pos + r->len <= r->end) {
+        r->rec = r->page + r->pos;
+        r->pos += r->len;
+        return PFE_OK;
+    }
+
+    // 3. One that carries on over the next pages is put together in big
+    if (r->len > r->bigLen) {
+        grown = realloc(r->big, r->len);
+        if (grown == NULL) {
+            return RM_NOMEM;
+        }
+        r->big = grown;
+        r->bigLen = r->len;
+    }
+    for (got = 0; ; ) {
+        n = (r->end - r->pos < r->len - got) ? r->end - r->pos : r->len - got;
+        memcpy(r->big + got, r->page + r->pos, n);
+        got += n;
+        r->pos += n;
+        if (got == r->len) {
+            break;
+        }
+        if (r->nextPage == r->endPage) {
+            return RM_INVALID_RECLEN; // The run ends inside the record
+        }
+        pf_err = RM_SortRunLoad(fd, r);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    r->rec = r->big;
+    return PFE_OK;
+}
+
+/* TRUE if run a's current record comes first; ties go to the lower run */
+static int RM_SortRunLess(RM_SortCmp cmp, void *cmpArg, struct RM_SortRun *runs, int a, int b) {
+    int c;
+
+    if (runs[a].rec == NULL)
+        return FALSE;
+    if (runs[b].rec == NULL)
+        return TRUE;
+    c = cmp(cmpArg, runs[a].rec, runs[a].len, runs[b].rec, runs[b].len);
+    return (c != 0) ? (c < 0) : (a < b);
+}
+
+/*
+ * RM_SortTreeBuild
+ * Leaves k..2k-1 stand for runs 0..k-1; internal node i keeps the loser
+ * of the match between its children and tree[0] the overall winner.
+ */
+static int RM_SortTreeBuild(RM_SortCmp cmp, void *cmpArg, struct RM_SortRun *runs, int k, int *tree) {
+    int *winner;
+    int i, l, r;
+
+    if (k == 1) {
+        tree[0] = 0;
+        return PFE_OK;
+    }
+    winner = malloc(2 * k * sizeof(int));
+    if (winner == NULL) {
+        return RM_NOMEM;
+    }
+    for (i = 0; i < k; i++)
+        winner[k + i] = i;
+    for (i = k - 1; i >= 1; i--) {
+        l = winner[2 * i];
+        r = winner[2 * i + 1];
+        if (RM_SortRunLess(cmp, cmpArg, runs, l, r)) {
+            winner[i] = l;
+            tree[i] = r;
+        } else {
+            winner[i] = r;
+            tree[i] = l;
+        }
+    }
+    tree[0] = winner[1];
+    free(winner);
+    return PFE_OK;
+}
+
+/* After the winner's run advanced, replays its path to the root */
+static void RM_SortTreeReplay(RM_SortCmp cmp, void *cmpArg, struct RM_SortRun *runs, int k, int *tree) {
+    int w = tree[0];
+    int node, t;
+
+    for (node = (w + k) / 2; node >= 1; node /= 2) {
+        if (RM_SortRunLess(cmp, cmpArg, runs, tree[node], w)) {
+            t = tree[node];
+            tree[node] = w;
+            w = t;
+        }
+    }
+    tree[0] = w;
+}
+
+/* Positions cursors on runs[0..k) and builds the tree over them */
+static int RM_SortMergeStart(RM_SortCmp cmp, void *cmpArg, int fd, const RM_SortRunDesc *descs,
+                             struct RM_SortRun *runs, int k, int *tree) {
+    int i, pf_err;
+
+    for (i = 0; i < k; i++) {
+        RM_SortRunInit(&runs[i], &descs[i]);
+        pf_err = RM_SortRunAdvance(fd, &runs[i]);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    return RM_SortTreeBuild(cmp, cmpArg, runs, k, tree);
+}
+
+/*
+ * =================================================================
+ * Run Generation and Merge Passes
+ * =================================================================
+ */
+
+/* Stable bottom-up merge sort of record offsets into area */
+static void RM_SortOffsets(RM_SortHandle *sh, int *a, int *tmp, int n) {
+    int width, lo, mid, hi, i, j, k;
+    int *src = a, *dst = tmp, *t;
+    int la, lb;
+
+    for (width = 1; width < n; width *= 2) {
+        for (lo = 0; lo < n; lo += 2 * width) {
+            mid = (lo + width < n) ? lo + width : n;
+            hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            i = lo;
+            j = mid;
+            for (k = lo; k < hi; k++) {
+                if (i < mid && j < hi) {
+                    memcpy(&la, sh->area + src[i], sizeof(int));
+                    memcpy(&lb, sh->area + src[j], sizeof(int));
+                    if (sh->cmp(sh->cmpArg, sh->area + src[j] + sizeof(int), lb,
+                                sh->area + src[i] + sizeof(int), la) < 0)
+                        dst[k] = src[j++];
+                    else
+                        dst[k] = src[i++];
+                } else {
+                    dst[k] = (i < mid) ? src[i++] : src[j++];
+                }
+            }
+        }
+        t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != a)
+        memcpy(a, src, n * sizeof(int));
+}
+
+/* Sorts the buffered records and writes them out as one run */
+static int RM_SortSpill(RM_SortHandle *sh, RM_SortWriter *w, int *scratch, int n) {
+    int i, len, pf_err;
+
+    RM_SortOffsets(sh, sh->offsets, scratch, n);
+    for (i = 0; i < n; i++) {
+        memcpy(&len, sh->area + sh->offsets[i], sizeof(int));
+        pf_err = RM_SortWriterPut(w, sh->area + sh->offsets[i] + sizeof(int), len);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    return RM_SortWriterEndRun(w);
+}
+
+/* Opens the run file the first time the buffer has to be spilled */
+static int RM_SortStartSpill(RM_SortHandle *sh, RM_SortWriter *w, int *spilled) {
+    int err;
+
+    if (*spilled) {
+        return PFE_OK;
+    }
+    err = RM_SortWriterOpen(w, sh->runFile);
+    if (err != PFE_OK) {
+        return err;
+    }
+    sh->runFd = w->fd;
+    *spilled = TRUE;
+    return PFE_OK;
+}
+
+/*
+ * RM_SortGenerateRuns
+ * Fills the buffer from a scan of fh. If every record fits, they stay
+ * in memory (sh->memRecs); otherwise each full buffer becomes a run,
+ * and a record too long for the buffer on its own is a run by itself.
+ */
+static int RM_SortGenerateRuns(RM_SortHandle *sh, RM_FileHandle *fh, RM_SortWriter *w, int *spilled) {
+    RM_ScanHandle scan;
+    RID rid;
+    char *record, *grown;
+    int recMax = PF_PAGE_SIZE;
+    int budget = sh->memPages * PF_PAGE_SIZE;
+    int used = 0, n = 0, len, big;
+    int *scratch;
+    int err;
+
+    // Each record costs its bytes, a length word, an offset and a
+    // scratch offset for the merge sort
+    sh->offsets = malloc((budget / (3 * sizeof(int)) + 1) * sizeof(int));
+    scratch = malloc((budget / (3 * sizeof(int)) + 1) * sizeof(int));
+    record = malloc(recMax);
+    if (sh->offsets == NULL || scratch == NULL || record == NULL) {
+        free(scratch);
+        free(record);
+        return RM_NOMEM;
+    }
+
+    *spilled = FALSE;
+    RM_ScanOpen(fh, &scan);
+    while ((err = RM_ScanNext(&scan, record, recMax, &len, &rid)) != RM_EOF) {
+        // 1. A record longer than the read buffer: grow it, read again
+        if (err == RM_INVALID_RECLEN && len > recMax) {
+            grown = realloc(record, len);
+            if (grown == NULL) {
+                err = RM_NOMEM;
+                break;
+            }
+            record = grown;
+            recMax = len;
+            continue;
+        }
+        if (err != PFE_OK) {
+            break;
+        }
+        if (len > sh->maxRecLen) {
+            sh->maxRecLen = len;
+        }
+
+        // 2. Buffer full, or the record needs all of it: spill a run
+        big = (len + 3 * (int)sizeof(int) > budget);
+        if (big || used + len + (n + 1) * 3 * (int)sizeof(int) > budget) {
+            err = RM_SortStartSpill(sh, w, spilled);
+            if (err == PFE_OK) {
+                err = RM_SortSpill(sh, w, scratch, n);
+            }
+            if (err != PFE_OK) {
+                break;
+            }
+            used = 0;
+            n = 0;
+        }
+
+        // 3. A record longer than the whole buffer is a run by itself
+        if (big) {
+            err = RM_SortWriterPut(w, record, len);
+            if (err == PFE_OK) {
+                err = RM_SortWriterEndRun(w);
+            }
+            if (err != PFE_OK) {
+                break;
+            }
+            continue;
+        }
+        memcpy(sh->area + used, &len, sizeof(int));
+        memcpy(sh->area + used + sizeof(int), record, len);
+        sh->offsets[n++] = used;
+        used += sizeof(int) + len;
+    }
+    RM_ScanClose(&scan);
+    free(record);
+    if (err == RM_EOF) {
+        err = PFE_OK;
+    }
+
+    // The last buffer load: a final run, or the whole input
+    if (err == PFE_OK) {
+        if (*spilled) {
+            err = RM_SortSpill(sh, w, scratch, n);
+        } else {
+            RM_SortOffsets(sh, sh->offsets, scratch, n);
+            sh->memRecs = n;
+        }
+    }
+    free(scratch);
+    return err;
+}
+
+/* Merges groups of fanIn runs of `in` into longer runs in a new file */
+static int RM_SortMergePass(RM_SortHandle *sh, RM_SortWriter *in, int fanIn, RM_SortWriter *out, char *outFile) {
+    int g, k, pf_err, w;
+
+    pf_err = RM_SortWriterOpen(out, outFile);
+    if (pf_err != PFE_OK) {
+        return pf_err;
+    }
+
+    for (g = 0; g < in->numRuns; g += fanIn) {
+        k = (in->numRuns - g < fanIn) ? in->numRuns - g : fanIn;
+        pf_err = RM_SortMergeStart(sh->cmp, sh->cmpArg, in->fd, &in->runs[g], sh->runs, k, sh->tree);
+        while (pf_err == PFE_OK && sh->runs[sh->tree[0]].rec != NULL) {
+            w = sh->tree[0];
+            pf_err = RM_SortWriterPut(out, sh->runs[w].rec, sh->runs[w].len);
+            if (pf_err == PFE_OK)
+                pf_err = RM_SortRunAdvance(in->fd, &sh->runs[w]);
+            RM_SortTreeReplay(sh->cmp, sh->cmpArg, sh->runs, k, sh->tree);
+        }
+        if (pf_err == PFE_OK)
+            pf_err = RM_SortWriterEndRun(out);
+        if (pf_err != PFE_OK) {
+            return pf_err;
+        }
+    }
+    return PFE_OK;
+}
+
+/*
+ * =================================================================
+ * Public Sort Functions
+ * =================================================================
+ */
+
+/*
+ * RM_SortOpen
+ * Generates the runs, merges them down to at most memPages - 1, and
+ * sets up the final merge.
+ */
+int RM_SortOpen(RM_FileHandle *fh, RM_SortCmp cmp, void *cmpArg, int memPages, RM_SortHandle *sh) {
+    RM_SortWriter cur, next;
+    char nextFile[64];
+    int fanIn = memPages - 1;
+    int spilled, err;
+
+    memset(sh, 0, sizeof(RM_SortHandle));
+    sh->runFd = -1;
+    if (cmp == NULL || memPages < RM_SORT_MINPAGES) {
+        return RM_INVALID_ARG;
+    }
+    sh->cmp = cmp;
+    sh->cmpArg = cmpArg;
+    sh->memPages = memPages;
+
+    // 1. Run generation
+    sh->area = malloc(memPages * PF_PAGE_SIZE);
+    if (sh->area == NULL) {
+        return RM_NOMEM;
+    }
+    err = RM_SortGenerateRuns(sh, fh, &cur, &spilled);
+    if (spilled) {
+        int flush_err = RM_SortWriterFlush(&cur);
+        if (err == PFE_OK)
+            err = flush_err;
+    }
+    if (err != PFE_OK || !spilled) {
+        if (spilled)
+            free(cur.runs);
+        if (err != PFE_OK)
+            RM_SortClose(sh);
+        return err; // In memory: RM_SortGetNext walks sh->offsets
+    }
+
+    // The run buffer is no longer needed: the merge uses one page per run
+    free(sh->area);
+    free(sh->offsets);
+    sh->area = NULL;
+    sh->offsets = NULL;
+    sh->numSpilled = cur.pagesWritten;
+
+    sh->runs = calloc(fanIn, sizeof(struct RM_SortRun)); // No big buffers yet
+    sh->tree = malloc(fanIn * sizeof(int));
+    if (sh->runs == NULL || sh->tree == NULL) {
+        free(cur.runs);
+        RM_SortClose(sh);
+        return RM_NOMEM;
+    }
+
+    // 2. Merge passes until the final merge fits in the budget
+    while (cur.numRuns > fanIn) {
+        err = RM_SortMergePass(sh, &cur, fanIn, &next, nextFile);
+        if (err != PFE_OK && next.fd < 0) {
+            free(cur.runs);
+            RM_SortClose(sh);
+            return err; // The new run file could not be created
+        }
+        int flush_err = RM_SortWriterFlush(&next);
+        if (err == PFE_OK)
+            err = flush_err;
+        free(cur.runs);
+        PF_CloseFile(cur.fd);
+        PF_DestroyFile(sh->runFile);
+        sh->runFd = next.fd;
+        strcpy(sh->runFile, nextFile);
+        cur = next;
+        if (err != PFE_OK) {
+            free(cur.runs);
+            RM_SortClose(sh);
+            return err;
+        }
+        sh->numSpilled += cur.pagesWritten;
+        sh->numPasses++;
+    }
+
+    // 3. Position the final merge
+    sh->numRuns = cur.numRuns;
+    err = RM_SortMergeStart(cmp, cmpArg, cur.fd, cur.runs, sh->runs, cur.numRuns, sh->tree);
+    free(cur.runs);
+    if (err != PFE_OK) {
+        RM_SortClose(sh);
+    }
+    return err;
+}
+
+/*
+ * RM_SortGetNext
+ * Returns the next record of the sort.
+ */
+int RM_SortGetNext(RM_SortHandle *sh, char *record_data, int *record_len) {
+    struct RM_SortRun *r;
+    int err;
+
+    // 1. The input fit in memory: walk the sorted offsets
+    if (sh->runFd < 0) {
+        if (sh->memNext >= sh->memRecs) {
+            return RM_EOF;
+        }
+        int off = sh->offsets[sh->memNext++];
+        memcpy(record_len, sh->area + off, sizeof(int));
+        memcpy(record_data, sh->area + off + sizeof(int), *record_len);
+        return PFE_OK;
+    }
+
+    // 2. Otherwise pop the loser tree's winner and refill from its run
+    if (sh->numRuns == 0) {
+        return RM_EOF;
+    }
+    r = &sh->runs[sh->tree[0]];
+    if (r->rec == NULL) {
+        return RM_EOF;
+    }
+    memcpy(record_data, r->rec, r->len);
+    *record_len = r->len;
+
+    err = RM_SortRunAdvance(sh->runFd, r);
+    RM_SortTreeReplay(sh->cmp, sh->cmpArg, sh->runs, sh->numRuns, sh->tree);
+    return err;
+}
+
+/*
+ * RM_SortClose
+ * Frees the buffers and removes the temporary run file.
+ */
+int RM_SortClose(RM_SortHandle *sh) {
+    int i;
+
+    for (i = 0; sh->runs != NULL && i < sh->memPages - 1; i++)
+        free(sh->runs[i].big);
+    free(sh->area);
+    free(sh->offsets);
+    free(sh->runs);
+    free(sh->tree);
+    sh->area = NULL;
+    sh->offsets = NULL;
+    sh->runs = NULL;
+    sh->tree = NULL;
+
+    if (sh->runFd >= 0) {
+        PF_CloseFile(sh->runFd);
+        PF_DestroyFile(sh->runFile);
+        sh->runFd = -1;
+    }
+    return PFE_OK;
+}
+
+/*
+ * RM_SortFile
+ * Writes the sorted records of fh into a new RM file, in order. The
+ * new file gets fh's page format and schema.
+ */
+int RM_SortFile(RM_FileHandle *fh, RM_SortCmp cmp, void *cmpArg, int memPages, char *outFname) {
+    RM_SortHandle sh;
+    RM_FileHandle out;
+    RID rid;
+    char *record;
+    int len, err, close_err;
+
+    if (fh->hdr.numAttrs > 0) {
+        err = RM_CreateFileSchema(outFname, fh->hdr.pageFormat, fh->hdr.attrs, fh->hdr.numAttrs);
+    } else {
+        err = RM_CreateFileFormat(outFname, fh->hdr.pageFormat, fh->hdr.recordLength);
+    }
+    if (err != PFE_OK) {
+        return err;
+    }
+    err = RM_OpenFileFlags(outFname, &out, RM_OPEN_APPEND); // Keeps sorted order
+    if (err != PFE_OK) {
+        return err;
+    }
+
+    err = RM_SortOpen(fh, cmp, cmpArg, memPages, &sh);
+    if (err == PFE_OK) {
+        record = malloc(sh.maxRecLen > 0 ? sh.maxRecLen : 1);
+        if (record == NULL) {
+            err = RM_NOMEM;
+        }
+        while (err == PFE_OK && (err = RM_SortGetNext(&sh, record, &len)) == PFE_OK) {
+            err = RM_InsertRec(&out, record, len, &rid);
+        }
+        if (err == RM_EOF) {
+            err = PFE_OK;
+        }
+        free(record);
+        RM_SortClose(&sh);
+    }
+
+    close_err = RM_CloseFile(&out);
+    return (err != PFE_OK) ? err : close_err;
+}
@@ -0,0 +1,357 @@
+/* test_agg.c: Benchmark for RM_Aggregate and RM_GroupBy against per-record aggregation */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define ROW_FILE "agg_file.db"
+#define PAX_FILE "agg_pax.db"
+#define NUM_RECORDS 400000
+#define NUM_REGIONS 100
+#define NUM_STORES 50000
+#define NUM_TAGS 20
+#define REPEAT 3
+
+/* Layout: region i32, store i32, tag char(8), amount f64, qty f32, ts i64 = 36 bytes */
+static RM_Attr layout[] = {
+    {RM_TYPE_INT32, 0}, {RM_TYPE_INT32, 0}, {RM_TYPE_CHAR, 8},
+    {RM_TYPE_DOUBLE, 0}, {RM_TYPE_FLOAT, 0}, {RM_TYPE_INT64, 0}};
+#define NUM_ATTRS 6
+#define RECORD_LEN 36
+enum { A_REGION, A_STORE, A_TAG, A_AMOUNT, A_QTY, A_TS };
+
+typedef struct {
+    int32_t region, store;
+    char tag[8];
+    double amount;
+    float qty;
+    int64_t ts;
+} Row;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_row(int i, Row *r) {
+    unsigned h = (unsigned)i * 2654435761u;
+    r->region = h % NUM_REGIONS;
+    r->store = (h >> 7) % NUM_STORES;
+    memset(r->tag, 0, sizeof(r->tag));
+    sprintf(r->tag, "cat%d", (h >> 3) % NUM_TAGS);
+    r->amount = (h % 100000) / 100.0;
+    r->qty = (float)((h >> 11) % 500);
+    r->ts = 1700000000000LL + (h >> 5) % 86400000;
+}
+
+static void pack_row(const Row *r, char *rec) {
+    memcpy(rec, &r->region, 4);
+    memcpy(rec + 4, &r->store, 4);
+    memcpy(rec + 8, r->tag, 8);
+    memcpy(rec + 16, &r->amount, 8);
+    memcpy(rec + 24, &r->qty, 4);
+    memcpy(rec + 28, &r->ts, 8);
+}
+
+static void unpack_row(const char *rec, Row *r) {
+    memcpy(&r->region, rec, 4);
+    memcpy(&r->store, rec + 4, 4);
+    memcpy(r->tag, rec + 8, 8);
+    memcpy(&r->amount, rec + 16, 8);
+    memcpy(&r->qty, rec + 24, 4);
+    memcpy(&r->ts, rec + 28, 8);
+}
+
+static void build_file(char *fname, int pageFormat, RM_FileHandle *fh) {
+    char rec[RECORD_LEN];
+    RID rid;
+    Row r;
+    int i, err;
+
+    RM_DestroyFile(fname);
+    if ((err = RM_CreateFileSchema(fname, pageFormat, layout, NUM_ATTRS)) != PFE_OK) {
+        printf("RM_CreateFileSchema failed: %d\n", err);
+        exit(1);
+    }
+    if (RM_OpenFileFlags(fname, fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    for (i = 0; i < NUM_RECORDS; i++) {
+        make_row(i, &r);
+        pack_row(&r, rec);
+        if ((err = RM_InsertRec(fh, rec, RECORD_LEN, &rid)) != PFE_OK) {
+            printf("RM_InsertRec failed: %d\n", err);
+            exit(1);
+        }
+    }
+}
+
+static int close_enough(double a, double b) {
+    return fabs(a - b) <= 1e-9 * (fabs(a) + fabs(b) + 1.0);
+}
+
+/*
+ * =================================================================
+ * Ungrouped aggregates
+ * =================================================================
+ */
+
+/* COUNT(*), SUM(amount), SUM(qty), SUM(store), MIN(ts), MAX(qty), MIN(amount) */
+static RM_AggSpec totals[] = {
+    {RM_AGG_COUNT, 0}, {RM_AGG_SUM, A_AMOUNT}, {RM_AGG_SUM, A_QTY}, {RM_AGG_SUM, A_STORE},
+    {RM_AGG_MIN, A_TS}, {RM_AGG_MAX, A_QTY}, {RM_AGG_MIN, A_AMOUNT}};
+#define NUM_TOTALS 7
+static int totalIsInt[NUM_TOTALS] = {1, 0, 0, 1, 1, 0, 0};
+
+/* The application-side loop the operators replace: WHERE region < 50 */
+static void totals_per_record(RM_FileHandle *fh, RM_AggValue *res) {
+    RM_ScanHandle sh;
+    char rec[RECORD_LEN];
+    RID rid;
+    Row r;
+
+    memset(res, 0, NUM_TOTALS * sizeof(RM_AggValue));
+    res[4].i = INT64_MAX;
+    res[5].d = -INFINITY;
+    res[6].d = INFINITY;
+    RM_ScanOpen(fh, &sh);
+    while (RM_GetNextRec(&sh, rec, &rid) == PFE_OK) {
+        unpack_row(rec, &r);
+        if (r.region >= 50)
+            continue;
+        res[0].i++;
+        res[1].d += r.amount;
+        res[2].d += r.qty;
+        res[3].i += r.store;
+        if (r.ts < res[4].i) res[4].i = r.ts;
+        if (r.qty > res[5].d) res[5].d = r.qty;
+        if (r.amount < res[6].d) res[6].d = r.amount;
+    }
+    RM_ScanClose(&sh);
+}
+
+static void totals_operator(RM_FileHandle *fh, RM_AggValue *res) {
+    int32_t half = 50;
+    RM_Pred pred = {A_REGION, RM_OP_LT, &half};
+    long rows;
+    int err;
+
+    if ((err = RM_Aggregate(fh, &pred, 1, totals, NUM_TOTALS, res, &rows)) != PFE_OK) {
+        printf("RM_Aggregate failed: %d\n", err);
+        exit(1);
+    }
+    if (rows != res[0].i) {
+        printf("*** ERROR: RM_Aggregate reported %ld rows but COUNT %lld ***\n", rows, res[0].i);
+        exit(1);
+    }
+}
+
+static void check_totals(const char *what, const RM_AggValue *got, const RM_AggValue *expect) {
+    int a;
+
+    for (a = 0; a < NUM_TOTALS; a++) {
+        if (totalIsInt[a] ? got[a].i != expect[a].i : !close_enough(got[a].d, expect[a].d)) {
+            printf("*** ERROR: %s: aggregate %d is %g, expected %g ***\n", what, a,
+                   totalIsInt[a] ? (double)got[a].i : got[a].d,
+                   totalIsInt[a] ? (double)expect[a].i : expect[a].d);
+            exit(1);
+        }
+    }
+}
+
+/*
+ * =================================================================
+ * GROUP BY
+ * =================================================================
+ */
+
+/* COUNT(*), SUM(amount), MIN(ts), MAX(ts) per group */
+static RM_AggSpec groupAggs[] = {
+    {RM_AGG_COUNT, 0}, {RM_AGG_SUM, A_AMOUNT}, {RM_AGG_MIN, A_TS}, {RM_AGG_MAX, A_TS}};
+#define NUM_GROUPAGGS 4
+
+typedef struct {
+    long long count, tsMin, tsMax;
+    double amount;
+    int seen;
+} GroupRes;
+
+typedef struct {
+    GroupRes *res;
+    int keyAttr;
+    long dupes;
+} Collector;
+
+/* Turns a group key into an index into the result arrays */
+static int key_index(int keyAttr, const char *key, int keyLen) {
+    int32_t k;
+
+    if (keyAttr == A_TAG)
+        return atoi(key + 3); // "catN"
+    memcpy(&k, key, keyLen);
+    return k;
+}
+
+static int collect_group(void *arg, const char *key, int keyLen, const RM_AggValue *values) {
+    Collector *c = (Collector *)arg;
+    GroupRes *g = &c->res[key_index(c->keyAttr, key, keyLen)];
+
+    if (g->seen)
+        c->dupes++;
+    g->seen = 1;
+    g->count = values[0].i;
+    g->amount = values[1].d;
+    g->tsMin = values[2].i;
+    g->tsMax = values[3].i;
+    return PFE_OK;
+}
+
+/* Reference grouping in application code, indexed by key */
+static void group_per_record(RM_FileHandle *fh, int keyAttr, GroupRes *res, int numKeys) {
+    RM_ScanHandle sh;
+    char rec[RECORD_LEN];
+    RID rid;
+    Row r;
+    int k;
+
+    memset(res, 0, numKeys * sizeof(GroupRes));
+    RM_ScanOpen(fh, &sh);
+    while (RM_GetNextRec(&sh, rec, &rid) == PFE_OK) {
+        unpack_row(rec, &r);
+        k = (keyAttr == A_REGION) ? r.region : (keyAttr == A_STORE) ? r.store : atoi(r.tag + 3);
+        if (!res[k].seen) {
+            res[k].seen = 1;
+            res[k].tsMin = r.ts;
+            res[k].tsMax = r.ts;
+        }
+        res[k].count++;
+        res[k].amount += r.amount;
+        if (r.ts < res[k].tsMin) res[k].tsMin = r.ts;
+        if (r.ts > res[k].tsMax) res[k].tsMax = r.ts;
+    }
+    RM_ScanClose(&sh);
+}
+
+static void group_operator(RM_FileHandle *fh, int keyAttr, long memBytes, GroupRes *res, int numKeys,
+                           RM_GroupStats *stats) {
+    Collector c;
+    int err;
+
+    memset(res, 0, numKeys * sizeof(GroupRes));
+    c.res = res;
+    c.keyAttr = keyAttr;
+    c.dupes = 0;
+    err = RM_GroupBy(fh, NULL, 0, keyAttr, groupAggs, NUM_GROUPAGGS, memBytes, collect_group, &c, stats);
+    if (err != PFE_OK || c.dupes != 0) {
+        printf("*** ERROR: RM_GroupBy returned %d with %ld duplicate groups ***\n", err, c.dupes);
+        exit(1);
+    }
+}
+
+static void check_groups(const char *what, const GroupRes *got, const GroupRes *expect, int numKeys) {
+    int k;
+
+    for (k = 0; k < numKeys; k++) {
+        if (got[k].seen != expect[k].seen || got[k].count != expect[k].count ||
+            got[k].tsMin != expect[k].tsMin || got[k].tsMax != expect[k].tsMax ||
+            !close_enough(got[k].amount, expect[k].amount)) {
+            printf("*** ERROR: %s: group %d differs (count %lld, expected %lld) ***\n",
+                   what, k, got[k].count, expect[k].count);
+            exit(1);
+        }
+    }
+}
+
+int main(void) {
+    RM_FileHandle files[2];
+    static const char *fmtNames[2] = {"row", "PAX"};
+    RM_AggValue expect[NUM_TOTALS], got[NUM_TOTALS];
+    GroupRes *ref = calloc(NUM_STORES, sizeof(GroupRes));
+    GroupRes *res = calloc(NUM_STORES, sizeof(GroupRes));
+    RM_GroupStats stats;
+    RM_AggSpec bad = {RM_AGG_SUM, A_TAG};
+    long rows, budgets[2];
+    int f, level, rep, b;
+    double t0, base, elapsed;
+
+    RM_Init();
+    build_file(ROW_FILE, RM_FORMAT_FIXED, &files[0]);
+    build_file(PAX_FILE, RM_FORMAT_PAX, &files[1]);
+    printf("Files: %d records of %d bytes (row and PAX layouts)\n\n", NUM_RECORDS, RECORD_LEN);
+
+    // Only numeric attributes can be summed
+    if (RM_Aggregate(&files[0], NULL, 0, &bad, 1, got, &rows) != RM_INVALID_ARG) {
+        printf("*** ERROR: SUM over a char attribute accepted ***\n");
+        exit(1);
+    }
+
+    // 1. Ungrouped aggregates with a filter
+    totals_per_record(&files[0], expect);
+    t0 = now_sec();
+    for (rep = 0; rep < REPEAT; rep++)
+        totals_per_record(&files[0], got);
+    base = (now_sec() - t0) / REPEAT;
+    printf("7 aggregates WHERE region < 50 (%lld rows)\n", expect[0].i);
+    printf("| Evaluation            | Format | Rows/s      | Time (sec) | Speedup |\n");
+    printf("|-----------------------|--------|-------------|------------|---------|\n");
+    printf("| RM_GetNextRec loop    | row    | %11.0f | %10.4f | %6.2fx |\n", NUM_RECORDS / base, base, 1.0);
+    for (f = 0; f < 2; f++) {
+        for (level = RM_SIMD_SCALAR; level <= RM_SIMD_AVX2; level += RM_SIMD_AVX2) {
+            if (RM_SetSimdLevel(level) != level)
+                continue;
+            t0 = now_sec();
+            for (rep = 0; rep < REPEAT; rep++)
+                totals_operator(&files[f], got);
+            elapsed = (now_sec() - t0) / REPEAT;
+            check_totals(fmtNames[f], got, expect);
+            printf("| RM_Aggregate, %-7s | %-6s | %11.0f | %10.4f | %6.2fx |\n",
+                   level == RM_SIMD_AVX2 ? "AVX2" : "scalar", fmtNames[f],
+                   NUM_RECORDS / elapsed, elapsed, base / elapsed);
+        }
+    }
+    RM_SetSimdLevel(RM_SIMD_AVX2);
+
+    // 2. GROUP BY a small integer key and a short string key
+    group_per_record(&files[0], A_REGION, ref, NUM_REGIONS);
+    group_operator(&files[1], A_REGION, 1 << 20, res, NUM_REGIONS, &stats);
+    check_groups("GROUP BY region", res, ref, NUM_REGIONS);
+    group_per_record(&files[0], A_TAG, ref, NUM_TAGS);
+    group_operator(&files[0], A_TAG, 1 << 20, res, NUM_TAGS, &stats);
+    check_groups("GROUP BY tag", res, ref, NUM_TAGS);
+
+    // 3. GROUP BY store: 50000 groups, in memory and with a budget
+    //    that holds only a fraction of them
+    t0 = now_sec();
+    group_per_record(&files[0], A_STORE, ref, NUM_STORES);
+    base = now_sec() - t0;
+    printf("\nGROUP BY store: COUNT(*), SUM(amount), MIN(ts), MAX(ts) (%d groups)\n", NUM_STORES);
+    printf("| Evaluation                  | Time (sec) | Speedup | Passes | Spilled rows | Spill pages |\n");
+    printf("|-----------------------------|------------|---------|--------|--------------|-------------|\n");
+    printf("| RM_GetNextRec loop (array)  | %10.4f | %6.2fx |      1 |            0 |           0 |\n", base, 1.0);
+    budgets[0] = 16L << 20;
+    budgets[1] = 512L << 10;
+    for (b = 0; b < 2; b++) {
+        t0 = now_sec();
+        group_operator(&files[1], A_STORE, budgets[b], res, NUM_STORES, &stats);
+        elapsed = now_sec() - t0;
+        check_groups("GROUP BY store", res, ref, NUM_STORES);
+        if (stats.groups != NUM_STORES || (b == 1 && stats.passes < 2)) {
+            printf("*** ERROR: %ld groups in %d passes ***\n", stats.groups, stats.passes);
+            exit(1);
+        }
+        printf("| RM_GroupBy, %5ld KB budget | %10.4f | %6.2fx | %6d | %12ld | %11d |\n",
+               budgets[b] >> 10, elapsed, base / elapsed, stats.passes, stats.spilledRows, stats.spillPages);
+    }
+
+    for (f = 0; f < 2; f++)
+        RM_CloseFile(&files[f]);
+    RM_DestroyFile(ROW_FILE);
+    RM_DestroyFile(PAX_FILE);
+    free(ref);
+    free(res);
+    printf("\n*** Aggregation Test Passed! ***\n");
+    return 0;
+}
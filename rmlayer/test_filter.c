@@ -0,0 +1,304 @@
+/* test_filter.c: Benchmark for filtered scans over typed row and PAX files (RM_ScanOpenFilter) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define TEST_FILE "filter_file.db"
+#define PAX_FILE "filter_pax.db"
+#define NUM_RECORDS 400000
+#define REPEAT 5
+
+/* Layout: id i32, ts i64, price f64, qty f32, tag char(8) = 32 bytes */
+static RM_Attr layout[] = {
+    {RM_TYPE_INT32, 0}, {RM_TYPE_INT64, 0}, {RM_TYPE_DOUBLE, 0},
+    {RM_TYPE_FLOAT, 0}, {RM_TYPE_CHAR, 8}};
+#define NUM_ATTRS 5
+#define RECORD_LEN 32
+
+typedef struct {
+    int32_t id;
+    int64_t ts;
+    double price;
+    float qty;
+    char tag[8];
+} Row;
+
+static const char *op_names[] = {"=", "!=", "<", "<=", ">", ">="};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void make_row(int i, Row *r) {
+    r->id = i;
+    r->ts = 1700000000000LL + (int64_t)(i % 5000) * 1000;
+    r->price = (i * 7919) % 10000 / 100.0;
+    r->qty = (float)((i * 31) % 200) - 100.0f; // -100 .. 99
+    memset(r->tag, 0, sizeof(r->tag));
+    sprintf(r->tag, "t%d", i % 10);
+}
+
+static void pack_row(const Row *r, char *rec) {
+    memcpy(rec, &r->id, 4);
+    memcpy(rec + 4, &r->ts, 8);
+    memcpy(rec + 12, &r->price, 8);
+    memcpy(rec + 20, &r->qty, 4);
+    memcpy(rec + 24, r->tag, 8);
+}
+
+static void unpack_row(const char *rec, Row *r) {
+    memcpy(&r->id, rec, 4);
+    memcpy(&r->ts, rec + 4, 8);
+    memcpy(&r->price, rec + 12, 8);
+    memcpy(&r->qty, rec + 20, 4);
+    memcpy(r->tag, rec + 24, 8);
+}
+
+/* Reference: one predicate on one unpacked row */
+static int row_matches(const Row *r, const RM_Pred *p) {
+    double a, b;
+    int cmp;
+
+    switch (p->attr) {
+    case 0: a = r->id; b = *(const int32_t *)p->value; break;
+    case 1: a = (double)r->ts; b = (double)*(const int64_t *)p->value; break;
+    case 2: a = r->price; b = *(const double *)p->value; break;
+    case 3: a = r->qty; b = *(const float *)p->value; break;
+    default:
+        cmp = memcmp(r->tag, p->value, 8);
+        a = cmp;
+        b = 0;
+        break;
+    }
+    switch (p->op) {
+    case RM_OP_EQ: return a == b;
+    case RM_OP_NE: return a != b;
+    case RM_OP_LT: return a < b;
+    case RM_OP_LE: return a <= b;
+    case RM_OP_GT: return a > b;
+    default:       return a >= b;
+    }
+}
+
+/* Per-record evaluation: fetch every record, decode it, test it */
+static long count_per_record(RM_FileHandle *fh, const RM_Pred *preds, int numPreds) {
+    RM_ScanHandle sh;
+    char rec[RECORD_LEN];
+    RID rid;
+    Row r;
+    long count = 0;
+    int i, ok;
+
+    RM_ScanOpen(fh, &sh);
+    while (RM_GetNextRec(&sh, rec, &rid) == PFE_OK) {
+        unpack_row(rec, &r);
+        for (ok = 1, i = 0; ok && i < numPreds; i++)
+            ok = row_matches(&r, &preds[i]);
+        count += ok;
+    }
+    RM_ScanClose(&sh);
+    return count;
+}
+
+static long count_filtered(RM_FileHandle *fh, const RM_Pred *preds, int numPreds) {
+    RM_ScanHandle sh;
+    char rec[RECORD_LEN];
+    RID rid;
+    long count = 0;
+    int err;
+
+    if ((err = RM_ScanOpenFilter(fh, &sh, preds, numPreds)) != PFE_OK) {
+        printf("RM_ScanOpenFilter failed: %d\n", err);
+        exit(1);
+    }
+    while (RM_GetNextRec(&sh, rec, &rid) == PFE_OK)
+        count++;
+    RM_ScanClose(&sh);
+    return count;
+}
+
+/* Every type and operator, at every SIMD level, against the reference */
+static void check_all_ops(RM_FileHandle *fh) {
+    int32_t c32 = 1234;
+    int64_t c64 = 1700000002000LL;
+    double cd = 50.0;
+    float cf = -0.5f;
+    char ctag[8] = "t3";
+    const void *values[NUM_ATTRS] = {&c32, &c64, &cd, &cf, ctag};
+    RM_Pred pred;
+    int level, attr, op;
+    long expect, got;
+
+    for (attr = 0; attr < NUM_ATTRS; attr++) {
+        for (op = RM_OP_EQ; op <= RM_OP_GE; op++) {
+            pred.attr = attr;
+            pred.op = op;
+            pred.value = values[attr];
+            RM_SetSimdLevel(RM_SIMD_SCALAR);
+            expect = count_per_record(fh, &pred, 1);
+            for (level = RM_SIMD_SCALAR; level <= RM_SIMD_AVX2; level++) {
+                if (RM_SetSimdLevel(level) != level)
+                    continue;
+                got = count_filtered(fh, &pred, 1);
+                if (got != expect) {
+                    printf("*** ERROR: attr %d %s at level %d: %ld records, expected %ld ***\n",
+                           attr, op_names[op], level, got, expect);
+                    exit(1);
+                }
+            }
+        }
+    }
+}
+
+/* Creates `fname` in `pageFormat` with the same rows and holes */
+static void build_file(char *fname, int pageFormat, RM_FileHandle *fh) {
+    RID rid;
+    Row r;
+    char rec[RECORD_LEN];
+    int i, err;
+
+    RM_DestroyFile(fname);
+    if ((err = RM_CreateFileSchema(fname, pageFormat, layout, NUM_ATTRS)) != PFE_OK) {
+        printf("RM_CreateFileSchema failed: %d\n", err);
+        exit(1);
+    }
+    if (RM_OpenFileFlags(fname, fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    for (i = 0; i < NUM_RECORDS; i++) {
+        make_row(i, &r);
+        pack_row(&r, rec);
+        if ((err = RM_InsertRec(fh, rec, RECORD_LEN, &rid)) != PFE_OK) {
+            printf("RM_InsertRec failed: %d\n", err);
+            exit(1);
+        }
+    }
+    // Holes in the presence bitmaps must stay unselected
+    for (i = 0; i < 200; i++) {
+        rid.pageNum = 1 + i * 7;
+        rid.slotNum = i % 100;
+        RM_DeleteRec(fh, &rid);
+    }
+}
+
+/* A PAX file returns whole records under the same RIDs as a row file */
+static void check_same_records(RM_FileHandle *rows, RM_FileHandle *pax) {
+    RM_ScanHandle sh;
+    char rec1[RECORD_LEN], rec2[RECORD_LEN];
+    Row r;
+    RID rid;
+    long n = 0;
+
+    RM_ScanOpen(rows, &sh);
+    while (RM_GetNextRec(&sh, rec1, &rid) == PFE_OK) {
+        if (n++ % 97 != 0)
+            continue;
+        if (RM_GetRec(pax, &rid, rec2) != PFE_OK || memcmp(rec1, rec2, RECORD_LEN) != 0) {
+            printf("*** ERROR: RID (%d,%d) differs between the formats ***\n", rid.pageNum, rid.slotNum);
+            exit(1);
+        }
+    }
+    RM_ScanClose(&sh);
+
+    // Updates go to every minipage
+    rid.pageNum = 2;
+    rid.slotNum = 5;
+    make_row(424242, &r);
+    pack_row(&r, rec1);
+    if (RM_UpdateRec(pax, &rid, rec1, RECORD_LEN) != PFE_OK || RM_GetRec(pax, &rid, rec2) != PFE_OK ||
+        memcmp(rec1, rec2, RECORD_LEN) != 0) {
+        printf("*** ERROR: PAX update did not round-trip ***\n");
+        exit(1);
+    }
+    RM_GetRec(rows, &rid, rec1);
+    RM_UpdateRec(pax, &rid, rec1, RECORD_LEN);
+}
+
+/* Times count_filtered at `level` (or per-record evaluation for -1) */
+static double time_filter(RM_FileHandle *fh, int level, const RM_Pred *preds, int numPreds, long expect) {
+    double t0;
+    long got = 0;
+    int rep;
+
+    if (level >= 0)
+        RM_SetSimdLevel(level);
+    t0 = now_sec();
+    for (rep = 0; rep < REPEAT; rep++)
+        got = (level < 0) ? count_per_record(fh, preds, numPreds) : count_filtered(fh, preds, numPreds);
+    if (got != expect) {
+        printf("*** ERROR: level %d found %ld records, expected %ld ***\n", level, got, expect);
+        exit(1);
+    }
+    return (now_sec() - t0) / REPEAT;
+}
+
+int main(void) {
+    RM_FileHandle rows, pax;
+    RM_SpaceStats stats;
+    static const char *level_names[] = {"scalar", "SSE4.2", "AVX2"};
+    float qlo = 90.0f;
+    double plo = 20.0, phi = 30.0;
+    RM_Pred preds[3];
+    RM_ScanHandle sh;
+    int level;
+    long expect;
+    double base, trow, tpax;
+
+    RM_Init();
+    build_file(TEST_FILE, RM_FORMAT_FIXED, &rows);
+    build_file(PAX_FILE, RM_FORMAT_PAX, &pax);
+    RM_GetSpaceStats(&rows, &stats, FALSE);
+    printf("Files: %d records of %d bytes on %d pages (row and PAX layouts)\n",
+           stats.numRecs, RECORD_LEN, stats.numPages);
+
+    // Predicates must name schema attributes
+    preds[0].attr = NUM_ATTRS;
+    preds[0].op = RM_OP_EQ;
+    preds[0].value = &qlo;
+    if (RM_ScanOpenFilter(&rows, &sh, preds, 1) != RM_INVALID_ARG) {
+        printf("*** ERROR: bad attribute accepted ***\n");
+        exit(1);
+    }
+
+    check_same_records(&rows, &pax);
+    check_all_ops(&rows);
+    check_all_ops(&pax);
+    printf("All 5 types x 6 operators agree with per-record evaluation (both layouts)\n\n");
+
+    // qty >= 90 AND price >= 20 AND price < 30: about 1% of the rows
+    preds[0].attr = 3; preds[0].op = RM_OP_GE; preds[0].value = &qlo;
+    preds[1].attr = 2; preds[1].op = RM_OP_GE; preds[1].value = &plo;
+    preds[2].attr = 2; preds[2].op = RM_OP_LT; preds[2].value = &phi;
+    RM_SetSimdLevel(RM_SIMD_SCALAR);
+    expect = count_per_record(&rows, preds, 3);
+
+    base = time_filter(&rows, -1, preds, 3, expect);
+    tpax = time_filter(&pax, -1, preds, 3, expect);
+    printf("Filter: qty >= 90 AND price >= 20 AND price < 30 (%ld matches)\n\n", expect);
+    printf("| Evaluation            | Row pages: rows/s  | PAX pages: rows/s  |\n");
+    printf("|-----------------------|--------------------|--------------------|\n");
+    printf("| Per record            | %10.0f (%4.2fx) | %10.0f (%4.2fx) |\n",
+           stats.numRecs / base, 1.0, stats.numRecs / tpax, base / tpax);
+
+    for (level = RM_SIMD_SCALAR; level <= RM_SIMD_AVX2; level++) {
+        if (RM_SetSimdLevel(level) != level) {
+            printf("| Page filter, %-8s | (not supported by this CPU)             |\n", level_names[level]);
+            continue;
+        }
+        trow = time_filter(&rows, level, preds, 3, expect);
+        tpax = time_filter(&pax, level, preds, 3, expect);
+        printf("| Page filter, %-8s | %10.0f (%4.2fx) | %10.0f (%4.2fx) |\n", level_names[level],
+               stats.numRecs / trow, base / trow, stats.numRecs / tpax, base / tpax);
+    }
+
+    RM_CloseFile(&rows);
+    RM_CloseFile(&pax);
+    RM_DestroyFile(TEST_FILE);
+    RM_DestroyFile(PAX_FILE);
+    printf("\n*** Filter Test Passed! ***\n");
+    return 0;
+}
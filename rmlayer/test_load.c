@@ -0,0 +1,174 @@
+/* test_load.c: Benchmark for the parallel CSV loader (RM_LoadCSV) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define CSV_FILE "load_input.csv"
+#define TEST_FILE "load_file.db"
+#define NUM_ROWS 200000
+#define NAME_LEN 16
+
+/* Layout: id i32, timestamp i64, value f64, name char(16) */
+static RM_Attr layout[] = {
+    {RM_TYPE_INT32, 0}, {RM_TYPE_INT64, 0}, {RM_TYPE_DOUBLE, 0}, {RM_TYPE_CHAR, NAME_LEN}};
+#define NUM_ATTRS 4
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Writes NUM_ROWS rows plus a header and two malformed lines */
+static void write_csv(void) {
+    FILE *f = fopen(CSV_FILE, "w");
+    int i;
+
+    if (f == NULL) { perror(CSV_FILE); exit(1); }
+    fprintf(f, "id,ts,value,name\n");
+    for (i = 0; i < NUM_ROWS; i++) {
+        fprintf(f, "%d,%lld,%.3f,", i, 1700000000000LL + i * 250LL, (i % 1000) * 0.125);
+        if (i % 7 == 0)
+            fprintf(f, "\"sensor,\"\"%d\"\n", i % 97); // Quoted: sensor,"N
+        else
+            fprintf(f, "sensor-%d\n", i % 97);
+        if (i == NUM_ROWS / 2)
+            fprintf(f, "not,a,valid\nrow,with,bad,number\n");
+    }
+    fclose(f);
+}
+
+/* The per-record path: a single-threaded parser calling RM_InsertRec */
+static long load_per_record(RM_FileHandle *fh) {
+    char line[256], rec[64];
+    FILE *f = fopen(CSV_FILE, "r");
+    RID rid;
+    long rows = 0;
+    int id;
+    long long ts;
+    double value;
+    char name[64];
+
+    if (f == NULL) { perror(CSV_FILE); exit(1); }
+    fgets(line, sizeof(line), f); // Header
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *p = line, *q;
+        id = (int)strtol(p, &q, 10);
+        if (*q != ',') continue;
+        ts = strtoll(q + 1, &q, 10);
+        if (*q != ',') continue;
+        value = strtod(q + 1, &q);
+        if (*q != ',') continue;
+        memset(name, 0, sizeof(name));
+        p = q + 1;
+        p[strcspn(p, "\r\n")] = '\0';
+        strncpy(name, p, NAME_LEN);
+        memcpy(rec, &id, 4);
+        memcpy(rec + 4, &ts, 8);
+        memcpy(rec + 12, &value, 8);
+        memcpy(rec + 20, name, NAME_LEN);
+        if (RM_InsertRec(fh, rec, 20 + NAME_LEN, &rid) != PFE_OK) {
+            printf("RM_InsertRec failed\n");
+            exit(1);
+        }
+        rows++;
+    }
+    fclose(f);
+    return rows;
+}
+
+/* Checks every id 0..NUM_ROWS-1 is present exactly once */
+static void check_file(RM_FileHandle *fh) {
+    RM_ScanHandle sh;
+    RM_SpaceStats stats;
+    char rec[64];
+    char *seen = calloc(NUM_ROWS, 1);
+    RID rid;
+    long count = 0;
+    int id, err;
+
+    RM_ScanOpen(fh, &sh);
+    while ((err = RM_GetNextRec(&sh, rec, &rid)) == PFE_OK) {
+        memcpy(&id, rec, 4);
+        if (id < 0 || id >= NUM_ROWS || seen[id]) {
+            printf("*** ERROR: unexpected id %d ***\n", id);
+            exit(1);
+        }
+        seen[id] = 1;
+        count++;
+    }
+    RM_ScanClose(&sh);
+    free(seen);
+    if (err != RM_EOF || count != NUM_ROWS || RM_GetSpaceStats(fh, &stats, TRUE) != PFE_OK) {
+        printf("*** ERROR: loaded file has %ld rows or bad counters ***\n", count);
+        exit(1);
+    }
+}
+
+int main(void) {
+    RM_FileHandle fh;
+    RM_LoadStats stats;
+    RID rid;
+    char rec[64];
+    int threads[] = {1, 2, 4};
+    int t, err;
+    double t0, elapsed, base;
+    long rows;
+
+    RM_Init();
+    write_csv();
+    printf("Input: %d rows, layout i32,i64,f64,c%d (%d-byte records)\n\n",
+           NUM_ROWS, NAME_LEN, RM_LayoutLength(layout, NUM_ATTRS));
+
+    // 1. Baseline: one RM_InsertRec per line (append mode, so the
+    //    insert path does not search the file for space)
+    RM_DestroyFile(TEST_FILE);
+    if (RM_CreateFile(TEST_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFileFlags(TEST_FILE, &fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFileFlags"); exit(1); }
+    t0 = now_sec();
+    rows = load_per_record(&fh);
+    base = now_sec() - t0;
+    check_file(&fh);
+    RM_CloseFile(&fh);
+
+    printf("| Loader               | Rows/s     | Time (sec) | Speedup |\n");
+    printf("|----------------------|------------|------------|---------|\n");
+    printf("| RM_InsertRec per row | %10.0f | %10.4f | %6.2fx |\n", rows / base, base, 1.0);
+
+    // 2. RM_LoadCSV with 1, 2 and 4 parser threads
+    for (t = 0; t < 3; t++) {
+        RM_DestroyFile(TEST_FILE);
+        if (RM_CreateFile(TEST_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+        if (RM_OpenFile(TEST_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+        t0 = now_sec();
+        err = RM_LoadCSV(&fh, CSV_FILE, layout, NUM_ATTRS, threads[t], RM_LOAD_HEADER, &stats);
+        elapsed = now_sec() - t0;
+        if (err != PFE_OK || stats.rows != NUM_ROWS || stats.rejected != 2) {
+            printf("*** ERROR: RM_LoadCSV returned %d, %ld rows, %ld rejected ***\n",
+                   err, stats.rows, stats.rejected);
+            exit(1);
+        }
+        check_file(&fh);
+        printf("| RM_LoadCSV %d thread%s | %10.0f | %10.4f | %6.2fx |\n", threads[t],
+               threads[t] == 1 ? " " : "s", stats.rows / elapsed, elapsed, base / elapsed);
+
+        // The quoted name keeps its comma and quote
+        if (t == 0) {
+            rid.pageNum = 1;
+            rid.slotNum = 0;
+            if (RM_GetRec(&fh, &rid, rec) != PFE_OK || strncmp(rec + 20, "sensor,\"0", NAME_LEN) != 0) {
+                printf("*** ERROR: quoted field parsed as '%.16s' ***\n", rec + 20);
+                exit(1);
+            }
+        }
+        RM_CloseFile(&fh);
+    }
+
+    RM_DestroyFile(TEST_FILE);
+    remove(CSV_FILE);
+    printf("\n*** CSV Load Test Passed! ***\n");
+    return 0;
+}
@@ -0,0 +1,177 @@
+/* test_pscan.c: Benchmark for the parallel heap scan (RM_ParallelScan) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define TEST_FILE "pscan_file.db"
+#define NUM_RECORDS 20000
+#define FILTER_WORK 200 /* hash rounds per record: makes the filter CPU-bound */
+
+/* Per-thread result, padded so workers do not share a cache line */
+typedef struct {
+    long seen;
+    long matched;
+    char pad[48];
+} FilterState;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* An intentionally expensive predicate over the record bytes */
+static int expensive_filter(const char *data, int len) {
+    unsigned int h = 2166136261u;
+    int round, i;
+
+    for (round = 0; round < FILTER_WORK; round++)
+        for (i = 0; i < len; i++)
+            h = (h ^ (unsigned char)data[i]) * 16777619u;
+    return ((h >> 16) % 10) == 0;
+}
+
+static int filter_cb(void *arg, const char *record_data, int record_len, const RID *rid) {
+    FilterState *st = (FilterState *)arg;
+    st->seen++;
+    if (expensive_filter(record_data, record_len))
+        st->matched++;
+    return PFE_OK;
+}
+
+/* One of two parallel scans run at the same time */
+typedef struct {
+    RM_FileHandle *fh;
+    FilterState states[4];
+    int result;
+} ConcurrentScan;
+
+static void *concurrent_scan_main(void *arg) {
+    ConcurrentScan *cs = (ConcurrentScan *)arg;
+    void *args[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        memset(&cs->states[i], 0, sizeof(FilterState));
+        args[i] = &cs->states[i];
+    }
+    cs->result = RM_ParallelScan(cs->fh, 4, filter_cb, args);
+    return NULL;
+}
+
+int main(void) {
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    RID rid;
+    char buf[64];
+    FilterState states[8];
+    void *args[8];
+    int thread_counts[] = {1, 2, 4, 8};
+    long expected_seen = 0, expected_matched = 0;
+    double t0, base_time = 0.0;
+    int i, t, err;
+
+    RM_Init();
+    RM_DestroyFile(TEST_FILE);
+
+    // 1. Populate the file
+    if ((err = RM_CreateFile(TEST_FILE)) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if ((err = RM_OpenFile(TEST_FILE, &fh)) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    printf("Populating %s with %d records...\n", TEST_FILE, NUM_RECORDS);
+    for (i = 0; i < NUM_RECORDS; i++) {
+        sprintf(buf, "Student_Name_%d", i);
+        err = RM_InsertRec(&fh, buf, strlen(buf) + 1, &rid);
+        if (err != PFE_OK) { PF_PrintError("RM_InsertRec"); exit(1); }
+    }
+
+    // 2. Sequential baseline with the same filter
+    t0 = now_sec();
+    RM_ScanOpen(&fh, &sh);
+    while ((err = RM_GetNextRec(&sh, buf, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { PF_PrintError("RM_GetNextRec"); exit(1); }
+        expected_seen++;
+        if (expensive_filter(buf, strlen(buf) + 1))
+            expected_matched++;
+    }
+    RM_ScanClose(&sh);
+    printf("Sequential RM_GetNextRec scan: %.4f sec (%ld records, %ld matched)\n\n",
+           now_sec() - t0, expected_seen, expected_matched);
+
+    // 3. Parallel scan with a varying number of threads
+    printf("| Threads | Time (sec) | Speedup | Records | Matched |\n");
+    printf("|---------|------------|---------|---------|---------|\n");
+    for (t = 0; t < (int)(sizeof(thread_counts) / sizeof(thread_counts[0])); t++) {
+        int n = thread_counts[t];
+        long seen = 0, matched = 0;
+        double elapsed;
+
+        for (i = 0; i < n; i++) {
+            memset(&states[i], 0, sizeof(FilterState));
+            args[i] = &states[i];
+        }
+
+        t0 = now_sec();
+        err = RM_ParallelScan(&fh, n, filter_cb, args);
+        elapsed = now_sec() - t0;
+        if (err != PFE_OK) { printf("RM_ParallelScan failed: %d\n", err); exit(1); }
+
+        for (i = 0; i < n; i++) {
+            seen += states[i].seen;
+            matched += states[i].matched;
+        }
+        if (n == 1)
+            base_time = elapsed;
+        printf("| %-7d | %-10.4f | %-7.2f | %-7ld | %-7ld |\n",
+               n, elapsed, base_time / elapsed, seen, matched);
+
+        if (seen != expected_seen || matched != expected_matched) {
+            printf("*** ERROR: parallel scan saw %ld/%ld, expected %ld/%ld ***\n",
+                   seen, matched, expected_seen, expected_matched);
+            exit(1);
+        }
+    }
+
+    // 4. Two parallel scans at once: their workers share the PF pool latch
+    {
+        ConcurrentScan scans[2];
+        pthread_t tids[2];
+
+        for (t = 0; t < 2; t++) {
+            scans[t].fh = &fh;
+            if (pthread_create(&tids[t], NULL, concurrent_scan_main, &scans[t]) != 0) {
+                printf("pthread_create failed\n");
+                exit(1);
+            }
+        }
+        for (t = 0; t < 2; t++)
+            pthread_join(tids[t], NULL);
+
+        for (t = 0; t < 2; t++) {
+            long seen = 0, matched = 0;
+
+            if (scans[t].result != PFE_OK) {
+                printf("Concurrent RM_ParallelScan failed: %d\n", scans[t].result);
+                exit(1);
+            }
+            for (i = 0; i < 4; i++) {
+                seen += scans[t].states[i].seen;
+                matched += scans[t].states[i].matched;
+            }
+            if (seen != expected_seen || matched != expected_matched) {
+                printf("*** ERROR: concurrent scan %d saw %ld/%ld, expected %ld/%ld ***\n",
+                       t, seen, matched, expected_seen, expected_matched);
+                exit(1);
+            }
+        }
+        printf("\nTwo concurrent 4-thread scans: both saw %ld records\n", expected_seen);
+    }
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(TEST_FILE);
+    printf("\n*** Parallel Scan Test Passed! ***\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* test_reccache.c: Benchmark for the record cache (RM_SetRecCache) on hot point lookups */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define TEST_FILE "reccache_file.db"
+#define NUM_RECORDS 100000
+#define HOT_RECORDS 4000
+#define NUM_LOOKUPS 400000
+#define HOT_PERCENT 95
+#define MAX_LEN 128
+
+static RID rids[NUM_RECORDS];
+static int hot[HOT_RECORDS];
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Record i: "rec-<i>-" padded with a letter to 80..119 bytes */
+static int make_rec(int i, char *rec) {
+    int len = 80 + i % 40;
+    int n = sprintf(rec, "rec-%d-", i);
+    memset(rec + n, 'a' + i % 26, len - n);
+    return len;
+}
+
+static void check_rec(int i, const char *got) {
+    char expect[MAX_LEN];
+    int len = make_rec(i, expect);
+
+    if (memcmp(got, expect, len) != 0) {
+        printf("*** ERROR: record %d came back as '%.20s' ***\n", i, got);
+        exit(1);
+    }
+}
+
+/*
+ * run_lookups
+ * NUM_LOOKUPS RM_GetRec calls: HOT_PERCENT of them to the hot records
+ * (spread over the whole file), the rest anywhere. Same sequence every
+ * run. Prints a table row.
+ */
+static void run_lookups(RM_FileHandle *fh, const char *label, long budget) {
+    RM_RecCacheStats stats;
+    char rec[MAX_LEN];
+    unsigned int seed = 12345;
+    double t0, elapsed;
+    int n, i, err;
+
+    if (RM_SetRecCache(fh, budget) != PFE_OK) { printf("RM_SetRecCache failed\n"); exit(1); }
+    PF_ResetStats();
+    t0 = now_sec();
+    for (n = 0; n < NUM_LOOKUPS; n++) {
+        seed = seed * 1103515245u + 12345u;
+        if ((seed >> 16) % 100 < HOT_PERCENT)
+            i = hot[(seed >> 8) % HOT_RECORDS];
+        else
+            i = (seed >> 4) % NUM_RECORDS;
+        if ((err = RM_GetRec(fh, &rids[i], rec)) != PFE_OK) {
+            printf("RM_GetRec failed: %d\n", err);
+            exit(1);
+        }
+        check_rec(i, rec);
+    }
+    elapsed = now_sec() - t0;
+    RM_GetRecCacheStats(fh, &stats);
+    if (stats.bytes > budget) {
+        printf("*** ERROR: cache holds %ld bytes, budget %ld ***\n", stats.bytes, budget);
+        exit(1);
+    }
+    printf("| %-16s | %10.0f | %8.1f%% | %8.1f%% | %10ld | %7d |\n", label, NUM_LOOKUPS / elapsed,
+           budget ? 100.0 * stats.hits / stats.lookups : 0.0,
+           stats.pageRequests ? 100.0 * (stats.pageRequests - stats.pageMisses) / stats.pageRequests : 0.0,
+           stats.pageMisses, stats.entries);
+}
+
+/* Deletes and updates must not leave stale copies behind */
+static void check_invalidation(RM_FileHandle *fh) {
+    RM_RecCacheStats stats;
+    char rec[MAX_LEN], longer[MAX_LEN];
+    RID rid = rids[hot[0]];
+    int len;
+
+    RM_SetRecCache(fh, 1 << 20);
+    RM_GetRec(fh, &rid, rec);
+    RM_GetRec(fh, &rid, rec);
+
+    // 1. An update replaces the record (with a longer one here)
+    len = make_rec(hot[0], longer);
+    memset(longer + len, 'Z', 5);
+    if (RM_UpdateRec(fh, &rid, longer, len + 5) != PFE_OK || RM_GetRec(fh, &rid, rec) != PFE_OK ||
+        memcmp(rec, longer, len + 5) != 0) {
+        printf("*** ERROR: cached record survived an update ***\n");
+        exit(1);
+    }
+
+    // 2. A deleted record is gone
+    if (RM_DeleteRec(fh, &rid) != PFE_OK || RM_GetRec(fh, &rid, rec) == PFE_OK) {
+        printf("*** ERROR: cached record survived a delete ***\n");
+        exit(1);
+    }
+    RM_GetRecCacheStats(fh, &stats);
+    if (stats.lookups != 4 || stats.hits != 1 || stats.invalidations != 2) {
+        printf("*** ERROR: %ld lookups, %ld hits, %ld invalidations ***\n",
+               stats.lookups, stats.hits, stats.invalidations);
+        exit(1);
+    }
+
+    // 3. The slot is reused by the next insert; the cache must not know it
+    len = make_rec(hot[0], rec);
+    if (RM_InsertRec(fh, rec, len, &rids[hot[0]]) != PFE_OK || RM_GetRec(fh, &rids[hot[0]], longer) != PFE_OK) {
+        printf("*** ERROR: reinsert failed ***\n");
+        exit(1);
+    }
+    check_rec(hot[0], longer);
+    RM_SetRecCache(fh, 0);
+}
+
+int main(void) {
+    RM_FileHandle fh;
+    RM_SpaceStats space;
+    char rec[MAX_LEN];
+    int i, len;
+
+    RM_Init();
+    RM_DestroyFile(TEST_FILE);
+    if (RM_CreateFile(TEST_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFileFlags(TEST_FILE, &fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    for (i = 0; i < NUM_RECORDS; i++) {
+        len = make_rec(i, rec);
+        if (RM_InsertRec(&fh, rec, len, &rids[i]) != PFE_OK) {
+            printf("RM_InsertRec failed\n");
+            exit(1);
+        }
+    }
+    // Every 25th record: the hot set touches almost every page
+    for (i = 0; i < HOT_RECORDS; i++)
+        hot[i] = i * (NUM_RECORDS / HOT_RECORDS);
+    RM_GetSpaceStats(&fh, &space, FALSE);
+    printf("File: %d records on %d pages; %d hot records (%d%% of %d lookups)\n\n",
+           NUM_RECORDS, space.numPages, HOT_RECORDS, HOT_PERCENT, NUM_LOOKUPS);
+
+    check_invalidation(&fh);
+
+    printf("| Record cache     | Lookups/s  | Rec hits  | Page hits | Disk reads | Entries |\n");
+    printf("|------------------|------------|-----------|-----------|------------|---------|\n");
+    run_lookups(&fh, "off", 0);
+    run_lookups(&fh, "128 KB", 128L << 10);
+    run_lookups(&fh, "512 KB", 512L << 10);
+    run_lookups(&fh, "2 MB", 2L << 20);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(TEST_FILE);
+    printf("\n*** Record Cache Test Passed! ***\n");
+    return 0;
+}
@@ -0,0 +1,153 @@
+/* test_sharedscan.c: Benchmark for cooperative scans (RM_ScanOpenShared) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define TEST_FILE "sharedscan_file.db"
+#define NUM_RECORDS 8000
+#define RECORD_LEN 100
+#define NUM_SCANS 4
+
+/* One client: its scan and what it has seen so far */
+typedef struct {
+    RM_ScanHandle sh;
+    int open;
+    int done;
+    long seen;
+    long ridSum;
+} ScanClient;
+
+static long rid_key(const RID *rid) {
+    return (long)rid->pageNum * 1000 + rid->slotNum;
+}
+
+/*
+ * run_clients
+ * Runs NUM_SCANS full scans of the file, interleaved one record at a
+ * time as concurrent clients would be. Client k opens its scan once
+ * client 0 has read k * stagger records. Returns the physical reads.
+ */
+static long run_clients(int shared, int stagger, long expectSum) {
+    RM_FileHandle fh;
+    ScanClient clients[NUM_SCANS];
+    char rec[RECORD_LEN];
+    RID rid;
+    long logical, physical, writes;
+    int k, err, active;
+
+    if (RM_OpenFile(TEST_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    memset(clients, 0, sizeof(clients));
+    PF_ResetStats();
+
+    for (active = NUM_SCANS; active > 0;) {
+        for (k = 0; k < NUM_SCANS; k++) {
+            ScanClient *c = &clients[k];
+            if (c->done)
+                continue;
+            if (!c->open) {
+                if (clients[0].seen < (long)k * stagger)
+                    continue; // Not arrived yet
+                if (shared)
+                    RM_ScanOpenShared(&fh, &c->sh);
+                else
+                    RM_ScanOpen(&fh, &c->sh);
+                c->open = 1;
+            }
+            err = RM_GetNextRec(&c->sh, rec, &rid);
+            if (err == RM_EOF) {
+                RM_ScanClose(&c->sh);
+                c->done = 1;
+                active--;
+                continue;
+            }
+            if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+            c->seen++;
+            c->ridSum += rid_key(&rid);
+        }
+    }
+    PF_GetStats(&logical, &physical, &writes);
+
+    // Every client must see every record exactly once
+    for (k = 0; k < NUM_SCANS; k++) {
+        if (clients[k].seen != NUM_RECORDS || clients[k].ridSum != expectSum) {
+            printf("*** ERROR: client %d saw %ld records (expected %d) ***\n",
+                   k, clients[k].seen, NUM_RECORDS);
+            exit(1);
+        }
+    }
+    RM_CloseFile(&fh);
+    return physical;
+}
+
+/* Physical reads of a single scan, the lower bound for any mix */
+static long run_single(long *expectSum) {
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    char rec[RECORD_LEN];
+    RID rid;
+    long logical, physical, writes;
+    int err;
+
+    if (RM_OpenFile(TEST_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    PF_ResetStats();
+    *expectSum = 0;
+    RM_ScanOpen(&fh, &sh);
+    while ((err = RM_GetNextRec(&sh, rec, &rid)) == PFE_OK)
+        *expectSum += rid_key(&rid);
+    RM_ScanClose(&sh);
+    PF_GetStats(&logical, &physical, &writes);
+    RM_CloseFile(&fh);
+    return physical;
+}
+
+int main() {
+    RM_FileHandle fh;
+    RID rid;
+    char rec[RECORD_LEN];
+    RM_SpaceStats stats;
+    long expectSum, single, indep, shared;
+    int i, err, stagger;
+    int staggers[2];
+
+    RM_Init();
+    RM_DestroyFile(TEST_FILE);
+    if (RM_CreateFile(TEST_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(TEST_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    printf("Loading %d records of %d bytes...\n", NUM_RECORDS, RECORD_LEN);
+    for (i = 0; i < NUM_RECORDS; i++) {
+        memset(rec, 'a' + i % 26, RECORD_LEN);
+        sprintf(rec, "Record %d", i);
+        err = RM_InsertRec(&fh, rec, RECORD_LEN, &rid);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+    RM_GetSpaceStats(&fh, &stats, FALSE);
+    RM_CloseFile(&fh);
+
+    single = run_single(&expectSum);
+    printf("File: %d data pages; one scan reads %ld pages from disk\n\n", stats.numPages, single);
+
+    // Clients that arrive together, and clients that arrive a quarter
+    // of the file apart
+    staggers[0] = 0;
+    staggers[1] = NUM_RECORDS / NUM_SCANS;
+    printf("%d clients        independent     shared   (physical reads)\n", NUM_SCANS);
+    for (i = 0; i < 2; i++) {
+        stagger = staggers[i];
+        indep = run_clients(0, stagger, expectSum);
+        shared = run_clients(1, stagger, expectSum);
+        printf("%-16s %11ld %10ld   (%.2fx vs %.2fx one scan)\n",
+               stagger == 0 ? "together" : "staggered", indep, shared,
+               (double)indep / single, (double)shared / single);
+        if (shared > indep || (stagger == 0 && shared > single + NUM_SCANS)) {
+            printf("*** ERROR: shared scans did not save I/O ***\n");
+            exit(1);
+        }
+    }
+
+    RM_DestroyFile(TEST_FILE);
+    printf("\n*** Shared Scan Test Passed! ***\n");
+    return 0;
+}
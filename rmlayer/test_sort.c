@@ -0,0 +1,248 @@
+/* test_sort.c: Benchmark for the external merge sort (RM_SortOpen / RM_SortFile) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../pflayer/pf.h"
+#include "rm.h"
+
+#define INPUT_FILE "sort_input.db"
+#define OUTPUT_FILE "sort_output.db"
+#define RECORD_LEN 64
+#define MEM_PAGES 32 /* Main memory budget */
+#define INPUT_FACTOR 10 /* Input size as a multiple of the budget */
+#define NUM_RECORDS (INPUT_FACTOR * MEM_PAGES * PF_PAGE_SIZE / RECORD_LEN)
+#define LARGE_FILE "sort_large.db"
+#define LARGE_RECORDS 300
+#define LARGE_MAX_LEN 24000 /* Longer than a 4-page budget */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The sort key is the int at offset 0 of each record */
+static int key_cmp(void *arg, const char *rec1, int len1, const char *rec2, int len2) {
+    int k1, k2;
+    memcpy(&k1, rec1, sizeof(int));
+    memcpy(&k2, rec2, sizeof(int));
+    return (k1 > k2) - (k1 < k2);
+}
+
+static int qsort_cmp(const void *a, const void *b) {
+    return key_cmp(NULL, (const char *)a, RECORD_LEN, (const char *)b, RECORD_LEN);
+}
+
+/* Checks order and count of a sort's output; returns elapsed time */
+static double run_sort(RM_FileHandle *fh, int memPages, RM_SortHandle *sh) {
+    char rec[PF_PAGE_SIZE];
+    int len, key, prev = -1, err;
+    long count = 0;
+    double t0 = now_sec();
+
+    err = RM_SortOpen(fh, key_cmp, NULL, memPages, sh);
+    if (err != PFE_OK) { printf("RM_SortOpen failed: %d\n", err); exit(1); }
+    while ((err = RM_SortGetNext(sh, rec, &len)) == PFE_OK) {
+        memcpy(&key, rec, sizeof(int));
+        if (key < prev || len != RECORD_LEN) {
+            printf("*** ERROR: sort output out of order at record %ld ***\n", count);
+            exit(1);
+        }
+        prev = key;
+        count++;
+    }
+    if (err != RM_EOF || count != NUM_RECORDS) {
+        printf("*** ERROR: sort returned %ld records (err %d), expected %d ***\n",
+               count, err, NUM_RECORDS);
+        exit(1);
+    }
+    return now_sec() - t0;
+}
+
+/* Length of large-input record i: small, page-sized, or many pages */
+static int large_len(int i) {
+    switch (i % 4) {
+    case 0: return 64;
+    case 1: return 3000 + i;
+    case 2: return 5000 + (i * 37) % 9000;
+    default: return LARGE_MAX_LEN - i;
+    }
+}
+
+/* Fills a large-input record: its key, then bytes derived from the key */
+static void large_fill(char *rec, int key, int len) {
+    int j;
+
+    memcpy(rec, &key, sizeof(int));
+    for (j = sizeof(int); j < len; j++)
+        rec[j] = (char)((key + j) % 251);
+}
+
+/* Checks one record of the large input's sorted output */
+static void large_check(const char *rec, int len, int *prev, long count) {
+    static char expect[LARGE_MAX_LEN];
+    int key;
+
+    memcpy(&key, rec, sizeof(int));
+    large_fill(expect, key, len);
+    if (key < *prev || len != large_len(key % LARGE_RECORDS) || memcmp(rec, expect, len) != 0) {
+        printf("*** ERROR: large record %ld (key %d, len %d) is wrong ***\n", count, key, len);
+        exit(1);
+    }
+    *prev = key;
+}
+
+/*
+ * Records longer than a page (overflow records) and longer than the
+ * whole budget: runs must carry them across pages
+ */
+static void test_large_records(void) {
+    static char rec[LARGE_MAX_LEN];
+    int budgets[] = {4, 8, 64};
+    RM_FileHandle fh, out;
+    RM_SortHandle sh;
+    RM_ScanHandle scan;
+    RID rid;
+    char *buf;
+    int i, b, key, len, prev, err;
+    long count;
+
+    RM_DestroyFile(LARGE_FILE);
+    RM_DestroyFile(OUTPUT_FILE);
+    if (RM_CreateFile(LARGE_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(LARGE_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    for (i = 0; i < LARGE_RECORDS; i++) {
+        key = ((i * 7919) % LARGE_RECORDS) + LARGE_RECORDS; // A permutation, so key % N names i
+        len = large_len(key % LARGE_RECORDS);
+        large_fill(rec, key, len);
+        err = RM_InsertRec(&fh, rec, len, &rid);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+
+    // 1. Through the iterator, under budgets smaller and larger than a record
+    for (b = 0; b < (int)(sizeof(budgets) / sizeof(budgets[0])); b++) {
+        err = RM_SortOpen(&fh, key_cmp, NULL, budgets[b], &sh);
+        if (err != PFE_OK) { printf("RM_SortOpen of large records failed: %d\n", err); exit(1); }
+        buf = malloc(sh.maxRecLen);
+        prev = -1;
+        count = 0;
+        while ((err = RM_SortGetNext(&sh, buf, &len)) == PFE_OK)
+            large_check(buf, len, &prev, count++);
+        if (err != RM_EOF || count != LARGE_RECORDS) {
+            printf("*** ERROR: large sort returned %ld records (err %d) ***\n", count, err);
+            exit(1);
+        }
+        printf("Large records, %2d-page budget: %ld records up to %d bytes, %ld run pages, %d passes\n",
+               budgets[b], count, sh.maxRecLen, sh.numSpilled, sh.numPasses);
+        free(buf);
+        RM_SortClose(&sh);
+    }
+
+    // 2. Into an output file
+    err = RM_SortFile(&fh, key_cmp, NULL, 4, OUTPUT_FILE);
+    if (err != PFE_OK) { printf("RM_SortFile of large records failed: %d\n", err); exit(1); }
+    if (RM_OpenFile(OUTPUT_FILE, &out) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    RM_ScanOpen(&out, &scan);
+    prev = -1;
+    count = 0;
+    while ((err = RM_GetNextRec(&scan, rec, &rid)) == PFE_OK) {
+        memcpy(&key, rec, sizeof(int));
+        large_check(rec, large_len(key % LARGE_RECORDS), &prev, count++);
+    }
+    RM_ScanClose(&scan);
+    RM_CloseFile(&out);
+    if (count != LARGE_RECORDS) {
+        printf("*** ERROR: %s holds %ld large records ***\n", OUTPUT_FILE, count);
+        exit(1);
+    }
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(LARGE_FILE);
+    RM_DestroyFile(OUTPUT_FILE);
+}
+
+int main(void) {
+    RM_FileHandle fh, out;
+    RM_SortHandle sh;
+    RM_ScanHandle scan;
+    RID rid;
+    char rec[RECORD_LEN];
+    char *all;
+    int budgets[] = {MEM_PAGES * INPUT_FACTOR * 2, MEM_PAGES, 8, 4};
+    int i, b, key, prev, err;
+    long count;
+    double t0, elapsed;
+
+    RM_Init();
+    RM_DestroyFile(INPUT_FILE);
+    RM_DestroyFile(OUTPUT_FILE);
+
+    // 1. Populate the input with random keys
+    if (RM_CreateFile(INPUT_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(INPUT_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    all = malloc((long)NUM_RECORDS * RECORD_LEN);
+    srand(42);
+    printf("Populating %s with %d records of %d bytes (%dx a %d-page budget)...\n",
+           INPUT_FILE, NUM_RECORDS, RECORD_LEN, INPUT_FACTOR, MEM_PAGES);
+    for (i = 0; i < NUM_RECORDS; i++) {
+        memset(rec, 0, RECORD_LEN);
+        key = rand();
+        memcpy(rec, &key, sizeof(int));
+        sprintf(rec + sizeof(int), "Sort record %d", i);
+        memcpy(all + (long)i * RECORD_LEN, rec, RECORD_LEN);
+        err = RM_InsertRec(&fh, rec, RECORD_LEN, &rid);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+
+    // 2. Baseline: sort everything in application memory
+    t0 = now_sec();
+    qsort(all, NUM_RECORDS, RECORD_LEN, qsort_cmp);
+    printf("In-memory qsort of all records: %.4f sec\n\n", now_sec() - t0);
+    free(all);
+
+    // 3. External sort (to the iterator) under several budgets
+    printf("| Budget (pages) | Input / Budget | Time (sec) | Run Pages Written | Merge Passes |\n");
+    printf("|----------------|----------------|------------|-------------------|--------------|\n");
+    for (b = 0; b < (int)(sizeof(budgets) / sizeof(budgets[0])); b++) {
+        elapsed = run_sort(&fh, budgets[b], &sh);
+        printf("| %-14d | %-14.1f | %-10.4f | %-17ld | %-12d |\n", budgets[b],
+               (double)NUM_RECORDS * RECORD_LEN / (budgets[b] * (double)PF_PAGE_SIZE),
+               elapsed, sh.numSpilled, sh.numPasses);
+        RM_SortClose(&sh);
+    }
+
+    // 4. Sort into an output RM file and check it with a plain scan
+    t0 = now_sec();
+    err = RM_SortFile(&fh, key_cmp, NULL, MEM_PAGES, OUTPUT_FILE);
+    if (err != PFE_OK) { printf("RM_SortFile failed: %d\n", err); exit(1); }
+    elapsed = now_sec() - t0;
+
+    if (RM_OpenFile(OUTPUT_FILE, &out) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    RM_ScanOpen(&out, &scan);
+    prev = -1;
+    count = 0;
+    while ((err = RM_GetNextRec(&scan, rec, &rid)) == PFE_OK) {
+        memcpy(&key, rec, sizeof(int));
+        if (key < prev) { printf("*** ERROR: %s is not sorted ***\n", OUTPUT_FILE); exit(1); }
+        prev = key;
+        count++;
+    }
+    RM_ScanClose(&scan);
+    RM_CloseFile(&out);
+    if (count != NUM_RECORDS) {
+        printf("*** ERROR: %s holds %ld records, expected %d ***\n", OUTPUT_FILE, count, NUM_RECORDS);
+        exit(1);
+    }
+    printf("\nRM_SortFile into %s (%d-page budget): %.4f sec\n", OUTPUT_FILE, MEM_PAGES, elapsed);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(INPUT_FILE);
+    RM_DestroyFile(OUTPUT_FILE);
+
+    // 5. Records longer than a page
+    printf("\n");
+    test_large_records();
+    printf("\n*** External Sort Test Passed! ***\n");
+    return 0;
+}
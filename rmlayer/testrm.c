@@ -9,12 +9,746 @@
 #define TEST_FILE "testfile.db"
 #define NUM_RECORDS 50
 #define MAX_RECORD_LEN 100
+#define FIXED_FILE "fixedfile.db"
+#define FIXED_RECORD_LEN 24
+#define DENSITY_FILE "densityfile.db"
+#define DENSITY_RECORDS 5000
+#define UPDATE_FILE "updatefile.db"
+#define UPDATE_RECORDS 400
+#define DIR_FILE "dirfile.db"
+#define DIR_RECORDS 1000
+#define LARGE_FILE "largefile.db"
+#define LARGE_RECORDS 12
+#define LARGE_MAX_LEN 20000
+#define LARGE_REUSED 5 /* Large record rewritten over and over */
+#define APPEND_FILE "appendfile.db"
+#define APPEND_RECORDS 10000
+#define BIG_FILE "bigfile.db"
+#define BIG_RECORD_LEN 2000 /* Two records per page */
+#define BIG_PAGES (RM_DIR_MAXPAGES + 2000)
 
 // Function to print a record's data (first 20 bytes)
 void print_record(char *data, int len) {
     printf(" (len %d) '%.*s...'", len, len > 20 ? 20 : len, data);
 }
 
+// Fixed-length mode: O(1) slot lookup, bitmap slots, reuse of freed slots
+void test_fixed_length(void) {
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    RID rids[NUM_RECORDS], rid;
+    char rec[FIXED_RECORD_LEN], get_buf[MAX_RECORD_LEN];
+    int i, err, found = 0;
+    int total_pages, total_record_bytes, total_wasted_bytes;
+    RM_SpaceStats stats;
+
+    printf("\n--- Fixed-length file (%d-byte records) ---\n", FIXED_RECORD_LEN);
+    RM_DestroyFile(FIXED_FILE);
+    err = RM_CreateFileFormat(FIXED_FILE, RM_FORMAT_FIXED, FIXED_RECORD_LEN);
+    if (err != PFE_OK) { printf("RM_CreateFileFormat failed: %d\n", err); exit(1); }
+    err = RM_OpenFile(FIXED_FILE, &fh);
+    if (err != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    for (i = 0; i < NUM_RECORDS; i++) {
+        memset(rec, 0, FIXED_RECORD_LEN);
+        sprintf(rec, "Fixed %d", i);
+        err = RM_InsertRec(&fh, rec, FIXED_RECORD_LEN, &rids[i]);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+    if (RM_InsertRec(&fh, rec, FIXED_RECORD_LEN - 1, &rid) != RM_INVALID_RECLEN) {
+        printf("*** ERROR: short record accepted by a fixed-length file ***\n");
+        exit(1);
+    }
+
+    for (i = 0; i < NUM_RECORDS; i += 3) {
+        err = RM_DeleteRec(&fh, &rids[i]);
+        if (err != PFE_OK) { printf("RM_DeleteRec failed: %d\n", err); exit(1); }
+    }
+
+    RM_ScanOpen(&fh, &sh);
+    while ((err = RM_GetNextRec(&sh, get_buf, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+        if (rid.slotNum % 3 == 0) {
+            printf("*** ERROR: Found deleted fixed record %d ***\n", rid.slotNum);
+            exit(1);
+        }
+        found++;
+    }
+    RM_ScanClose(&sh);
+
+    // A new record reuses the first freed slot
+    err = RM_InsertRec(&fh, rec, FIXED_RECORD_LEN, &rid);
+    if (err != PFE_OK || rid.pageNum != rids[0].pageNum || rid.slotNum != rids[0].slotNum) {
+        printf("*** ERROR: freed slot was not reused ***\n");
+        exit(1);
+    }
+    err = RM_GetRec(&fh, &rid, get_buf);
+    if (err != PFE_OK || memcmp(get_buf, rec, FIXED_RECORD_LEN) != 0) {
+        printf("*** ERROR: RM_GetRec returned the wrong fixed record ***\n");
+        exit(1);
+    }
+
+    if (RM_GetSpaceStats(&fh, &stats, TRUE) != PFE_OK || stats.deadBytes != 0) {
+        printf("*** ERROR: fixed-length space counters are wrong ***\n");
+        exit(1);
+    }
+    RM_GetSpaceUtilization(&fh, &total_pages, &total_record_bytes, &total_wasted_bytes);
+    printf("Found %d records; %d records per page; utilization %.2f%%\n",
+           found, fh.hdr.recsPerPage,
+           100.0 * total_record_bytes / (total_pages * (double)PF_PAGE_SIZE));
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(FIXED_FILE);
+}
+
+/*
+ * Loads the same short records into a file of the given format, checks
+ * that deletes still tombstone correctly, and reports the page count.
+ */
+int load_density_file(int pageFormat, const char *label) {
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    RID rid, first_rid;
+    char rec[MAX_RECORD_LEN];
+    int i, err, found = 0;
+    int total_pages, total_record_bytes, total_wasted_bytes;
+    RM_SpaceStats stats;
+
+    RM_DestroyFile(DENSITY_FILE);
+    err = RM_CreateFileFormat(DENSITY_FILE, pageFormat, 0);
+    if (err != PFE_OK) { printf("RM_CreateFileFormat failed: %d\n", err); exit(1); }
+    err = RM_OpenFile(DENSITY_FILE, &fh);
+    if (err != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    for (i = 0; i < DENSITY_RECORDS; i++) {
+        sprintf(rec, "Student_Name_%d", i);
+        err = RM_InsertRec(&fh, rec, strlen(rec) + 1, &rid);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+        if (i == 0)
+            first_rid = rid;
+    }
+
+    err = RM_DeleteRec(&fh, &first_rid);
+    if (err != PFE_OK) { printf("RM_DeleteRec failed: %d\n", err); exit(1); }
+    if (RM_GetRec(&fh, &first_rid, rec) != RM_RECORD_DELETED) {
+        printf("*** ERROR: %s tombstone not honoured by RM_GetRec ***\n", label);
+        exit(1);
+    }
+
+    RM_ScanOpen(&fh, &sh);
+    while ((err = RM_GetNextRec(&sh, rec, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+        found++;
+    }
+    RM_ScanClose(&sh);
+    if (found != DENSITY_RECORDS - 1) {
+        printf("*** ERROR: %s scan found %d records, expected %d ***\n",
+               label, found, DENSITY_RECORDS - 1);
+        exit(1);
+    }
+
+    // The counters must survive a close and reopen
+    RM_CloseFile(&fh);
+    err = RM_OpenFile(DENSITY_FILE, &fh);
+    if (err != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    if (RM_GetSpaceStats(&fh, &stats, TRUE) != PFE_OK || stats.numRecs != found) {
+        printf("*** ERROR: %s space counters lost across reopen ***\n", label);
+        exit(1);
+    }
+
+    RM_GetSpaceUtilization(&fh, &total_pages, &total_record_bytes, &total_wasted_bytes);
+    printf("| %-8s | %-5d | %-12d | %10.2f%% |\n", label, total_pages,
+           total_record_bytes, 100.0 * total_record_bytes / (total_pages * (double)PF_PAGE_SIZE));
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(DENSITY_FILE);
+    return total_pages;
+}
+
+void test_compact_density(void) {
+    int slotted_pages, compact_pages;
+
+    printf("\n--- Slot directory density (%d records) ---\n", DENSITY_RECORDS);
+    printf("| Format   | Pages | Record Bytes | Utilization |\n");
+    printf("|----------|-------|--------------|-------------|\n");
+    slotted_pages = load_density_file(RM_FORMAT_SLOTTED, "slotted");
+    compact_pages = load_density_file(RM_FORMAT_COMPACT, "compact");
+    if (compact_pages > slotted_pages) {
+        printf("*** ERROR: compact slots used more pages than int slots ***\n");
+        exit(1);
+    }
+}
+
+/* Builds the expected contents of record i after `version` updates */
+int make_update_record(char *buf, int i, int version) {
+    int len = (version == 0) ? 24 : (version == 1) ? 8 : 300;
+
+    memset(buf, 'a' + (i + version) % 26, len);
+    sprintf(buf, "R%d.%d", i, version);
+    buf[strlen(buf)] = '-';
+    return len;
+}
+
+void check_update_file(RM_FileHandle *fh, RID *rids, int *versions, const char *when) {
+    RM_ScanHandle sh;
+    RM_SpaceStats stats;
+    RID rid;
+    char expect[MAX_RECORD_LEN * 4], got[PF_PAGE_SIZE];
+    int seen[UPDATE_RECORDS];
+    int i, len, err, found = 0;
+
+    // 1. Every RID still returns the latest version
+    for (i = 0; i < UPDATE_RECORDS; i++) {
+        len = make_update_record(expect, i, versions[i]);
+        err = RM_GetRec(fh, &rids[i], got);
+        if (err != PFE_OK || memcmp(got, expect, len) != 0) {
+            printf("*** ERROR (%s): RM_GetRec on record %d returned %d ***\n", when, i, err);
+            exit(1);
+        }
+    }
+
+    // 2. A scan visits each record once, under its original RID
+    memset(seen, 0, sizeof(seen));
+    RM_ScanOpen(fh, &sh);
+    while ((err = RM_GetNextRec(&sh, got, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+        i = atoi(got + 1);
+        if (i < 0 || i >= UPDATE_RECORDS || seen[i] ||
+            rid.pageNum != rids[i].pageNum || rid.slotNum != rids[i].slotNum) {
+            printf("*** ERROR (%s): scan returned record %d under the wrong RID ***\n", when, i);
+            exit(1);
+        }
+        seen[i] = 1;
+        found++;
+    }
+    RM_ScanClose(&sh);
+    if (found != UPDATE_RECORDS) {
+        printf("*** ERROR (%s): scan found %d records, expected %d ***\n", when, found, UPDATE_RECORDS);
+        exit(1);
+    }
+
+    // 3. The incremental counters still match the pages
+    err = RM_GetSpaceStats(fh, &stats, TRUE);
+    if (err != PFE_OK) {
+        printf("*** ERROR (%s): space counters disagree with a full scan ***\n", when);
+        exit(1);
+    }
+    printf("%-22s %d pages, %d live bytes, %d dead bytes\n",
+           when, stats.numPages, stats.recordBytes, stats.deadBytes);
+}
+
+void test_update(void) {
+    RM_FileHandle fh;
+    RID rids[UPDATE_RECORDS], victim;
+    int versions[UPDATE_RECORDS];
+    char rec[MAX_RECORD_LEN * 4];
+    int i, len, err;
+
+    printf("\n--- In-place updates and forwarding (%d records) ---\n", UPDATE_RECORDS);
+    RM_DestroyFile(UPDATE_FILE);
+    if (RM_CreateFile(UPDATE_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(UPDATE_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    for (i = 0; i < UPDATE_RECORDS; i++) {
+        versions[i] = 0;
+        len = make_update_record(rec, i, 0);
+        err = RM_InsertRec(&fh, rec, len, &rids[i]);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+    check_update_file(&fh, rids, versions, "after insert:");
+
+    // 1. Shrink every other record: always fits in place
+    for (i = 0; i < UPDATE_RECORDS; i += 2) {
+        versions[i] = 1;
+        len = make_update_record(rec, i, 1);
+        err = RM_UpdateRec(&fh, &rids[i], rec, len);
+        if (err != PFE_OK) { printf("RM_UpdateRec (shrink) failed: %d\n", err); exit(1); }
+    }
+    check_update_file(&fh, rids, versions, "after shrink:");
+
+    // 2. Grow every third record well past its page's free space
+    for (i = 0; i < UPDATE_RECORDS; i += 3) {
+        versions[i] = 2;
+        len = make_update_record(rec, i, 2);
+        err = RM_UpdateRec(&fh, &rids[i], rec, len);
+        if (err != PFE_OK) { printf("RM_UpdateRec (grow) failed: %d\n", err); exit(1); }
+    }
+    check_update_file(&fh, rids, versions, "after grow:");
+
+    // 3. Shrink some moved records again: they return home when they fit
+    for (i = 0; i < UPDATE_RECORDS; i += 6) {
+        versions[i] = 1;
+        len = make_update_record(rec, i, 1);
+        err = RM_UpdateRec(&fh, &rids[i], rec, len);
+        if (err != PFE_OK) { printf("RM_UpdateRec (move back) failed: %d\n", err); exit(1); }
+    }
+    check_update_file(&fh, rids, versions, "after shrink again:");
+
+    // 4. Deleting a forwarded record frees both slots
+    victim = rids[3];
+    if (RM_DeleteRec(&fh, &victim) != PFE_OK || RM_GetRec(&fh, &victim, rec) != RM_RECORD_DELETED) {
+        printf("*** ERROR: forwarded record was not deleted ***\n");
+        exit(1);
+    }
+    len = make_update_record(rec, 3, versions[3]);
+    RM_InsertRec(&fh, rec, len, &rids[3]);
+
+    // 5. Compaction reclaims holes and pulls moved records home
+    err = RM_CompactFile(&fh);
+    if (err != PFE_OK) { printf("RM_CompactFile failed: %d\n", err); exit(1); }
+    check_update_file(&fh, rids, versions, "after compaction:");
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(UPDATE_FILE);
+}
+
+/* Parallel scan callback: counts records */
+int count_cb(void *arg, const char *record_data, int record_len, const RID *rid) {
+    (*(int *)arg)++;
+    return PFE_OK;
+}
+
+/* Counts the records a sequential scan returns */
+int count_scan(RM_FileHandle *fh) {
+    RM_ScanHandle sh;
+    RID rid;
+    char buf[MAX_RECORD_LEN];
+    int err, found = 0;
+
+    RM_ScanOpen(fh, &sh);
+    while ((err = RM_GetNextRec(&sh, buf, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+        found++;
+    }
+    RM_ScanClose(&sh);
+    return found;
+}
+
+void test_page_directory(void) {
+    RM_FileHandle fh, fh2;
+    RM_FileHeader hdr;
+    RM_SpaceStats stats;
+    char *hdrPage;
+    RID rids[DIR_RECORDS], rid;
+    char rec[MAX_RECORD_LEN];
+    int i, err, hole, deleted = 0, found, pfound = 0;
+    int pages_before, reused = 0;
+    void *args[1];
+
+    printf("\n--- Page directory and freed pages ---\n");
+    RM_DestroyFile(DIR_FILE);
+    if (RM_CreateFile(DIR_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(DIR_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    for (i = 0; i < DIR_RECORDS; i++) {
+        sprintf(rec, "Directory record %d", i);
+        err = RM_InsertRec(&fh, rec, strlen(rec) + 1, &rids[i]);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+
+    // 1. Empty out a page in the middle of the file and compact it away
+    hole = rids[DIR_RECORDS / 2].pageNum;
+    for (i = 0; i < DIR_RECORDS; i++) {
+        if (rids[i].pageNum == hole) {
+            RM_DeleteRec(&fh, &rids[i]);
+            deleted++;
+        }
+    }
+    RM_GetSpaceStats(&fh, &stats, FALSE);
+    pages_before = stats.numPages;
+    err = RM_CompactFile(&fh);
+    if (err != PFE_OK) { printf("RM_CompactFile failed: %d\n", err); exit(1); }
+    RM_GetSpaceStats(&fh, &stats, FALSE);
+    if (stats.numPages != pages_before - 1 ||
+        RM_GetRec(&fh, &rids[DIR_RECORDS / 2], rec) != RM_INVALID_RID) {
+        printf("*** ERROR: empty page %d was not disposed ***\n", hole);
+        exit(1);
+    }
+
+    // 2. Both scans must step over the hole instead of stopping at it
+    found = count_scan(&fh);
+    args[0] = &pfound;
+    err = RM_ParallelScan(&fh, 1, count_cb, args);
+    if (err != PFE_OK || found != DIR_RECORDS - deleted || pfound != found) {
+        printf("*** ERROR: scans found %d/%d records across the hole, expected %d ***\n",
+               found, pfound, DIR_RECORDS - deleted);
+        exit(1);
+    }
+    printf("Disposed page %d; scan found %d records on %d pages\n", hole, found, stats.numPages);
+
+    // 3. RM_FlushFile brings the counters to page 0 before close, and
+    //    a second handle on the file is refused
+    err = RM_FlushFile(&fh);
+    if (err != PFE_OK) { PF_PrintError("RM_FlushFile"); exit(1); }
+    err = PF_GetThisPage(fh.pf_fd, 0, &hdrPage);
+    if (err != PFE_OK) { PF_PrintError("PF_GetThisPage"); exit(1); }
+    memcpy(&hdr, hdrPage, sizeof(RM_FileHeader));
+    PF_UnfixPage(fh.pf_fd, 0, FALSE);
+    if (memcmp(&hdr.stats, &stats, sizeof(RM_SpaceStats)) != 0) {
+        printf("*** ERROR: page 0 holds stale counters (%d pages, %d records) ***\n",
+               hdr.stats.numPages, hdr.stats.numRecs);
+        exit(1);
+    }
+    err = RM_OpenFile(DIR_FILE, &fh2);
+    if (err != PFE_FILEOPEN) {
+        printf("*** ERROR: second open of an open file returned %d ***\n", err);
+        exit(1);
+    }
+
+    // 4. The directory survives a reopen, and new pages reuse the hole
+    RM_CloseFile(&fh);
+    if (RM_OpenFile(DIR_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    for (i = 0; i < deleted; i++) {
+        sprintf(rec, "Directory record %d (again), padded to fill the free space", i);
+        err = RM_InsertRec(&fh, rec, strlen(rec) + 1, &rid);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+        if (rid.pageNum == hole)
+            reused++;
+    }
+    if (reused == 0) {
+        printf("*** ERROR: no record went back to freed page %d ***\n", hole);
+        exit(1);
+    }
+    found = count_scan(&fh);
+    if (found != DIR_RECORDS || RM_GetSpaceStats(&fh, &stats, TRUE) != PFE_OK) {
+        printf("*** ERROR: file is inconsistent after refilling the hole (%d records) ***\n", found);
+        exit(1);
+    }
+    printf("Refilled: %d records on %d pages, %d of them on page %d\n", found, stats.numPages, reused, hole);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(DIR_FILE);
+}
+
+/*
+ * A file larger than the part of the page directory kept on page 0:
+ * the directory must grow onto pages of its own, survive a reopen and
+ * still let compaction free a page past the first RM_DIR_MAXPAGES.
+ */
+void test_big_file(void) {
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    RM_SpaceStats stats;
+    RID rid, hole[2];
+    char rec[BIG_RECORD_LEN];
+    int i, err, found, numRecs = 2 * BIG_PAGES;
+
+    printf("\n--- Files past %d pages ---\n", RM_DIR_MAXPAGES);
+    RM_DestroyFile(BIG_FILE);
+    if (RM_CreateFileFormat(BIG_FILE, RM_FORMAT_FIXED, BIG_RECORD_LEN) != PFE_OK) { PF_PrintError("RM_CreateFileFormat"); exit(1); }
+    if (RM_OpenFileFlags(BIG_FILE, &fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFileFlags"); exit(1); }
+
+    // 1. Append until the file is well past the end of page 0's bitmap
+    memset(rec, 'b', sizeof(rec));
+    for (i = 0; i < numRecs; i++) {
+        memcpy(rec, &i, sizeof(int));
+        err = RM_InsertRec(&fh, rec, BIG_RECORD_LEN, &rid);
+        if (err != PFE_OK) { printf("*** ERROR: insert %d failed: %d ***\n", i, err); exit(1); }
+        if (i == numRecs - 1000 || i == numRecs - 999)
+            hole[i - (numRecs - 1000)] = rid;
+    }
+    RM_GetSpaceStats(&fh, &stats, FALSE);
+    if (stats.numPages != BIG_PAGES || hole[0].pageNum <= RM_DIR_MAXPAGES ||
+        hole[1].pageNum != hole[0].pageNum) {
+        printf("*** ERROR: %d records made %d pages, expected %d ***\n", numRecs, stats.numPages, BIG_PAGES);
+        exit(1);
+    }
+
+    // 2. Empty a page past RM_DIR_MAXPAGES and compact it away
+    RM_DeleteRec(&fh, &hole[0]);
+    RM_DeleteRec(&fh, &hole[1]);
+    err = RM_CompactFile(&fh);
+    if (err != PFE_OK) { printf("RM_CompactFile failed: %d\n", err); exit(1); }
+    RM_CloseFile(&fh);
+
+    // 3. After a reopen the whole directory is back: counters and scan
+    //    agree, and the next page allocated is the one compaction freed
+    if (RM_OpenFile(BIG_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    found = 0;
+    RM_ScanOpen(&fh, &sh);
+    while (RM_GetNextRec(&sh, rec, &rid) == PFE_OK)
+        found++;
+    RM_ScanClose(&sh);
+    err = RM_GetSpaceStats(&fh, &stats, TRUE);
+    if (err != PFE_OK || found != numRecs - 2 || stats.numPages != BIG_PAGES - 1) {
+        printf("*** ERROR: reopened file has %d records on %d pages (err %d) ***\n",
+               found, stats.numPages, err);
+        exit(1);
+    }
+    err = RM_InsertRec(&fh, rec, BIG_RECORD_LEN, &rid);
+    if (err != PFE_OK || rid.pageNum != hole[0].pageNum) {
+        printf("*** ERROR: insert went to page %d, freed page was %d ***\n", rid.pageNum, hole[0].pageNum);
+        exit(1);
+    }
+    printf("%d pages; freed page %d reused after reopen\n", stats.numPages, rid.pageNum);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(BIG_FILE);
+}
+
+/* Fills a large record with a pattern that depends on i and the position */
+int make_large_record(char *buf, int i, int len) {
+    int j;
+    for (j = 0; j < len; j++)
+        buf[j] = (char)((i * 7 + j) % 251);
+    return len;
+}
+
+/* Large records i use lengths[i]; -1 marks a deleted one */
+void check_large_file(RM_FileHandle *fh, RID *rids, int *lengths, const char *when) {
+    static char expect[LARGE_MAX_LEN], got[LARGE_MAX_LEN];
+    RM_RecStream rs;
+    RM_SpaceStats stats;
+    int i, n, pos, err;
+
+    for (i = 0; i < LARGE_RECORDS; i++) {
+        if (lengths[i] < 0)
+            continue;
+        make_large_record(expect, i, lengths[i]);
+
+        // 1. Whole-record reads
+        err = RM_GetRec(fh, &rids[i], got);
+        if (err != PFE_OK || memcmp(got, expect, lengths[i]) != 0) {
+            printf("*** ERROR %s: RM_GetRec of record %d (len %d) failed: %d ***\n",
+                   when, i, lengths[i], err);
+            exit(1);
+        }
+
+        // 2. Streaming reads in odd-sized chunks that straddle pages
+        err = RM_OpenRecStream(fh, &rids[i], &rs);
+        if (err != PFE_OK || rs.length != lengths[i]) {
+            printf("*** ERROR %s: RM_OpenRecStream of record %d failed: %d ***\n", when, i, err);
+            exit(1);
+        }
+        pos = 0;
+        while ((err = RM_ReadRecStream(&rs, got + pos, 1000, &n)) == PFE_OK)
+            pos += n;
+        RM_CloseRecStream(&rs);
+        if (err != RM_EOF || pos != lengths[i] || memcmp(got, expect, pos) != 0) {
+            printf("*** ERROR %s: streamed record %d is wrong (%d of %d bytes) ***\n",
+                   when, i, pos, lengths[i]);
+            exit(1);
+        }
+    }
+
+    // 3. The stored counters still match the pages
+    err = RM_GetSpaceStats(fh, &stats, TRUE);
+    if (err != PFE_OK) {
+        printf("*** ERROR %s: space counters do not match the pages: %d ***\n", when, err);
+        exit(1);
+    }
+    printf("%-18s %d records, %d data pages, %d overflow pages\n",
+           when, stats.numRecs, stats.numPages, stats.overflowPages);
+}
+
+void test_large_records(void) {
+    static char rec[LARGE_MAX_LEN];
+    RM_FileHandle fh;
+    RM_ScanHandle sh;
+    RID rids[LARGE_RECORDS], rid;
+    int lengths[LARGE_RECORDS];
+    RM_SpaceStats stats;
+    int i, err, found = 0, pfound = 0, len;
+    int total, pages = 0;
+    void *args[1];
+
+    printf("\n--- Large records in overflow extents ---\n");
+    RM_DestroyFile(LARGE_FILE);
+    if (RM_CreateFile(LARGE_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFile(LARGE_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+
+    // 1. Mix small records with ones from just over the threshold up to
+    //    several pages
+    for (i = 0; i < LARGE_RECORDS; i++) {
+        lengths[i] = (i % 3 == 0) ? 40 + i : RM_OVERFLOW_THRESHOLD + 1 + i * 1500;
+        make_large_record(rec, i, lengths[i]);
+        err = RM_InsertRec(&fh, rec, lengths[i], &rids[i]);
+        if (err != PFE_OK) { printf("RM_InsertRec (len %d) failed: %d\n", lengths[i], err); exit(1); }
+        if (lengths[i] > RM_OVERFLOW_THRESHOLD)
+            pages += (lengths[i] + PF_PAGE_SIZE - 1) / PF_PAGE_SIZE;
+    }
+    check_large_file(&fh, rids, lengths, "after insert:");
+
+    // 2. Extents take no more pages than their bytes need, and every
+    //    page of the file is either the header, a data page or overflow
+    PF_GetNumPages(fh.pf_fd, &total);
+    RM_GetSpaceStats(&fh, &stats, FALSE);
+    if (stats.overflowPages != pages || stats.numPages + stats.overflowPages + 1 != total) {
+        printf("*** ERROR: expected %d overflow pages, counters say %d (file has %d pages) ***\n",
+               pages, stats.overflowPages, total);
+        exit(1);
+    }
+
+    // 3. Both scans return large records whole, under their RIDs
+    RM_ScanOpen(&fh, &sh);
+    while ((err = RM_GetNextRec(&sh, rec, &rid)) != RM_EOF) {
+        if (err != PFE_OK) { printf("RM_GetNextRec failed: %d\n", err); exit(1); }
+        for (i = 0; i < LARGE_RECORDS && (rids[i].pageNum != rid.pageNum || rids[i].slotNum != rid.slotNum); i++)
+            ;
+        len = lengths[i];
+        if (i == LARGE_RECORDS || rec[len - 1] != (char)((i * 7 + len - 1) % 251)) {
+            printf("*** ERROR: scan returned a wrong record ***\n");
+            exit(1);
+        }
+        found++;
+    }
+    RM_ScanClose(&sh);
+    args[0] = &pfound;
+    err = RM_ParallelScan(&fh, 1, count_cb, args);
+    if (err != PFE_OK || found != LARGE_RECORDS || pfound != LARGE_RECORDS) {
+        printf("*** ERROR: scans found %d/%d of %d records ***\n", found, pfound, LARGE_RECORDS);
+        exit(1);
+    }
+
+    // 4. Updates between sizes: large to larger, large to small,
+    //    small to large; deletes free the extent
+    for (i = 0; i < LARGE_RECORDS; i++) {
+        lengths[i] = (i % 3 == 1) ? 30 : (i % 3 == 0) ? LARGE_MAX_LEN - i : lengths[i] + 2000;
+        make_large_record(rec, i, lengths[i]);
+        err = RM_UpdateRec(&fh, &rids[i], rec, lengths[i]);
+        if (err != PFE_OK) { printf("RM_UpdateRec (len %d) failed: %d\n", lengths[i], err); exit(1); }
+    }
+    check_large_file(&fh, rids, lengths, "after update:");
+
+    for (i = 0; i < LARGE_RECORDS; i += 2) {
+        if (RM_DeleteRec(&fh, &rids[i]) != PFE_OK || RM_GetRec(&fh, &rids[i], rec) != RM_RECORD_DELETED) {
+            printf("*** ERROR: large record %d was not deleted ***\n", i);
+            exit(1);
+        }
+        lengths[i] = -1;
+    }
+    check_large_file(&fh, rids, lengths, "after delete:");
+
+    // 5. Everything survives a reopen
+    RM_CloseFile(&fh);
+    if (RM_OpenFile(LARGE_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+    check_large_file(&fh, rids, lengths, "after reopen:");
+
+    // 6. Rewriting one large record many times, between sizes and by
+    //    delete and reinsert, reuses its pages: the file does not grow
+    lengths[LARGE_REUSED] = LARGE_MAX_LEN;
+    make_large_record(rec, LARGE_REUSED, LARGE_MAX_LEN);
+    if (RM_UpdateRec(&fh, &rids[LARGE_REUSED], rec, LARGE_MAX_LEN) != PFE_OK) {
+        printf("RM_UpdateRec failed\n");
+        exit(1);
+    }
+    PF_GetNumPages(fh.pf_fd, &total);
+    for (i = 0; i < 200; i++) {
+        len = (i % 10 == 9) ? LARGE_MAX_LEN
+                            : RM_OVERFLOW_THRESHOLD + 1 + (i * 7919) % (LARGE_MAX_LEN - RM_OVERFLOW_THRESHOLD);
+        make_large_record(rec, LARGE_REUSED, len);
+        if (i % 10 == 9) {
+            err = RM_DeleteRec(&fh, &rids[LARGE_REUSED]);
+            if (err == PFE_OK)
+                err = RM_InsertRec(&fh, rec, len, &rids[LARGE_REUSED]);
+        } else {
+            err = RM_UpdateRec(&fh, &rids[LARGE_REUSED], rec, len);
+        }
+        if (err != PFE_OK) { printf("Rewrite %d (len %d) failed: %d\n", i, len, err); exit(1); }
+        lengths[LARGE_REUSED] = len;
+        PF_GetNumPages(fh.pf_fd, &pages);
+        if (pages != total) {
+            printf("*** ERROR: rewrite %d (len %d) grew the file from %d to %d pages ***\n",
+                   i, len, total, pages);
+            exit(1);
+        }
+        if (i == 99) {
+            // The free runs are kept in the header across a reopen
+            RM_CloseFile(&fh);
+            if (RM_OpenFile(LARGE_FILE, &fh) != PFE_OK) { PF_PrintError("RM_OpenFile"); exit(1); }
+        }
+    }
+    check_large_file(&fh, rids, lengths, "after rewrites:");
+    printf("200 rewrites of record %d kept the file at %d pages\n", LARGE_REUSED, total);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(LARGE_FILE);
+}
+
+/* Loads APPEND_RECORDS log rows with the given open flags; returns page reads */
+long load_log_file(int flags, RID *rids, double *secs) {
+    RM_FileHandle fh;
+    char rec[MAX_RECORD_LEN];
+    long logical, physical, writes;
+    clock_t start;
+    int i, err;
+
+    RM_DestroyFile(APPEND_FILE);
+    if (RM_CreateFile(APPEND_FILE) != PFE_OK) { PF_PrintError("RM_CreateFile"); exit(1); }
+    if (RM_OpenFileFlags(APPEND_FILE, &fh, flags) != PFE_OK) { PF_PrintError("RM_OpenFileFlags"); exit(1); }
+
+    PF_ResetStats();
+    start = clock();
+    for (i = 0; i < APPEND_RECORDS; i++) {
+        sprintf(rec, "%08d log entry: sensor %d reading %d", i, i % 17, (i * 31) % 1000);
+        err = RM_InsertRec(&fh, rec, strlen(rec) + 1, &rids[i]);
+        if (err != PFE_OK) { printf("RM_InsertRec failed: %d\n", err); exit(1); }
+    }
+    *secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    PF_GetStats(&logical, &physical, &writes);
+
+    RM_CloseFile(&fh);
+    return logical;
+}
+
+void test_append_mode(void) {
+    static RID rids[APPEND_RECORDS];
+    RM_FileHandle fh;
+    RM_SpaceStats stats;
+    RID rid;
+    char rec[MAX_RECORD_LEN];
+    long reads_normal, reads_append;
+    double secs_normal, secs_append;
+    int i, err, tail;
+
+    printf("\n--- Append-only inserts ---\n");
+
+    // 1. Same load both ways: each append only touches the tail page
+    //    instead of searching every page for room (two accesses per
+    //    insert: the tail page to check for room and again to insert)
+    reads_normal = load_log_file(0, rids, &secs_normal);
+    reads_append = load_log_file(RM_OPEN_APPEND, rids, &secs_append);
+    printf("%-8s %12s %10s\n", "mode", "page reads", "CPU sec");
+    printf("%-8s %12ld %10.4f\n", "search", reads_normal, secs_normal);
+    printf("%-8s %12ld %10.4f\n", "append", reads_append, secs_append);
+    if (reads_append > 2 * APPEND_RECORDS + APPEND_RECORDS / 20) {
+        printf("*** ERROR: append mode read %ld pages for %d inserts ***\n",
+               reads_append, APPEND_RECORDS);
+        exit(1);
+    }
+
+    // 2. Rows land in insertion order
+    for (i = 1; i < APPEND_RECORDS; i++) {
+        if (rids[i].pageNum < rids[i - 1].pageNum ||
+            (rids[i].pageNum == rids[i - 1].pageNum && rids[i].slotNum <= rids[i - 1].slotNum)) {
+            printf("*** ERROR: append %d went to (%d,%d) before (%d,%d) ***\n", i,
+                   rids[i].pageNum, rids[i].slotNum, rids[i - 1].pageNum, rids[i - 1].slotNum);
+            exit(1);
+        }
+    }
+
+    // 3. After a reopen, inserts continue on the tail page and space
+    //    freed earlier in the file is left alone
+    if (RM_OpenFileFlags(APPEND_FILE, &fh, RM_OPEN_APPEND) != PFE_OK) { PF_PrintError("RM_OpenFileFlags"); exit(1); }
+    tail = rids[APPEND_RECORDS - 1].pageNum;
+    for (i = 0; i < 200; i++)
+        RM_DeleteRec(&fh, &rids[i]);
+    sprintf(rec, "after reopen");
+    err = RM_InsertRec(&fh, rec, strlen(rec) + 1, &rid);
+    if (err != PFE_OK || rid.pageNum < tail) {
+        printf("*** ERROR: insert after reopen went to page %d, tail is %d ***\n", rid.pageNum, tail);
+        exit(1);
+    }
+    if (RM_GetSpaceStats(&fh, &stats, TRUE) != PFE_OK || stats.numRecs != APPEND_RECORDS - 200 + 1) {
+        printf("*** ERROR: append file is inconsistent ***\n");
+        exit(1);
+    }
+    printf("Reopened: next row on page %d (tail %d), %d pages\n", rid.pageNum, tail, stats.numPages);
+
+    RM_CloseFile(&fh);
+    RM_DestroyFile(APPEND_FILE);
+}
+
 int main() {
     RM_FileHandle fh;
     RM_ScanHandle sh;
@@ -127,6 +861,17 @@ int main() {
     printf("Bytes Used by Records: %d\n", total_record_bytes);
     printf("Bytes Wasted (header, slots, free, holes): %d\n", total_wasted_bytes);
     printf("Space Utilization (Record Data / Total Bytes): %.2f%%\n", utilization_percent);
+
+    // The counters above come from the file header; a verify pass
+    // recomputes them from every data page and must agree
+    RM_SpaceStats stats;
+    err = RM_GetSpaceStats(&fh, &stats, TRUE);
+    if (err != PFE_OK) {
+        printf("*** ERROR: space counters disagree with a full scan (%d) ***\n", err);
+        exit(1);
+    }
+    printf("Verified counters: %d live records, %d dead bytes, %d free bytes\n",
+           stats.numRecs, stats.deadBytes, stats.freeBytes);
     
     // --- 5. CLEANUP ---
     printf("\nClosing scan...\n");
@@ -151,6 +896,14 @@ int main() {
         exit(1);
     }
 
+    test_fixed_length();
+    test_compact_density();
+    test_update();
+    test_page_directory();
+    test_large_records();
+    test_append_mode();
+    test_big_file();
+
     printf("\n*** RM Layer Test Passed! ***\n");
     return 0;
 }
\ No newline at end of file